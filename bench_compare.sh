@@ -0,0 +1,97 @@
+#!/bin/sh
+############################################################################
+# bench_compare.sh - Compare two sets of loopback benchmark results
+############################################################################
+# Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+#
+# Prints a table comparing every scenario found in both results directories
+# (as written by run_bench.sh).  The server's CPU time and busy time (time
+# spent processing rather than waiting in poll) are the best measures of
+# server efficiency because the scenarios publish at a fixed rate.  Busy
+# time is missing for servers built or run without statistics.  Negative
+# changes are improvements for every metric except recv_msgs_per_sec,
+# delivery_ratio and connect_syn_data.
+#
+# Usage: bench_compare.sh <baseline results dir> <candidate results dir>
+#
+############################################################################
+
+if [ $# -ne 2 ]
+then
+    echo "Usage: $0 <baseline results dir> <candidate results dir>" >&2
+    exit 1
+fi
+
+METRICS="recv_msgs_per_sec delivery_ratio lat_p50_us lat_p99_us lat_max_us
+lat_over_1ms urgent_lat_p50_us urgent_lat_p99_us skew_p50_us skew_p99_us
+connect_p50_us connect_p99_us connect_syn_data server_send_calls
+server_loop_busy_ms server_loop_stalls server_cpu_total_ms
+server_cpu_minor_faults server_cpu_preempted perf_cycles_per_msg
+perf_syscalls_per_msg"
+
+# metric <json file> <name> - the value of a numeric field, empty if missing
+metric()
+{
+    sed -n "s/.*\"$2\": \\([0-9.]*\\).*/\\1/p" "$1"
+}
+
+printf '%-16s %-22s %14s %14s %9s\n' scenario metric "$(basename "$1")" \
+    "$(basename "$2")" change
+
+for base in "$1"/*.json
+do
+    case $base in
+        *.record.json) continue ;;
+    esac
+
+    name=$(basename "$base" .json)
+    cand="$2/$name.json"
+    [ -f "$cand" ] || continue
+
+    for m in $METRICS
+    do
+        b=$(metric "$base" "$m")
+        c=$(metric "$cand" "$m")
+        [ -z "$b" ] || [ -z "$c" ] && continue
+
+        awk -v n="$name" -v m="$m" -v b="$b" -v c="$c" 'BEGIN {
+            if (b != 0)
+            {
+                printf "%-16s %-22s %14s %14s %+8.1f%%\n", n, m, b, c,
+                    100.0 * (c - b) / b
+            }
+            else
+            {
+                printf "%-16s %-22s %14s %14s %9s\n", n, m, b, c, "-"
+            }
+        }'
+    done
+done
@@ -0,0 +1,394 @@
+/***************************************************************************
+*                     Receive Buffer Pool and Sizing
+*
+*   File    : bufpool.c
+*   Purpose : This file provides a pool of power of two sized receive
+*             buffers, along with routines used to pick a receive size
+*             from a running estimate of the message sizes seen on a
+*             connection or source.  Buffers are only borrowed for the
+*             duration of a receive, so idle connections hold no buffer
+*             memory at all.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Buffer Pool: Receive buffer pool for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "bufpool.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define MIN_CLASS_SIZE  64          /* smallest size class (holds a link) */
+#define NUM_CLASSES     32          /* more than enough for any size_t */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct free_buf_t
+{
+    struct free_buf_t *next;
+} free_buf_t;
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+static free_buf_t *freeLists[NUM_CLASSES];      /* free buffers by class */
+static unsigned int freeCounts[NUM_CLASSES];    /* length of free lists */
+static bufpool_stats_t poolStats;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int ClassIndex(size_t size);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : ClassIndex
+*   Description: This routine returns the index of the smallest size class
+*                able to hold a buffer of the requested size.
+*   Parameters : size - The number of bytes required.
+*   Effects    : None
+*   Returned   : Index into the free lists for the size.
+***************************************************************************/
+static unsigned int ClassIndex(size_t size)
+{
+    unsigned int index;
+    size_t classSize;
+
+    index = 0;
+    classSize = MIN_CLASS_SIZE;
+
+    while ((classSize < size) && (index < (NUM_CLASSES - 1)))
+    {
+        classSize <<= 1;
+        index++;
+    }
+
+    return index;
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolClassSize
+*   Description: This routine returns the size of the pool buffer that
+*                will be handed out for a request of the specified size.
+*   Parameters : size - The number of bytes required.
+*   Effects    : None
+*   Returned   : The size of the buffer's size class.
+***************************************************************************/
+size_t BufPoolClassSize(size_t size)
+{
+    return ((size_t)MIN_CLASS_SIZE) << ClassIndex(size);
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolGet
+*   Description: This routine hands out a buffer with room for at least
+*                size bytes.  A cached buffer of the right size class is
+*                used if there is one, otherwise a new one is allocated.
+*   Parameters : size - The number of bytes required.
+*   Effects    : The pool statistics are updated.
+*   Returned   : A pointer to the buffer, or NULL if allocation failed.
+*                The buffer must be returned with BufPoolPut using the
+*                same size.
+***************************************************************************/
+void *BufPoolGet(size_t size)
+{
+    unsigned int index;
+    free_buf_t *buffer;
+    size_t classSize;
+
+    index = ClassIndex(size);
+    classSize = ((size_t)MIN_CLASS_SIZE) << index;
+    poolStats.gets++;
+
+    if (NULL != freeLists[index])
+    {
+        buffer = freeLists[index];
+        freeLists[index] = buffer->next;
+        freeCounts[index]--;
+        poolStats.cached -= classSize;
+    }
+    else
+    {
+        buffer = (free_buf_t *)malloc(classSize);
+        poolStats.misses++;
+
+        if (NULL == buffer)
+        {
+            return NULL;
+        }
+    }
+
+    poolStats.inUse += classSize;
+
+    if (poolStats.inUse > poolStats.peakInUse)
+    {
+        poolStats.peakInUse = poolStats.inUse;
+    }
+
+    return buffer;
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolPut
+*   Description: This routine returns a buffer obtained from BufPoolGet
+*                to the pool.  Only BUFPOOL_MAX_FREE buffers are cached
+*                for each size class, the rest are freed.
+*   Parameters : buffer - The buffer being returned.
+*                size - The size that was passed to BufPoolGet.
+*   Effects    : The buffer is cached or freed.
+*   Returned   : None
+***************************************************************************/
+void BufPoolPut(void *buffer, size_t size)
+{
+    unsigned int index;
+    size_t classSize;
+
+    if (NULL == buffer)
+    {
+        return;
+    }
+
+    index = ClassIndex(size);
+    classSize = ((size_t)MIN_CLASS_SIZE) << index;
+    poolStats.inUse -= classSize;
+
+    if (freeCounts[index] >= BUFPOOL_MAX_FREE)
+    {
+        free(buffer);
+        return;
+    }
+
+    ((free_buf_t *)buffer)->next = freeLists[index];
+    freeLists[index] = (free_buf_t *)buffer;
+    freeCounts[index]++;
+    poolStats.cached += classSize;
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolPrefill
+*   Description: This routine fills the free list of every size class up
+*                to the one for maxSize with BUFPOOL_MAX_FREE buffers and
+*                writes to each of them, so the buffers a burst needs are
+*                already allocated and their pages mapped (locked, in low
+*                latency mode) before the first one is handed out.  The
+*                buffers aren't counted as gets or misses.
+*   Parameters : maxSize - The largest buffer size that will be requested.
+*   Effects    : Buffers are allocated and cached.
+*   Returned   : The number of bytes cached by the pool.
+***************************************************************************/
+size_t BufPoolPrefill(size_t maxSize)
+{
+    unsigned int index, last;
+    free_buf_t *buffer;
+    size_t classSize;
+
+    last = ClassIndex(maxSize);
+
+    for (index = 0; index <= last; index++)
+    {
+        classSize = ((size_t)MIN_CLASS_SIZE) << index;
+
+        while (freeCounts[index] < BUFPOOL_MAX_FREE)
+        {
+            buffer = (free_buf_t *)malloc(classSize);
+
+            if (NULL == buffer)
+            {
+                return poolStats.cached;
+            }
+
+            memset(buffer, 0, classSize);
+            buffer->next = freeLists[index];
+            freeLists[index] = buffer;
+            freeCounts[index]++;
+            poolStats.cached += classSize;
+        }
+    }
+
+    return poolStats.cached;
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolGetStats
+*   Description: This routine copies the pool's usage statistics.
+*   Parameters : stats - pointer to the structure receiving the statistics.
+*   Effects    : None
+*   Returned   : None
+***************************************************************************/
+void BufPoolGetStats(bufpool_stats_t *stats)
+{
+    memcpy(stats, &poolStats, sizeof(bufpool_stats_t));
+}
+
+
+/***************************************************************************
+*   Function   : BufPoolRelease
+*   Description: This routine frees every buffer cached by the pool.  It
+*                is intended to be called before a program exits.
+*   Parameters : None
+*   Effects    : All cached buffers are freed.
+*   Returned   : None
+***************************************************************************/
+void BufPoolRelease(void)
+{
+    unsigned int i;
+    free_buf_t *here;
+
+    for (i = 0; i < NUM_CLASSES; i++)
+    {
+        while (NULL != freeLists[i])
+        {
+            here = freeLists[i];
+            freeLists[i] = here->next;
+            free(here);
+        }
+
+        freeCounts[i] = 0;
+    }
+
+    poolStats.cached = 0;
+}
+
+
+/***************************************************************************
+*   Function   : RxEstimateInit
+*   Description: This routine initializes a receive size estimate so that
+*                the first receive uses the smallest permitted size.
+*   Parameters : estimate - pointer to the estimate being initialized.
+*   Effects    : The estimate is reset.
+*   Returned   : None
+***************************************************************************/
+void RxEstimateInit(rx_estimate_t *estimate)
+{
+    estimate->average = RX_MIN_SIZE;
+}
+
+
+/***************************************************************************
+*   Function   : RxEstimateSize
+*   Description: This routine converts a receive size estimate into the
+*                number of bytes that should be requested by the next
+*                receive.  The result is a pool size class that is
+*                bounded by RX_MIN_SIZE and RX_MAX_SIZE.
+*   Parameters : estimate - pointer to the estimate.
+*   Effects    : None
+*   Returned   : The number of bytes to receive.
+***************************************************************************/
+size_t RxEstimateSize(const rx_estimate_t *estimate)
+{
+    size_t size;
+
+    size = BufPoolClassSize(estimate->average);
+
+    if (size < RX_MIN_SIZE)
+    {
+        size = RX_MIN_SIZE;
+    }
+    else if (size > RX_MAX_SIZE)
+    {
+        size = RX_MAX_SIZE;
+    }
+
+    return size;
+}
+
+
+/***************************************************************************
+*   Function   : RxEstimateUpdate
+*   Description: This routine updates a receive size estimate after a
+*                receive.  Receives that fill their buffer grow the
+*                estimate to cover the unread backlog right away.  All
+*                other receives move the estimate a quarter of the way
+*                toward the amount received, so a connection that goes
+*                quiet drifts back to small buffers.
+*   Parameters : estimate - pointer to the estimate being updated.
+*                received - number of bytes the receive returned.
+*                requested - number of bytes the receive asked for.
+*                pending - number of bytes still waiting to be read
+*                (only meaningful when received == requested).
+*   Effects    : The estimate is updated.
+*   Returned   : None
+***************************************************************************/
+void RxEstimateUpdate(rx_estimate_t *estimate, size_t received,
+    size_t requested, size_t pending)
+{
+    size_t average;
+
+    average = estimate->average;
+
+    if ((received >= requested) && (pending > 0))
+    {
+        /* the buffer was too small, size for everything that's waiting */
+        average = received + pending;
+
+        if (average < (2 * requested))
+        {
+            average = 2 * requested;
+        }
+    }
+    else if (received > average)
+    {
+        average += (received - average + 3) / 4;
+    }
+    else
+    {
+        average -= (average - received) / 4;
+    }
+
+    if (average < RX_MIN_SIZE)
+    {
+        average = RX_MIN_SIZE;
+    }
+    else if (average > RX_MAX_SIZE)
+    {
+        average = RX_MAX_SIZE;
+    }
+
+    estimate->average = (unsigned int)average;
+}
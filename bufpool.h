@@ -0,0 +1,98 @@
+/***************************************************************************
+*                   Receive Buffer Pool and Sizing Header
+*
+*   File    : bufpool.h
+*   Purpose : This file provides the prototypes and types for a pool of
+*             power of two sized receive buffers, along with routines
+*             used to pick a receive size from a running estimate of the
+*             message sizes seen on a connection or source.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Buffer Pool: Receive buffer pool for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* receive sizes are bounded by these values (override with -D) */
+#ifndef RX_MIN_SIZE
+#define RX_MIN_SIZE     256         /* smallest receive size */
+#endif
+
+#ifndef RX_MAX_SIZE
+#define RX_MAX_SIZE     65536       /* largest receive size */
+#endif
+
+#define BUFPOOL_MAX_FREE    8       /* free buffers cached per size class */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct rx_estimate_t
+{
+    unsigned int average;           /* moving average of message sizes */
+} rx_estimate_t;
+
+typedef struct bufpool_stats_t
+{
+    size_t inUse;                   /* bytes currently handed out */
+    size_t peakInUse;               /* most bytes ever handed out at once */
+    size_t cached;                  /* bytes held on free lists */
+    unsigned long gets;             /* calls to BufPoolGet */
+    unsigned long misses;           /* gets that required a malloc */
+} bufpool_stats_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+size_t BufPoolClassSize(size_t size);
+void *BufPoolGet(size_t size);
+void BufPoolPut(void *buffer, size_t size);
+size_t BufPoolPrefill(size_t maxSize);
+void BufPoolGetStats(bufpool_stats_t *stats);
+void BufPoolRelease(void);
+
+void RxEstimateInit(rx_estimate_t *estimate);
+size_t RxEstimateSize(const rx_estimate_t *estimate);
+void RxEstimateUpdate(rx_estimate_t *estimate, size_t received,
+    size_t requested, size_t pending);
+
+#endif  /* ndef BUFPOOL_H */
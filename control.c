@@ -0,0 +1,458 @@
+/***************************************************************************
+*                              Control Socket
+*
+*   File    : control.c
+*   Purpose : This file provides a local (UNIX domain) control socket for
+*             the servers.  A client connects, writes a single command line,
+*             and reads the server's reply until the server closes the
+*             connection.  Commands are interpreted by the server, this file
+*             only handles the socket.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Control Socket: Control socket for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#define _GNU_SOURCE             /* for fopencookie and accept4 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "control.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define CONTROL_BACKLOG     4       /* outstanding control connections */
+#define CONTROL_TIMEOUT_MS  100     /* time allowed for a whole exchange */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* a control connection behind a reply stream */
+typedef struct control_conn_t
+{
+    int fd;                         /* the non-blocking connection */
+    struct timespec deadline;       /* CLOCK_MONOTONIC end of the exchange */
+} control_conn_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int Remaining(const control_conn_t *conn);
+static int Await(const control_conn_t *conn, short events);
+static ssize_t ReplyWrite(void *cookie, const char *data, size_t size);
+static int ReplyClose(void *cookie);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : ControlOpen
+*   Description: This routine creates a UNIX domain stream socket bound to
+*                path and listens on it.  Any stale socket file left at
+*                path is removed first.
+*   Parameters : path - the file system path for the socket.
+*   Effects    : A listening socket is created at path.
+*   Returned   : The listening socket descriptor, or -1 on failure.
+***************************************************************************/
+int ControlOpen(const char *path)
+{
+    int controlFd;
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Control socket path is too long: %s\n", path);
+        return -1;
+    }
+
+    controlFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (controlFd < 0)
+    {
+        perror("Error creating control socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(controlFd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("Error binding control socket");
+        close(controlFd);
+        return -1;
+    }
+
+    if (listen(controlFd, CONTROL_BACKLOG) < 0)
+    {
+        perror("Error listening on control socket");
+        close(controlFd);
+        unlink(path);
+        return -1;
+    }
+
+    /* a client that gives up before it's accepted mustn't block accept */
+    fcntl(controlFd, F_SETFL, fcntl(controlFd, F_GETFL) | O_NONBLOCK);
+
+    return controlFd;
+}
+
+
+/***************************************************************************
+*   Function   : ControlAccept
+*   Description: This routine accepts a connection on the control socket
+*                and reads one command line from it.  The trailing
+*                newline is removed.  The connection is non-blocking and
+*                the whole exchange, reading the command and writing the
+*                reply, must be over within CONTROL_TIMEOUT_MS, so a slow
+*                or stuck client can't stall the server's loop for long.
+*                A reply that isn't written by then is dropped.
+*   Parameters : controlFd - the listening control socket.
+*                command - buffer receiving the command.
+*                size - size of the command buffer.
+*   Effects    : A control connection is accepted and read from.
+*   Returned   : A stream for writing the reply (close it with fclose),
+*                or NULL if no command could be read.
+***************************************************************************/
+FILE *ControlAccept(int controlFd, char *command, size_t size)
+{
+    control_conn_t *conn;
+    size_t length;
+    ssize_t result;
+    FILE *reply;
+    cookie_io_functions_t functions = {NULL, ReplyWrite, NULL, ReplyClose};
+
+    conn = (control_conn_t *)malloc(sizeof(control_conn_t));
+
+    if (NULL == conn)
+    {
+        perror("Error allocating control connection");
+        return NULL;
+    }
+
+    conn->fd = accept4(controlFd, NULL, NULL, SOCK_NONBLOCK);
+
+    if (conn->fd < 0)
+    {
+        if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+        {
+            perror("Error accepting control connection");
+        }
+
+        free(conn);
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &(conn->deadline));
+    conn->deadline.tv_nsec += CONTROL_TIMEOUT_MS * 1000000L;
+    conn->deadline.tv_sec += conn->deadline.tv_nsec / 1000000000L;
+    conn->deadline.tv_nsec %= 1000000000L;
+
+    /* read until we have a whole line */
+    length = 0;
+
+    while ((length < (size - 1)) && (Await(conn, POLLIN) > 0))
+    {
+        result = recv(conn->fd, command + length, size - 1 - length, 0);
+
+        if ((result < 0) && ((EAGAIN == errno) || (EWOULDBLOCK == errno)))
+        {
+            continue;
+        }
+
+        if (result <= 0)
+        {
+            break;
+        }
+
+        length += result;
+
+        if (memchr(command, '\n', length) != NULL)
+        {
+            break;
+        }
+    }
+
+    command[length] = '\0';
+    command[strcspn(command, "\r\n")] = '\0';
+
+    if (0 == length)
+    {
+        ReplyClose(conn);
+        return NULL;
+    }
+
+    reply = fopencookie(conn, "w", functions);
+
+    if (NULL == reply)
+    {
+        perror("Error opening control reply stream");
+        ReplyClose(conn);
+    }
+
+    return reply;
+}
+
+
+/***************************************************************************
+*   Function   : ControlClose
+*   Description: This routine closes the listening control socket and
+*                removes its file.
+*   Parameters : controlFd - the listening control socket.
+*                path - the file system path for the socket.
+*   Effects    : The socket is closed and path is removed.
+*   Returned   : None
+***************************************************************************/
+void ControlClose(int controlFd, const char *path)
+{
+    if (controlFd >= 0)
+    {
+        close(controlFd);
+        unlink(path);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ControlSetTunables
+*   Description: This routine carries out the arguments of a set command,
+*                a list of name=value assignments to the settings in
+*                table.  Every assignment is checked, so either all of
+*                them are made or none are used.
+*   Parameters : table - the settings, ended by an entry with a NULL name.
+*                values - the structure holding the settings (a copy the
+*                caller will only publish on success).
+*                assignments - the name=value list.
+*                reply - where to write an error.
+*   Effects    : The settings in values are changed.
+*   Returned   : 0 if every assignment was made, otherwise -1.
+***************************************************************************/
+int ControlSetTunables(const control_tunable_t *table, void *values,
+    const char *assignments, FILE *reply)
+{
+    const control_tunable_t *tunable;
+    char name[CONTROL_CMD_SIZE];
+    long long value;
+    int used, count;
+
+    count = 0;
+
+    while (sscanf(assignments, " %255[^= ]=%lld%n", name, &value, &used) == 2)
+    {
+        for (tunable = table; NULL != tunable->name; tunable++)
+        {
+            if (strcmp(tunable->name, name) == 0)
+            {
+                break;
+            }
+        }
+
+        if (NULL == tunable->name)
+        {
+            fprintf(reply, "error: unknown setting '%s'\n", name);
+            return -1;
+        }
+
+        if ((value < tunable->min) || (value > tunable->max))
+        {
+            fprintf(reply, "error: %s must be %lld to %lld\n", name,
+                tunable->min, tunable->max);
+            return -1;
+        }
+
+        *(long long *)((char *)values + tunable->offset) = value;
+        assignments += used;
+        count++;
+    }
+
+    if ((0 == count) || (assignments[strspn(assignments, " ")] != '\0'))
+    {
+        fprintf(reply, "error: expected set <name>=<value> ...\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ControlPrintTunables
+*   Description: This routine writes the settings in table as a single
+*                "tunables:" line of name=value pairs.
+*   Parameters : table - the settings, ended by an entry with a NULL name.
+*                values - the structure holding the settings.
+*                stream - where to write the settings.
+*   Effects    : The settings are written to stream.
+*   Returned   : None
+***************************************************************************/
+void ControlPrintTunables(const control_tunable_t *table,
+    const void *values, FILE *stream)
+{
+    const control_tunable_t *tunable;
+
+    fprintf(stream, "tunables:");
+
+    for (tunable = table; NULL != tunable->name; tunable++)
+    {
+        fprintf(stream, " %s=%lld", tunable->name,
+            *(const long long *)((const char *)values + tunable->offset));
+    }
+
+    fprintf(stream, "\n");
+}
+
+
+/***************************************************************************
+*   Function   : Remaining
+*   Description: This routine computes the time left in a control
+*                exchange.
+*   Parameters : conn - the control connection.
+*   Effects    : None
+*   Returned   : Milliseconds until the deadline, 0 if it has passed.
+***************************************************************************/
+static int Remaining(const control_conn_t *conn)
+{
+    struct timespec now;
+    long long ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (conn->deadline.tv_sec - now.tv_sec) * 1000LL +
+        (conn->deadline.tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+
+    return (ms > 0) ? (int)ms : 0;
+}
+
+
+/***************************************************************************
+*   Function   : Await
+*   Description: This routine waits, no later than the exchange's
+*                deadline, for a control connection to become ready.
+*   Parameters : conn - the control connection.
+*                events - POLLIN or POLLOUT.
+*   Effects    : None
+*   Returned   : > 0 if the connection is ready, 0 if the deadline passed,
+*                < 0 on failure.
+***************************************************************************/
+static int Await(const control_conn_t *conn, short events)
+{
+    struct pollfd pfd;
+    int result;
+
+    pfd.fd = conn->fd;
+    pfd.events = events;
+
+    do
+    {
+        result = poll(&pfd, 1, Remaining(conn));
+    } while ((result < 0) && (EINTR == errno));
+
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : ReplyWrite
+*   Description: This routine is the write function of a reply stream.  It
+*                writes as much as the client accepts before the exchange's
+*                deadline.
+*   Parameters : cookie - the control connection.
+*                data - the data to write.
+*                size - the number of bytes to write.
+*   Effects    : data is written to the control connection.
+*   Returned   : The number of bytes written, 0 if none could be.
+***************************************************************************/
+static ssize_t ReplyWrite(void *cookie, const char *data, size_t size)
+{
+    control_conn_t *conn;
+    size_t written;
+    ssize_t result;
+
+    conn = (control_conn_t *)cookie;
+    written = 0;
+
+    while ((written < size) && (Await(conn, POLLOUT) > 0))
+    {
+        result = send(conn->fd, data + written, size - written,
+            MSG_NOSIGNAL);
+
+        if ((result < 0) && ((EAGAIN == errno) || (EWOULDBLOCK == errno)))
+        {
+            continue;
+        }
+
+        if (result <= 0)
+        {
+            break;
+        }
+
+        written += result;
+    }
+
+    return written;
+}
+
+
+/***************************************************************************
+*   Function   : ReplyClose
+*   Description: This routine is the close function of a reply stream.
+*   Parameters : cookie - the control connection.
+*   Effects    : The connection is closed and freed.
+*   Returned   : The result of close.
+***************************************************************************/
+static int ReplyClose(void *cookie)
+{
+    control_conn_t *conn;
+    int result;
+
+    conn = (control_conn_t *)cookie;
+    result = close(conn->fd);
+    free(conn);
+    return result;
+}
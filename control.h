@@ -0,0 +1,79 @@
+/***************************************************************************
+*                          Control Socket Header
+*
+*   File    : control.h
+*   Purpose : This file provides the prototypes for the local (UNIX domain)
+*             control socket used to query and adjust a running server.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Control Socket: Control socket for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef CONTROL_H
+#define CONTROL_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define CONTROL_CMD_SIZE    256     /* longest command line accepted */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* a setting changed by the set command, a long long in a structure */
+typedef struct control_tunable_t
+{
+    const char *name;               /* NULL ends a table */
+    size_t offset;                  /* offsetof the field */
+    long long min;                  /* allowed values */
+    long long max;
+} control_tunable_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int ControlOpen(const char *path);
+FILE *ControlAccept(int controlFd, char *command, size_t size);
+void ControlClose(int controlFd, const char *path);
+
+int ControlSetTunables(const control_tunable_t *table, void *values,
+    const char *assignments, FILE *reply);
+void ControlPrintTunables(const control_tunable_t *table,
+    const void *values, FILE *stream);
+
+#endif  /* ndef CONTROL_H */
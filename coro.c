@@ -0,0 +1,600 @@
+/***************************************************************************
+*                            Reactor Coroutines
+*
+*   File    : coro.c
+*   Purpose : This file implements coroutine frames, allocated from a pool,
+*             that run connection handlers on the reactor, and the awaitable
+*             frame read and write operations they use.  Receive buffers
+*             come from the buffer pool, so no operation allocates memory.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Coroutines: Connection handler coroutines for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include "coro.h"
+#include "loopmon.h"
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct coro_chunk_t
+{
+    struct coro_chunk_t *next;
+    coro_t frames[CORO_POOL_CHUNK];
+} coro_chunk_t;
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+static coro_chunk_t *chunks;        /* every frame ever allocated */
+static coro_t *freeFrames;          /* frames that aren't in use */
+static unsigned long numFrames;
+static unsigned long framesInUse;
+static unsigned long peakFramesInUse;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void CoroReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+static int FindFrame(coro_t *co);
+static int Receive(coro_t *co);
+static void ReleaseRx(coro_t *co);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : CoroNew
+*   Description: This routine takes a frame from the pool for a new
+*                coroutine and registers its fd with the reactor.  The
+*                body first runs when the fd becomes ready, and is resumed
+*                every time it's ready after that.  When the body finishes
+*                the fd is removed from the reactor and exit is called; the
+*                fd isn't closed and the frame isn't freed, that's up to
+*                exit.
+*   Parameters : reactor - the reactor that will run the coroutine.
+*                fd - the connected socket the coroutine serves.
+*                body - the coroutine body.
+*                exit - called when body finishes.
+*                data - owner's data, available as co->data.
+*   Effects    : The pool may grow by CORO_POOL_CHUNK frames.  fd is
+*                registered for REACTOR_READ.
+*   Returned   : The coroutine, or NULL if a frame couldn't be allocated
+*                or fd couldn't be registered.
+***************************************************************************/
+coro_t *CoroNew(reactor_t *reactor, int fd, coro_body_t body,
+    coro_exit_t exit, void *data)
+{
+    coro_t *co;
+
+    if (NULL == freeFrames)
+    {
+        coro_chunk_t *chunk;
+        int i;
+
+        chunk = (coro_chunk_t *)malloc(sizeof(coro_chunk_t));
+
+        if (NULL == chunk)
+        {
+            perror("Error allocating coroutine frames");
+            return NULL;
+        }
+
+        for (i = 0; i < CORO_POOL_CHUNK; i++)
+        {
+            chunk->frames[i].nextFree = freeFrames;
+            freeFrames = &(chunk->frames[i]);
+        }
+
+        chunk->next = chunks;
+        chunks = chunk;
+        numFrames += CORO_POOL_CHUNK;
+    }
+
+    co = freeFrames;
+    freeFrames = co->nextFree;
+
+    memset(co, 0, sizeof(coro_t));
+    co->body = body;
+    co->exit = exit;
+    co->reactor = reactor;
+    co->fd = fd;
+    co->data = data;
+    RxEstimateInit(&(co->rxEstimate));
+
+    if (ReactorAdd(reactor, fd, REACTOR_READ, CoroReady, co) != 0)
+    {
+        co->nextFree = freeFrames;
+        freeFrames = co;
+        return NULL;
+    }
+
+    framesInUse++;
+
+    if (framesInUse > peakFramesInUse)
+    {
+        peakFramesInUse = framesInUse;
+    }
+
+    return co;
+}
+
+
+/***************************************************************************
+*   Function   : CoroFree
+*   Description: This routine returns a coroutine's receive buffer to the
+*                buffer pool and its frame to the frame pool.  It doesn't
+*                touch the coroutine's fd.
+*   Parameters : co - the coroutine.
+*   Effects    : co may no longer be used.
+*   Returned   : None
+***************************************************************************/
+void CoroFree(coro_t *co)
+{
+    ReleaseRx(co);
+    co->nextFree = freeFrames;
+    freeFrames = co;
+    framesInUse--;
+}
+
+
+/***************************************************************************
+*   Function   : CoroReady
+*   Description: This is the reactor callback for every coroutine's fd.  It
+*                resumes the body, and ends the coroutine once the body
+*                finishes.
+*   Parameters : reactor - the reactor running the coroutine.
+*                fd - the coroutine's fd.
+*                events - the events that are ready.
+*                data - the coroutine.
+*   Effects    : The body runs until it suspends or finishes.
+*   Returned   : None
+***************************************************************************/
+static void CoroReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    coro_t *co;
+    int status;
+
+    co = (coro_t *)data;
+
+    if (events & (REACTOR_READ | REACTOR_ERROR))
+    {
+        co->readable = 1;
+    }
+
+    status = co->body(co);
+
+    if (CORO_WAITING != status)
+    {
+        ReactorRemove(reactor, fd);
+        co->exit(co, status);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : CoroReadFrame
+*   Description: This is the operation awaited by CORO_READ_FRAME.  It
+*                consumes the previous frame and returns the next one.
+*                With raw framing a frame is whatever was received; with
+*                line framing it's every complete '\n' ended line that's
+*                been received (lines longer than CORO_MAX_FRAME are
+*                split).  It receives at most once per time the fd is
+*                reported readable, like the hand written loop, and the
+*                receive is sized by the coroutine's receive estimate.
+*   Parameters : co - the coroutine.
+*   Effects    : co->frame and co->frameLen are set when a frame is
+*                returned.  Receives are counted by the reactor and
+*                recorded in co->flight.
+*   Returned   : CORO_READY when a frame is returned, CORO_WAITING until
+*                one has been received, CORO_CLOSED if the peer closed the
+*                connection, otherwise CORO_FAILED.
+***************************************************************************/
+int CoroReadFrame(coro_t *co)
+{
+    int result;
+
+    /* done with the last frame */
+    co->rxStart += co->frameLen;
+    co->frame = NULL;
+    co->frameLen = 0;
+
+    if (co->rxStart == co->rxLen)
+    {
+        ReleaseRx(co);
+    }
+
+    while (!FindFrame(co))
+    {
+        if (!co->readable)
+        {
+            return CORO_WAITING;
+        }
+
+        result = Receive(co);
+
+        if (CORO_READY != result)
+        {
+            return result;
+        }
+    }
+
+    return CORO_READY;
+}
+
+
+/***************************************************************************
+*   Function   : FindFrame
+*   Description: This routine looks for a frame in the unconsumed data.
+*   Parameters : co - the coroutine.
+*   Effects    : co->frame and co->frameLen are set if a frame is found.
+*   Returned   : 1 if a frame was found, otherwise 0.
+***************************************************************************/
+static int FindFrame(coro_t *co)
+{
+    size_t end;
+
+    if (co->rxStart == co->rxLen)
+    {
+        return 0;
+    }
+
+    end = co->rxLen;
+
+    if (REACTOR_FRAME_LINE == REACTOR_FRAMING_OF(co->reactor))
+    {
+        /* find the last '\n' that hasn't been looked for already */
+        while ((end > co->rxScanned) && ('\n' != co->rxBuffer[end - 1]))
+        {
+            end--;
+        }
+
+        if (end == co->rxScanned)
+        {
+            co->rxScanned = co->rxLen;
+
+            if ((co->rxLen - co->rxStart) < CORO_MAX_FRAME)
+            {
+                return 0;       /* no complete line yet */
+            }
+
+            end = co->rxLen;    /* too long to hold, split it */
+        }
+    }
+
+    co->frame = co->rxBuffer + co->rxStart;
+    co->frameLen = end - co->rxStart;
+    co->rxScanned = end;
+    return 1;
+}
+
+
+/***************************************************************************
+*   Function   : Receive
+*   Description: This routine receives into the space after any data that
+*                hasn't been consumed.  Unconsumed data is moved to the
+*                start of the buffer, and the buffer is replaced by a
+*                larger one from the pool if there's less room than the
+*                receive estimate.  When a receive fills the space, the
+*                FIONREAD backlog is used to grow the estimate.
+*   Parameters : co - the coroutine.
+*   Effects    : Received data is appended to co->rxBuffer.  co->readable
+*                is cleared; the reactor will report the fd again if there
+*                is more to read.
+*   Returned   : CORO_READY if data was received, CORO_WAITING if there was
+*                none, CORO_CLOSED if the peer closed the connection,
+*                otherwise CORO_FAILED.
+***************************************************************************/
+static int Receive(coro_t *co)
+{
+    reactor_t *reactor;
+    size_t want;        /* room needed for the receive */
+    ssize_t result;
+
+    reactor = co->reactor;
+    want = RxEstimateSize(&(co->rxEstimate));
+
+    if (co->rxStart > 0)
+    {
+        co->rxLen -= co->rxStart;
+        co->rxScanned -= co->rxStart;
+        memmove(co->rxBuffer, co->rxBuffer + co->rxStart, co->rxLen);
+        co->rxStart = 0;
+    }
+
+    if ((co->rxSize - co->rxLen) < want)
+    {
+        char *buffer;
+        size_t size;
+
+        size = BufPoolClassSize(co->rxLen + want);
+        buffer = (char *)BufPoolGet(size);
+
+        if (NULL == buffer)
+        {
+            perror("Error allocating receive buffer");
+            return CORO_FAILED;
+        }
+
+        if (NULL != co->rxBuffer)
+        {
+            memcpy(buffer, co->rxBuffer, co->rxLen);
+            BufPoolPut(co->rxBuffer, co->rxSize);
+        }
+
+        co->rxBuffer = buffer;
+        co->rxSize = size;
+    }
+
+    result = recv(co->fd, co->rxBuffer + co->rxLen, want, 0);
+    REACTOR_COUNT(reactor, recvCalls, 1);
+    co->readable = 0;
+    co->now = LoopMonNow();
+
+    if (result < 0)
+    {
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+            return CORO_WAITING;
+        }
+
+        if (NULL != co->flight)
+        {
+            FlightRecord(co->flight, FR_ERROR, errno, co->now);
+        }
+
+        perror("Error receiving message from client");
+        return CORO_FAILED;
+    }
+
+    if (0 == result)
+    {
+        if (NULL != co->flight)
+        {
+            FlightRecord(co->flight, FR_CLOSE, 0, co->now);
+        }
+
+        return CORO_CLOSED;
+    }
+
+    {
+        int pending;        /* bytes still waiting to be read */
+
+        REACTOR_COUNT(reactor, bytesIn, result);
+        pending = 0;
+
+        if (NULL != co->flight)
+        {
+            FlightRecord(co->flight, FR_RECV, result, co->now);
+        }
+
+        if ((size_t)result == want)
+        {
+            /* filled the space, see how much more is waiting */
+            REACTOR_COUNT(reactor, ioctlCalls, 1);
+
+            if (ioctl(co->fd, FIONREAD, &pending) < 0)
+            {
+                pending = 0;
+            }
+
+            if (NULL != co->flight)
+            {
+                FlightRecord(co->flight, FR_BACKLOG, pending, co->now);
+            }
+        }
+
+        RxEstimateUpdate(&(co->rxEstimate), result, want, pending);
+    }
+
+    co->rxLen += result;
+    return CORO_READY;
+}
+
+
+/***************************************************************************
+*   Function   : ReleaseRx
+*   Description: This routine returns a coroutine's receive buffer to the
+*                buffer pool.  Any unconsumed data is discarded.
+*   Parameters : co - the coroutine.
+*   Effects    : co has no receive buffer.
+*   Returned   : None
+***************************************************************************/
+static void ReleaseRx(coro_t *co)
+{
+    if (NULL != co->rxBuffer)
+    {
+        BufPoolPut(co->rxBuffer, co->rxSize);
+    }
+
+    co->rxBuffer = NULL;
+    co->rxSize = 0;
+    co->rxStart = 0;
+    co->rxLen = 0;
+    co->rxScanned = 0;
+}
+
+
+/***************************************************************************
+*   Function   : CoroWriteStart
+*   Description: This routine starts a write for CORO_WRITE.
+*   Parameters : co - the coroutine.
+*                data - the data to write, it must stay valid until the
+*                write completes.
+*                length - the number of bytes to write.
+*   Effects    : The write is recorded in co.
+*   Returned   : None
+***************************************************************************/
+void CoroWriteStart(coro_t *co, const char *data, size_t length)
+{
+    co->txData = data;
+    co->txLen = length;
+}
+
+
+/***************************************************************************
+*   Function   : CoroWrite
+*   Description: This is the operation awaited by CORO_WRITE.  It sends as
+*                much of the write as the socket will take without
+*                blocking.  While the write is incomplete the fd is only
+*                registered for REACTOR_WRITE, so nothing more is read
+*                from a peer that isn't reading what it's sent.
+*   Parameters : co - the coroutine.
+*   Effects    : Sends are counted by the reactor and recorded in
+*                co->flight.
+*   Returned   : CORO_READY when everything has been sent, CORO_WAITING
+*                until it has, otherwise CORO_FAILED.
+***************************************************************************/
+int CoroWrite(coro_t *co)
+{
+    reactor_t *reactor;
+    ssize_t sent;
+
+    reactor = co->reactor;
+
+    while (co->txLen > 0)
+    {
+        sent = send(co->fd, co->txData, co->txLen, MSG_DONTWAIT);
+        REACTOR_COUNT(reactor, sendCalls, 1);
+
+        if (sent < 0)
+        {
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                if (NULL != co->flight)
+                {
+                    FlightRecord(co->flight, FR_ERROR, errno, co->now);
+                }
+
+                fprintf(stderr, "Error writing to socket %d ", co->fd);
+                perror("");
+                return CORO_FAILED;
+            }
+
+            if (NULL != co->flight)
+            {
+                FlightRecord(co->flight, FR_EAGAIN, 0, co->now);
+            }
+
+            if (!co->writeWait)
+            {
+                if (ReactorModify(reactor, co->fd, REACTOR_WRITE) != 0)
+                {
+                    return CORO_FAILED;
+                }
+
+                co->writeWait = 1;
+            }
+
+            return CORO_WAITING;
+        }
+
+        if (NULL != co->flight)
+        {
+            FlightRecord(co->flight, FR_SEND, sent, co->now);
+        }
+
+        REACTOR_COUNT(reactor, bytesOut, sent);
+        co->txData += sent;
+        co->txLen -= sent;
+    }
+
+    if (co->writeWait)
+    {
+        /* back to reading, there may be data that arrived meanwhile */
+        if (ReactorModify(reactor, co->fd, REACTOR_READ) != 0)
+        {
+            return CORO_FAILED;
+        }
+
+        co->writeWait = 0;
+        co->readable = 1;
+    }
+
+    return CORO_READY;
+}
+
+
+/***************************************************************************
+*   Function   : CoroPoolPrint
+*   Description: This routine writes the frame pool's statistics.
+*   Parameters : stream - where to write them.
+*   Effects    : One "coro:" line is written to stream.
+*   Returned   : None
+***************************************************************************/
+void CoroPoolPrint(FILE *stream)
+{
+    fprintf(stream, "coro: frames=%lu in_use=%lu peak=%lu frame_bytes=%lu\n",
+        numFrames, framesInUse, peakFramesInUse,
+        (unsigned long)sizeof(coro_t));
+}
+
+
+/***************************************************************************
+*   Function   : CoroPoolRelease
+*   Description: This routine frees every frame in the pool.  It should
+*                only be called once no coroutine is in use.
+*   Parameters : None
+*   Effects    : The pool is empty.
+*   Returned   : None
+***************************************************************************/
+void CoroPoolRelease(void)
+{
+    coro_chunk_t *chunk;
+
+    while (NULL != chunks)
+    {
+        chunk = chunks;
+        chunks = chunk->next;
+        free(chunk);
+    }
+
+    freeFrames = NULL;
+    numFrames = 0;
+    framesInUse = 0;
+}
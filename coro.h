@@ -0,0 +1,181 @@
+/***************************************************************************
+*                         Reactor Coroutine Header
+*
+*   File    : coro.h
+*   Purpose : This file provides the macros, types and prototypes for
+*             stackless (protothread style) coroutines that run connection
+*             handlers on the reactor with awaitable frame reads and writes.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Coroutines: Connection handler coroutines for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef CORO_H
+#define CORO_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stddef.h>
+
+#include "reactor.h"
+#include "bufpool.h"
+#include "flightrec.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* results of awaited operations and coroutine bodies */
+#define CORO_WAITING    0           /* suspended until the fd is ready */
+#define CORO_READY      1           /* the awaited operation completed */
+#define CORO_DONE       2           /* the body finished */
+#define CORO_CLOSED     (-1)        /* the peer closed the connection */
+#define CORO_FAILED     (-2)        /* a receive, send or allocation failed */
+
+#define CORO_POOL_CHUNK 64          /* frames allocated at a time */
+#define CORO_MAX_FRAME  (4 * RX_MAX_SIZE)   /* longer lines are split */
+
+/***************************************************************************
+*                                 MACROS
+***************************************************************************/
+/***************************************************************************
+* A coroutine body is a function that takes its coro_t and is called again
+* every time its fd is ready.  Its statements go between CORO_BEGIN and
+* CORO_END, and it suspends at each CORO_AWAIT until the awaited operation
+* completes or fails; the result is left in co->result.  The body's local
+* variables don't survive a suspension, so anything that has to be kept
+* belongs in the coro_t or in the owner's data.  The awaits must not be
+* placed inside a switch statement of the body.
+***************************************************************************/
+#define CORO_BEGIN(co)      switch ((co)->resume) { case 0:
+
+/* (re)try op until it doesn't return CORO_WAITING */
+#define CORO_AWAIT(co, op) \
+    do \
+    { \
+        if (0) \
+        { \
+            case __LINE__: ; \
+        } \
+        else \
+        { \
+            (co)->resume = __LINE__; \
+        } \
+        \
+        if (CORO_WAITING == ((co)->result = (op))) \
+        { \
+            return CORO_WAITING; \
+        } \
+    } while (0)
+
+/* await the next frame, which is left in co->frame and co->frameLen */
+#define CORO_READ_FRAME(co)     CORO_AWAIT(co, CoroReadFrame(co))
+
+/* await writing all of a buffer, which must stay valid until it's sent */
+#define CORO_WRITE(co, buffer, length) \
+    do \
+    { \
+        CoroWriteStart((co), (buffer), (length)); \
+        CORO_AWAIT(co, CoroWrite(co)); \
+    } while (0)
+
+/* finish the body with a status of CORO_DONE or CORO_FAILED */
+#define CORO_RETURN(co, status) \
+    do \
+    { \
+        (co)->resume = -1; \
+        return (status); \
+    } while (0)
+
+#define CORO_END(co)        } (co)->resume = -1; return CORO_DONE;
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+struct coro_t;
+
+/* the body returns CORO_WAITING when suspended, otherwise its status */
+typedef int (*coro_body_t)(struct coro_t *co);
+
+/* called once the body has finished, status is what it returned */
+typedef void (*coro_exit_t)(struct coro_t *co, int status);
+
+typedef struct coro_t
+{
+    int resume;                 /* line to resume at (0 to start) */
+    int result;                 /* result of the last awaited operation */
+    coro_body_t body;
+    coro_exit_t exit;
+    reactor_t *reactor;
+    int fd;
+    int readable;               /* fd reported readable since last recv */
+    int writeWait;              /* registered for REACTOR_WRITE */
+    long long now;              /* time of the last receive (ns) */
+    flight_rec_t *flight;       /* optional recorder for socket events */
+    void *data;                 /* owner's data */
+
+    /* received data, rxBuffer[rxStart, rxLen) hasn't been consumed */
+    rx_estimate_t rxEstimate;
+    char *rxBuffer;             /* buffer pool buffer or NULL */
+    size_t rxSize;
+    size_t rxStart;
+    size_t rxLen;
+    size_t rxScanned;           /* line framing: no '\n' before this */
+
+    /* frame returned by the last CoroReadFrame */
+    const char *frame;
+    size_t frameLen;
+
+    /* write in progress */
+    const char *txData;
+    size_t txLen;
+
+    struct coro_t *nextFree;    /* frame pool free list */
+} coro_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+coro_t *CoroNew(reactor_t *reactor, int fd, coro_body_t body,
+    coro_exit_t exit, void *data);
+void CoroFree(coro_t *co);
+
+int CoroReadFrame(coro_t *co);
+void CoroWriteStart(coro_t *co, const char *data, size_t length);
+int CoroWrite(coro_t *co);
+
+void CoroPoolPrint(FILE *stream);
+void CoroPoolRelease(void);
+
+#endif  /* ndef CORO_H */
@@ -0,0 +1,1283 @@
+/***************************************************************************
+*                      Echo Server Loopback Benchmark
+*
+*   File    : echobench.c
+*   Purpose : This file provides a load generator for the TCP/IP and
+*             UDP/IP echo servers.  It opens publisher, subscriber and
+*             idle connections to a server, has the publishers send
+*             timestamped messages at a fixed rate, measures how the
+*             echoed messages arrive at the subscribers, and writes the
+*             results as a JSON object.  It may also time fresh TCP
+*             connections from connect to their first echo, with or
+*             without TCP Fast Open.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Echo Bench: A load generator for the Berkeley socket echo servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+
+#include <poll.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define RX_BUF_SIZE     65536       /* per connection receive buffer */
+#define MIN_MSG_SIZE    32          /* room for the sequence and timestamp */
+#define MAX_MSG_SIZE    60000       /* fits in a UDP datagram */
+#define MAX_SAMPLES     (1 << 20)   /* latency samples kept */
+#define DRAIN_MS        250         /* time to wait for stragglers */
+#define NS_PER_SEC      1000000000LL
+#define URGENT_MARK     '!'         /* first byte of an urgent message */
+#define URGENT_MSG_SIZE 64          /* urgent messages are this short */
+#define SKEW_SLOTS      (1 << 16)   /* messages tracked at once with -S */
+#define OUTLIER_1MS     1000000LL   /* latency outlier thresholds (ns) */
+#define OUTLIER_10MS    10000000LL
+#define CONNECT_MSG     "connect\n" /* each -c connection's only message */
+#define CONNECT_WAIT_MS 1000        /* longest wait for its echo */
+
+typedef enum
+{
+    ROLE_PUBLISHER,
+    ROLE_SUBSCRIBER,
+    ROLE_IDLE
+} role_t;
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct bench_conn_t
+{
+    int fd;
+    role_t role;
+    int subscriber;             /* index among the subscribers */
+    char *rxBuf;                /* partial TCP lines wait here */
+    size_t rxLen;               /* bytes in rxBuf */
+    char *txBuf;                /* message being sent */
+    size_t txLen;               /* length of message in txBuf */
+    size_t txOffset;            /* bytes of txBuf already sent */
+    unsigned long seq;          /* next sequence number to send */
+    long long nextSend;         /* time of next send (ns) */
+} bench_conn_t;
+
+typedef struct bench_opts_t
+{
+    int udp;                    /* non-zero for UDP */
+    int publishers;
+    int subscribers;
+    int idle;
+    size_t msgSize;
+    long rate;                  /* messages/sec/publisher, 0 = unlimited */
+    unsigned long urgentEvery;  /* every n-th message is urgent, 0 = none */
+    int skew;                   /* measure the fan-out spread */
+    int connects;               /* -c: connections timed after the run */
+    int fastOpen;               /* -F: they send in the SYN (TCP_FASTOPEN) */
+    int duration;               /* seconds */
+    const char *name;           /* scenario name */
+} bench_opts_t;
+
+/* deliveries of one message to the subscribers (-S) */
+typedef struct skew_slot_t
+{
+    unsigned long seq;          /* the message's sequence number and */
+    long long sendTime;         /* send time identify it */
+    long long first;            /* earliest and latest delivery (ns) */
+    long long last;
+    int count;                  /* subscribers that have it, 0 = free */
+    int lastSubscriber;         /* the subscriber that got it last */
+} skew_slot_t;
+
+typedef struct bench_results_t
+{
+    unsigned long sent;         /* messages published */
+    unsigned long received;     /* messages received by subscribers */
+    unsigned long corrupt;      /* received lines that didn't parse */
+    unsigned long numSamples;
+    long long *samples;         /* latency samples (ns) */
+    unsigned long urgentSent;   /* urgent messages published */
+    unsigned long urgentReceived;
+    unsigned long numUrgentSamples;
+    long long *urgentSamples;   /* urgent message latency samples (ns) */
+    skew_slot_t *skewSlots;     /* -S: messages still being delivered */
+    unsigned long numSkewSamples;
+    long long *skewSamples;     /* first to last delivery spreads (ns) */
+    unsigned long skewIncomplete;   /* messages some subscribers missed */
+    unsigned long *lastCounts;  /* times each subscriber was last */
+    unsigned long numConnectSamples;
+    long long *connectSamples;  /* -c: connect to first echo times (ns) */
+    unsigned long connectSynData;   /* connections whose SYN data was
+                                       accepted by the server */
+    unsigned long connectFailed;    /* connections with no echo */
+} bench_results_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+long long NowNs(void);
+int OpenConnection(const struct addrinfo *info, const bench_opts_t *opts);
+long long ConnectProbe(const struct addrinfo *info, const bench_opts_t *opts,
+    int *synData);
+void FormatMessage(bench_conn_t *conn, const bench_opts_t *opts,
+    long long now, bench_results_t *results);
+int SendPending(bench_conn_t *conn);
+void HandleMessage(const char *msg, size_t len, const bench_opts_t *opts,
+    int subscriber, long long arrival, bench_results_t *results);
+void SkewRecord(bench_results_t *results, const bench_opts_t *opts,
+    int subscriber, unsigned long seq, long long sendTime, long long now);
+void SkewFinish(bench_results_t *results, const bench_opts_t *opts,
+    skew_slot_t *slot);
+int ReceiveMessages(bench_conn_t *conn, const bench_opts_t *opts,
+    bench_results_t *results);
+int CompareSamples(const void *s1, const void *s2);
+long long Percentile(const long long *samples, unsigned long numSamples,
+    double pct);
+unsigned long Outliers(const long long *samples, unsigned long numSamples,
+    long long limit);
+void PrintResults(const bench_opts_t *opts, bench_results_t *results);
+void Usage(const char *prog);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : main
+*   Description: This is the main function for this program.  It parses
+*                the command line, opens all of the benchmark connections
+*                to the echo server at argv[optind] on port argv[optind+1],
+*                and runs a poll loop that publishes and receives messages
+*                for the requested duration.  With -S it also measures the
+*                spread between the first and last subscriber receiving
+*                each message (see SkewRecord).  With -c, once the run is
+*                over and its connections are closed, that many fresh
+*                connections are timed one after the other (see
+*                ConnectProbe).
+*   Parameters : argc - number of parameters
+*                argv - parameter list
+*   Effects    : Messages are sent to and received from the echo server,
+*                results are written to stdout as JSON.
+*   Returned   : EXIT_SUCCESS for success, otherwise EXIT_FAILURE.
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt, i, numConns;
+    int result;
+    bench_opts_t opts;
+    bench_results_t results;
+    bench_conn_t *conns;
+    struct pollfd *pfds;
+    struct addrinfo hints, *info;
+    struct rlimit limit;
+    long long now, start, stop, interval;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.publishers = 1;
+    opts.subscribers = 4;
+    opts.msgSize = 64;
+    opts.rate = 1000;
+    opts.duration = 5;
+    opts.name = "default";
+
+    while ((opt = getopt(argc, argv, "up:s:i:m:r:d:n:U:Sc:F")) != -1)
+    {
+        switch (opt)
+        {
+            case 'u':
+                opts.udp = 1;
+                break;
+
+            case 'p':
+                opts.publishers = atoi(optarg);
+                break;
+
+            case 's':
+                opts.subscribers = atoi(optarg);
+                break;
+
+            case 'i':
+                opts.idle = atoi(optarg);
+                break;
+
+            case 'm':
+                opts.msgSize = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'r':
+                opts.rate = atol(optarg);
+                break;
+
+            case 'd':
+                opts.duration = atoi(optarg);
+                break;
+
+            case 'n':
+                opts.name = optarg;
+                break;
+
+            case 'U':
+                opts.urgentEvery = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'S':
+                opts.skew = 1;
+                break;
+
+            case 'c':
+                opts.connects = atoi(optarg);
+                break;
+
+            case 'F':
+                opts.fastOpen = 1;
+                break;
+
+            default:
+                Usage(argv[0]);
+        }
+    }
+
+    if ((argc - optind) != 2)
+    {
+        Usage(argv[0]);
+    }
+
+    if (opts.udp && (opts.connects > 0))
+    {
+        fprintf(stderr, "-c times TCP connections, it can't be used with -u\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((opts.msgSize < MIN_MSG_SIZE) || (opts.msgSize > MAX_MSG_SIZE))
+    {
+        fprintf(stderr, "Message size must be between %d and %d\n",
+            MIN_MSG_SIZE, MAX_MSG_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    /* large idle counts need a lot of fds */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = opts.udp ? SOCK_DGRAM : SOCK_STREAM;
+    hints.ai_protocol = opts.udp ? IPPROTO_UDP : IPPROTO_TCP;
+
+    result = getaddrinfo(argv[optind], argv[optind + 1], &hints, &info);
+
+    if (result != 0)
+    {
+        fprintf(stderr, "Error getting addrinfo: %s\n", gai_strerror(result));
+        exit(EXIT_FAILURE);
+    }
+
+    numConns = opts.publishers + opts.subscribers + opts.idle;
+    conns = (bench_conn_t *)calloc(numConns, sizeof(bench_conn_t));
+    pfds = (struct pollfd *)calloc(numConns, sizeof(struct pollfd));
+    memset(&results, 0, sizeof(results));
+    results.samples = (long long *)malloc(MAX_SAMPLES * sizeof(long long));
+    results.urgentSamples =
+        (long long *)malloc(MAX_SAMPLES * sizeof(long long));
+    results.connectSamples =
+        (long long *)malloc((opts.connects + 1) * sizeof(long long));
+
+    if ((NULL == conns) || (NULL == pfds) || (NULL == results.samples) ||
+        (NULL == results.urgentSamples) || (NULL == results.connectSamples))
+    {
+        perror("Error allocating connections");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.skew)
+    {
+        results.skewSlots =
+            (skew_slot_t *)calloc(SKEW_SLOTS, sizeof(skew_slot_t));
+        results.skewSamples =
+            (long long *)malloc(MAX_SAMPLES * sizeof(long long));
+        results.lastCounts = (unsigned long *)calloc(opts.subscribers + 1,
+            sizeof(unsigned long));
+
+        if ((NULL == results.skewSlots) || (NULL == results.skewSamples) ||
+            (NULL == results.lastCounts))
+        {
+            perror("Error allocating skew tables");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* subscribers first, so they're listening before anything is sent */
+    for (i = 0; i < numConns; i++)
+    {
+        if (i < opts.subscribers)
+        {
+            conns[i].role = ROLE_SUBSCRIBER;
+        }
+        else if (i < (opts.subscribers + opts.publishers))
+        {
+            conns[i].role = ROLE_PUBLISHER;
+        }
+        else
+        {
+            conns[i].role = ROLE_IDLE;
+        }
+
+        conns[i].subscriber = i;
+        conns[i].fd = OpenConnection(info, &opts);
+        conns[i].rxBuf = (char *)malloc(RX_BUF_SIZE + 1);
+        conns[i].txBuf = (char *)malloc(opts.msgSize + 1);
+
+        if ((conns[i].fd < 0) || (NULL == conns[i].rxBuf) ||
+            (NULL == conns[i].txBuf))
+        {
+            fprintf(stderr, "Error opening connection %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+
+        pfds[i].fd = conns[i].fd;
+        pfds[i].events = POLLIN;
+    }
+
+    /* give the server a moment to register everyone */
+    usleep(100000);
+
+    interval = (opts.rate > 0) ? (NS_PER_SEC / opts.rate) : 0;
+    start = NowNs();
+    stop = start + (opts.duration * NS_PER_SEC);
+
+    for (i = 0; i < numConns; i++)
+    {
+        /* spread the publishers' first sends across one interval */
+        conns[i].nextSend = start + ((interval * i) / numConns);
+    }
+
+    now = start;
+
+    while (now < (stop + (DRAIN_MS * 1000000LL)))
+    {
+        int timeout = 1;
+
+        for (i = 0; i < numConns; i++)
+        {
+            if ((ROLE_PUBLISHER != conns[i].role) || (now >= stop))
+            {
+                continue;
+            }
+
+            /* send everything that's due, unless the socket is backed up */
+            while ((0 != interval) &&
+                (conns[i].txOffset == conns[i].txLen) &&
+                (conns[i].nextSend <= now))
+            {
+                FormatMessage(&conns[i], &opts, now, &results);
+                conns[i].nextSend += interval;
+
+                if (SendPending(&conns[i]) < 0)
+                {
+                    break;
+                }
+            }
+
+            pfds[i].events = POLLIN;
+
+            if ((conns[i].txOffset < conns[i].txLen) || (0 == interval))
+            {
+                /* wait until the socket can take more */
+                pfds[i].events |= POLLOUT;
+            }
+        }
+
+        if (now >= stop)
+        {
+            timeout = 10;
+        }
+
+        if (poll(pfds, numConns, timeout) < 0)
+        {
+            if (EINTR != errno)
+            {
+                perror("Error poll failed");
+                break;
+            }
+        }
+
+        for (i = 0; i < numConns; i++)
+        {
+            if (pfds[i].revents & POLLOUT)
+            {
+                if (conns[i].txOffset < conns[i].txLen)
+                {
+                    SendPending(&conns[i]);
+                }
+                else if ((0 == interval) && (NowNs() < stop))
+                {
+                    FormatMessage(&conns[i], &opts, NowNs(), &results);
+                    SendPending(&conns[i]);
+                }
+            }
+
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                if (ReceiveMessages(&conns[i], &opts, &results) < 0)
+                {
+                    fprintf(stderr, "Server closed connection\n");
+                    now = stop + (DRAIN_MS * 1000000LL);
+                    break;
+                }
+            }
+        }
+
+        now = NowNs();
+    }
+
+    for (i = 0; i < numConns; i++)
+    {
+        if (opts.udp)
+        {
+            /* an empty message removes us from the server's list */
+            send(conns[i].fd, "", 1, 0);
+        }
+
+        close(conns[i].fd);
+        free(conns[i].rxBuf);
+        free(conns[i].txBuf);
+    }
+
+    if (opts.skew)
+    {
+        /* what's left was missed by some subscriber */
+        for (i = 0; i < SKEW_SLOTS; i++)
+        {
+            SkewFinish(&results, &opts, &results.skewSlots[i]);
+        }
+    }
+
+    for (i = 0; i < opts.connects; i++)
+    {
+        long long elapsed;
+        int synData;
+
+        elapsed = ConnectProbe(info, &opts, &synData);
+
+        if (elapsed < 0)
+        {
+            results.connectFailed++;
+            continue;
+        }
+
+        results.connectSamples[results.numConnectSamples++] = elapsed;
+        results.connectSynData += synData;
+    }
+
+    freeaddrinfo(info);
+    PrintResults(&opts, &results);
+
+    free(results.samples);
+    free(results.urgentSamples);
+    free(results.skewSlots);
+    free(results.skewSamples);
+    free(results.lastCounts);
+    free(results.connectSamples);
+    free(conns);
+    free(pfds);
+    return EXIT_SUCCESS;
+}
+
+
+/***************************************************************************
+*   Function   : Usage
+*   Description: This routine writes the command line usage to stderr and
+*                exits.
+*   Parameters : prog - the name of this program.
+*   Effects    : The program exits.
+*   Returned   : None
+***************************************************************************/
+void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage:  %s [options] <server hostname or address> <port number>\n"
+        "  -u         use UDP instead of TCP\n"
+        "  -p <n>     number of publishers (default 1)\n"
+        "  -s <n>     number of subscribers (default 4)\n"
+        "  -i <n>     number of idle connections (default 0)\n"
+        "  -m <n>     message size in bytes (default 64)\n"
+        "  -r <n>     messages/sec per publisher, 0 = unlimited "
+        "(default 1000)\n"
+        "  -d <n>     duration in seconds (default 5)\n"
+        "  -n <name>  scenario name reported with the results\n"
+        "  -U <n>     every n-th message is a short urgent one "
+        "(default 0, none)\n"
+        "  -S         measure the spread from first to last subscriber\n"
+        "  -c <n>     time n new connections from connect to first echo\n"
+        "  -F         send their first message in the SYN (TCP Fast Open)\n",
+        prog);
+    exit(EXIT_FAILURE);
+}
+
+
+/***************************************************************************
+*   Function   : NowNs
+*   Description: This routine returns the monotonic clock in nanoseconds.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : The current time in nanoseconds.
+***************************************************************************/
+long long NowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+
+/***************************************************************************
+*   Function   : OpenConnection
+*   Description: This routine opens a non-blocking socket to the server.
+*                TCP sockets are connected before they are made
+*                non-blocking.  UDP sockets are connected so that only
+*                the server's datagrams are received, and a registration
+*                message is sent so the server adds us to its list.  With
+*                -S the kernel time stamps everything received.
+*   Parameters : info - the server's address information.
+*                opts - the benchmark options.
+*   Effects    : A socket is opened.
+*   Returned   : The socket descriptor, or -1 on failure.
+***************************************************************************/
+int OpenConnection(const struct addrinfo *info, const bench_opts_t *opts)
+{
+    int fd;
+
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+
+    if (fd < 0)
+    {
+        perror("Error creating socket");
+        return -1;
+    }
+
+    if (connect(fd, info->ai_addr, info->ai_addrlen) != 0)
+    {
+        perror("Error connecting to server");
+        close(fd);
+        return -1;
+    }
+
+    if (opts->skew)
+    {
+        /* the kernel's receive time isn't skewed by our read order */
+        int on = 1;
+
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    }
+
+    if (opts->udp)
+    {
+        if (send(fd, "subscribe", sizeof("subscribe"), 0) < 0)
+        {
+            perror("Error registering with server");
+            close(fd);
+            return -1;
+        }
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+
+/***************************************************************************
+*   Function   : ConnectProbe
+*   Description: This routine times one short-lived publisher: a new TCP
+*                connection sends CONNECT_MSG and waits for its echo.  The
+*                time runs from before the socket is created until the
+*                whole echo is back, so it includes the handshake.  With
+*                -F the socket has TCP_FASTOPEN_CONNECT, so once the
+*                kernel holds a Fast Open cookie for the server connect
+*                returns at once and the message goes out in the SYN,
+*                saving the handshake's round trip.  The first connection
+*                to a server fetches the cookie with a normal handshake.
+*   Parameters : info - the server's address information.
+*                opts - the benchmark options.
+*                synData - set to 1 if the server accepted data in the SYN.
+*   Effects    : A connection is opened and closed.
+*   Returned   : The time from connect to first echo (ns), or -1 if the
+*                connection failed or the echo didn't arrive within
+*                CONNECT_WAIT_MS.
+***************************************************************************/
+long long ConnectProbe(const struct addrinfo *info, const bench_opts_t *opts,
+    int *synData)
+{
+    struct pollfd pfd;
+    struct tcp_info tcpInfo;
+    socklen_t length;
+    char buffer[sizeof(CONNECT_MSG)];
+    size_t received;
+    ssize_t result;
+    long long start, stop;
+    int on;
+
+    *synData = 0;
+    start = NowNs();
+    pfd.fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    pfd.events = POLLIN;
+
+    if (pfd.fd < 0)
+    {
+        perror("Error creating socket");
+        return -1;
+    }
+
+    on = 1;
+
+    if (opts->fastOpen &&
+        (setsockopt(pfd.fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on,
+            sizeof(on)) < 0))
+    {
+        perror("Error setting TCP_FASTOPEN_CONNECT");
+        close(pfd.fd);
+        return -1;
+    }
+
+    if ((connect(pfd.fd, info->ai_addr, info->ai_addrlen) != 0) ||
+        (send(pfd.fd, CONNECT_MSG, strlen(CONNECT_MSG), 0) < 0))
+    {
+        perror("Error connecting to server");
+        close(pfd.fd);
+        return -1;
+    }
+
+    received = 0;
+    stop = -1;
+
+    while (poll(&pfd, 1, CONNECT_WAIT_MS) > 0)
+    {
+        result = recv(pfd.fd, buffer, sizeof(buffer), 0);
+
+        if (result <= 0)
+        {
+            break;
+        }
+
+        received += result;
+
+        if (received >= strlen(CONNECT_MSG))
+        {
+            stop = NowNs();
+            break;
+        }
+    }
+
+    length = sizeof(tcpInfo);
+
+    if ((getsockopt(pfd.fd, IPPROTO_TCP, TCP_INFO, &tcpInfo, &length) == 0) &&
+        (tcpInfo.tcpi_options & TCPI_OPT_SYN_DATA))
+    {
+        *synData = 1;
+    }
+
+    close(pfd.fd);
+    return (stop < 0) ? -1 : (stop - start);
+}
+
+
+/***************************************************************************
+*   Function   : FormatMessage
+*   Description: This routine fills a publisher's transmit buffer with the
+*                next message.  A message starts with its sequence number
+*                and send time, and is padded to the message size.  TCP
+*                messages end in a newline, UDP messages end in a '\0'
+*                because that's what the UDP echo server expects.  With
+*                -U every n-th message is urgent: it starts with
+*                URGENT_MARK and is only URGENT_MSG_SIZE bytes long.
+*   Parameters : conn - the publishing connection.
+*                opts - the benchmark options.
+*                now - the send time (ns).
+*                results - the results being collected.
+*   Effects    : conn's transmit buffer holds a new message, which is
+*                counted as sent.
+*   Returned   : None
+***************************************************************************/
+void FormatMessage(bench_conn_t *conn, const bench_opts_t *opts,
+    long long now, bench_results_t *results)
+{
+    int len;
+    size_t size;
+
+    size = opts->msgSize;
+
+    if ((opts->urgentEvery > 0) &&
+        ((conn->seq % opts->urgentEvery) == (opts->urgentEvery - 1)))
+    {
+        size = (size < URGENT_MSG_SIZE) ? size : URGENT_MSG_SIZE;
+        len = snprintf(conn->txBuf, size, "%c%lu %lld ", URGENT_MARK,
+            conn->seq, now);
+        results->urgentSent++;
+    }
+    else
+    {
+        len = snprintf(conn->txBuf, size, "%lu %lld ", conn->seq, now);
+    }
+
+    memset(conn->txBuf + len, 'x', size - len);
+    conn->txBuf[size - 1] = opts->udp ? '\0' : '\n';
+    conn->txLen = size;
+    conn->txOffset = 0;
+    conn->seq++;
+    results->sent++;
+}
+
+
+/***************************************************************************
+*   Function   : SendPending
+*   Description: This routine sends as much of a connection's transmit
+*                buffer as the socket will accept without blocking.
+*   Parameters : conn - the publishing connection.
+*   Effects    : Data is written to the socket.
+*   Returned   : 0 if everything was sent, 1 if some remains, -1 on error.
+***************************************************************************/
+int SendPending(bench_conn_t *conn)
+{
+    ssize_t result;
+
+    result = send(conn->fd, conn->txBuf + conn->txOffset,
+        conn->txLen - conn->txOffset, MSG_NOSIGNAL);
+
+    if (result < 0)
+    {
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+            return 1;
+        }
+
+        perror("Error sending message");
+        conn->txOffset = conn->txLen;   /* drop it */
+        return -1;
+    }
+
+    conn->txOffset += result;
+    return (conn->txOffset < conn->txLen) ? 1 : 0;
+}
+
+
+/***************************************************************************
+*   Function   : HandleMessage
+*   Description: This routine parses one received message and records the
+*                time it took to be echoed.  Messages that aren't the
+*                right length or don't parse are counted as corrupt
+*                (a TCP server that drops data for a busy socket can
+*                splice two messages together).  Urgent messages are
+*                measured separately as well.
+*   Parameters : msg - the received message (not including terminator).
+*                len - the length of msg.
+*                opts - the benchmark options.
+*                subscriber - the index of the receiving subscriber.
+*                arrival - the kernel's receive time, for -S (ns).
+*                results - the results being collected.
+*   Effects    : results is updated.
+*   Returned   : None
+***************************************************************************/
+void HandleMessage(const char *msg, size_t len, const bench_opts_t *opts,
+    int subscriber, long long arrival, bench_results_t *results)
+{
+    unsigned long seq;
+    long long sendTime;
+    size_t size;
+    int urgent;
+
+    urgent = (len > 0) && (URGENT_MARK == msg[0]);
+    size = opts->msgSize;
+
+    if (urgent)
+    {
+        size = (size < URGENT_MSG_SIZE) ? size : URGENT_MSG_SIZE;
+    }
+
+    if ((len != (size - 1)) ||
+        (sscanf(msg + urgent, "%lu %lld ", &seq, &sendTime) != 2))
+    {
+        results->corrupt++;
+        return;
+    }
+
+    results->received++;
+
+    if (urgent)
+    {
+        results->urgentReceived++;
+
+        if (results->numUrgentSamples < MAX_SAMPLES)
+        {
+            results->urgentSamples[results->numUrgentSamples] =
+                NowNs() - sendTime;
+            results->numUrgentSamples++;
+        }
+    }
+
+    if (results->numSamples < MAX_SAMPLES)
+    {
+        results->samples[results->numSamples] = NowNs() - sendTime;
+        results->numSamples++;
+    }
+
+    if (opts->skew)
+    {
+        SkewRecord(results, opts, subscriber, seq, sendTime, arrival);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SkewRecord
+*   Description: This routine records one subscriber's delivery of a
+*                message for -S.  A message is tracked in a slot chosen by
+*                hashing its sequence number and send time (which together
+*                identify it across publishers) from its first delivery
+*                until every subscriber has it.  A different message
+*                hashing to a busy slot evicts the one there, which is
+*                then counted as incomplete.  Deliveries are read in any
+*                order, so the earliest and latest are kept.
+*   Parameters : results - the results being collected.
+*                opts - the benchmark options.
+*                subscriber - the index of the receiving subscriber.
+*                seq - the message's sequence number.
+*                sendTime - the message's send time (ns).
+*                now - the delivery time (ns).  Any clock will do, since
+*                only differences are kept.
+*   Effects    : The message's slot is updated and may be finished.
+*   Returned   : None
+***************************************************************************/
+void SkewRecord(bench_results_t *results, const bench_opts_t *opts,
+    int subscriber, unsigned long seq, long long sendTime, long long now)
+{
+    skew_slot_t *slot;
+    unsigned long long hash;
+
+    hash = ((unsigned long long)seq * 0x9E3779B97F4A7C15ULL) ^
+        (unsigned long long)sendTime;
+    slot = &(results->skewSlots[(hash ^ (hash >> 32)) & (SKEW_SLOTS - 1)]);
+
+    if ((slot->count > 0) &&
+        ((slot->seq != seq) || (slot->sendTime != sendTime)))
+    {
+        SkewFinish(results, opts, slot);
+    }
+
+    if (0 == slot->count)
+    {
+        slot->seq = seq;
+        slot->sendTime = sendTime;
+        slot->first = now;
+        slot->last = now;
+        slot->lastSubscriber = subscriber;
+    }
+    else if (now < slot->first)
+    {
+        slot->first = now;      /* read after a later delivery */
+    }
+    else if (now >= slot->last)
+    {
+        slot->last = now;
+        slot->lastSubscriber = subscriber;
+    }
+
+    slot->count++;
+
+    if (slot->count >= opts->subscribers)
+    {
+        SkewFinish(results, opts, slot);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SkewFinish
+*   Description: This routine stops tracking a message.  The spread from
+*                its first to its last delivery is kept if every
+*                subscriber received it, and the last subscriber is
+*                counted, otherwise the message is counted as incomplete.
+*   Parameters : results - the results being collected.
+*                opts - the benchmark options.
+*                slot - the message's slot.
+*   Effects    : The slot is freed and results is updated.
+*   Returned   : None
+***************************************************************************/
+void SkewFinish(bench_results_t *results, const bench_opts_t *opts,
+    skew_slot_t *slot)
+{
+    if (0 == slot->count)
+    {
+        return;
+    }
+
+    if (slot->count < opts->subscribers)
+    {
+        results->skewIncomplete++;
+    }
+    else
+    {
+        results->lastCounts[slot->lastSubscriber]++;
+
+        if (results->numSkewSamples < MAX_SAMPLES)
+        {
+            results->skewSamples[results->numSkewSamples] =
+                slot->last - slot->first;
+            results->numSkewSamples++;
+        }
+    }
+
+    slot->count = 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReceiveMessages
+*   Description: This routine reads everything that's waiting on a
+*                connection.  Only subscriber messages are measured, the
+*                echoes sent to publishers and idle connections are read
+*                and discarded.  With -S each read's kernel time stamp
+*                (the latest segment's, for TCP) is its messages' arrival
+*                time.
+*   Parameters : conn - the connection to read from.
+*                opts - the benchmark options.
+*                results - the results being collected.
+*   Effects    : The socket is drained and results is updated.
+*   Returned   : 0 for success, -1 if the server closed the connection.
+***************************************************************************/
+int ReceiveMessages(bench_conn_t *conn, const bench_opts_t *opts,
+    bench_results_t *results)
+{
+    ssize_t result;
+    char *line, *end;
+    long long arrival;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct timespec stamp;
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+
+    while (1)
+    {
+        iov.iov_base = conn->rxBuf + conn->rxLen;
+        iov.iov_len = RX_BUF_SIZE - conn->rxLen;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        result = recvmsg(conn->fd, &msg, 0);
+
+        if (result < 0)
+        {
+            return ((EAGAIN == errno) || (EWOULDBLOCK == errno)) ? 0 : -1;
+        }
+        else if ((0 == result) && !opts->udp)
+        {
+            return -1;
+        }
+
+        if (ROLE_SUBSCRIBER != conn->role)
+        {
+            continue;
+        }
+
+        /* the same clock as the kernel's time stamps if there are none */
+        clock_gettime(CLOCK_REALTIME, &stamp);
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg;
+            cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if ((SOL_SOCKET == cmsg->cmsg_level) &&
+                (SCM_TIMESTAMPNS == cmsg->cmsg_type))
+            {
+                memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            }
+        }
+
+        arrival = (stamp.tv_sec * NS_PER_SEC) + stamp.tv_nsec;
+
+        if (opts->udp)
+        {
+            /* each datagram is one message */
+            conn->rxBuf[result] = '\0';
+            HandleMessage(conn->rxBuf, strlen(conn->rxBuf), opts,
+                conn->subscriber, arrival, results);
+            continue;
+        }
+
+        /* split the stream into lines, keep any partial line */
+        conn->rxLen += result;
+        conn->rxBuf[conn->rxLen] = '\0';
+        line = conn->rxBuf;
+
+        while ((end = memchr(line, '\n',
+            conn->rxLen - (line - conn->rxBuf))) != NULL)
+        {
+            HandleMessage(line, end - line, opts, conn->subscriber,
+                arrival, results);
+            line = end + 1;
+        }
+
+        conn->rxLen -= (line - conn->rxBuf);
+        memmove(conn->rxBuf, line, conn->rxLen);
+
+        if (RX_BUF_SIZE == conn->rxLen)
+        {
+            /* no newline in a full buffer, it's garbage */
+            results->corrupt++;
+            conn->rxLen = 0;
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : CompareSamples
+*   Description: This routine is the qsort comparison function for latency
+*                samples.
+*   Parameters : s1 - pointer to a sample
+*                s2 - pointer to a sample
+*   Effects    : None
+*   Returned   : < 0, 0, or > 0 if s1 is less than, equal to, or greater
+*                than s2.
+***************************************************************************/
+int CompareSamples(const void *s1, const void *s2)
+{
+    long long a = *(const long long *)s1;
+    long long b = *(const long long *)s2;
+
+    return (a > b) - (a < b);
+}
+
+
+/***************************************************************************
+*   Function   : Percentile
+*   Description: This routine returns a percentile of sorted latency
+*                samples.
+*   Parameters : samples - the sorted samples.
+*                numSamples - the number of samples.
+*                pct - the percentile (0.0 - 100.0).
+*   Effects    : None
+*   Returned   : The percentile in nanoseconds, 0 if there are no samples.
+***************************************************************************/
+long long Percentile(const long long *samples, unsigned long numSamples,
+    double pct)
+{
+    unsigned long index;
+
+    if (0 == numSamples)
+    {
+        return 0;
+    }
+
+    index = (unsigned long)((pct / 100.0) * (numSamples - 1));
+    return samples[index];
+}
+
+
+/***************************************************************************
+*   Function   : Outliers
+*   Description: This routine counts the sorted latency samples above a
+*                limit.  Tail percentiles hide how often a rare stall
+*                happens, the count doesn't.
+*   Parameters : samples - the sorted samples.
+*                numSamples - the number of samples.
+*                limit - the latency limit in nanoseconds.
+*   Effects    : None
+*   Returned   : The number of samples greater than limit.
+***************************************************************************/
+unsigned long Outliers(const long long *samples, unsigned long numSamples,
+    long long limit)
+{
+    unsigned long low, high, middle;
+
+    /* find the first sample over the limit */
+    low = 0;
+    high = numSamples;
+
+    while (low < high)
+    {
+        middle = low + ((high - low) / 2);
+
+        if (samples[middle] > limit)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return numSamples - low;
+}
+
+
+/***************************************************************************
+*   Function   : PrintResults
+*   Description: This routine writes the benchmark results to stdout as a
+*                single JSON object.  Urgent message results are only
+*                included with -U, and fan-out spread results with -S.
+*                skew_last_top_share is the share of messages whose last
+*                delivery went to the subscriber that was most often last;
+*                1/subscribers is perfectly fair.  lat_over_1ms and
+*                lat_over_10ms count the outliers (see Outliers).  The
+*                connect to first echo times are only included with -c;
+*                connect_syn_data counts the connections whose first
+*                message the server took from the SYN.
+*   Parameters : opts - the benchmark options.
+*                results - the collected results.
+*   Effects    : The samples are sorted and the results are written.
+*   Returned   : None
+***************************************************************************/
+void PrintResults(const bench_opts_t *opts, bench_results_t *results)
+{
+    double expected;
+
+    qsort(results->samples, results->numSamples, sizeof(long long),
+        CompareSamples);
+    qsort(results->urgentSamples, results->numUrgentSamples,
+        sizeof(long long), CompareSamples);
+
+    expected = (double)results->sent * opts->subscribers;
+
+    printf("{\"name\": \"%s\", \"proto\": \"%s\", \"publishers\": %d, "
+        "\"subscribers\": %d, \"idle\": %d, \"msg_size\": %lu, "
+        "\"rate\": %ld, \"duration_s\": %d, \"sent_msgs\": %lu, "
+        "\"recv_msgs\": %lu, \"corrupt_msgs\": %lu, "
+        "\"delivery_ratio\": %.4f, \"recv_msgs_per_sec\": %.1f, "
+        "\"lat_p50_us\": %.1f, \"lat_p90_us\": %.1f, \"lat_p99_us\": %.1f, "
+        "\"lat_max_us\": %.1f, \"lat_over_1ms\": %lu, "
+        "\"lat_over_10ms\": %lu",
+        opts->name, opts->udp ? "udp" : "tcp", opts->publishers,
+        opts->subscribers, opts->idle, (unsigned long)opts->msgSize,
+        opts->rate, opts->duration, results->sent, results->received,
+        results->corrupt,
+        (expected > 0) ? (results->received / expected) : 0.0,
+        (double)results->received / opts->duration,
+        Percentile(results->samples, results->numSamples, 50.0) / 1000.0,
+        Percentile(results->samples, results->numSamples, 90.0) / 1000.0,
+        Percentile(results->samples, results->numSamples, 99.0) / 1000.0,
+        Percentile(results->samples, results->numSamples, 100.0) / 1000.0,
+        Outliers(results->samples, results->numSamples, OUTLIER_1MS),
+        Outliers(results->samples, results->numSamples, OUTLIER_10MS));
+
+    if (opts->urgentEvery > 0)
+    {
+        printf(", \"urgent_every\": %lu, \"urgent_sent_msgs\": %lu, "
+            "\"urgent_recv_msgs\": %lu, \"urgent_lat_p50_us\": %.1f, "
+            "\"urgent_lat_p99_us\": %.1f, \"urgent_lat_max_us\": %.1f",
+            opts->urgentEvery, results->urgentSent, results->urgentReceived,
+            Percentile(results->urgentSamples, results->numUrgentSamples,
+                50.0) / 1000.0,
+            Percentile(results->urgentSamples, results->numUrgentSamples,
+                99.0) / 1000.0,
+            Percentile(results->urgentSamples, results->numUrgentSamples,
+                100.0) / 1000.0);
+    }
+
+    if (opts->skew)
+    {
+        unsigned long top;
+        int i;
+
+        qsort(results->skewSamples, results->numSkewSamples,
+            sizeof(long long), CompareSamples);
+        top = 0;
+
+        for (i = 0; i < opts->subscribers; i++)
+        {
+            top = (results->lastCounts[i] > top) ?
+                results->lastCounts[i] : top;
+        }
+
+        printf(", \"skew_msgs\": %lu, \"skew_incomplete_msgs\": %lu, "
+            "\"skew_p50_us\": %.1f, \"skew_p90_us\": %.1f, "
+            "\"skew_p99_us\": %.1f, \"skew_max_us\": %.1f, "
+            "\"skew_last_top_share\": %.3f",
+            results->numSkewSamples, results->skewIncomplete,
+            Percentile(results->skewSamples, results->numSkewSamples,
+                50.0) / 1000.0,
+            Percentile(results->skewSamples, results->numSkewSamples,
+                90.0) / 1000.0,
+            Percentile(results->skewSamples, results->numSkewSamples,
+                99.0) / 1000.0,
+            Percentile(results->skewSamples, results->numSkewSamples,
+                100.0) / 1000.0,
+            (results->numSkewSamples > 0) ?
+                ((double)top / results->numSkewSamples) : 0.0);
+    }
+
+    if (opts->connects > 0)
+    {
+        qsort(results->connectSamples, results->numConnectSamples,
+            sizeof(long long), CompareSamples);
+
+        printf(", \"connects\": %d, \"connect_fastopen\": %d, "
+            "\"connect_failed\": %lu, \"connect_syn_data\": %lu, "
+            "\"connect_p50_us\": %.1f, \"connect_p90_us\": %.1f, "
+            "\"connect_p99_us\": %.1f, \"connect_max_us\": %.1f",
+            opts->connects, opts->fastOpen, results->connectFailed,
+            results->connectSynData,
+            Percentile(results->connectSamples, results->numConnectSamples,
+                50.0) / 1000.0,
+            Percentile(results->connectSamples, results->numConnectSamples,
+                90.0) / 1000.0,
+            Percentile(results->connectSamples, results->numConnectSamples,
+                99.0) / 1000.0,
+            Percentile(results->connectSamples, results->numConnectSamples,
+                100.0) / 1000.0);
+    }
+
+    printf("}\n");
+}
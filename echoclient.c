@@ -54,9 +54,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 
-#include <poll.h>
+#include "reactor.h"
 
 /***************************************************************************
 *                                CONSTANTS
@@ -68,6 +70,10 @@
 ***************************************************************************/
 int DoEchoClient(const int socketFd);
 
+/* reactor callbacks */
+void UserReady(reactor_t *reactor, int fd, unsigned int events, void *data);
+void EchoReady(reactor_t *reactor, int fd, unsigned int events, void *data);
+
 /***************************************************************************
 *                                FUNCTIONS
 ***************************************************************************/
@@ -75,11 +81,17 @@ int DoEchoClient(const int socketFd);
 /***************************************************************************
 *   Function   : main
 *   Description: This is the main function for this program, it opens a TCP
-*                connection to the host specified in argv[1] on the port
-*                specified in argv[2].  Then calls DoEchoClient to handle
-*                sending and receiving messages.
+*                connection to the host and port that follow the options
+*                on the command line.  Then calls DoEchoClient to handle
+*                sending and receiving messages.  With -F the connection
+*                uses TCP Fast Open (TCP_FASTOPEN_CONNECT): if the kernel
+*                holds a Fast Open cookie from an earlier connection to
+*                the server, connect returns at once and the first
+*                message is sent in the SYN, saving a round trip on
+*                reconnects.  Without a cookie the handshake is the usual
+*                one, and it fetches a cookie for next time.
 *   Parameters : argc - number of parameters
-*                argv - parameter list (argv[1] is host name, argv[2] is
+*                argv - parameter list (options, then the host name and
 *                port)
 *   Effects    : A connection to is established with the echo server and
 *                DoEchoClient is called to handle transmitting and
@@ -91,17 +103,35 @@ int main(int argc, char **argv)
 {
     int result;
     int socketFd;               /* TCP/IP socket descriptor */
+    int fastOpen;               /* -F: send the first message in the SYN */
+    int opt;
 
     /* structures for use with getaddrinfo() */
     struct addrinfo hints;      /* hints for getaddrinfo() */
     struct addrinfo *servInfo;  /* list of info returned by getaddrinfo() */
     struct addrinfo *p;         /* pointer for iterating list in servInfo */
 
-    /* argv[1] is host name, argv[2] is port number, make sure we have them */
-    if (argc != 3)
+    fastOpen = 0;
+
+    while ((opt = getopt(argc, argv, "F")) != -1)
+    {
+        switch (opt)
+        {
+            case 'F':
+                fastOpen = 1;
+                break;
+
+            default:
+                optind = argc;      /* force the usage message */
+                break;
+        }
+    }
+
+    /* host name and port number follow the options, make sure we have them */
+    if (argc != (optind + 2))
     {
         fprintf(stderr,
-            "Usage:  %s <server hostname or address> <port number>\n",
+            "Usage:  %s [-F] <server hostname or address> <port number>\n",
             argv[0]);
         exit(EXIT_FAILURE);
     }
@@ -115,7 +145,7 @@ int main(int argc, char **argv)
     hints.ai_flags = AI_CANONNAME;      /* include canonical name */
 
     /* get a linked list of likely servers pointed to by servInfo */
-    result = getaddrinfo(argv[1], argv[2], &hints, &servInfo);
+    result = getaddrinfo(argv[optind], argv[optind + 1], &hints, &servInfo);
 
     if (result != 0)
     {
@@ -124,7 +154,7 @@ int main(int argc, char **argv)
     }
 
 
-    printf("Trying %s...\n", argv[1]);
+    printf("Trying %s...\n", argv[optind]);
     p = servInfo;
 
     while (p != NULL)
@@ -132,6 +162,14 @@ int main(int argc, char **argv)
         /* use current info to create a socket */
         socketFd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
 
+        if ((socketFd >= 0) && fastOpen &&
+            (setsockopt(socketFd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                &fastOpen, sizeof(fastOpen)) < 0))
+        {
+            /* connect the usual way */
+            perror("Error setting TCP_FASTOPEN_CONNECT");
+        }
+
         if (socketFd >= 0)
         {
             /***************************************************************
@@ -182,7 +220,7 @@ int main(int argc, char **argv)
 
 /***************************************************************************
 *   Function   : DoEchoClient
-*   Description: This routine contains the polling loop to handle sending
+*   Description: This routine runs the event loop that handles sending
 *                and receiving of echo messages.  Message from stdin are
 *                written to the socket passed as a parameter.  Messages
 *                received from the socket passed as a parameter are written
@@ -194,69 +232,122 @@ int main(int argc, char **argv)
 *                from and written to.
 *   Effects    : stdin is read for messages, which are sent to socketFd.
 *                socketFd is read for messages, which are sent to stdout.
-*   Returned   : 0 for empty message from stdin or closed socket.
+*   Returned   : 0 for empty message from stdin or closed socket, -1 if
+*                the event loop fails.
 ***************************************************************************/
 int DoEchoClient(const int socketFd)
 {
     int result;
-    char buffer[BUF_SIZE + 1];  /* stores received message */
-    struct pollfd pfds[2];      /* file descriptors for polling */
+    reactor_t reactor;
 
-    printf("Enter messages to send [empty message exits]:\n");
+    /* poll is cheaper than epoll for two fds */
+    if (ReactorInit(&reactor, REACTOR_POLL, 0) != 0)
+    {
+        return -1;
+    }
 
-    /* enter a poll loop until empty message or server disconnects */
-    while (1)
+    /* stdin for user input, socket for input from echos */
+    if ((ReactorAdd(&reactor, STDIN_FILENO, REACTOR_READ, UserReady,
+            (void *)&socketFd) != 0) ||
+        (ReactorAdd(&reactor, socketFd, REACTOR_READ, EchoReady, NULL) != 0))
     {
-        /* stdin for user input */
-        pfds[0].fd = STDIN_FILENO;
-        pfds[0].events = POLLIN;
+        perror("Error registering fds");
+        ReactorFree(&reactor);
+        return -1;
+    }
 
-        /* socket for input from echos */
-        pfds[1].fd = socketFd;
-        pfds[1].events = POLLIN;
+    printf("Enter messages to send [empty message exits]:\n");
 
-        result = poll(pfds, 2, -1);
+    /* run the event loop until empty message or server disconnects */
+    result = ReactorRun(&reactor);
+    ReactorFree(&reactor);
+    return result;
+}
 
-        if (pfds[0].revents &  POLLIN)
-        {
-            /* we can read the user's input to send */
-            fgets(buffer, BUF_SIZE, stdin);
 
-            if (strlen(buffer) <= 1)
-            {
-                /* exit on empty message */
-                break;
-            }
+/***************************************************************************
+*   Function   : UserReady
+*   Description: This is the reactor callback for stdin.  It sends the
+*                user's message line to the server, or stops the reactor
+*                if the line is empty.
+*   Parameters : reactor - the client's reactor.
+*                fd - stdin.
+*                events - unused.
+*                data - pointer to the socket descriptor for the server.
+*   Effects    : A line is read from stdin and written to the socket.
+*   Returned   : None
+***************************************************************************/
+void UserReady(reactor_t *reactor, int fd, unsigned int events, void *data)
+{
+    int result;
+    int socketFd;
+    char buffer[BUF_SIZE + 1];  /* stores the user's message */
 
-            /* send the message line to the server (write is blocking) */
-            result = write(socketFd, buffer, strlen(buffer));
+    (void)fd;
+    (void)events;
+    socketFd = *(const int *)data;
 
-            if (result != (int)strlen(buffer))
-            {
-                perror("Error sending message to server");
-            }
-        }
+    /* we can read the user's input to send */
+    if ((NULL == fgets(buffer, BUF_SIZE, stdin)) || (strlen(buffer) <= 1))
+    {
+        /* exit on empty message */
+        ReactorStop(reactor, 0);
+        return;
+    }
 
-        if (pfds[1].revents &  POLLIN)
-        {
-            /* get server's echo */
-            result = read(socketFd, buffer, BUF_SIZE);
+    /* send the message line to the server (write is blocking) */
+    result = write(socketFd, buffer, strlen(buffer));
+    REACTOR_COUNT(reactor, sendCalls, 1);
 
-            if (result < 0)
-            {
-                perror("Error receiving echo");
-            }
-            else if (0 == result)
-            {
-                /* the server side of the */
-                printf("Server closed connection.  Exiting ...\n");
-                break;
-            }
+    if (result != (int)strlen(buffer))
+    {
+        perror("Error sending message to server");
+    }
+    else
+    {
+        REACTOR_COUNT(reactor, bytesOut, result);
+    }
+}
 
-            buffer[result] = '\0';
-            printf("Received: %s", buffer);
-        }
+
+/***************************************************************************
+*   Function   : EchoReady
+*   Description: This is the reactor callback for the socket.  It writes
+*                the server's echo to stdout, or stops the reactor if the
+*                server closed the connection.
+*   Parameters : reactor - the client's reactor.
+*                fd - the socket connected to the server.
+*                events - unused.
+*                data - unused.
+*   Effects    : The socket is read and the echo is written to stdout.
+*   Returned   : None
+***************************************************************************/
+void EchoReady(reactor_t *reactor, int fd, unsigned int events, void *data)
+{
+    int result;
+    char buffer[BUF_SIZE + 1];  /* stores received message */
+
+    (void)events;
+    (void)data;
+
+    /* get server's echo */
+    result = read(fd, buffer, BUF_SIZE);
+    REACTOR_COUNT(reactor, recvCalls, 1);
+
+    if (result < 0)
+    {
+        perror("Error receiving echo");
+        return;
+    }
+    else if (0 == result)
+    {
+        /* the server side of the */
+        printf("Server closed connection.  Exiting ...\n");
+        ReactorStop(reactor, 0);
+        return;
     }
 
-    return 0;
+    REACTOR_COUNT(reactor, bytesIn, result);
+    buffer[result] = '\0';
+    printf("Received: %s", buffer);
 }
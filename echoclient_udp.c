@@ -54,20 +54,33 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
-#include <poll.h>
-
 #include <netdb.h>
 
+#include "reactor.h"
+
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
 #define BUF_SIZE    1024        /* size of send/receive buffer */
 
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct echo_client_t
+{
+    int socketFd;                           /* socket for the server */
+    const struct sockaddr_in *serverAddr;   /* where messages are sent */
+} echo_client_t;
+
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
 int DoEchoClient(const int socketFd, const struct sockaddr_in *serverAddr);
 
+/* reactor callbacks */
+void EchoReady(reactor_t *reactor, int fd, unsigned int events, void *data);
+void UserReady(reactor_t *reactor, int fd, unsigned int events, void *data);
+
 /***************************************************************************
 *                                FUNCTIONS
 ***************************************************************************/
@@ -161,11 +174,11 @@ int main(int argc, char **argv)
 
 /***************************************************************************
 *   Function   : DoEchoClient
-*   Description: This routine gets a messages from stdin then writes them
-*                server's socket.  It also receives any messages from  the
-*                server's socket.  It will exit when an empty message is
-*                received from stdin, or an error occurs.
-*                stdin, this routine will exit without transmitting it.
+*   Description: This routine runs the event loop that gets messages from
+*                stdin then writes them server's socket.  It also receives
+*                any messages from  the server's socket.  It will exit when
+*                an empty message is received from stdin, or an error
+*                occurs.
 *   Parameters : socketFd - The socket descriptor for the socket to be read
 *                from and echoed to.  It must be bound to the server
 *                address.
@@ -180,82 +193,132 @@ int main(int argc, char **argv)
 int DoEchoClient(const int socketFd, const struct sockaddr_in *serverAddr)
 {
     int result;
-    char buffer[BUF_SIZE + 1];  /* stores received message */
-    struct pollfd pfds[2];      /* poll for socket recv and stdin */
+    reactor_t reactor;
+    echo_client_t client;
+
+    client.socketFd = socketFd;
+    client.serverAddr = serverAddr;
 
-    pfds[0].fd = socketFd;
-    pfds[0].events = POLLIN;
+    /* poll is cheaper than epoll for two fds */
+    if (ReactorInit(&reactor, REACTOR_POLL, 0) != 0)
+    {
+        return -1;
+    }
 
-    pfds[1].fd = STDIN_FILENO;
-    pfds[1].events = POLLIN;
+    /* poll for socket recv and stdin */
+    if ((ReactorAdd(&reactor, socketFd, REACTOR_READ, EchoReady, NULL) != 0) ||
+        (ReactorAdd(&reactor, STDIN_FILENO, REACTOR_READ, UserReady,
+            &client) != 0))
+    {
+        perror("Error registering fds");
+        ReactorFree(&reactor);
+        return -1;
+    }
 
     /* get message line from the user */
     printf("Enter message to send [empty message exits]:\n");
 
-    while (1)
+    result = ReactorRun(&reactor);
+    ReactorFree(&reactor);
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : EchoReady
+*   Description: This is the reactor callback for the socket.  It writes
+*                the server's reply to stdout.
+*   Parameters : reactor - the client's reactor.
+*                fd - the client's socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : A datagram is received and written to stdout.  The
+*                reactor is stopped if the receive fails.
+*   Returned   : None
+***************************************************************************/
+void EchoReady(reactor_t *reactor, int fd, unsigned int events, void *data)
+{
+    int result;
+    char buffer[BUF_SIZE + 1];  /* stores received message */
+
+    (void)events;
+    (void)data;
+
+    /* get the server's reply (recv actually accepts all replies) */
+    result = recv(fd, buffer, BUF_SIZE, 0);
+    REACTOR_COUNT(reactor, recvCalls, 1);
+
+    if (result < 0)
     {
-        /* block with poll until user input or socket receive data */
-        poll(pfds, 2, -1);
+        /* receiver error, print error message and exit */
+        perror("Error receiving echo");
+        ReactorStop(reactor, result);
+        return;
+    }
 
-        /* check for recv on socket */
-        if (pfds[0].revents & POLLIN)
-        {
-            /* get the server's reply (recv actually accepts all replies) */
-            result = recv(socketFd, buffer, BUF_SIZE, 0);
-
-            if (result < 0)
-            {
-                /* receiver error, print error message and exit */
-                perror("Error receiving echo");
-                break;
-            }
-            else
-            {
-                printf("Received bytes: %s\n", buffer);
-                memset(buffer, 0, strlen(buffer));  /* clear buffer for reuse */
-            }
-        }
+    REACTOR_COUNT(reactor, bytesIn, result);
+    buffer[result] = '\0';
+    printf("Received bytes: %s\n", buffer);
+}
 
-        /* check for message to transmit */
-        if (pfds[1].revents & POLLIN)
-        {
-            if (NULL == fgets(buffer, BUF_SIZE, stdin))
-            {
-                /* error, print error message, get error code, and exit */
-                perror("Error reading user input");
-                result = ferror(stdin);
-                break;
-            }
-
-            /* strip off the trailing carriage return */
-            buffer[strlen(buffer) - 1] = '\0';
-
-            /* send the message line to the server */
-            result = sendto(socketFd, buffer, strlen(buffer) + 1, 0,
-                (const struct sockaddr *)serverAddr,
-                sizeof(struct sockaddr_in));
-
-            if (result < 0)
-            {
-                /* error, print error message and exit */
-                perror("Error sending message to server");
-                break;
-            }
-
-            if (buffer[0] == '\0')
-            {
-                /* exit on empty message */
-                result = 0;
-                break;
-            }
-            else
-            {
-                /* clear the buffer and prompt for new message to echo */
-                memset(buffer, 0, strlen(buffer));
-                printf("Enter message to send [empty message exits]:\n");
-            }
-        }
+
+/***************************************************************************
+*   Function   : UserReady
+*   Description: This is the reactor callback for stdin.  It sends the
+*                user's message line to the server, including an empty
+*                message, which also stops the reactor.
+*   Parameters : reactor - the client's reactor.
+*                fd - stdin.
+*                events - unused.
+*                data - the client's echo_client_t.
+*   Effects    : A line is read from stdin and sent to the server.
+*   Returned   : None
+***************************************************************************/
+void UserReady(reactor_t *reactor, int fd, unsigned int events, void *data)
+{
+    int result;
+    char buffer[BUF_SIZE + 1];  /* stores the user's message */
+    const echo_client_t *client;
+
+    (void)fd;
+    (void)events;
+    client = (const echo_client_t *)data;
+
+    if (NULL == fgets(buffer, BUF_SIZE, stdin))
+    {
+        /* error, print error message, get error code, and exit */
+        perror("Error reading user input");
+        ReactorStop(reactor, ferror(stdin));
+        return;
     }
 
-    return result;
+    /* strip off the trailing carriage return */
+    buffer[strcspn(buffer, "\n")] = '\0';
+
+    /* send the message line to the server */
+    result = sendto(client->socketFd, buffer, strlen(buffer) + 1, 0,
+        (const struct sockaddr *)client->serverAddr,
+        sizeof(struct sockaddr_in));
+    REACTOR_COUNT(reactor, sendCalls, 1);
+
+    if (result < 0)
+    {
+        /* error, print error message and exit */
+        perror("Error sending message to server");
+        ReactorStop(reactor, result);
+        return;
+    }
+
+    REACTOR_COUNT(reactor, bytesOut, result);
+
+    if (buffer[0] == '\0')
+    {
+        /* exit on empty message */
+        ReactorStop(reactor, 0);
+    }
+    else
+    {
+        /* prompt for new message to echo */
+        printf("Enter message to send [empty message exits]:\n");
+    }
 }
@@ -48,289 +48,4886 @@
 ***************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sched.h>
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
-#include <poll.h>
+#include <signal.h>
+
+#include "reactor.h"
+#include "bufpool.h"
+#include "loopmon.h"
+#include "flightrec.h"
+#include "control.h"
+#include "tcpinfo.h"
+#include "coro.h"
+#include "ringq.h"
+#include "shmring.h"
+#include "rcu.h"
+#include "websock.h"
+#include "handoff.h"
+#include "lowlat.h"
+#include "topk.h"
+#include "filter.h"
 
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
-#define MAX_BACKLOG 10          /* maximum outstanding connection requests */
-#define BUF_SIZE    1024        /* size of receive buffer */
+#define MAX_BACKLOG 10          /* default outstanding connection requests */
+#define STALL_THRESHOLD_US  10000   /* report loop iterations longer than this */
+#define TCPINFO_INTERVAL_MS 1000    /* time between TCP_INFO sweeps */
+#define TCPINFO_BATCH       32      /* default connections sampled per turn */
+#define MAX_LINE_SIZE   (4 * RX_MAX_SIZE)   /* longer lines are split */
+#define COALESCE_MAX_BYTES  RX_MAX_SIZE     /* batch held per subscriber */
+#define COALESCE_DEFAULT_US 1000    /* window when only -N is given */
+
+/* priority lanes (-P) */
+#define LANE_URGENT     0           /* frames starting with LANE_MARK */
+#define LANE_BULK       1           /* everything else */
+#define LANE_COUNT      2
+#define LANE_MARK       '!'         /* first byte of an urgent frame */
+#define LANE_URGENT_LIMIT   (64 * 1024)     /* default bytes queued per client */
+#define LANE_BULK_LIMIT     (1024 * 1024)   /* default bytes queued per client */
+#define LANE_URGENT_BURST   32      /* default urgent frames back to back */
+#define LANE_IOV_MAX    16          /* frames written per sendmsg */
+#define LANE_NOTSENT_LOWAT  16384   /* default unsent bytes left to the kernel */
+
+/* WebSocket gateway (-G), the states of a connection */
+#define WS_RAW          0           /* a plain TCP client */
+#define WS_PENDING      1           /* not known yet, nothing is sent to it */
+#define WS_OPEN         2           /* the WebSocket handshake is done */
+#define WS_DETECT_MS    50          /* a silent client is plain after this */
+#define WS_MAX_PAYLOAD  MAX_LINE_SIZE   /* larger client frames are refused */
+
+/* pre-forked workers (-w) */
+#define RING_BUFFER_SIZE    (MAX_LINE_SIZE + RX_MAX_SIZE)   /* biggest read */
+
+/* dedicated acceptor (-A) */
+#define BALANCE_INTERVAL_MS 100     /* time between load samples */
+#define BALANCE_RATIO       2       /* hot worker's load over the cold one's */
+#define MIGRATE_MS          1000    /* default time between migrations */
+#define MIGRATE_GAP     (64 * 1024) /* default load gap worth a migration */
+#define HANDOFF_NEW     0           /* master to worker: a new connection */
+#define HANDOFF_MOVE    1           /* a migrating connection and its state */
+#define HANDOFF_SHED    2           /* master to worker: migrate one away */
+
+/* the worst connections, by peer address (see topk.h) */
+#define TOP_LAG         0           /* bytes queued for it, every sweep */
+#define TOP_EAGAIN      1           /* sends it was too busy for */
+#define TOP_INGRESS     2           /* bytes received from it */
+#define TOP_COUNT       3
+
+/* subscriber content filters (see filter.h) */
+#define MAX_FILTERS     16          /* filters a client may register */
 
 /***************************************************************************
 *                                 TYPES
 ***************************************************************************/
+/* the header in front of each frame in a lane queue */
+typedef struct lane_frame_t
+{
+    size_t length;
+    long long arrival;          /* when the frame was received (ns) */
+} lane_frame_t;
+
+/* one lane of a client's output, frames waiting for the socket (-P) */
+typedef struct lane_queue_t
+{
+    char *buffer;               /* a lane_frame_t and data for each frame */
+    size_t size;                /* size of the pool buffer */
+    size_t head;                /* offset of the first unsent frame */
+    size_t tail;                /* offset just past the last frame */
+    size_t sent;                /* bytes of the first frame already sent */
+    size_t bytes;               /* frame data queued */
+} lane_queue_t;
+
 typedef struct fd_list_t
 {
     int fd;
+    rx_estimate_t rxEstimate;   /* sizes receives from this connection */
+    flight_rec_t flight;        /* recent events on this connection */
+    tcp_sample_t tcpInfo;       /* most recent TCP_INFO sample */
+    char *partial;              /* line framing: start of an unended line */
+    size_t partialLen;
+    size_t partialSize;         /* size of the pool buffer holding it */
+    coro_t *co;                 /* -C: the coroutine serving it */
+    char *out;                  /* -W: messages waiting to be flushed */
+    size_t outLen;
+    size_t outSize;             /* size of the pool buffer holding them */
+    lane_queue_t lanes[LANE_COUNT]; /* -P: frames waiting for the socket */
+    int writeWait;              /* -P: waiting for the socket to drain */
+    int ws;                     /* -G: WS_RAW, WS_PENDING or WS_OPEN */
+    long long accepted;         /* -G: when it connected (ns) */
+    unsigned long activity;     /* -A: bytes moved, halved every sample */
+    unsigned long long peer;    /* IPv4 address and port, its top-K key */
+    unsigned int filters;       /* filters registered, 0 = every message */
+    unsigned long matched;      /* the last filtered frame it matched */
     struct fd_list_t* next;
 } fd_list_t;
 
+/***************************************************************************
+* Settings that may be changed while the server runs, with the control
+* socket's set command.  The loops read them through the RCU pointer
+* config (see TUNABLES), so a change is published without locks.
+***************************************************************************/
+typedef struct tunables_t
+{
+    long long coalesceWindowUs; /* -W: longest a message is held, 0 = off */
+    long long coalesceMessages; /* -N: flush after this many, 0 = no limit */
+    long long urgentRate;       /* -P: urgent frames/sec, 0 = no limit */
+    long long urgentBurst;      /* urgent frames allowed back to back */
+    long long urgentLimit;      /* urgent bytes queued per client */
+    long long bulkLimit;        /* bulk bytes queued per client */
+    long long notsentLowat;     /* unsent bytes left to the kernel (-P) */
+    long long tcpinfoBatch;     /* connections sampled per loop turn */
+    long long stallUs;          /* loop turns longer than this stall */
+    long long backlog;          /* outstanding connection requests */
+    long long log;              /* per message logging (-q sets 0) */
+    long long migrateMs;        /* -A: time between migrations, 0 = never */
+    long long migrateGap;       /* -A: smallest load gap worth migrating */
+    long long fastOpenQueue;    /* -F: TCP Fast Open requests, 0 = off */
+} tunables_t;
+
+/* broadcast coalescing (-W and -N) */
+typedef struct coalesce_t
+{
+    long long lastFlush;        /* time of the last send to subscribers */
+    long long lastArrival;      /* time of the last broadcast (ns) */
+    long long averageGap;       /* moving average time between them */
+    int timer;                  /* pending flush timer, or -1 */
+
+    /* the batch being collected */
+    unsigned int batched;       /* messages in the batch */
+    long long firstArrival;     /* time of its first message (ns) */
+    long long arrivals;         /* sum of its messages' arrival times */
+    unsigned long copies;       /* messages appended to subscribers */
+
+    /* totals reported on the coalesce: line */
+    unsigned long messages;     /* messages broadcast */
+    unsigned long immediate;    /* sent as they arrived */
+    unsigned long batches;      /* batches flushed */
+    unsigned long sendsSaved;   /* sends avoided by batching */
+    long long delaySum;         /* time batched messages were held (ns) */
+    long long delayMax;
+} coalesce_t;
+
+/* priority lanes (-P), totals for each lane */
+typedef struct lane_stats_t
+{
+    unsigned long frames;       /* frames completely sent */
+    unsigned long queued;       /* frames that waited in a queue */
+    unsigned long dropped;      /* frames dropped at the limit */
+    size_t peakBytes;           /* most bytes queued for any client */
+    unsigned long histogram[LOOPMON_BUCKETS];   /* arrival to sent */
+} lane_stats_t;
+
+typedef struct lanes_t
+{
+    int enabled;
+    long long credit;           /* urgent rate allowance (ns) */
+    long long lastUrgent;       /* time the allowance was last updated */
+    unsigned long demoted;      /* urgent frames over the rate sent as bulk */
+    lane_stats_t stats[LANE_COUNT];
+} lanes_t;
+
+/* WebSocket gateway (-G) totals */
+typedef struct websocket_t
+{
+    unsigned long open;         /* clients with an open WebSocket */
+    unsigned long upgrades;     /* handshakes completed */
+    unsigned long refused;      /* bad handshakes or protocol errors */
+    unsigned long framesIn;     /* data frames received */
+    unsigned long framesOut;    /* data frames sent or queued */
+    unsigned long headers;      /* broadcast frame headers encoded */
+    unsigned long pings;        /* pings answered */
+    unsigned long closes;       /* close handshakes */
+} websocket_t;
+
+/* subscriber content filters */
+typedef struct filtering_t
+{
+    filter_index_t index;       /* every client's filters */
+    unsigned long frame;        /* frames looked up in the index */
+    unsigned long commands;     /* filter commands carried out */
+    unsigned long refused;      /* malformed or over MAX_FILTERS */
+    unsigned long matches;      /* filtered clients sent a frame */
+} filtering_t;
+
+/* TCP Fast Open (-F) totals */
+typedef struct fastopen_t
+{
+    unsigned long accepts;      /* connections accepted while it's on */
+    unsigned long synData;      /* ones that sent their first data in the
+                                   SYN, saving a round trip */
+} fastopen_t;
+
+/* the run time policies from the command line, for every reactor */
+typedef struct policies_t
+{
+    reactor_backend_t backend;
+    int framing;
+    int statsOn;
+    int logOn;
+} policies_t;
+
+/* a pre-forked worker (-w), in memory shared with the master */
+typedef struct worker_t
+{
+    pid_t pid;                  /* 0 when it isn't running */
+    unsigned long starts;       /* times it has been started */
+    unsigned long crashes;      /* retired totals: workers killed by signals */
+    reactor_stats_t stats;      /* its reactor's counters */
+    bufpool_stats_t pool;       /* its buffer pool, copied when it exits */
+    unsigned long clients;      /* -A: its connections */
+    unsigned long load;         /* -A: recent bytes moved plus bytes queued */
+    topk_t top[TOP_COUNT];      /* its sketches, copied every sweep */
+} worker_t;
+
+/* the dedicated acceptor (-A), in the master */
+typedef struct balance_t
+{
+    int enabled;
+    int listenFd;               /* the only listening socket */
+    int handoff[SHMRING_MAX_READERS];   /* the master's end of each worker's
+                                           handoff socket, or -1 */
+    unsigned long pending[SHMRING_MAX_READERS]; /* connections placed since
+                                                   the last load sample */
+    unsigned long perClient;    /* average load of a connection */
+    long long lastShed;         /* when a migration was last asked for */
+    char *buffer;               /* a migrating connection's state */
+
+    /* totals reported on the balance: line */
+    unsigned long placed;       /* new connections given to workers */
+    unsigned long refused;      /* connections no worker could take */
+    unsigned long sheds;        /* migrations asked for */
+    unsigned long migrated;     /* connections moved between workers */
+} balance_t;
+
+/* a message on a handoff socket (-A) */
+typedef struct handoff_msg_t
+{
+    int type;                   /* HANDOFF_NEW, HANDOFF_MOVE or HANDOFF_SHED */
+    unsigned long limit;        /* HANDOFF_SHED: most load to migrate */
+} handoff_msg_t;
+
+/* a migrating connection, after the HANDOFF_MOVE message */
+typedef struct client_state_t
+{
+    int ws;
+    long long accepted;
+    unsigned long activity;
+    rx_estimate_t rxEstimate;
+    flight_rec_t flight;
+    size_t partialLen;          /* the partial line follows */
+    size_t laneLen[LANE_COUNT]; /* then each lane's queue, head to tail */
+    size_t laneSent[LANE_COUNT];
+} client_state_t;
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+static fd_list_t *fdList;           /* every connected client */
+static fd_list_t *fanoutStart;      /* the next broadcast starts here */
+static tcpinfo_dist_t tcpDist;      /* TCP_INFO from the last full sweep */
+static tcpinfo_dist_t sweepDist;    /* TCP_INFO from the sweep in progress */
+static int sweepIndex;              /* next connection in the sweep */
+static topk_t top[TOP_COUNT];       /* the worst connections */
+static int useCoroutines;           /* -C: serve clients with coroutines */
+static coalesce_t coalesce;         /* -W/-N: broadcast coalescing */
+static lanes_t lanes;               /* -P: priority lanes */
+static policies_t policies;         /* -b/-f/-n/-q for every reactor */
+static int useWebSockets;           /* -G: accept WebSocket upgrades */
+static websocket_t websocket;       /* -G: gateway totals */
+static filtering_t filtering;       /* #sub filters and their totals */
+static fastopen_t fastOpen;         /* -F: Fast Open totals */
+static rcu_t *config;               /* current tunables_t */
+
+#define TUNABLES()  ((const tunables_t *)RcuRead(config))
+
+/* does a client want the frame last passed to MatchFilters */
+#define WANTS_FRAME(client) \
+    ((0 == (client)->filters) || ((client)->matched == filtering.frame))
+
+/* add n to a client's count in one of the top-K sketches, for reactor r */
+#define TOP_ADD(r, sketch, client, n) \
+    do \
+    { \
+        if (REACTOR_STATS_ON(r)) \
+        { \
+            TopKAdd(&top[(sketch)], (client)->peer, (n)); \
+        } \
+    } while (0)
+
+/* the tunables and their limits, for the get and set commands */
+#define TUNABLE(name, field, min, max) \
+    {name, offsetof(tunables_t, field), (min), (max)}
+
+static const control_tunable_t tunableTable[] =
+{
+    TUNABLE("coalesce_window_us", coalesceWindowUs, 0, 1000000),
+    TUNABLE("coalesce_msgs", coalesceMessages, 0, 1000000),
+    TUNABLE("urgent_rate", urgentRate, 0, 1000000000),
+    TUNABLE("urgent_burst", urgentBurst, 1, 1000000),
+    TUNABLE("urgent_limit", urgentLimit, 0, 1LL << 30),
+    TUNABLE("bulk_limit", bulkLimit, 0, 1LL << 30),
+    TUNABLE("notsent_lowat", notsentLowat, 1, 1LL << 30),
+    TUNABLE("tcpinfo_batch", tcpinfoBatch, 1, 1000000),
+    TUNABLE("stall_us", stallUs, 0, 60000000),
+    TUNABLE("backlog", backlog, 1, 65535),
+    TUNABLE("log", log, 0, 1),
+    TUNABLE("migrate_ms", migrateMs, 0, 3600000),
+    TUNABLE("migrate_gap", migrateGap, 0, 1LL << 40),
+    TUNABLE("fastopen_queue", fastOpenQueue, 0, 65535),
+    {NULL, 0, 0, 0}
+};
+
+/* pre-forked workers (-w) */
+static unsigned int numWorkers;     /* 0 for a single process */
+static worker_t *workers;           /* worker table shared with the master */
+static worker_t retired;            /* totals from workers that have exited */
+static int workerIndex = -1;        /* this worker's index, -1 in the master */
+static shmring_t *ring;             /* broadcasts between the workers */
+static char *ringBuffer;            /* message read from the ring */
+static const char *listenPort;      /* port each worker listens on */
+static int masterControlFd = -1;    /* the master's control socket */
+static int stopping;                /* the master is stopping the workers */
+static balance_t balance;           /* -A: the master's acceptor */
+static int handoffFd = -1;          /* -A: this worker's handoff socket */
+static int lowLatency = LOWLAT_OFF; /* -L: SCHED_FIFO priority or 0 */
+
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
-int DoEcho(const int clientFd, const fd_list_t *list);
+int DoEcho(fd_list_t *client, fd_list_t *list, reactor_t *reactor);
+int EchoLines(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    const char *data, size_t length, long long now);
+int HoldPartial(fd_list_t *client, const char *data, size_t length);
+void Publish(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    const char *data, size_t length, long long now);
+size_t TakeCommands(fd_list_t *client, const char *data, size_t length);
+void MatchFilters(const char *message, size_t length);
+void PrintFilters(const fd_list_t *list, FILE *stream);
+void Broadcast(fd_list_t *list, reactor_t *reactor, const char *message,
+    size_t length, const fd_list_t *skip, long long now);
+void BroadcastLocal(fd_list_t *list, reactor_t *reactor,
+    const char *message, size_t length, const fd_list_t *skip,
+    long long now);
+void BroadcastFrame(fd_list_t *list, reactor_t *reactor,
+    const char *message, size_t length, const fd_list_t *skip,
+    long long now);
+void SendTo(fd_list_t *client, reactor_t *reactor, const char *message,
+    size_t length, long long now);
+int Coalesce(fd_list_t *list, reactor_t *reactor, const char *message,
+    size_t length, const fd_list_t *skip, long long now);
+int AppendOutput(fd_list_t *client, reactor_t *reactor, const char *message,
+    size_t length, long long now);
+fd_list_t *FanoutFirst(fd_list_t *list);
+fd_list_t *FanoutNext(const fd_list_t *here, fd_list_t *list,
+    const fd_list_t *first);
+int SendOutput(fd_list_t *client, reactor_t *reactor, long long now);
+void FlushOutput(fd_list_t *list, reactor_t *reactor, long long now);
+void PrintCoalesce(FILE *stream);
+size_t LaneFrameLength(const char *message, size_t length);
+int LaneOf(const char *message, size_t length, long long now);
+void QueueTo(fd_list_t *client, reactor_t *reactor, int lane,
+    const char *message, size_t length, long long now);
+void LaneQueue(fd_list_t *client, reactor_t *reactor, int lane,
+    const char *message, size_t length, size_t sent, long long now);
+int LanePush(lane_queue_t *queue, const char *message, size_t length,
+    size_t sent, long long arrival);
+int DrainLanes(fd_list_t *client, reactor_t *reactor, long long now);
+void LaneConsume(lane_queue_t *queue, lane_stats_t *stats, size_t sent,
+    long long now);
+void LaneWatch(fd_list_t *client, reactor_t *reactor);
+void FreeLanes(fd_list_t *client);
+void PrintLanes(FILE *stream);
+int WsReceive(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    char *data, size_t length, long long now);
+int WsFrames(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    char *data, size_t length, size_t *used, long long now);
+void WsSendTo(fd_list_t *client, reactor_t *reactor, int lane,
+    const unsigned char *header, size_t headerLength, const char *message,
+    size_t length, long long now);
+void WsControl(fd_list_t *client, reactor_t *reactor, int opcode,
+    const char *payload, size_t length, long long now);
+void WsClose(fd_list_t *client, reactor_t *reactor, int code, long long now);
+void PrintWebSocket(FILE *stream);
+unsigned long long PeerKey(int fd);
+void PrintTop(FILE *stream);
+int EchoCoroutine(coro_t *co);
+void EchoExit(coro_t *co, int status);
+int SampleTcpInfo(const fd_list_t *list, int index, long long now);
+
+int OpenListener(const char *port, int reusePort);
+int SetFastOpen(int listenFd);
+void CheckFastOpen(void);
+void CountFastOpen(int fd);
+void PrintFastOpen(FILE *stream);
+int Serve(int listenFd, int controlFd);
+int RunMaster(const char *port, int controlFd);
+int StartWorker(unsigned int index, reactor_t *master);
+void ReapWorkers(reactor_t *master);
+void RetireWorker(unsigned int index, int status);
+void PrintWorkers(const reactor_t *master, FILE *stream);
+int JoinRing(reactor_t *reactor);
+void DrainRing(reactor_t *reactor);
+int StartAcceptor(reactor_t *master, const char *port);
+void StopAcceptor(void);
+int PassClient(int fd, const void *message, size_t length, int from);
+int JoinAcceptor(reactor_t *reactor);
+unsigned long ClientLoad(const fd_list_t *client);
+void ShedClient(reactor_t *reactor, unsigned long limit);
+int MigrateClient(fd_list_t *client, reactor_t *reactor);
+void RestoreClient(fd_list_t *client, reactor_t *reactor, const char *state,
+    size_t length);
+void PrintBalance(FILE *stream);
+
+/* reactor callbacks */
+void AcceptReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+fd_list_t *AdoptClient(reactor_t *reactor, int fd);
+void PlaceReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void HandoffReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void AdoptReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void ClientReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void ControlReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void SignalReceived(reactor_t *reactor, int signo, void *data);
+void TunablesChanged(reactor_t *reactor, void *data);
+void SweepTimer(reactor_t *reactor, void *data);
+void FlushTimer(reactor_t *reactor, void *data);
+void RingReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void BalanceTimer(reactor_t *reactor, void *data);
+void LoadTimer(reactor_t *reactor, void *data);
 
-int InsertFd(int fd, fd_list_t **list);
+void HandleControl(const int controlFd, const reactor_t *reactor,
+    const fd_list_t *list);
+void SetTunables(const char *assignments, FILE *reply);
+void DumpFlight(const fd_list_t *list, const int fd, FILE *stream);
+void DumpTcpInfo(const fd_list_t *list, const int fd, FILE *stream);
+
+fd_list_t *InsertFd(int fd, fd_list_t **list);
 int RemoveFd(int fd, fd_list_t **list);
+void FreeFdList(fd_list_t **list);
 void PrintFdList(const fd_list_t *list);
 
 /***************************************************************************
-*                                FUNCTIONS
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : main
+*   Description: This is the main function for this program, it opens a TCP
+*                socket on the port specified in argv[1].  It accepts all
+*                connections and maintains connections to the specified
+*                port.  The event loop is provided by the reactor, which
+*                calls AcceptReady for connection requests and ClientReady
+*                (and through it DoEcho) for readable connections.  The
+*                reactor also delivers ctrl-c and ctrl-\, which exit
+*                cleanly, and SIGUSR1, which dumps every connection's
+*                flight recorder.  Every loop iteration is timed by the
+*                reactor's loop monitor, which reports iterations that
+*                stall.  Once per TCPINFO_INTERVAL_MS a timer sweeps every
+*                connection's TCP_INFO, tcpinfo_batch connections per loop
+*                turn.  The options select the reactor's run time
+*                policies: -b backend, -f framing, -q disables per
+*                message logging and -n disables statistics.  -C serves
+*                clients with EchoCoroutine instead of DoEcho.  -W and -N
+*                coalesce broadcasts (see Coalesce).  -P queues output in
+*                priority lanes (see QueueTo).  -G accepts WebSocket
+*                clients on the same port (see WsReceive).  -F enables TCP
+*                Fast Open on the listener (see SetFastOpen).  -w pre-forks
+*                workers that share the port and their broadcasts (see
+*                RunMaster), and -A has the master place their connections
+*                (see StartAcceptor), otherwise the server is a single
+*                process (see Serve).
+*   Parameters : argc - number of parameters
+*                argv - parameter list (options, then the port number)
+*   Effects    : A socket is open and accepts connections on the specified
+*                port.  Readable connections are passed to DoEcho
+*   Returned   : EXIT_SUCCESS after SIGINT or SIGQUIT, otherwise
+*                EXIT_FAILURE.
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    int result;
+    int listenFd;   /* socket fd used to listen for connection requests */
+
+    /* optional control socket */
+    const char *controlPath;
+    int controlFd;
+    int opt;
+
+    tunables_t tunables =
+    {
+        0, 0, 0, LANE_URGENT_BURST, LANE_URGENT_LIMIT, LANE_BULK_LIMIT,
+        LANE_NOTSENT_LOWAT, TCPINFO_BATCH, STALL_THRESHOLD_US, MAX_BACKLOG, 1,
+        MIGRATE_MS, MIGRATE_GAP, 0
+    };
+
+    controlPath = NULL;
+    policies.backend = REACTOR_EPOLL;
+    policies.framing = REACTOR_FRAME_RAW;
+    policies.statsOn = 1;
+    policies.logOn = 1;
+
+    coalesce.timer = -1;
+
+    while ((opt = getopt(argc, argv, "b:c:f:nqACF:GL:W:N:P:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                if (ReactorParseBackend(optarg, &policies.backend) != 0)
+                {
+                    optind = argc;  /* force the usage message */
+                }
+                break;
+
+            case 'c':
+                controlPath = optarg;
+                break;
+
+            case 'f':
+                if (ReactorParseFraming(optarg, &policies.framing) != 0)
+                {
+                    optind = argc;  /* force the usage message */
+                }
+                break;
+
+            case 'n':
+                policies.statsOn = 0;
+                break;
+
+            case 'q':
+                policies.logOn = 0;
+                tunables.log = 0;
+                break;
+
+            case 'A':
+                balance.enabled = 1;
+                break;
+
+            case 'C':
+                useCoroutines = 1;
+                break;
+
+            case 'F':
+                tunables.fastOpenQueue = atol(optarg);
+                break;
+
+            case 'G':
+                useWebSockets = 1;
+                break;
+
+            case 'L':
+                lowLatency = atoi(optarg);
+
+                if ((lowLatency < 0) ||
+                    (lowLatency > sched_get_priority_max(SCHED_FIFO)))
+                {
+                    fprintf(stderr, "-L priority must be 0 to %d\n",
+                        sched_get_priority_max(SCHED_FIFO));
+                    optind = argc;
+                }
+                break;
+
+            case 'W':
+                tunables.coalesceWindowUs = atol(optarg);
+                break;
+
+            case 'N':
+                tunables.coalesceMessages = atoi(optarg);
+                break;
+
+            case 'P':
+                lanes.enabled = 1;
+                tunables.urgentRate = atol(optarg);
+                break;
+
+            case 'w':
+                numWorkers = atoi(optarg);
+
+                if (numWorkers > SHMRING_MAX_READERS)
+                {
+                    fprintf(stderr, "At most %d workers\n",
+                        SHMRING_MAX_READERS);
+                    optind = argc;
+                }
+                break;
+
+            default:
+                optind = argc;      /* force the usage message */
+                break;
+        }
+    }
+
+    if (lanes.enabled && useCoroutines)
+    {
+        /* the coroutines do their own waiting for writable sockets */
+        fprintf(stderr, "-P can't be used with -C\n");
+        optind = argc;
+    }
+
+    if (useWebSockets && useCoroutines)
+    {
+        /* the coroutines don't speak WebSocket */
+        fprintf(stderr, "-G can't be used with -C\n");
+        optind = argc;
+    }
+
+    if (balance.enabled && ((0 == numWorkers) || useCoroutines))
+    {
+        /* coroutines can't be migrated, and -A places them on workers */
+        fprintf(stderr, "-A needs -w and can't be used with -C\n");
+        optind = argc;
+    }
+
+    /* the port number follows the options, make sure it's passed to us */
+    if (argc != (optind + 1))
+    {
+        fprintf(stderr,
+            "Usage:  %s [-b poll|epoll] [-f raw|line] [-n] [-q] [-C] [-G] "
+            "[-F <fast open queue>] "
+            "[-W <window us>] [-N <messages>] [-P <urgent msgs/sec>] "
+            "[-w <workers> [-A]] [-L <priority>] [-c <control socket path>] "
+            "<port number>\n",
+            argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((tunables.coalesceMessages > 0) && (0 == tunables.coalesceWindowUs))
+    {
+        tunables.coalesceWindowUs = COALESCE_DEFAULT_US;
+    }
+
+    if (tunables.fastOpenQueue > 0)
+    {
+        CheckFastOpen();
+    }
+
+    /* every worker (or the only process) reads the tunables */
+    config = RcuNew(&tunables, sizeof(tunables), (numWorkers > 0) ?
+        numWorkers : 1);
+
+    if (NULL == config)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    controlFd = -1;
+
+    if (NULL != controlPath)
+    {
+        controlFd = ControlOpen(controlPath);
+
+        if (controlFd < 0)
+        {
+            RcuFree(config);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (numWorkers > 0)
+    {
+        result = RunMaster(argv[optind], controlFd);
+    }
+    else
+    {
+        listenFd = OpenListener(argv[optind], 0);
+        result = (listenFd < 0) ? EXIT_FAILURE : Serve(listenFd, controlFd);
+    }
+
+    ControlClose(controlFd, controlPath);
+    RcuFree(config);
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : OpenListener
+*   Description: This routine opens a TCP socket that listens for
+*                connections to a port on any local address, with TCP
+*                Fast Open if fastopen_queue is set.
+*   Parameters : port - the port number (a string).
+*                reusePort - non-zero to set SO_REUSEPORT, so each worker
+*                process may have its own listener on the port and the
+*                kernel spreads connections across them.
+*   Effects    : A listening socket is opened.
+*   Returned   : The socket, or -1 on failure.
+***************************************************************************/
+int OpenListener(const char *port, int reusePort)
+{
+    int result;
+    int listenFd;   /* socket fd used to listen for connection requests */
+
+    /* structures for server and client internet addresses */
+    struct sockaddr_in serverAddr;
+
+    /* create server socket descriptor */
+    listenFd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (listenFd < 0)
+    {
+        perror("Error creating socket");
+        return -1;
+    }
+
+    if (reusePort &&
+        (setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &reusePort,
+            sizeof(reusePort)) < 0))
+    {
+        perror("Error setting SO_REUSEPORT");
+        close(listenFd);
+        return -1;
+    }
+
+    memset(&serverAddr, 0, sizeof(serverAddr));     /* clear data structure */
+
+    /* allow internet connection from any address on the port */
+    serverAddr.sin_family = AF_INET;                /* internet address family */
+    serverAddr.sin_addr.s_addr = htonl(INADDR_ANY); /* any incoming address */
+    serverAddr.sin_port = htons(atoi(port));        /* port number */
+
+    /* bind to the local address */
+    result = bind(listenFd, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
+
+    if (result < 0)
+    {
+        /* bind failed */
+        perror("Error binding socket");
+        close(listenFd);
+        return -1;
+    }
+
+    if ((TUNABLES()->fastOpenQueue > 0) && (SetFastOpen(listenFd) < 0))
+    {
+        /* clients still connect, with the full handshake */
+        perror("Error setting TCP_FASTOPEN");
+    }
+
+    /* listen for incoming connections */
+    result = listen(listenFd, TUNABLES()->backlog);
+
+    if (result < 0)
+    {
+        /* listen failed */
+        perror("Error listening for connections");
+        close(listenFd);
+        return -1;
+    }
+
+    return listenFd;
+}
+
+
+/***************************************************************************
+*   Function   : SetFastOpen
+*   Description: This routine sets the TCP Fast Open queue of a listening
+*                socket to fastopen_queue.  A client holding a Fast Open
+*                cookie from this server may send its first data in the
+*                SYN, and the connection is accepted with the data ready
+*                to read, saving the handshake's round trip.  The queue
+*                limits connections whose SYN data was taken but haven't
+*                completed the handshake; past it clients fall back to the
+*                full handshake.  0 turns Fast Open off.
+*   Parameters : listenFd - the listening socket.
+*   Effects    : The socket's Fast Open queue is set.
+*   Returned   : 0 for success, -1 (with errno set) for failure.
+***************************************************************************/
+int SetFastOpen(int listenFd)
+{
+    int queue;
+
+    queue = (int)TUNABLES()->fastOpenQueue;
+    return setsockopt(listenFd, IPPROTO_TCP, TCP_FASTOPEN, &queue,
+        sizeof(queue));
+}
+
+
+/***************************************************************************
+*   Function   : CheckFastOpen
+*   Description: This routine warns if the kernel won't take Fast Open
+*                connections.  Listeners only use their Fast Open queue
+*                when the net.ipv4.tcp_fastopen sysctl has its server bit
+*                (2) set, and the default (1) only enables clients.
+*   Parameters : None
+*   Effects    : A warning may be written to stderr.
+*   Returned   : None
+***************************************************************************/
+void CheckFastOpen(void)
+{
+    FILE *sysctl;
+    int mode;
+
+    sysctl = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+
+    if (NULL == sysctl)
+    {
+        return;
+    }
+
+    if ((fscanf(sysctl, "%d", &mode) == 1) && (0 == (mode & 2)))
+    {
+        fprintf(stderr, "net.ipv4.tcp_fastopen is %d, set it to %d for Fast "
+            "Open connections to this server\n", mode, mode | 2);
+    }
+
+    fclose(sysctl);
+}
+
+
+/***************************************************************************
+*   Function   : CountFastOpen
+*   Description: This routine counts an accepted connection while Fast
+*                Open is on, and whether its first data came in the SYN
+*                (its TCP_INFO has TCPI_OPT_SYN_DATA).  It costs one
+*                getsockopt per connection, and nothing when Fast Open is
+*                off.
+*   Parameters : fd - the accepted connection.
+*   Effects    : The Fast Open totals are updated.
+*   Returned   : None
+***************************************************************************/
+void CountFastOpen(int fd)
+{
+    struct tcp_info info;
+    socklen_t length;
+
+    if (0 == TUNABLES()->fastOpenQueue)
+    {
+        return;
+    }
+
+    fastOpen.accepts++;
+    length = sizeof(info);
+
+    if ((getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) == 0) &&
+        (info.tcpi_options & TCPI_OPT_SYN_DATA))
+    {
+        fastOpen.synData++;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : PrintFastOpen
+*   Description: This routine writes the TCP Fast Open totals of the
+*                connections this process accepted.
+*   Parameters : stream - where to write them.
+*   Effects    : A "fastopen:" line is written if Fast Open is on or has
+*                been.
+*   Returned   : None
+***************************************************************************/
+void PrintFastOpen(FILE *stream)
+{
+    if ((0 == TUNABLES()->fastOpenQueue) && (0 == fastOpen.accepts))
+    {
+        return;
+    }
+
+    fprintf(stream, "fastopen: queue=%lld accepts=%lu syn_data=%lu\n",
+        TUNABLES()->fastOpenQueue, fastOpen.accepts, fastOpen.synData);
+}
+
+
+/***************************************************************************
+*   Function   : Serve
+*   Description: This routine runs the server's event loop on a listening
+*                socket until SIGINT or SIGQUIT, then cleans up and writes
+*                its statistics.  It's the whole server in a single
+*                process, and each worker with -w, where broadcasts are
+*                also read from the shared ring (see JoinRing) and the
+*                master reports the totals.  With -A a worker has no
+*                listening socket, the master hands it connections instead
+*                (see JoinAcceptor).  With -L the process prefills the
+*                buffer pool and enters low latency mode (see LowLatStart)
+*                once it's set up, and doesn't serve at all if it didn't
+*                get everything it asked for.
+*   Parameters : listenFd - the listening socket, or -1 with -A.
+*                controlFd - the control socket or -1.
+*   Effects    : Connections are served.  listenFd is closed.
+*   Returned   : EXIT_SUCCESS after SIGINT or SIGQUIT, otherwise
+*                EXIT_FAILURE.
+***************************************************************************/
+int Serve(int listenFd, int controlFd)
+{
+    int result;
+    reactor_t reactor;
+    fd_list_t *thisFd;
+
+    fdList = NULL;
+
+    /* register everything we need to service with the reactor */
+    if ((ReactorInit(&reactor, policies.backend, TUNABLES()->stallUs) != 0) ||
+        ((listenFd >= 0) &&
+        (ReactorAdd(&reactor, listenFd, REACTOR_READ, AcceptReady,
+            NULL) != 0)) ||
+        ((controlFd >= 0) &&
+        (ReactorAdd(&reactor, controlFd, REACTOR_READ, ControlReady,
+            NULL) != 0)) ||
+        (ReactorSignal(&reactor, SIGINT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGQUIT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGUSR1, SignalReceived, NULL) != 0) ||
+        (ReactorTimer(&reactor, TCPINFO_INTERVAL_MS, SweepTimer, NULL) < 0) ||
+        ((NULL != ring) && (JoinRing(&reactor) != 0)) ||
+        ((handoffFd >= 0) && (JoinAcceptor(&reactor) != 0)))
+    {
+        ReactorFree(&reactor);
+
+        if (listenFd >= 0)
+        {
+            close(listenFd);
+        }
+
+        return EXIT_FAILURE;
+    }
+
+    reactor.framing = policies.framing;
+    reactor.statsOn = policies.statsOn;
+    reactor.logOn = policies.logOn;
+    sweepIndex = 0;
+
+    /* this loop is a reader of the tunables */
+    ReactorRcu(&reactor, config, (workerIndex < 0) ? 0 : workerIndex,
+        TunablesChanged, &listenFd);
+    TunablesChanged(&reactor, &listenFd);
+
+    if ((LOWLAT_OFF != lowLatency) &&
+        ((0 == BufPoolPrefill(RING_BUFFER_SIZE)) ||
+        (LowLatStart(LowLatCpu((workerIndex < 0) ? 0 : workerIndex),
+            lowLatency, stderr) != 0)))
+    {
+        /* don't run with less than was asked for */
+        result = EXIT_FAILURE;
+    }
+    else
+    {
+        /* service all sockets until SIGINT or SIGQUIT */
+        result = ReactorRun(&reactor);
+    }
+
+    /* the filters go with the clients, report them first */
+    PrintFilters(fdList, stderr);
+
+    /* clean up everything so leaks checkers have nothing to report */
+    for (thisFd = fdList; thisFd != NULL; thisFd = thisFd->next)
+    {
+        close(thisFd->fd);
+    }
+
+    FreeFdList(&fdList);
+    ReactorFree(&reactor);
+
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+    }
+
+    if (handoffFd >= 0)
+    {
+        close(handoffFd);
+    }
+
+    if (workerIndex < 0)
+    {
+        ReactorPrintPolicies(&reactor, stderr);
+        ReactorPrintStats(&reactor, stderr);
+        ReactorPrintCpu(stderr);
+    }
+    else
+    {
+        /* the master reports the totals */
+        fprintf(stderr, "worker: index=%d pid=%d\n", workerIndex,
+            (int)getpid());
+        BufPoolPut(ringBuffer, RING_BUFFER_SIZE);
+    }
+
+    if (REACTOR_STATS_ON(&reactor))
+    {
+        LoopMonPrint(&(reactor.monitor), stderr);
+    }
+
+    TcpInfoPrintDist(&tcpDist, stderr);
+    PrintCoalesce(stderr);
+    PrintLanes(stderr);
+    PrintWebSocket(stderr);
+    PrintFastOpen(stderr);
+    PrintTop(stderr);
+
+    if (useCoroutines)
+    {
+        CoroPoolPrint(stderr);
+    }
+
+    CoroPoolRelease();
+
+    if (workerIndex >= 0)
+    {
+        BufPoolGetStats(&(workers[workerIndex].pool));
+        memcpy(workers[workerIndex].top, top, sizeof(top));
+    }
+
+    BufPoolRelease();
+    return ((0 == result) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/***************************************************************************
+*   Function   : RunMaster
+*   Description: This routine is the master process of the pre-forked
+*                server (-w).  It maps the worker table and the broadcast
+*                ring in shared memory and forks the workers, each of
+*                which serves its own SO_REUSEPORT listener, or with -A
+*                the connections the master accepts and places (see
+*                StartAcceptor).  Otherwise the master only handles
+*                signals and the control socket: a worker that's killed
+*                by a signal is replaced, SIGUSR1 is passed on to the
+*                workers, and SIGINT or SIGQUIT stops them all.  The
+*                master then adds up the workers' counters.
+*   Parameters : port - the port number (a string).
+*                controlFd - the control socket or -1.
+*   Effects    : Workers are started, supervised and stopped.
+*   Returned   : EXIT_SUCCESS after SIGINT or SIGQUIT, otherwise
+*                EXIT_FAILURE.
+***************************************************************************/
+int RunMaster(const char *port, int controlFd)
+{
+    reactor_t reactor;
+    unsigned int i;
+    int result, status;
+
+    balance.listenFd = -1;
+
+    for (i = 0; i < SHMRING_MAX_READERS; i++)
+    {
+        balance.handoff[i] = -1;
+    }
+
+    workers = (worker_t *)mmap(NULL, numWorkers * sizeof(worker_t),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (MAP_FAILED == workers)
+    {
+        perror("Error mapping worker table");
+        return EXIT_FAILURE;
+    }
+
+    ring = ShmRingNew(numWorkers);
+    listenPort = port;
+    masterControlFd = controlFd;
+
+    if ((NULL == ring) ||
+        (ReactorInit(&reactor, policies.backend, 0) != 0) ||
+        ((controlFd >= 0) &&
+        (ReactorAdd(&reactor, controlFd, REACTOR_READ, ControlReady,
+            NULL) != 0)) ||
+        (ReactorSignal(&reactor, SIGINT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGQUIT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGUSR1, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGCHLD, SignalReceived, NULL) != 0) ||
+        (balance.enabled && (StartAcceptor(&reactor, port) != 0)))
+    {
+        ReactorFree(&reactor);
+        StopAcceptor();
+        ShmRingFree(ring);
+        munmap(workers, numWorkers * sizeof(worker_t));
+        return EXIT_FAILURE;
+    }
+
+    reactor.framing = policies.framing;
+    reactor.statsOn = policies.statsOn;
+    reactor.logOn = policies.logOn;
+    result = 0;
+
+    for (i = 0; (i < numWorkers) && (0 == result); i++)
+    {
+        result = StartWorker(i, &reactor);
+    }
+
+    if (0 == result)
+    {
+        result = ReactorRun(&reactor);
+    }
+
+    /* stop every worker and wait for them */
+    stopping = 1;
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if (workers[i].pid > 0)
+        {
+            kill(workers[i].pid, SIGINT);
+        }
+    }
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if ((workers[i].pid > 0) && (waitpid(workers[i].pid, &status, 0) > 0))
+        {
+            RetireWorker(i, status);
+        }
+    }
+
+    ReactorFree(&reactor);
+    StopAcceptor();
+    ReactorPrintPolicies(&reactor, stderr);
+    PrintWorkers(&reactor, stderr);
+    ReactorPrintCpu(stderr);
+
+    ShmRingFree(ring);
+    munmap(workers, numWorkers * sizeof(worker_t));
+    return ((0 == result) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/***************************************************************************
+*   Function   : StartWorker
+*   Description: This routine forks a worker process.  The worker leaves
+*                the master's process group, so a ctrl-c reaches it only
+*                through the master, gives up the master's reactor and
+*                control socket, and serves its own SO_REUSEPORT
+*                listener until it's told to stop.  With -A the worker
+*                gets one end of a new handoff socket pair instead of a
+*                listener, and the master watches the other end for
+*                connections it migrates (see HandoffReady).
+*   Parameters : index - the worker's index in the worker table.
+*                master - the master's reactor.
+*   Effects    : A worker process is started.  The worker never returns.
+*   Returned   : 0 for success, -1 if the fork failed.
+***************************************************************************/
+int StartWorker(unsigned int index, reactor_t *master)
+{
+    pid_t pid;
+    int listenFd;
+    int pair[2];
+    unsigned int i;
+
+    if (balance.enabled)
+    {
+        if (balance.handoff[index] >= 0)
+        {
+            /* left over from the worker this one replaces */
+            ReactorRemove(master, balance.handoff[index]);
+            close(balance.handoff[index]);
+            balance.handoff[index] = -1;
+        }
+
+        if (HandoffPair(pair) != 0)
+        {
+            return -1;
+        }
+    }
+
+    fflush(NULL);       /* don't let the worker repeat buffered output */
+    pid = fork();
+
+    if (pid < 0)
+    {
+        perror("Error forking worker");
+
+        if (balance.enabled)
+        {
+            close(pair[0]);
+            close(pair[1]);
+        }
+
+        return -1;
+    }
+
+    if (pid > 0)
+    {
+        workers[index].pid = pid;
+        workers[index].starts++;
+
+        if (balance.enabled)
+        {
+            close(pair[1]);
+            balance.handoff[index] = pair[0];
+
+            if (ReactorAdd(master, pair[0], REACTOR_READ, HandoffReady,
+                &workers[index]) != 0)
+            {
+                /* it won't be given connections */
+                close(pair[0]);
+                balance.handoff[index] = -1;
+            }
+        }
+
+        return 0;
+    }
+
+    /* this is the worker */
+    setpgid(0, 0);
+    ReactorFree(master);
+
+    if (masterControlFd >= 0)
+    {
+        close(masterControlFd);
+    }
+
+    workerIndex = index;
+
+    if (!balance.enabled)
+    {
+        listenFd = OpenListener(listenPort, 1);
+        exit((listenFd < 0) ? EXIT_FAILURE : Serve(listenFd, -1));
+    }
+
+    /* only the master accepts, and only it talks to the other workers */
+    close(balance.listenFd);
+    close(pair[0]);
+    free(balance.buffer);
+    balance.listenFd = -1;
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if (balance.handoff[i] >= 0)
+        {
+            close(balance.handoff[i]);
+        }
+    }
+
+    handoffFd = pair[1];
+    exit(Serve(-1, -1));
+}
+
+
+/***************************************************************************
+*   Function   : ReapWorkers
+*   Description: This routine collects workers that have exited.  Unless
+*                the server is stopping, a worker killed by a signal is
+*                replaced.  One that exited on its own (for example it
+*                couldn't open its listener) isn't, so a problem that
+*                would kill every replacement doesn't become a fork loop.
+*   Parameters : master - the master's reactor.
+*   Effects    : Exited workers are collected and may be restarted.
+*   Returned   : None
+***************************************************************************/
+void ReapWorkers(reactor_t *master)
+{
+    unsigned int i;
+    pid_t pid;
+    int status;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (i = 0; i < numWorkers; i++)
+        {
+            if (workers[i].pid == pid)
+            {
+                break;
+            }
+        }
+
+        if (i == numWorkers)
+        {
+            continue;       /* not one of ours */
+        }
+
+        RetireWorker(i, status);
+
+        if (stopping)
+        {
+            continue;
+        }
+
+        if (WIFSIGNALED(status))
+        {
+            fprintf(stderr, "Worker %u (pid %d) killed by signal %d, "
+                "restarting it\n", i, (int)pid, WTERMSIG(status));
+            StartWorker(i, master);
+        }
+        else
+        {
+            fprintf(stderr, "Worker %u (pid %d) exited with status %d\n", i,
+                (int)pid, WEXITSTATUS(status));
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : RetireWorker
+*   Description: This routine adds the counters of a worker that has
+*                exited to the totals of retired workers, so they aren't
+*                lost when it's replaced.
+*   Parameters : index - the worker's index in the worker table.
+*                status - its status from waitpid.
+*   Effects    : The worker's entry is cleared for a replacement.
+*   Returned   : None
+***************************************************************************/
+void RetireWorker(unsigned int index, int status)
+{
+    worker_t *worker;
+    unsigned int i;
+
+    worker = &workers[index];
+    retired.stats.recvCalls += worker->stats.recvCalls;
+    retired.stats.ioctlCalls += worker->stats.ioctlCalls;
+    retired.stats.sendCalls += worker->stats.sendCalls;
+    retired.stats.bytesIn += worker->stats.bytesIn;
+    retired.stats.bytesOut += worker->stats.bytesOut;
+    retired.pool.gets += worker->pool.gets;
+    retired.pool.misses += worker->pool.misses;
+    retired.pool.peakInUse += worker->pool.peakInUse;
+    retired.crashes += WIFSIGNALED(status) ? 1 : 0;
+
+    for (i = 0; i < TOP_COUNT; i++)
+    {
+        TopKMerge(&(retired.top[i]), &(worker->top[i]));
+    }
+
+    /* it holds no tunables now, don't hold up their updates */
+    RcuOffline(config, index);
+
+    memset(&(worker->stats), 0, sizeof(reactor_stats_t));
+    memset(&(worker->pool), 0, sizeof(bufpool_stats_t));
+    memset(worker->top, 0, sizeof(worker->top));
+    worker->clients = 0;
+    worker->load = 0;
+    worker->pid = 0;
+}
+
+
+/***************************************************************************
+*   Function   : PrintWorkers
+*   Description: This routine writes the pre-forked server's totals: a
+*                statistics line adding up the counters of every worker,
+*                running or retired (the pool's peak is the sum of each
+*                worker's peak), and a "prefork:" line with the workers
+*                and the traffic through the shared ring, followed by the
+*                acceptor's "balance:" line with -A and the merged top-K
+*                sketches (see PrintTop).
+*   Parameters : master - the master's reactor (for its policies).
+*                stream - where to write the totals.
+*   Effects    : The totals are written to stream.
+*   Returned   : None
+***************************************************************************/
+void PrintWorkers(const reactor_t *master, FILE *stream)
+{
+    worker_t total;
+    unsigned long starts, received, overruns, wakeups;
+    unsigned int i, running;
+
+    (void)master;       /* only its policies are used, which may be fixed */
+    total = retired;
+    starts = running = 0;
+    received = overruns = wakeups = 0;
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        total.stats.recvCalls += workers[i].stats.recvCalls;
+        total.stats.ioctlCalls += workers[i].stats.ioctlCalls;
+        total.stats.sendCalls += workers[i].stats.sendCalls;
+        total.stats.bytesIn += workers[i].stats.bytesIn;
+        total.stats.bytesOut += workers[i].stats.bytesOut;
+        starts += workers[i].starts;
+        running += (workers[i].pid > 0) ? 1 : 0;
+        received += ring->readers[i].received;
+        overruns += ring->readers[i].overruns;
+        wakeups += atomic_load(&ring->readers[i].wake.wakeups);
+    }
+
+    if (REACTOR_STATS_ON(master))
+    {
+        ReactorPrintTotals(&(total.stats), &(total.pool), stream);
+    }
+
+    fprintf(stream, "prefork: workers=%u running=%u restarts=%lu "
+        "crashes=%lu ring_published=%lu ring_received=%lu "
+        "ring_overruns=%lu ring_wakeups=%lu ring_too_long=%lu\n",
+        numWorkers, running, starts - numWorkers, retired.crashes,
+        atomic_load(&ring->published), received, overruns, wakeups,
+        atomic_load(&ring->tooLong));
+    PrintBalance(stream);
+
+    if (balance.enabled)
+    {
+        /* with -A the master accepts every connection */
+        PrintFastOpen(stream);
+    }
+
+    PrintTop(stream);
+}
+
+
+/***************************************************************************
+*   Function   : JoinRing
+*   Description: This routine connects a worker to the shared broadcast
+*                ring.  Its counters are moved to the worker table, where
+*                the master reads them, and the ring's eventfd for it is
+*                registered with its reactor.
+*   Parameters : reactor - the worker's reactor.
+*   Effects    : The worker starts reading the ring from its current end.
+*   Returned   : 0 for success, otherwise -1.
+***************************************************************************/
+int JoinRing(reactor_t *reactor)
+{
+    ReactorShareStats(reactor, &(workers[workerIndex].stats));
+    ShmRingAttach(ring, workerIndex);
+    ringBuffer = (char *)BufPoolGet(RING_BUFFER_SIZE);
+
+    if (NULL == ringBuffer)
+    {
+        perror("Error allocating ring buffer");
+        return -1;
+    }
+
+    if (ReactorAdd(reactor, ring->readers[workerIndex].wake.eventFd,
+        REACTOR_READ, RingReady, NULL) != 0)
+    {
+        return -1;
+    }
+
+    DrainRing(reactor);
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : DrainRing
+*   Description: This routine sends every message other workers have
+*                published to this worker's clients, then parks on the
+*                ring's eventfd.  The ring is checked again after parking
+*                so a message published before the publisher saw the park
+*                isn't left waiting.
+*   Parameters : reactor - the worker's reactor.
+*   Effects    : Messages from the ring are sent to this worker's clients.
+*   Returned   : None
+***************************************************************************/
+void DrainRing(reactor_t *reactor)
+{
+    ringq_wake_t *wake;
+    size_t length;
+
+    wake = &(ring->readers[workerIndex].wake);
+
+    for (;;)
+    {
+        while ((length = ShmRingRead(ring, workerIndex, ringBuffer,
+            RING_BUFFER_SIZE)) > 0)
+        {
+            BroadcastLocal(fdList, reactor, ringBuffer, length, NULL,
+                LoopMonNow());
+        }
+
+        RingqPark(wake);
+
+        if (!ShmRingPending(ring, workerIndex))
+        {
+            break;
+        }
+
+        RingqUnpark(wake);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : StartAcceptor
+*   Description: This routine makes the master the only process that
+*                accepts connections (-A).  Each connection is handed to
+*                the worker with the least load, where load is the bytes
+*                its connections recently moved plus the bytes waiting in
+*                their queues, not how many connections it has (see
+*                PassClient).  A timer samples the load and asks a worker
+*                that's much busier than another to migrate a connection
+*                (see BalanceTimer).
+*   Parameters : master - the master's reactor.
+*                port - the port number (a string).
+*   Effects    : The master listens on the port.
+*   Returned   : 0 for success, otherwise -1.
+***************************************************************************/
+int StartAcceptor(reactor_t *master, const char *port)
+{
+    balance.buffer = (char *)malloc(HANDOFF_MAX);
+
+    if (NULL == balance.buffer)
+    {
+        perror("Error allocating handoff buffer");
+        return -1;
+    }
+
+    balance.listenFd = OpenListener(port, 0);
+
+    if ((balance.listenFd < 0) ||
+        (ReactorAdd(master, balance.listenFd, REACTOR_READ, PlaceReady,
+            NULL) != 0) ||
+        (ReactorTimer(master, BALANCE_INTERVAL_MS, BalanceTimer, NULL) < 0))
+    {
+        return -1;
+    }
+
+    balance.lastShed = LoopMonNow();
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : StopAcceptor
+*   Description: This routine closes the master's listening socket and its
+*                ends of the handoff sockets.  Connections still waiting
+*                in a handoff socket are closed with it.
+*   Parameters : None
+*   Effects    : The acceptor's sockets and buffer are released.
+*   Returned   : None
+***************************************************************************/
+void StopAcceptor(void)
+{
+    unsigned int i;
+
+    if (balance.listenFd >= 0)
+    {
+        close(balance.listenFd);
+        balance.listenFd = -1;
+    }
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if (balance.handoff[i] >= 0)
+        {
+            close(balance.handoff[i]);
+            balance.handoff[i] = -1;
+        }
+    }
+
+    free(balance.buffer);
+    balance.buffer = NULL;
+}
+
+
+/***************************************************************************
+*   Function   : PassClient
+*   Description: This routine hands a connection to the least loaded
+*                worker.  Connections placed since the last load sample
+*                are counted as average ones, so a burst of them is
+*                spread out instead of all going to the same worker, and
+*                when loads are equal (an idle server) the worker with
+*                fewer connections gets it.  A worker that isn't taking
+*                connections is passed over for the next least loaded.
+*   Parameters : fd - the connection.
+*                message - the handoff_msg_t, and state for HANDOFF_MOVE.
+*                length - the length of the message.
+*                from - a worker that isn't considered, or -1.
+*   Effects    : The connection is sent to a worker, the caller still has
+*                to close its copy.
+*   Returned   : The worker's index, or -1 if no worker took it.
+***************************************************************************/
+int PassClient(int fd, const void *message, size_t length, int from)
+{
+    unsigned long long tried;
+    unsigned long load, bestLoad, clients, bestClients;
+    int i, best;
+
+    tried = 0;
+
+    for (;;)
+    {
+        best = -1;
+        bestLoad = bestClients = 0;
+
+        for (i = 0; i < (int)numWorkers; i++)
+        {
+            if ((i == from) || (balance.handoff[i] < 0) ||
+                (tried & (1ULL << i)))
+            {
+                continue;
+            }
+
+            load = workers[i].load + (balance.pending[i] * balance.perClient);
+            clients = workers[i].clients + balance.pending[i];
+
+            if ((best < 0) || (load < bestLoad) ||
+                ((load == bestLoad) && (clients < bestClients)))
+            {
+                best = i;
+                bestLoad = load;
+                bestClients = clients;
+            }
+        }
+
+        if (best < 0)
+        {
+            return -1;
+        }
+
+        if (HandoffSend(balance.handoff[best], fd, message, length) == 0)
+        {
+            balance.pending[best]++;
+            return best;
+        }
+
+        tried |= 1ULL << best;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : PrintBalance
+*   Description: This routine writes the acceptor's totals and each
+*                worker's latest connection count and load.
+*   Parameters : stream - where to write them.
+*   Effects    : A "balance:" line is written with -A.
+*   Returned   : None
+***************************************************************************/
+void PrintBalance(FILE *stream)
+{
+    unsigned int i;
+
+    if (!balance.enabled)
+    {
+        return;
+    }
+
+    fprintf(stream, "balance: placed=%lu refused=%lu sheds=%lu "
+        "migrated=%lu worker_clients=", balance.placed, balance.refused,
+        balance.sheds, balance.migrated);
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        fprintf(stream, "%s%lu", (0 == i) ? "" : ",", workers[i].clients);
+    }
+
+    fprintf(stream, " worker_load=");
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        fprintf(stream, "%s%lu", (0 == i) ? "" : ",", workers[i].load);
+    }
+
+    fprintf(stream, "\n");
+}
+
+
+/***************************************************************************
+*   Function   : JoinAcceptor
+*   Description: This routine connects a worker to the master's acceptor
+*                (-A).  Connections arrive on its handoff socket, and a
+*                timer publishes its load to the worker table.
+*   Parameters : reactor - the worker's reactor.
+*   Effects    : The worker starts taking connections from the master.
+*   Returned   : 0 for success, otherwise -1.
+***************************************************************************/
+int JoinAcceptor(reactor_t *reactor)
+{
+    if ((ReactorAdd(reactor, handoffFd, REACTOR_READ, AdoptReady,
+        NULL) != 0) ||
+        (ReactorTimer(reactor, BALANCE_INTERVAL_MS, LoadTimer, NULL) < 0))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ClientLoad
+*   Description: This routine measures how busy a connection is: the bytes
+*                it recently moved in either direction and the bytes
+*                waiting to be sent to it.
+*   Parameters : client - the client's list node.
+*   Effects    : None
+*   Returned   : The connection's load in bytes.
+***************************************************************************/
+unsigned long ClientLoad(const fd_list_t *client)
+{
+    return client->activity + client->lanes[LANE_URGENT].bytes +
+        client->lanes[LANE_BULK].bytes + client->outLen;
+}
+
+
+/***************************************************************************
+*   Function   : ShedClient
+*   Description: This routine carries out the master's request to migrate
+*                a connection away.  The busiest connection with no more
+*                than limit load is chosen, so moving it narrows the gap
+*                between this worker and the least loaded one without
+*                reversing it.  Connections that haven't been identified
+*                as plain or WebSocket yet, ones with filters (which are
+*                in this worker's index) and ones with more state than
+*                fits a handoff message, stay.
+*   Parameters : reactor - the worker's reactor.
+*                limit - the most load to migrate.
+*   Effects    : A connection may be migrated (see MigrateClient).
+*   Returned   : None
+***************************************************************************/
+void ShedClient(reactor_t *reactor, unsigned long limit)
+{
+    fd_list_t *here, *best;
+    unsigned long load, bestLoad;
+    size_t size;
+
+    best = NULL;
+    bestLoad = 0;
+
+    for (here = fdList; here != NULL; here = here->next)
+    {
+        size = sizeof(handoff_msg_t) + sizeof(client_state_t) +
+            here->partialLen + here->outLen +
+            (here->lanes[LANE_URGENT].tail - here->lanes[LANE_URGENT].head) +
+            (here->lanes[LANE_BULK].tail - here->lanes[LANE_BULK].head);
+        load = ClientLoad(here);
+
+        if ((WS_PENDING == here->ws) || (here->filters > 0) ||
+            (size > HANDOFF_MAX) || (load > limit) || (load <= bestLoad))
+        {
+            continue;
+        }
+
+        best = here;
+        bestLoad = load;
+    }
+
+    if (NULL != best)
+    {
+        MigrateClient(best, reactor);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : MigrateClient
+*   Description: This routine sends a connection, with its buffered state,
+*                to the master, which passes it to the least loaded of the
+*                other workers.  A coalescing batch is flushed first; the
+*                partial line and the lane queues, including a partly sent
+*                frame, travel with it (see RestoreClient).  Data the
+*                kernel holds for the socket moves with the socket.
+*   Parameters : client - the client's list node.
+*                reactor - the worker's reactor.
+*   Effects    : The connection is removed from this worker.
+*   Returned   : 0 for success, -1 if it couldn't be sent and stays.
+***************************************************************************/
+int MigrateClient(fd_list_t *client, reactor_t *reactor)
+{
+    handoff_msg_t msg;
+    client_state_t state;
+    char *buffer;
+    size_t length;
+    int lane, fd;
+
+    SendOutput(client, reactor, LoopMonNow());
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = HANDOFF_MOVE;
+    memset(&state, 0, sizeof(state));
+    state.ws = client->ws;
+    state.accepted = client->accepted;
+    state.activity = client->activity;
+    state.rxEstimate = client->rxEstimate;
+    state.flight = client->flight;
+    state.partialLen = client->partialLen;
+    length = sizeof(msg) + sizeof(state) + client->partialLen;
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        state.laneLen[lane] = client->lanes[lane].tail -
+            client->lanes[lane].head;
+        state.laneSent[lane] = client->lanes[lane].sent;
+        length += state.laneLen[lane];
+    }
+
+    if (length > HANDOFF_MAX)
+    {
+        return -1;      /* the flushed batch made it too big */
+    }
+
+    buffer = (char *)BufPoolGet(HANDOFF_MAX);
+
+    if (NULL == buffer)
+    {
+        perror("Error allocating handoff buffer");
+        return -1;
+    }
+
+    memcpy(buffer, &msg, sizeof(msg));
+    memcpy(buffer + sizeof(msg), &state, sizeof(state));
+    length = sizeof(msg) + sizeof(state);
+    memcpy(buffer + length, client->partial, client->partialLen);
+    length += client->partialLen;
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        memcpy(buffer + length,
+            client->lanes[lane].buffer + client->lanes[lane].head,
+            state.laneLen[lane]);
+        length += state.laneLen[lane];
+    }
+
+    if (HandoffSend(handoffFd, client->fd, buffer, length) != 0)
+    {
+        perror("Error migrating connection");
+        BufPoolPut(buffer, HANDOFF_MAX);
+        return -1;
+    }
+
+    BufPoolPut(buffer, HANDOFF_MAX);
+
+    if (REACTOR_LOG_ON(reactor))
+    {
+        printf("Socket %d migrated.\n", client->fd);
+    }
+
+    fd = client->fd;
+    ReactorRemove(reactor, fd);
+    close(fd);
+    RemoveFd(fd, &fdList);
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : RestoreClient
+*   Description: This routine gives a migrated connection the state it had
+*                on the worker it came from.  Its queued frames are pushed
+*                back onto its lanes in order, and if any are waiting the
+*                reactor is asked to report the socket writable.
+*   Parameters : client - the client's new list node.
+*                reactor - the worker's reactor.
+*                state - the client_state_t and the data that follows it.
+*                length - the length of state.
+*   Effects    : The client's state is restored.  State that doesn't add
+*                up is ignored and the connection starts fresh.
+*   Returned   : None
+***************************************************************************/
+void RestoreClient(fd_list_t *client, reactor_t *reactor, const char *state,
+    size_t length)
+{
+    client_state_t saved;
+    lane_frame_t frame;
+    size_t offset, end, sent;
+    int lane;
+
+    if (length < sizeof(saved))
+    {
+        return;
+    }
+
+    memcpy(&saved, state, sizeof(saved));
+
+    if (length != (sizeof(saved) + saved.partialLen +
+        saved.laneLen[LANE_URGENT] + saved.laneLen[LANE_BULK]))
+    {
+        return;
+    }
+
+    client->ws = saved.ws;
+    websocket.open += (WS_OPEN == client->ws) ? 1 : 0;
+    client->accepted = saved.accepted;
+    client->activity = saved.activity;
+    client->rxEstimate = saved.rxEstimate;
+    client->flight = saved.flight;
+    FlightRecord(&(client->flight), FR_MOVE, workerIndex, LoopMonNow());
+
+    offset = sizeof(saved);
+    HoldPartial(client, state + offset, saved.partialLen);
+    offset += saved.partialLen;
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        end = offset + saved.laneLen[lane];
+        sent = saved.laneSent[lane];
+
+        while ((offset + sizeof(frame)) <= end)
+        {
+            memcpy(&frame, state + offset, sizeof(frame));
+            offset += sizeof(frame);
+
+            if ((frame.length > (end - offset)) ||
+                (LanePush(&(client->lanes[lane]), state + offset,
+                    frame.length, sent, frame.arrival) != 0))
+            {
+                break;
+            }
+
+            offset += frame.length;
+            sent = 0;
+        }
+
+        offset = end;
+    }
+
+    LaneWatch(client, reactor);
+}
+
+
+/***************************************************************************
+*   Function   : DoEcho
+*   Description: This routine receives from a client's socket and then
+*                writes the received message back to each connected client
+*                socket.  The write is non-blocking, so clients with busy
+*                sockets will not receive the message.  The receive buffer
+*                is borrowed from the buffer pool and sized by the client's
+*                receive estimate.  When a receive fills the buffer, the
+*                FIONREAD backlog is used to grow the estimate so bulk
+*                senders need fewer receives.  With raw framing whatever
+*                was received is echoed; with line framing only complete
+*                lines are (see EchoLines).  Filter commands at the start
+*                of what's echoed are carried out instead (see Publish).
+*   Parameters : client - The list node for the socket to be read from.
+*                list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor (policies and statistics).
+*   Effects    : client's socket is read from.  If the read succeeds, the
+*                value that was read is sent to all client sockets.  The
+*                send will only succeed if the socket may be written to
+*                without blocking.  Receives and sends are recorded in the
+*                flight recorder of the connection they happen on.
+*   Returned   : 0 for normal disconnect of clientFd, < 0 for failure,
+*                a positive value will be returned.
+***************************************************************************/
+int DoEcho(fd_list_t *client, fd_list_t *list, reactor_t *reactor)
+{
+    int result;
+    char *buffer;               /* stores received message */
+    size_t size;                /* size of the receive buffer */
+    long long now;              /* time stamp for flight recorder events */
+
+    size = RxEstimateSize(&client->rxEstimate);
+    buffer = (char *)BufPoolGet(size);
+
+    if (NULL == buffer)
+    {
+        perror("Error allocating receive buffer");
+        return -1;
+    }
+
+    result = recv(client->fd, buffer, size, 0);
+    REACTOR_COUNT(reactor, recvCalls, 1);
+    now = LoopMonNow();
+
+    if (result < 0)
+    {
+        /* receive failed */
+        FlightRecord(&client->flight, FR_ERROR, errno, now);
+        perror("Error receiving message from client");
+    }
+    else if (0 == result)
+    {
+        FlightRecord(&client->flight, FR_CLOSE, 0, now);
+
+        if (REACTOR_LOG_ON(reactor))
+        {
+            printf("Socket %d disconnected.\n", client->fd);
+        }
+    }
+    else
+    {
+        int pending;            /* bytes still waiting to be read */
+
+        REACTOR_COUNT(reactor, bytesIn, result);
+        client->activity += result;
+        TOP_ADD(reactor, TOP_INGRESS, client, result);
+        pending = 0;
+        FlightRecord(&client->flight, FR_RECV, result, now);
+
+        if ((size_t)result == size)
+        {
+            /* filled the buffer, see how much more is waiting */
+            REACTOR_COUNT(reactor, ioctlCalls, 1);
+
+            if (ioctl(client->fd, FIONREAD, &pending) < 0)
+            {
+                pending = 0;
+            }
+
+            FlightRecord(&client->flight, FR_BACKLOG, pending, now);
+        }
+
+        RxEstimateUpdate(&client->rxEstimate, result, size, pending);
+
+        if (REACTOR_LOG_ON(reactor))
+        {
+            printf("Socket %d received %.*s", client->fd, result, buffer);
+        }
+
+        if (WS_RAW != client->ws)
+        {
+            int status;
+
+            /* a WebSocket client, or one that may become one */
+            status = WsReceive(client, list, reactor, buffer, result, now);
+
+            if (status <= 1)
+            {
+                BufPoolPut(buffer, size);
+                return status;
+            }
+        }
+
+        if (REACTOR_FRAME_LINE == REACTOR_FRAMING_OF(reactor))
+        {
+            if (EchoLines(client, list, reactor, buffer, result, now) != 0)
+            {
+                BufPoolPut(buffer, size);
+                return -1;
+            }
+        }
+        else
+        {
+            Publish(client, list, reactor, buffer, result, now);
+        }
+
+        result = 1;     /* any echoing is success for this function */
+    }
+
+    BufPoolPut(buffer, size);
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : EchoLines
+*   Description: This routine implements line framing.  Received data up
+*                to and including the last '\n' completes one or more
+*                lines, which are echoed with a single send per client.
+*                Anything after the last '\n' is held until the rest of
+*                its line arrives.  Lines longer than MAX_LINE_SIZE are
+*                echoed in pieces.
+*   Parameters : client - The list node for the socket data came from.
+*                list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                data - the received data.
+*                length - the number of bytes received.
+*                now - time stamp for flight recorder events.
+*   Effects    : Complete lines are echoed to all client sockets (see
+*                Publish) and the client's partial line is updated.
+*   Returned   : 0 for success, -1 if a buffer for the partial line
+*                couldn't be allocated.
+***************************************************************************/
+int EchoLines(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    const char *data, size_t length, long long now)
+{
+    size_t complete;        /* bytes through the last '\n' */
+
+    for (complete = length; complete > 0; complete--)
+    {
+        if ('\n' == data[complete - 1])
+        {
+            break;
+        }
+    }
+
+    if ((client->partialLen + length) > MAX_LINE_SIZE)
+    {
+        /* too long to hold, echo what we have as a line of its own */
+        Broadcast(list, reactor, client->partial, client->partialLen, NULL,
+            now);
+        client->partialLen = 0;
+    }
+
+    if (0 == complete)
+    {
+        /* no end of line yet, hold on to everything */
+        return HoldPartial(client, data, length);
+    }
+
+    if (0 == client->partialLen)
+    {
+        Publish(client, list, reactor, data, complete, now);
+    }
+    else
+    {
+        /* finish the held line and echo it with the lines that follow */
+        if (HoldPartial(client, data, complete) != 0)
+        {
+            return -1;
+        }
+
+        Publish(client, list, reactor, client->partial, client->partialLen,
+            now);
+        BufPoolPut(client->partial, client->partialSize);
+        client->partial = NULL;
+        client->partialLen = 0;
+        client->partialSize = 0;
+    }
+
+    return HoldPartial(client, data + complete, length - complete);
+}
+
+
+/***************************************************************************
+*   Function   : HoldPartial
+*   Description: This routine appends data to a client's partial line.
+*                The line is kept in a buffer pool buffer that is replaced
+*                by a larger one as needed.
+*   Parameters : client - The list node for the socket data came from.
+*                data - the data to append.
+*                length - the number of bytes to append.
+*   Effects    : data is appended to the client's partial line.
+*   Returned   : 0 for success, -1 if a buffer couldn't be allocated.
+***************************************************************************/
+int HoldPartial(fd_list_t *client, const char *data, size_t length)
+{
+    size_t needed;
+
+    if (0 == length)
+    {
+        return 0;
+    }
+
+    needed = client->partialLen + length;
+
+    if (needed > client->partialSize)
+    {
+        size_t size;
+        char *buffer;
+
+        size = BufPoolClassSize(needed);
+        buffer = (char *)BufPoolGet(size);
+
+        if (NULL == buffer)
+        {
+            perror("Error allocating partial line buffer");
+            return -1;
+        }
+
+        if (NULL != client->partial)
+        {
+            memcpy(buffer, client->partial, client->partialLen);
+            BufPoolPut(client->partial, client->partialSize);
+        }
+
+        client->partial = buffer;
+        client->partialSize = size;
+    }
+
+    memcpy(client->partial + client->partialLen, data, length);
+    client->partialLen = needed;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : Publish
+*   Description: This routine echoes data received from a client, after
+*                carrying out any filter commands it starts with (see
+*                TakeCommands).  Commands aren't echoed.
+*   Parameters : client - The list node for the socket data came from.
+*                list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                data - the received data (complete lines with line
+*                framing).
+*                length - the length of data.
+*                now - time stamp for flight recorder events.
+*   Effects    : The client's filters may change and the rest of the data
+*                is sent to all client sockets (see Broadcast).
+*   Returned   : None
+***************************************************************************/
+void Publish(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    const char *data, size_t length, long long now)
+{
+    size_t taken;
+
+    taken = TakeCommands(client, data, length);
+
+    if (taken < length)
+    {
+        Broadcast(list, reactor, data + taken, length - taken, NULL, now);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : TakeCommands
+*   Description: This routine carries out the filter commands at the start
+*                of a client's data, one per line (see FilterCommand).
+*                "#sub <prefix>" and "#sub <low>..<high>" add a filter on
+*                message keys, "#unsub" removes them all.  A client with
+*                no filters is sent every message.
+*   Parameters : client - The list node for the socket data came from.
+*                data - the received data.
+*                length - the length of data.
+*   Effects    : The client's filters may change.
+*   Returned   : The number of bytes of commands at the start of data.
+***************************************************************************/
+size_t TakeCommands(fd_list_t *client, const char *data, size_t length)
+{
+    const char *end;
+    size_t taken, line;
+    int status;
+
+    taken = 0;
+
+    while ((taken < length) && ('#' == data[taken]))
+    {
+        end = (const char *)memchr(data + taken, '\n', length - taken);
+        line = (NULL == end) ? (length - taken) :
+            (size_t)(end - (data + taken)) + 1;
+        status = FilterCommand(&filtering.index, client, data + taken, line,
+            MAX_FILTERS);
+
+        if (FILTER_NONE == status)
+        {
+            break;      /* an ordinary message */
+        }
+        else if (FILTER_BAD == status)
+        {
+            filtering.refused++;
+            fprintf(stderr, "Socket %d sent a bad filter command\n",
+                client->fd);
+        }
+        else
+        {
+            filtering.commands++;
+            client->filters = FilterOwned(&filtering.index, client);
+        }
+
+        taken += line;
+    }
+
+    return taken;
+}
+
+
+/***************************************************************************
+*   Function   : MatchFilters
+*   Description: This routine looks up the clients with a filter matching
+*                a frame's key in the filter index and marks them with
+*                the number of this frame, so the fan out checks a client
+*                by comparing its mark (see WANTS_FRAME) rather than its
+*                filters.  The work is a binary search and one mark per
+*                matching client, however many clients and filters there
+*                are.
+*   Parameters : message - the frame.
+*                length - the length of the frame.
+*   Effects    : The matching clients are marked.
+*   Returned   : None
+***************************************************************************/
+void MatchFilters(const char *message, size_t length)
+{
+    void **owners;
+    int count, i;
+
+    if (0 == filtering.index.count)
+    {
+        return;     /* nobody filters, so WANTS_FRAME is always true */
+    }
+
+    filtering.frame++;
+    count = FilterMatch(&filtering.index, message,
+        FilterKeyLength(message, length), &owners);
+
+    if (count < 0)
+    {
+        perror("Error building the filter index");
+        return;
+    }
+
+    filtering.matches += count;
+
+    for (i = 0; i < count; i++)
+    {
+        ((fd_list_t *)owners[i])->matched = filtering.frame;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Broadcast
+*   Description: This routine sends a message to every connected client.
+*                In a worker (-w) it's also published to the shared ring,
+*                where the other workers read it and send it to their
+*                clients (see DrainRing).
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                message - the message to send.
+*                length - the length of the message.
+*                skip - a client that isn't sent the message, or NULL.
+*                now - time stamp for flight recorder events.
+*   Effects    : The message is sent to all client sockets (see
+*                BroadcastLocal).
+*   Returned   : None
+***************************************************************************/
+void Broadcast(fd_list_t *list, reactor_t *reactor, const char *message,
+    size_t length, const fd_list_t *skip, long long now)
+{
+    if (NULL != ring)
+    {
+        ShmRingPublish(ring, workerIndex, message, length);
+    }
+
+    BroadcastLocal(list, reactor, message, length, skip, now);
+}
+
+
+/***************************************************************************
+*   Function   : BroadcastLocal
+*   Description: This routine sends a message to every client connected to
+*                this process.  The message is one frame, except that with
+*                priority lanes and line framing each line is a frame of
+*                its own (runs of bulk lines stay together, see
+*                LaneFrameLength).  While clients have filters, every line
+*                is a frame, so each is matched by its own key.
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                message - the message to send.
+*                length - the length of the message.
+*                skip - a client that isn't sent the message, or NULL.
+*                now - time stamp for flight recorder events.
+*   Effects    : The message is sent to all client sockets (see
+*                BroadcastFrame).
+*   Returned   : None
+***************************************************************************/
+void BroadcastLocal(fd_list_t *list, reactor_t *reactor,
+    const char *message, size_t length, const fd_list_t *skip,
+    long long now)
+{
+    const char *end;
+    size_t frame;
+
+    if ((!lanes.enabled && (0 == filtering.index.count)) ||
+        (REACTOR_FRAME_LINE != REACTOR_FRAMING_OF(reactor)))
+    {
+        BroadcastFrame(list, reactor, message, length, skip, now);
+        return;
+    }
+
+    while (length > 0)
+    {
+        if (filtering.index.count > 0)
+        {
+            end = (const char *)memchr(message, '\n', length);
+            frame = (NULL == end) ? length : (size_t)(end - message) + 1;
+        }
+        else
+        {
+            frame = LaneFrameLength(message, length);
+        }
+
+        BroadcastFrame(list, reactor, message, frame, skip, now);
+        message += frame;
+        length -= frame;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : BroadcastFrame
+*   Description: This routine sends a frame to every connected client.
+*                The send is non-blocking, so clients with busy sockets
+*                will not receive the frame, unless priority lanes are
+*                enabled, in which case it waits in the client's queue for
+*                its lane.  With coalescing, the frame may instead be
+*                batched (see Coalesce); urgent frames never are.
+*                WebSocket clients are sent the frame as a binary message
+*                (see WsSendTo) whose header is encoded once, for the
+*                first of them.  Each frame starts with the client after
+*                the one the last frame started with (see FanoutFirst).
+*                Clients with filters are only sent frames whose key they
+*                match (see MatchFilters).
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                message - the frame to send.
+*                length - the length of the frame.
+*                skip - a client that isn't sent the frame, or NULL.
+*                now - time stamp for flight recorder events.
+*   Effects    : The frame is sent or queued to all client sockets.  Sends
+*                are recorded in the flight recorder of the connection they
+*                happen on.
+*   Returned   : None
+***************************************************************************/
+void BroadcastFrame(fd_list_t *list, reactor_t *reactor,
+    const char *message, size_t length, const fd_list_t *skip,
+    long long now)
+{
+    fd_list_t *here, *first;
+    unsigned char header[WS_MAX_HEADER];
+    size_t headerLength;
+    int lane, batched;
+
+    MatchFilters(message, length);
+    lane = lanes.enabled ? LaneOf(message, length, now) : LANE_BULK;
+    batched = (TUNABLES()->coalesceWindowUs > 0) && (LANE_URGENT != lane) &&
+        Coalesce(list, reactor, message, length, skip, now);
+
+    if (batched && (0 == websocket.open))
+    {
+        return;     /* batched, it's sent when the batch is flushed */
+    }
+
+    headerLength = 0;
+    first = FanoutFirst(list);
+
+    /***********************************************************************
+    * echo the buffer to all connected sockets, skip if waiting
+    * is required.  Use threads or a complex polling loop if it's
+    * important that every socket receive the echo.
+    ***********************************************************************/
+    for (here = first; here != NULL; here = FanoutNext(here, list, first))
+    {
+        if (here == skip)
+        {
+            continue;
+        }
+
+        if (!WANTS_FRAME(here))
+        {
+            continue;
+        }
+
+        if ((WS_PENDING == here->ws) && (0 == here->partialLen) &&
+            ((now - here->accepted) >= (WS_DETECT_MS * 1000000LL)))
+        {
+            here->ws = WS_RAW;  /* it never asked for a WebSocket */
+        }
+
+        if (WS_OPEN == here->ws)
+        {
+            /* one header for every WebSocket subscriber */
+            if (0 == headerLength)
+            {
+                headerLength = WsEncodeHeader(header, WS_OP_BINARY, length);
+                websocket.headers++;
+            }
+
+            WsSendTo(here, reactor, lane, header, headerLength, message,
+                length, now);
+            websocket.framesOut++;
+            continue;
+        }
+
+        if (batched || (WS_RAW != here->ws))
+        {
+            continue;
+        }
+
+        if (lanes.enabled)
+        {
+            QueueTo(here, reactor, lane, message, length, now);
+        }
+        else
+        {
+            SendTo(here, reactor, message, length, now);
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SendTo
+*   Description: This routine makes one non-blocking send to a client.  A
+*                client with a busy socket doesn't receive the message.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                message - the message to send.
+*                length - the length of the message.
+*                now - time stamp for flight recorder events.
+*   Effects    : The message is sent if the socket can take it without
+*                blocking.  The send is recorded in the client's flight
+*                recorder.
+*   Returned   : None
+***************************************************************************/
+void SendTo(fd_list_t *client, reactor_t *reactor, const char *message,
+    size_t length, long long now)
+{
+    ssize_t sent;
+
+    sent = send(client->fd, message, length, MSG_DONTWAIT);
+    REACTOR_COUNT(reactor, sendCalls, 1);
+
+    if (sent == -1)
+    {
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+            FlightRecord(&client->flight, FR_EAGAIN, 0, now);
+            TOP_ADD(reactor, TOP_EAGAIN, client, 1);
+
+            if (REACTOR_LOG_ON(reactor))
+            {
+                fprintf(stderr, "Socket %d is busy\n", client->fd);
+            }
+        }
+        else
+        {
+            /* send failed */
+            FlightRecord(&client->flight, FR_ERROR, errno, now);
+            fprintf(stderr, "Error echoing message to socket %d ",
+                client->fd);
+            perror("");
+        }
+    }
+    else
+    {
+        FlightRecord(&client->flight, FR_SEND, sent, now);
+        REACTOR_COUNT(reactor, bytesOut, sent);
+        client->activity += sent;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Coalesce
+*   Description: This routine decides whether a broadcast is sent now or
+*                batched.  While no batch is waiting, a message is sent
+*                immediately if messages have been arriving too slowly for
+*                a window to collect at least two of them (the average gap
+*                between them is over half the window), or if it arrives
+*                at least a window after the last send to subscribers.  So
+*                quiet traffic isn't delayed.  Otherwise messages are
+*                appended to each subscriber's output buffer and flushed
+*                with one send per subscriber when the window since the
+*                last send ends, or as soon as the batch holds -N messages.
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                message - the message to send.
+*                length - the length of the message.
+*                skip - a client that isn't sent the message, or NULL.
+*                now - arrival time of the message (ns).
+*   Effects    : The message may be appended to the subscribers' output
+*                buffers and the flush timer started.
+*   Returned   : 1 if the message was batched, 0 if it should be sent now.
+***************************************************************************/
+int Coalesce(fd_list_t *list, reactor_t *reactor, const char *message,
+    size_t length, const fd_list_t *skip, long long now)
+{
+    const tunables_t *tunables;
+    long long window;
+    fd_list_t *here;
+
+    tunables = TUNABLES();
+    window = tunables->coalesceWindowUs * 1000LL;
+    coalesce.messages++;
+    coalesce.averageGap +=
+        ((now - coalesce.lastArrival) - coalesce.averageGap) / 8;
+    coalesce.lastArrival = now;
+
+    if ((-1 == coalesce.timer) &&
+        (((2 * coalesce.averageGap) > window) ||
+        ((now - coalesce.lastFlush) >= window)))
+    {
+        /* quiet, send it now and batch anything that follows closely */
+        coalesce.lastFlush = now;
+        coalesce.immediate++;
+        return 0;
+    }
+
+    for (here = list; here != NULL; here = here->next)
+    {
+        if ((here != skip) && (WS_RAW == here->ws) && WANTS_FRAME(here) &&
+            (AppendOutput(here, reactor, message, length, now) == 0))
+        {
+            coalesce.copies++;
+        }
+    }
+
+    if (0 == coalesce.batched)
+    {
+        coalesce.firstArrival = now;
+    }
+
+    coalesce.batched++;
+    coalesce.arrivals += now;
+
+    if ((tunables->coalesceMessages > 0) &&
+        (coalesce.batched >= tunables->coalesceMessages))
+    {
+        ReactorCancelTimer(reactor, coalesce.timer);
+        coalesce.timer = -1;
+        FlushOutput(list, reactor, now);
+    }
+    else if (-1 == coalesce.timer)
+    {
+        coalesce.timer = ReactorTimerUs(reactor,
+            (long)((coalesce.lastFlush + window - now) / 1000),
+            FlushTimer, NULL);
+
+        if (coalesce.timer < 0)
+        {
+            /* no timer to flush it later */
+            FlushOutput(list, reactor, now);
+        }
+    }
+
+    return 1;
+}
+
+
+/***************************************************************************
+*   Function   : AppendOutput
+*   Description: This routine appends a message to a client's output
+*                buffer.  If the buffer would grow past COALESCE_MAX_BYTES
+*                what it holds is sent first.  The buffer comes from the
+*                buffer pool and is replaced by a larger one as needed.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                message - the message to append.
+*                length - the length of the message.
+*                now - time stamp for flight recorder events.
+*   Effects    : The message is held for the client.
+*   Returned   : 0 for success, -1 if a buffer couldn't be allocated.
+***************************************************************************/
+int AppendOutput(fd_list_t *client, reactor_t *reactor, const char *message,
+    size_t length, long long now)
+{
+    size_t needed;
+
+    if ((client->outLen + length) > COALESCE_MAX_BYTES)
+    {
+        SendOutput(client, reactor, now);
+    }
+
+    needed = client->outLen + length;
+
+    if (needed > client->outSize)
+    {
+        size_t size;
+        char *buffer;
+
+        size = BufPoolClassSize(needed);
+        buffer = (char *)BufPoolGet(size);
+
+        if (NULL == buffer)
+        {
+            perror("Error allocating output buffer");
+            return -1;
+        }
+
+        if (NULL != client->out)
+        {
+            memcpy(buffer, client->out, client->outLen);
+            BufPoolPut(client->out, client->outSize);
+        }
+
+        client->out = buffer;
+        client->outSize = size;
+    }
+
+    memcpy(client->out + client->outLen, message, length);
+    client->outLen = needed;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : FanoutFirst
+*   Description: This routine picks the client a broadcast starts with.
+*                Each broadcast starts one client further along the list
+*                than the last one, so every client takes its turn at each
+*                place in the send order instead of the earliest connected
+*                always going first and the latest always going last.
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*   Effects    : The next broadcast will start with the following client.
+*   Returned   : The first client to send to, NULL if there are none.
+***************************************************************************/
+fd_list_t *FanoutFirst(fd_list_t *list)
+{
+    fd_list_t *first;
+
+    first = (NULL != fanoutStart) ? fanoutStart : list;
+    fanoutStart = (NULL != first) ? first->next : NULL;
+    return first;
+}
+
+
+/***************************************************************************
+*   Function   : FanoutNext
+*   Description: This routine steps through the clients in broadcast
+*                order, wrapping from the end of the list to its head.
+*   Parameters : here - the current client.
+*                list - a pointer to a list of fds for all connected sockets.
+*                first - the client the broadcast started with.
+*   Effects    : None
+*   Returned   : The next client, NULL once every client has been visited.
+***************************************************************************/
+fd_list_t *FanoutNext(const fd_list_t *here, fd_list_t *list,
+    const fd_list_t *first)
+{
+    fd_list_t *next;
+
+    next = (NULL != here->next) ? here->next : list;
+    return (next == first) ? NULL : next;
+}
+
+
+/***************************************************************************
+*   Function   : SendOutput
+*   Description: This routine sends a client's output buffer with one send
+*                and returns the buffer to the pool.  Like any broadcast,
+*                what a busy socket can't take is dropped, or with priority
+*                lanes queued in the bulk lane.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                now - time stamp for flight recorder events.
+*   Effects    : The client's output buffer is sent and released.
+*   Returned   : 1 if a send was made, 0 if there was nothing to send.
+***************************************************************************/
+int SendOutput(fd_list_t *client, reactor_t *reactor, long long now)
+{
+    if (NULL == client->out)
+    {
+        return 0;
+    }
+
+    if (lanes.enabled)
+    {
+        QueueTo(client, reactor, LANE_BULK, client->out, client->outLen, now);
+    }
+    else
+    {
+        SendTo(client, reactor, client->out, client->outLen, now);
+    }
+
+    BufPoolPut(client->out, client->outSize);
+    client->out = NULL;
+    client->outLen = 0;
+    client->outSize = 0;
+    return 1;
+}
+
+
+/***************************************************************************
+*   Function   : FlushOutput
+*   Description: This routine sends the batch held for every client and
+*                updates the coalescing totals.  Like a broadcast, each
+*                flush starts with the next client (see FanoutFirst).
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                now - the current time (ns).
+*   Effects    : Every client's output buffer is sent and a new batch may
+*                be started.
+*   Returned   : None
+***************************************************************************/
+void FlushOutput(fd_list_t *list, reactor_t *reactor, long long now)
+{
+    fd_list_t *here, *first;
+    unsigned long sends;
+
+    sends = 0;
+    first = FanoutFirst(list);
+
+    for (here = first; here != NULL; here = FanoutNext(here, list, first))
+    {
+        sends += SendOutput(here, reactor, now);
+    }
+
+    if (coalesce.batched > 0)
+    {
+        coalesce.batches++;
+        coalesce.sendsSaved +=
+            (coalesce.copies > sends) ? (coalesce.copies - sends) : 0;
+        coalesce.delaySum += (coalesce.batched * now) - coalesce.arrivals;
+
+        if ((now - coalesce.firstArrival) > coalesce.delayMax)
+        {
+            coalesce.delayMax = now - coalesce.firstArrival;
+        }
+    }
+
+    coalesce.batched = 0;
+    coalesce.arrivals = 0;
+    coalesce.copies = 0;
+    coalesce.lastFlush = now;
+}
+
+
+/***************************************************************************
+*   Function   : PrintCoalesce
+*   Description: This routine writes the coalescing totals: how many
+*                messages were batched, how many sends that saved, and how
+*                long batched messages were held.
+*   Parameters : stream - where to write them.
+*   Effects    : A "coalesce:" line is written if coalescing is enabled.
+*   Returned   : None
+***************************************************************************/
+void PrintCoalesce(FILE *stream)
+{
+    const tunables_t *tunables;
+    unsigned long held;
+
+    tunables = TUNABLES();
+
+    if ((0 == tunables->coalesceWindowUs) && (0 == coalesce.messages))
+    {
+        return;
+    }
+
+    held = coalesce.messages - coalesce.immediate;
+
+    fprintf(stream, "coalesce: window_us=%lld max_msgs=%lld messages=%lu "
+        "immediate=%lu batches=%lu msgs_per_batch=%.1f sends_saved=%lu "
+        "delay_avg_us=%.1f delay_max_us=%.1f\n",
+        tunables->coalesceWindowUs, tunables->coalesceMessages,
+        coalesce.messages,
+        coalesce.immediate, coalesce.batches,
+        (coalesce.batches > 0) ? ((double)held / coalesce.batches) : 0.0,
+        coalesce.sendsSaved,
+        (held > 0) ? (coalesce.delaySum / 1000.0 / held) : 0.0,
+        coalesce.delayMax / 1000.0);
+}
+
+
+/***************************************************************************
+*   Function   : LaneFrameLength
+*   Description: This routine finds the first frame of line framed data
+*                when priority lanes are enabled.  An urgent line is a
+*                frame by itself, so its rate and queue are accounted for
+*                separately.  Consecutive bulk lines make up one frame.
+*   Parameters : message - complete lines (the last may be unended if it
+*                was too long to hold).
+*                length - the length of message.
+*   Effects    : None
+*   Returned   : The length of the first frame.
+***************************************************************************/
+size_t LaneFrameLength(const char *message, size_t length)
+{
+    const char *end;
+    size_t frame;
+
+    frame = 0;
+
+    do
+    {
+        end = (const char *)memchr(message + frame, '\n', length - frame);
+        frame = (NULL == end) ? length : (size_t)(end - message) + 1;
+    } while ((frame < length) && (LANE_MARK != message[0]) &&
+        (LANE_MARK != message[frame]));
+
+    return frame;
+}
+
+
+/***************************************************************************
+*   Function   : LaneOf
+*   Description: This routine picks the lane for a frame.  Frames that
+*                start with LANE_MARK are urgent, unless urgent frames are
+*                arriving faster than the -P rate, in which case they are
+*                demoted to the bulk lane.  The rate is a token bucket
+*                that allows urgent_burst frames back to back.
+*   Parameters : message - the frame.
+*                length - the length of the frame.
+*                now - arrival time of the frame (ns).
+*   Effects    : The urgent rate allowance is updated.
+*   Returned   : LANE_URGENT or LANE_BULK.
+***************************************************************************/
+int LaneOf(const char *message, size_t length, long long now)
+{
+    const tunables_t *tunables;
+    long long cost;
+
+    if ((0 == length) || (LANE_MARK != message[0]))
+    {
+        return LANE_BULK;
+    }
+
+    tunables = TUNABLES();
+
+    if (0 == tunables->urgentRate)
+    {
+        return LANE_URGENT;
+    }
+
+    cost = 1000000000LL / tunables->urgentRate;
+    lanes.credit += now - lanes.lastUrgent;
+    lanes.lastUrgent = now;
+
+    if (lanes.credit > (tunables->urgentBurst * cost))
+    {
+        lanes.credit = tunables->urgentBurst * cost;
+    }
+
+    if (lanes.credit < cost)
+    {
+        lanes.demoted++;
+        return LANE_BULK;
+    }
+
+    lanes.credit -= cost;
+    return LANE_URGENT;
+}
+
+
+/***************************************************************************
+*   Function   : QueueTo
+*   Description: This routine sends a frame to a client using priority
+*                lanes.  If nothing is queued for the client the frame is
+*                sent immediately, otherwise it (or what the socket didn't
+*                take) is queued in its lane, to be sent by DrainLanes when
+*                the socket is writable.  A frame that would take the
+*                lane's queue past its limit is dropped, unless part of it
+*                has already been sent.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                lane - LANE_URGENT or LANE_BULK.
+*                message - the frame to send.
+*                length - the length of the frame.
+*                now - arrival time of the frame (ns).
+*   Effects    : The frame is sent or queued, and the reactor is asked to
+*                report when a socket with queued frames is writable.
+*   Returned   : None
+***************************************************************************/
+void QueueTo(fd_list_t *client, reactor_t *reactor, int lane,
+    const char *message, size_t length, long long now)
+{
+    lane_stats_t *stats;
+    ssize_t sent;
+
+    stats = &(lanes.stats[lane]);
+    sent = 0;
+
+    if (!client->writeWait)
+    {
+        /* nothing is queued, so the frame can go straight out */
+        sent = send(client->fd, message, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        REACTOR_COUNT(reactor, sendCalls, 1);
+
+        if (sent < 0)
+        {
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                FlightRecord(&client->flight, FR_ERROR, errno, now);
+                fprintf(stderr, "Error echoing message to socket %d ",
+                    client->fd);
+                perror("");
+                return;
+            }
+
+            FlightRecord(&client->flight, FR_EAGAIN, 0, now);
+            TOP_ADD(reactor, TOP_EAGAIN, client, 1);
+            sent = 0;
+        }
+        else
+        {
+            FlightRecord(&client->flight, FR_SEND, sent, now);
+            REACTOR_COUNT(reactor, bytesOut, sent);
+            client->activity += sent;
+
+            if ((size_t)sent == length)
+            {
+                stats->frames++;
+                stats->histogram[LoopMonBucket(LoopMonNow() - now)]++;
+                return;
+            }
+        }
+    }
+
+    LaneQueue(client, reactor, lane, message, length, sent, now);
+}
+
+
+/***************************************************************************
+*   Function   : LaneQueue
+*   Description: This routine queues a frame, or the rest of a partly sent
+*                one, in a client's lane.  A frame that would take the
+*                lane's queue past its limit is dropped, unless part of it
+*                has already been sent.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                lane - LANE_URGENT or LANE_BULK.
+*                message - the frame.
+*                length - the length of the frame.
+*                sent - bytes of the frame already sent.
+*                now - arrival time of the frame (ns).
+*   Effects    : The frame is queued, and the reactor is asked to report
+*                when the socket is writable.
+*   Returned   : None
+***************************************************************************/
+void LaneQueue(fd_list_t *client, reactor_t *reactor, int lane,
+    const char *message, size_t length, size_t sent, long long now)
+{
+    lane_queue_t *queue;
+    lane_stats_t *stats;
+    long long limit;
+
+    queue = &(client->lanes[lane]);
+    stats = &(lanes.stats[lane]);
+    limit = (LANE_URGENT == lane) ? TUNABLES()->urgentLimit :
+        TUNABLES()->bulkLimit;
+
+    if ((0 == sent) && ((long long)(queue->bytes + length) > limit))
+    {
+        stats->dropped++;
+        return;
+    }
+
+    if (LanePush(queue, message, length, sent, now) != 0)
+    {
+        return;
+    }
+
+    stats->queued++;
+
+    if (queue->bytes > stats->peakBytes)
+    {
+        stats->peakBytes = queue->bytes;
+    }
+
+    LaneWatch(client, reactor);
+}
+
+
+/***************************************************************************
+*   Function   : LanePush
+*   Description: This routine appends a frame to a lane's queue.  The
+*                queue is a buffer pool buffer holding a lane_frame_t
+*                header and the data of each frame.  Sent frames are
+*                squeezed out of the front before a larger buffer is used.
+*   Parameters : queue - the lane's queue.
+*                message - the frame.
+*                length - the length of the frame.
+*                sent - bytes of the frame already sent (only when the
+*                queue is empty).
+*                arrival - arrival time of the frame (ns).
+*   Effects    : The frame is queued.
+*   Returned   : 0 for success, -1 if a buffer couldn't be allocated.
+***************************************************************************/
+int LanePush(lane_queue_t *queue, const char *message, size_t length,
+    size_t sent, long long arrival)
+{
+    lane_frame_t frame;
+    size_t needed;
+
+    if ((queue->head > 0) &&
+        ((queue->tail + sizeof(frame) + length) > queue->size))
+    {
+        memmove(queue->buffer, queue->buffer + queue->head,
+            queue->tail - queue->head);
+        queue->tail -= queue->head;
+        queue->head = 0;
+    }
+
+    needed = queue->tail + sizeof(frame) + length;
+
+    if (needed > queue->size)
+    {
+        size_t size;
+        char *buffer;
+
+        size = BufPoolClassSize(needed);
+        buffer = (char *)BufPoolGet(size);
+
+        if (NULL == buffer)
+        {
+            perror("Error allocating lane buffer");
+            return -1;
+        }
+
+        if (NULL != queue->buffer)
+        {
+            memcpy(buffer, queue->buffer, queue->tail);
+            BufPoolPut(queue->buffer, queue->size);
+        }
+
+        queue->buffer = buffer;
+        queue->size = size;
+    }
+
+    frame.length = length;
+    frame.arrival = arrival;
+    memcpy(queue->buffer + queue->tail, &frame, sizeof(frame));
+    memcpy(queue->buffer + queue->tail + sizeof(frame), message, length);
+    queue->tail = needed;
+    queue->bytes += length - sent;
+    queue->sent += sent;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : DrainLanes
+*   Description: This routine sends a client's queued frames once its
+*                socket is writable.  A partly sent frame is finished
+*                first, so lanes only change at frame boundaries.  After
+*                that urgent frames are sent before bulk frames.  Up to
+*                LANE_IOV_MAX frames from one lane go out with each
+*                sendmsg.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                now - the current time (ns).
+*   Effects    : Queued frames are sent until the socket is full or the
+*                queues are empty.
+*   Returned   : 0 for success, -1 if a send failed.
+***************************************************************************/
+int DrainLanes(fd_list_t *client, reactor_t *reactor, long long now)
+{
+    struct iovec iov[LANE_IOV_MAX];
+    struct msghdr msg;
+    lane_frame_t frame;
+    lane_queue_t *queue;
+    size_t offset, skip, total;
+    ssize_t sent;
+    int lane, count;
+
+    for (;;)
+    {
+        if (client->lanes[LANE_BULK].sent > 0)
+        {
+            lane = LANE_BULK;
+        }
+        else if (client->lanes[LANE_URGENT].tail > 0)
+        {
+            lane = LANE_URGENT;
+        }
+        else if (client->lanes[LANE_BULK].tail > 0)
+        {
+            lane = LANE_BULK;
+        }
+        else
+        {
+            return 0;       /* everything's sent */
+        }
+
+        queue = &(client->lanes[lane]);
+        total = 0;
+        skip = queue->sent;
+        offset = queue->head;
+
+        for (count = 0; (count < LANE_IOV_MAX) && (offset < queue->tail);
+            count++)
+        {
+            memcpy(&frame, queue->buffer + offset, sizeof(frame));
+            iov[count].iov_base = queue->buffer + offset + sizeof(frame) +
+                skip;
+            iov[count].iov_len = frame.length - skip;
+            total += frame.length - skip;
+            offset += sizeof(frame) + frame.length;
+            skip = 0;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        sent = sendmsg(client->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        REACTOR_COUNT(reactor, sendCalls, 1);
+
+        if (sent < 0)
+        {
+            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            {
+                FlightRecord(&client->flight, FR_EAGAIN, 0, now);
+                TOP_ADD(reactor, TOP_EAGAIN, client, 1);
+                return 0;
+            }
+
+            FlightRecord(&client->flight, FR_ERROR, errno, now);
+            return -1;
+        }
+
+        FlightRecord(&client->flight, FR_SEND, sent, now);
+        REACTOR_COUNT(reactor, bytesOut, sent);
+        client->activity += sent;
+        LaneConsume(queue, &(lanes.stats[lane]), sent, now);
+
+        if ((size_t)sent < total)
+        {
+            return 0;       /* the socket is full */
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LaneConsume
+*   Description: This routine removes sent data from the front of a lane's
+*                queue.  The time from arrival until its last byte was
+*                sent is added to the lane's histogram for every frame
+*                that was finished.  An emptied queue's buffer is returned
+*                to the pool.
+*   Parameters : queue - the lane's queue.
+*                stats - the lane's totals.
+*                sent - the number of bytes sent.
+*                now - the current time (ns).
+*   Effects    : The queue and totals are updated.
+*   Returned   : None
+***************************************************************************/
+void LaneConsume(lane_queue_t *queue, lane_stats_t *stats, size_t sent,
+    long long now)
+{
+    lane_frame_t frame;
+    size_t left;
+
+    queue->bytes -= sent;
+
+    while (sent > 0)
+    {
+        memcpy(&frame, queue->buffer + queue->head, sizeof(frame));
+        left = frame.length - queue->sent;
+
+        if (sent < left)
+        {
+            queue->sent += sent;
+            break;
+        }
+
+        sent -= left;
+        queue->head += sizeof(frame) + frame.length;
+        queue->sent = 0;
+        stats->frames++;
+        stats->histogram[LoopMonBucket(now - frame.arrival)]++;
+    }
+
+    if (queue->head == queue->tail)
+    {
+        BufPoolPut(queue->buffer, queue->size);
+        memset(queue, 0, sizeof(lane_queue_t));
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LaneWatch
+*   Description: This routine asks the reactor to report a client's socket
+*                writable while it has queued frames, and stops asking
+*                once they've all been sent.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*   Effects    : The client's reactor events may be changed.
+*   Returned   : None
+***************************************************************************/
+void LaneWatch(fd_list_t *client, reactor_t *reactor)
+{
+    int waiting;
+
+    waiting = (client->lanes[LANE_URGENT].tail > 0) ||
+        (client->lanes[LANE_BULK].tail > 0);
+
+    if (waiting != client->writeWait)
+    {
+        ReactorModify(reactor, client->fd,
+            REACTOR_READ | (waiting ? REACTOR_WRITE : 0));
+        client->writeWait = waiting;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : FreeLanes
+*   Description: This routine returns a client's lane queues to the buffer
+*                pool, dropping anything that wasn't sent.
+*   Parameters : client - the client's list node.
+*   Effects    : The client's lane queues are emptied.
+*   Returned   : None
+***************************************************************************/
+void FreeLanes(fd_list_t *client)
+{
+    int lane;
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        if (NULL != client->lanes[lane].buffer)
+        {
+            BufPoolPut(client->lanes[lane].buffer, client->lanes[lane].size);
+        }
+    }
+
+    memset(client->lanes, 0, sizeof(client->lanes));
+}
+
+
+/***************************************************************************
+*   Function   : PrintLanes
+*   Description: This routine writes the priority lane totals: frames sent,
+*                frames that had to wait, frames dropped at each lane's
+*                limit, and the time from arrival to sent for each lane as
+*                estimated percentiles and a histogram.
+*   Parameters : stream - where to write them.
+*   Effects    : A "lanes:" line and a histogram line per lane are written
+*                if priority lanes are enabled.
+*   Returned   : None
+***************************************************************************/
+void PrintLanes(FILE *stream)
+{
+    static const char *names[LANE_COUNT] = {"urgent", "bulk"};
+    char label[32];
+    const lane_stats_t *stats;
+    int lane;
+
+    if (!lanes.enabled)
+    {
+        return;
+    }
+
+    fprintf(stream, "lanes: urgent_rate=%lld demoted=%lu",
+        TUNABLES()->urgentRate, lanes.demoted);
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        stats = &(lanes.stats[lane]);
+        fprintf(stream, " %s_frames=%lu %s_queued=%lu %s_dropped=%lu "
+            "%s_peak_bytes=%lu %s_lat_p50_us=%lu %s_lat_p99_us=%lu",
+            names[lane], stats->frames, names[lane], stats->queued,
+            names[lane], stats->dropped, names[lane],
+            (unsigned long)stats->peakBytes, names[lane],
+            LoopMonHistPercentile(stats->histogram, 50.0), names[lane],
+            LoopMonHistPercentile(stats->histogram, 99.0));
+    }
+
+    fprintf(stream, "\n");
+
+    for (lane = 0; lane < LANE_COUNT; lane++)
+    {
+        sprintf(label, "lane_%s_hist", names[lane]);
+        LoopMonPrintHist(label, lanes.stats[lane].histogram, stream);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : WsReceive
+*   Description: This routine handles data from a client while the
+*                WebSocket gateway (-G) is enabled.  A new client is
+*                pending until its first data arrives: an HTTP GET is held
+*                until its blank line and answered with the opening
+*                handshake, anything else makes it a plain client.  The
+*                frames of an open WebSocket are parsed straight from the
+*                received data, and only an unfinished frame is held (in
+*                the client's partial buffer) until the rest arrives.
+*   Parameters : client - The list node for the socket data came from.
+*                list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                data - the received data, it's unmasked in place.
+*                length - the number of bytes received.
+*                now - time stamp for flight recorder events.
+*   Effects    : The handshake may be answered, and received frames are
+*                handled (see WsFrames).
+*   Returned   : 1 if the data was handled, 2 if the client is a plain
+*                client whose data should be echoed as usual, 0 if the
+*                connection should be closed and -1 on failure.
+***************************************************************************/
+int WsReceive(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    char *data, size_t length, long long now)
+{
+    char response[WS_RESPONSE_SIZE];
+    size_t used, request;
+    int status;
+
+    if (WS_PENDING == client->ws)
+    {
+        if (HoldPartial(client, data, length) != 0)
+        {
+            return -1;
+        }
+
+        if (!WsIsUpgrade(client->partial, client->partialLen))
+        {
+            /* a plain client */
+            client->ws = WS_RAW;
+            client->partialLen -= length;
+
+            if ((client->partialLen > 0) &&
+                (REACTOR_FRAME_LINE != REACTOR_FRAMING_OF(reactor)))
+            {
+                /* send what was held, line framing keeps it as a line */
+                Broadcast(list, reactor, client->partial, client->partialLen,
+                    NULL, now);
+                client->partialLen = 0;
+            }
+
+            if (0 == client->partialLen)
+            {
+                BufPoolPut(client->partial, client->partialSize);
+                client->partial = NULL;
+                client->partialSize = 0;
+            }
+
+            return 2;
+        }
+
+        for (request = 4; request <= client->partialLen; request++)
+        {
+            if (memcmp(client->partial + request - 4, "\r\n\r\n", 4) == 0)
+            {
+                break;
+            }
+        }
+
+        if (request > client->partialLen)
+        {
+            if (client->partialLen <= MAX_LINE_SIZE)
+            {
+                return 1;       /* wait for the rest of the request */
+            }
+
+            status = -1;        /* too long for a handshake */
+        }
+        else
+        {
+            status = WsHandshake(client->partial, request, response,
+                sizeof(response));
+        }
+
+        if (status < 0)
+        {
+            static const char refused[] =
+                "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
+
+            websocket.refused++;
+            send(client->fd, refused, sizeof(refused) - 1, MSG_NOSIGNAL);
+            REACTOR_COUNT(reactor, sendCalls, 1);
+            return 0;
+        }
+
+        send(client->fd, response, status, MSG_NOSIGNAL);
+        REACTOR_COUNT(reactor, sendCalls, 1);
+        client->ws = WS_OPEN;
+        websocket.upgrades++;
+        websocket.open++;
+
+        /* frames may follow the request */
+        client->partialLen -= request;
+        memmove(client->partial, client->partial + request,
+            client->partialLen);
+        length = 0;
+
+        if (0 == client->partialLen)
+        {
+            /* nothing followed, an idle WebSocket holds no buffer */
+            BufPoolPut(client->partial, client->partialSize);
+            client->partial = NULL;
+            client->partialSize = 0;
+            return 1;
+        }
+    }
+
+    if (0 == client->partialLen)
+    {
+        status = WsFrames(client, list, reactor, data, length, &used, now);
+
+        if ((status > 0) &&
+            (HoldPartial(client, data + used, length - used) != 0))
+        {
+            status = -1;
+        }
+
+        return status;
+    }
+
+    /* finish the held frame */
+    if (HoldPartial(client, data, length) != 0)
+    {
+        return -1;
+    }
+
+    status = WsFrames(client, list, reactor, client->partial,
+        client->partialLen, &used, now);
+    client->partialLen -= used;
+    memmove(client->partial, client->partial + used, client->partialLen);
+
+    if (0 == client->partialLen)
+    {
+        BufPoolPut(client->partial, client->partialSize);
+        client->partial = NULL;
+        client->partialSize = 0;
+    }
+
+    return status;
+}
+
+
+/***************************************************************************
+*   Function   : WsFrames
+*   Description: This routine handles the complete frames at the start of
+*                data received from a WebSocket client.  Each payload is
+*                unmasked in place.  Data frames are broadcast, fragments
+*                as separate messages, pings are answered and a close is
+*                returned.  Unmasked frames, frames with reserved bits and
+*                frames over WS_MAX_PAYLOAD end the connection with a
+*                close status.
+*   Parameters : client - The list node for the socket data came from.
+*                list - a pointer to a list of fds for all connected sockets.
+*                reactor - the server's reactor.
+*                data - the received frames.
+*                length - the number of bytes received.
+*                used - set to the number of bytes in complete frames.
+*                now - time stamp for flight recorder events.
+*   Effects    : Frames are handled and unmasked in place.
+*   Returned   : 1 if the connection stays open, 0 if it should be closed.
+***************************************************************************/
+int WsFrames(fd_list_t *client, fd_list_t *list, reactor_t *reactor,
+    char *data, size_t length, size_t *used, long long now)
+{
+    ws_frame_t frame;
+    char *payload;
+    size_t offset, size;
+
+    offset = 0;
+    *used = 0;
+
+    while (WsParseFrame((unsigned char *)data + offset, length - offset,
+        &frame))
+    {
+        if (frame.payloadLength > WS_MAX_PAYLOAD)
+        {
+            websocket.refused++;
+            WsClose(client, reactor, WS_CLOSE_TOO_BIG, now);
+            return 0;
+        }
+
+        if (!frame.masked || frame.reserved || ((frame.opcode & 0x08) &&
+            (!frame.fin || (frame.payloadLength > 125))))
+        {
+            websocket.refused++;
+            WsClose(client, reactor, WS_CLOSE_PROTOCOL, now);
+            return 0;
+        }
+
+        size = frame.headerLength + (size_t)frame.payloadLength;
+
+        if ((length - offset) < size)
+        {
+            break;      /* the rest of the payload hasn't arrived */
+        }
+
+        payload = data + offset + frame.headerLength;
+        WsUnmask((unsigned char *)payload, frame.payloadLength, frame.mask);
+        offset += size;
+        *used = offset;
+
+        switch (frame.opcode)
+        {
+            case WS_OP_CONTINUE:
+            case WS_OP_TEXT:
+            case WS_OP_BINARY:
+                websocket.framesIn++;
+
+                if (frame.payloadLength > 0)
+                {
+                    Broadcast(list, reactor, payload, frame.payloadLength,
+                        NULL, now);
+                }
+                break;
+
+            case WS_OP_PING:
+                websocket.pings++;
+                WsControl(client, reactor, WS_OP_PONG, payload,
+                    frame.payloadLength, now);
+                break;
+
+            case WS_OP_PONG:
+                break;
+
+            case WS_OP_CLOSE:
+                websocket.closes++;
+                WsControl(client, reactor, WS_OP_CLOSE, payload,
+                    frame.payloadLength, now);
+                return 0;
+
+            default:
+                websocket.refused++;
+                WsClose(client, reactor, WS_CLOSE_PROTOCOL, now);
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/***************************************************************************
+*   Function   : WsSendTo
+*   Description: This routine sends a frame to a WebSocket client.  The
+*                header and payload go out with one sendmsg, so a
+*                broadcast's payload isn't copied and its header is only
+*                encoded once.  A frame the socket can't take all of is
+*                queued whole in the client's lane (see LaneQueue), so
+*                frames are never cut short or interleaved.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                lane - LANE_URGENT or LANE_BULK.
+*                header - the frame's header.
+*                headerLength - the length of the header.
+*                message - the frame's payload.
+*                length - the length of the payload.
+*                now - arrival time of the message (ns).
+*   Effects    : The frame is sent or queued.
+*   Returned   : None
+***************************************************************************/
+void WsSendTo(fd_list_t *client, reactor_t *reactor, int lane,
+    const unsigned char *header, size_t headerLength, const char *message,
+    size_t length, long long now)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    char *frame;
+    size_t size;
+    ssize_t sent;
+
+    sent = 0;
+
+    if (!client->writeWait)
+    {
+        iov[0].iov_base = (void *)header;
+        iov[0].iov_len = headerLength;
+        iov[1].iov_base = (void *)message;
+        iov[1].iov_len = length;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        sent = sendmsg(client->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        REACTOR_COUNT(reactor, sendCalls, 1);
+
+        if (sent < 0)
+        {
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                FlightRecord(&client->flight, FR_ERROR, errno, now);
+                fprintf(stderr, "Error echoing message to socket %d ",
+                    client->fd);
+                perror("");
+                return;
+            }
+
+            FlightRecord(&client->flight, FR_EAGAIN, 0, now);
+            TOP_ADD(reactor, TOP_EAGAIN, client, 1);
+            sent = 0;
+        }
+        else
+        {
+            FlightRecord(&client->flight, FR_SEND, sent, now);
+            REACTOR_COUNT(reactor, bytesOut, sent);
+            client->activity += sent;
+
+            if ((size_t)sent == (headerLength + length))
+            {
+                return;
+            }
+        }
+    }
+
+    /* the lane queue needs the header and payload together */
+    size = BufPoolClassSize(headerLength + length);
+    frame = (char *)BufPoolGet(size);
+
+    if (NULL == frame)
+    {
+        perror("Error allocating WebSocket frame");
+        return;
+    }
+
+    memcpy(frame, header, headerLength);
+    memcpy(frame + headerLength, message, length);
+    LaneQueue(client, reactor, lane, frame, headerLength + length, sent,
+        now);
+    BufPoolPut(frame, size);
+}
+
+
+/***************************************************************************
+*   Function   : WsControl
+*   Description: This routine sends a control frame (a pong or a close)
+*                to a WebSocket client ahead of any queued bulk frames.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                opcode - WS_OP_PONG or WS_OP_CLOSE.
+*                payload - the frame's payload (at most 125 bytes).
+*                length - the length of the payload.
+*                now - the current time (ns).
+*   Effects    : The frame is sent or queued.
+*   Returned   : None
+***************************************************************************/
+void WsControl(fd_list_t *client, reactor_t *reactor, int opcode,
+    const char *payload, size_t length, long long now)
+{
+    unsigned char header[WS_MAX_HEADER];
+    size_t headerLength;
+
+    headerLength = WsEncodeHeader(header, opcode, length);
+    WsSendTo(client, reactor, LANE_URGENT, header, headerLength, payload,
+        length, now);
+}
+
+
+/***************************************************************************
+*   Function   : WsClose
+*   Description: This routine starts closing a WebSocket connection with
+*                a close frame giving the reason.
+*   Parameters : client - the client's list node.
+*                reactor - the server's reactor.
+*                code - the close status code (WS_CLOSE_).
+*                now - the current time (ns).
+*   Effects    : A close frame is sent or queued.
+*   Returned   : None
+***************************************************************************/
+void WsClose(fd_list_t *client, reactor_t *reactor, int code, long long now)
+{
+    char status[2];
+
+    status[0] = (char)((code >> 8) & 0xFF);
+    status[1] = (char)(code & 0xFF);
+    WsControl(client, reactor, WS_OP_CLOSE, status, sizeof(status), now);
+}
+
+
+/***************************************************************************
+*   Function   : PrintWebSocket
+*   Description: This routine writes the WebSocket gateway totals.
+*                headers_encoded below frames_out shows frame headers
+*                shared by the subscribers of a broadcast.
+*   Parameters : stream - where to write them.
+*   Effects    : A "websocket:" line is written if the gateway is enabled.
+*   Returned   : None
+***************************************************************************/
+void PrintWebSocket(FILE *stream)
+{
+    if (!useWebSockets)
+    {
+        return;
+    }
+
+    fprintf(stream, "websocket: open=%lu upgrades=%lu refused=%lu "
+        "frames_in=%lu frames_out=%lu headers_encoded=%lu pings=%lu "
+        "closes=%lu\n",
+        websocket.open, websocket.upgrades, websocket.refused,
+        websocket.framesIn, websocket.framesOut, websocket.headers,
+        websocket.pings, websocket.closes);
+}
+
+
+/***************************************************************************
+*   Function   : PrintFilters
+*   Description: This routine writes the subscriber filter totals.
+*                matches over frames is the average number of filtered
+*                clients each frame was sent to.
+*   Parameters : list - a pointer to a list of fds for all connected sockets.
+*                stream - where to write them.
+*   Effects    : A "filters:" line is written if any filter command was
+*                received.
+*   Returned   : None
+***************************************************************************/
+void PrintFilters(const fd_list_t *list, FILE *stream)
+{
+    unsigned long clients;
+
+    if (0 == (filtering.commands + filtering.refused))
+    {
+        return;
+    }
+
+    for (clients = 0; list != NULL; list = list->next)
+    {
+        clients += (list->filters > 0);
+    }
+
+    fprintf(stream, "filters: filters=%u clients=%lu frames=%lu "
+        "matches=%lu commands=%lu refused=%lu\n",
+        filtering.index.count, clients, filtering.frame, filtering.matches,
+        filtering.commands, filtering.refused);
+}
+
+
+/***************************************************************************
+*   Function   : PeerKey
+*   Description: This routine makes a connection's key for the top-K
+*                sketches from its peer's IPv4 address and port.  Unlike
+*                the fd, it isn't reused by the next connection, and it
+*                stays the same when the connection migrates to another
+*                worker, so the master's merged sketches add its counts
+*                from both workers together.
+*   Parameters : fd - the connection.
+*   Effects    : None
+*   Returned   : The address in bits 16 to 47 and the port in bits 0 to
+*                15, or 0 if the peer isn't known.
+***************************************************************************/
+unsigned long long PeerKey(int fd)
+{
+    struct sockaddr_in addr;
+    socklen_t length;
+
+    length = sizeof(addr);
+
+    if ((getpeername(fd, (struct sockaddr *)&addr, &length) != 0) ||
+        (AF_INET != addr.sin_family))
+    {
+        return 0;
+    }
+
+    return ((unsigned long long)ntohl(addr.sin_addr.s_addr) << 16) |
+        ntohs(addr.sin_port);
+}
+
+
+/***************************************************************************
+*   Function   : PrintTop
+*   Description: This routine writes the heaviest connections of each
+*                top-K sketch, a "top_lag:" line for the bytes left
+*                unsent at each TCP_INFO sweep, "top_eagain:" for sends
+*                the connection was too busy for and "top_ingress:" for
+*                bytes received.  Each line starts with the sketch's total
+*                and lists address:port=count~error, heaviest first, where
+*                the count may be too high by the error but never too
+*                low.  The master of pre-forked workers merges the
+*                workers' latest copies, including those of retired
+*                workers.  Sketches that are still empty aren't written.
+*   Parameters : stream - where to write them.
+*   Effects    : The lines are written to stream.
+*   Returned   : None
+***************************************************************************/
+void PrintTop(FILE *stream)
+{
+    static const char *names[TOP_COUNT] = {"lag", "eagain", "ingress"};
+    topk_t merged[TOP_COUNT];
+    topk_entry_t entries[TOPK_SIZE];
+    unsigned long long key;
+    unsigned int i, j, count;
+
+    if ((NULL != workers) && (workerIndex < 0))
+    {
+        memcpy(merged, retired.top, sizeof(merged));
+
+        for (i = 0; i < numWorkers; i++)
+        {
+            for (j = 0; j < TOP_COUNT; j++)
+            {
+                TopKMerge(&merged[j], &(workers[i].top[j]));
+            }
+        }
+    }
+    else
+    {
+        memcpy(merged, top, sizeof(merged));
+    }
+
+    for (i = 0; i < TOP_COUNT; i++)
+    {
+        if (0 == merged[i].total)
+        {
+            continue;
+        }
+
+        fprintf(stream, "top_%s: total=%llu", names[i], merged[i].total);
+        count = TopKSorted(&merged[i], entries);
+
+        for (j = 0; j < count; j++)
+        {
+            key = entries[j].key;
+            fprintf(stream, " %u.%u.%u.%u:%u=%llu~%llu",
+                (unsigned int)(key >> 40) & 0xFF,
+                (unsigned int)(key >> 32) & 0xFF,
+                (unsigned int)(key >> 24) & 0xFF,
+                (unsigned int)(key >> 16) & 0xFF,
+                (unsigned int)key & 0xFFFF, entries[j].count,
+                entries[j].error);
+        }
+
+        fputc('\n', stream);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : EchoCoroutine
+*   Description: This is the coroutine body used instead of DoEcho with -C.
+*                It awaits each frame from its client (see CoroReadFrame
+*                for the framing), sends it to every other client the same
+*                way DoEcho does, and then awaits writing all of it back
+*                to the sender.  A sender that stops reading its echoes is
+*                paused rather than losing them.  A frame of filter
+*                commands is carried out instead (see TakeCommands).
+*   Parameters : co - the coroutine, its data is the client's list node.
+*   Effects    : Frames from the client are echoed to all client sockets.
+*   Returned   : CORO_WAITING while suspended, CORO_DONE when the client
+*                disconnects or CORO_FAILED when a receive or send fails.
+***************************************************************************/
+int EchoCoroutine(coro_t *co)
+{
+    CORO_BEGIN(co);
+
+    for (;;)
+    {
+        CORO_READ_FRAME(co);
+
+        if (CORO_CLOSED == co->result)
+        {
+            CORO_RETURN(co, CORO_DONE);
+        }
+        else if (CORO_READY != co->result)
+        {
+            CORO_RETURN(co, CORO_FAILED);
+        }
+
+        if (REACTOR_LOG_ON(co->reactor))
+        {
+            printf("Socket %d received %.*s", co->fd, (int)co->frameLen,
+                co->frame);
+        }
+
+        TOP_ADD(co->reactor, TOP_INGRESS, (fd_list_t *)co->data,
+            co->frameLen);
+
+        if (TakeCommands((fd_list_t *)co->data, co->frame, co->frameLen) ==
+            co->frameLen)
+        {
+            continue;   /* only filter commands, nothing to echo */
+        }
+
+        Broadcast(fdList, co->reactor, co->frame, co->frameLen,
+            (fd_list_t *)co->data, co->now);
+        CORO_WRITE(co, co->frame, co->frameLen);
+
+        if (CORO_READY != co->result)
+        {
+            CORO_RETURN(co, CORO_FAILED);
+        }
+    }
+
+    CORO_END(co);
+}
+
+
+/***************************************************************************
+*   Function   : EchoExit
+*   Description: This is the coroutine exit callback.  It closes the
+*                client's connection the way ClientReady does for DoEcho.
+*   Parameters : co - the finished coroutine.
+*                status - CORO_DONE or CORO_FAILED.
+*   Effects    : The connection is closed and removed from the list of
+*                fds, which also frees the coroutine.
+*   Returned   : None
+***************************************************************************/
+void EchoExit(coro_t *co, int status)
+{
+    int fd;
+
+    fd = co->fd;
+
+    if (CORO_FAILED == status)
+    {
+        /* keep the failed connection's history */
+        DumpFlight(fdList, fd, stderr);
+    }
+    else if (REACTOR_LOG_ON(co->reactor))
+    {
+        printf("Socket %d disconnected.\n", fd);
+    }
+
+    close(fd);
+    RemoveFd(fd, &fdList);
+}
+
+
+/***************************************************************************
+*   Function   : AcceptReady
+*   Description: This is the reactor callback for the listening socket.  It
+*                accepts a connection request and adopts the new
+*                connection (see AdoptClient).
+*   Parameters : reactor - the server's reactor.
+*                fd - the listening socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : A connection is accepted and added to the list of fds.
+*   Returned   : None
+***************************************************************************/
+void AcceptReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    int acceptedFd;     /* fd for accepted connection */
+
+    (void)events;
+    (void)data;
+
+    /* accept the connection; we don't care about the address */
+    acceptedFd = accept(fd, NULL, NULL);
+
+    if (acceptedFd < 0)
+    {
+        /* accept failed.  keep processing */
+        perror("Error accepting connections");
+        return;
+    }
+
+    CountFastOpen(acceptedFd);
+    AdoptClient(reactor, acceptedFd);
+}
+
+
+/***************************************************************************
+*   Function   : AdoptClient
+*   Description: This routine starts serving a connection, whether it was
+*                just accepted or handed over by the master (-A).  The
+*                connection is registered with the reactor, or with -C a
+*                coroutine is started for it.  With priority lanes, the
+*                kernel is only allowed LANE_NOTSENT_LOWAT unsent bytes, so
+*                a bulk backlog stays in the lane queues where urgent
+*                frames can pass it.
+*   Parameters : reactor - the server's reactor.
+*                acceptedFd - the connection.
+*   Effects    : The connection is added to the list of fds, or closed if
+*                that fails.
+*   Returned   : The connection's list node, or NULL if it was closed.
+***************************************************************************/
+fd_list_t *AdoptClient(reactor_t *reactor, int acceptedFd)
+{
+    fd_list_t *client;
+
+    if (REACTOR_LOG_ON(reactor))
+    {
+        printf("New connection on socket %d.\n", acceptedFd);
+    }
+
+    client = InsertFd(acceptedFd, &fdList);
+
+    if (NULL == client)
+    {
+        close(acceptedFd);
+        return NULL;
+    }
+
+    client->peer = PeerKey(acceptedFd);
+
+    if (lanes.enabled)
+    {
+        int lowat = TUNABLES()->notsentLowat;
+
+        setsockopt(acceptedFd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat,
+            sizeof(lowat));
+    }
+
+    if (useCoroutines)
+    {
+        client->co = CoroNew(reactor, acceptedFd, EchoCoroutine, EchoExit,
+            client);
+
+        if (NULL != client->co)
+        {
+            client->co->flight = &(client->flight);
+            return client;
+        }
+    }
+    else if (ReactorAdd(reactor, acceptedFd, REACTOR_READ, ClientReady,
+        client) == 0)
+    {
+        return client;
+    }
+
+    RemoveFd(acceptedFd, &fdList);
+    close(acceptedFd);
+    return NULL;
+}
+
+
+/***************************************************************************
+*   Function   : PlaceReady
+*   Description: This is the master's reactor callback for the listening
+*                socket with -A.  It accepts a connection request and
+*                hands the connection to the least loaded worker.
+*   Parameters : reactor - the master's reactor (unused).
+*                fd - the listening socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : A connection is accepted and passed to a worker, or
+*                closed if none will take it.
+*   Returned   : None
+***************************************************************************/
+void PlaceReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    handoff_msg_t msg;
+    int acceptedFd;
+
+    (void)reactor;
+    (void)events;
+    (void)data;
+
+    acceptedFd = accept(fd, NULL, NULL);
+
+    if (acceptedFd < 0)
+    {
+        perror("Error accepting connections");
+        return;
+    }
+
+    CountFastOpen(acceptedFd);
+    memset(&msg, 0, sizeof(msg));
+    msg.type = HANDOFF_NEW;
+
+    if (PassClient(acceptedFd, &msg, sizeof(msg), -1) < 0)
+    {
+        balance.refused++;
+    }
+    else
+    {
+        balance.placed++;
+    }
+
+    close(acceptedFd);
+}
+
+
+/***************************************************************************
+*   Function   : HandoffReady
+*   Description: This is the master's reactor callback for its end of a
+*                worker's handoff socket (-A).  A connection the worker
+*                migrated is passed on, state and all, to the least loaded
+*                of the other workers, or back to it if none will take it.
+*                When the worker exits the socket is closed.
+*   Parameters : reactor - the master's reactor.
+*                fd - the handoff socket.
+*                events - unused.
+*                data - the worker's entry in the worker table.
+*   Effects    : Migrating connections are passed on.
+*   Returned   : None
+***************************************************************************/
+void HandoffReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    ssize_t length;
+    int index, passedFd, target;
+
+    (void)events;
+
+    index = (worker_t *)data - workers;
+
+    while ((length = HandoffReceive(fd, &passedFd, balance.buffer,
+        HANDOFF_MAX)) > 0)
+    {
+        if (passedFd < 0)
+        {
+            continue;
+        }
+
+        target = PassClient(passedFd, balance.buffer, length, index);
+
+        if (target < 0)
+        {
+            target = PassClient(passedFd, balance.buffer, length, -1);
+        }
+
+        if (target < 0)
+        {
+            balance.refused++;
+        }
+        else if (target != index)
+        {
+            balance.migrated++;
+        }
+
+        close(passedFd);
+    }
+
+    if ((0 == length) || ((EAGAIN != errno) && (EMSGSIZE != errno)))
+    {
+        /* the worker has exited */
+        ReactorRemove(reactor, fd);
+        close(fd);
+        balance.handoff[index] = -1;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : AdoptReady
+*   Description: This is a worker's reactor callback for its handoff
+*                socket (-A).  New connections from the master are adopted
+*                as if they'd been accepted, migrating ones also get back
+*                the state they had (see RestoreClient), and a request to
+*                migrate a connection away is carried out (see
+*                ShedClient).
+*   Parameters : reactor - the worker's reactor.
+*                fd - the handoff socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : Connections are added to or removed from the list of fds.
+*   Returned   : None
+***************************************************************************/
+void AdoptReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    handoff_msg_t msg;
+    fd_list_t *client;
+    char *buffer;
+    ssize_t length;
+    int passedFd, closed;
+
+    (void)events;
+    (void)data;
+
+    buffer = (char *)BufPoolGet(HANDOFF_MAX);
+
+    if (NULL == buffer)
+    {
+        perror("Error allocating handoff buffer");
+        return;
+    }
+
+    while ((length = HandoffReceive(fd, &passedFd, buffer,
+        HANDOFF_MAX)) > 0)
+    {
+        if ((size_t)length < sizeof(msg))
+        {
+            msg.type = -1;      /* not one of ours */
+        }
+        else
+        {
+            memcpy(&msg, buffer, sizeof(msg));
+        }
+
+        if (HANDOFF_SHED == msg.type)
+        {
+            ShedClient(reactor, msg.limit);
+        }
+
+        if (passedFd < 0)
+        {
+            continue;
+        }
+
+        if ((HANDOFF_NEW != msg.type) && (HANDOFF_MOVE != msg.type))
+        {
+            close(passedFd);
+            continue;
+        }
+
+        client = AdoptClient(reactor, passedFd);
+
+        if ((NULL != client) && (HANDOFF_MOVE == msg.type))
+        {
+            RestoreClient(client, reactor, buffer + sizeof(msg),
+                length - sizeof(msg));
+        }
+    }
+
+    closed = (0 == length) || ((EAGAIN != errno) && (EMSGSIZE != errno));
+    BufPoolPut(buffer, HANDOFF_MAX);
+
+    if (closed)
+    {
+        /* the master has exited, keep serving what we have */
+        ReactorRemove(reactor, fd);
+        close(fd);
+        handoffFd = -1;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ClientReady
+*   Description: This is the reactor callback for a connected client.  It
+*                sends queued frames when the socket is writable (only
+*                requested with priority lanes), calls DoEcho when it's
+*                readable, and drops the connection when it closes or
+*                fails.
+*   Parameters : reactor - the server's reactor.
+*                fd - the client's socket.
+*                events - REACTOR_WRITE and/or REACTOR_READ or
+*                REACTOR_ERROR, DoEcho handles readable and failed sockets
+*                the same way.
+*                data - the client's list node.
+*   Effects    : Queued frames are sent and the client's message is
+*                echoed, or the connection is closed and removed from the
+*                list of fds.
+*   Returned   : None
+***************************************************************************/
+void ClientReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    fd_list_t *client;
+    int result;
+
+    client = (fd_list_t *)data;
+    result = 1;
+
+    if (events & REACTOR_WRITE)
+    {
+        result = (DrainLanes(client, reactor, LoopMonNow()) == 0) ? 1 : -1;
+        LaneWatch(client, reactor);
+    }
+
+    if ((result > 0) && (events & (REACTOR_READ | REACTOR_ERROR)))
+    {
+        result = DoEcho(client, fdList, reactor);
+    }
+
+    if (result <= 0)
+    {
+        if (result < 0)
+        {
+            /* keep the failed connection's history */
+            DumpFlight(fdList, fd, stderr);
+        }
+
+        /* socket closed normally or failed */
+        ReactorRemove(reactor, fd);
+        close(fd);
+        RemoveFd(fd, &fdList);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ControlReady
+*   Description: This is the reactor callback for the control socket.
+*   Parameters : reactor - the server's reactor.
+*                fd - the listening control socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : The control command is carried out.
+*   Returned   : None
+***************************************************************************/
+void ControlReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    (void)events;
+    (void)data;
+
+    HandleControl(fd, reactor, fdList);
+}
+
+
+/***************************************************************************
+*   Function   : SignalReceived
+*   Description: This is the reactor callback for signals.  SIGUSR1 dumps
+*                every connection's flight recorder; ctrl-c and ctrl-\ stop
+*                the reactor.  The master of pre-forked workers passes
+*                SIGUSR1 on to them and handles SIGCHLD (see ReapWorkers).
+*   Parameters : reactor - the server's reactor.
+*                signo - the signal that was delivered.
+*                data - unused.
+*   Effects    : Flight recorders are written to stderr, or the reactor is
+*                stopped.
+*   Returned   : None
+***************************************************************************/
+void SignalReceived(reactor_t *reactor, int signo, void *data)
+{
+    unsigned int i;
+
+    (void)data;
+
+    if (SIGCHLD == signo)
+    {
+        /* the master collects (and replaces) workers that exit */
+        ReapWorkers(reactor);
+    }
+    else if ((SIGUSR1 == signo) && (NULL != workers) && (workerIndex < 0))
+    {
+        /* the master passes it on to the workers */
+        for (i = 0; i < numWorkers; i++)
+        {
+            if (workers[i].pid > 0)
+            {
+                kill(workers[i].pid, SIGUSR1);
+            }
+        }
+    }
+    else if (SIGUSR1 == signo)
+    {
+        /* dump everyone's flight recorder */
+        DumpFlight(fdList, -1, stderr);
+    }
+    else
+    {
+        /* SIGINT or SIGQUIT get out of here */
+        ReactorStop(reactor, 0);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : TunablesChanged
+*   Description: This is the reactor callback for a new version of the
+*                tunables.  Most are read where they're used; this applies
+*                the ones that are kept elsewhere: logging, the stall
+*                threshold, the listen backlog and Fast Open queue, the
+*                timer slack for coalescing, and TCP_NOTSENT_LOWAT on
+*                every connection.
+*   Parameters : reactor - the server's reactor.
+*                data - a pointer to the listening socket.
+*   Effects    : The new settings are applied.
+*   Returned   : None
+***************************************************************************/
+void TunablesChanged(reactor_t *reactor, void *data)
+{
+    const tunables_t *tunables;
+    fd_list_t *here;
+    int lowat;
+
+    tunables = TUNABLES();
+    reactor->logOn = (int)tunables->log;
+    reactor->monitor.thresholdNs = tunables->stallUs * 1000LL;
+
+    /* listen again to change the backlog of a listening socket */
+    if (*(int *)data >= 0)
+    {
+        listen(*(int *)data, tunables->backlog);
+        SetFastOpen(*(int *)data);
+    }
+
+    if (tunables->coalesceWindowUs > 0)
+    {
+        /* the default 50us of timer slack is a lot of a short window */
+        prctl(PR_SET_TIMERSLACK, 1000UL);
+    }
+
+    if (lanes.enabled)
+    {
+        lowat = tunables->notsentLowat;
+
+        for (here = fdList; here != NULL; here = here->next)
+        {
+            setsockopt(here->fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat,
+                sizeof(lowat));
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SweepTimer
+*   Description: This is the reactor timer callback for TCP_INFO sweeps.
+*                It samples the next batch of connections, then restarts
+*                itself immediately if the sweep isn't complete, or for
+*                the next sweep if it is.
+*   Parameters : reactor - the server's reactor.
+*                data - unused.
+*   Effects    : Up to tcpinfo_batch connections are sampled.
+*   Returned   : None
+***************************************************************************/
+void SweepTimer(reactor_t *reactor, void *data)
+{
+    sweepIndex = SampleTcpInfo(fdList, sweepIndex, LoopMonNow());
+
+    /* don't sleep through the next batch or sweep */
+    ReactorTimer(reactor, (0 == sweepIndex) ? TCPINFO_INTERVAL_MS : 0,
+        SweepTimer, data);
+}
+
+
+/***************************************************************************
+*   Function   : FlushTimer
+*   Description: This is the reactor timer callback that ends a coalescing
+*                window.
+*   Parameters : reactor - the server's reactor.
+*                data - unused.
+*   Effects    : The batch held for every client is sent.
+*   Returned   : None
 ***************************************************************************/
+void FlushTimer(reactor_t *reactor, void *data)
+{
+    (void)data;
+
+    coalesce.timer = -1;
+    FlushOutput(fdList, reactor, LoopMonNow());
+}
+
 
 /***************************************************************************
-*   Function   : main
-*   Description: This is the main function for this program, it opens a TCP
-*                socket on the port specified in argv[1].  It accepts all
-*                connections and maintains connections to the specified
-*                port.  If the connected socket may be read, DoEcho is
-*                called to handle receiving and echoing data.
-*   Parameters : argc - number of parameters
-*                argv - parameter list (argv[1] is port number)
-*   Effects    : A socket is open and accepts connections on the specified
-*                port.  Readable connections are passed to DoEcho
-*   Returned   : This function should never return
-*
-*   TODO: Add signalfd to handle ctrl-c and exit cleanly.
+*   Function   : SampleTcpInfo
+*   Description: This routine samples TCP_INFO for the next batch of
+*                connections in a sweep.  When the sweep reaches the last
+*                connection, the distribution of the sweep replaces the
+*                one being reported.  Each sampled connection's unsent
+*                bytes, in the kernel and queued by the server, are added
+*                to its count in the send lag sketch, so a consumer that
+*                stays behind sweep after sweep rises to the top.  A
+*                worker's sketches are copied to the worker table at the
+*                end of each sweep.
+*   Parameters : list - a pointer to a list of fds for all connected
+*                sockets.
+*                index - position in the list of the first connection to
+*                sample.
+*                now - time of the samples (ns).
+*   Effects    : Up to tcpinfo_batch connections are sampled.
+*   Returned   : The index to continue the sweep from, or 0 when the
+*                sweep is complete.
 ***************************************************************************/
-int main(int argc, char *argv[])
+int SampleTcpInfo(const fd_list_t *list, int index, long long now)
 {
-    int result;
-    int listenFd;   /* socket fd used to listen for connection requests */
-
-    struct fd_list_t *fdList, *thisFd;
-    struct pollfd *pfds;
-    int numFds, changed;
+    fd_list_t *here;
+    unsigned long long lag;
+    int i, batch;
 
-    /* structures for server and client internet addresses */
-    struct sockaddr_in serverAddr;
+    batch = TUNABLES()->tcpinfoBatch;
 
-    int i;
+    /* connections may have closed since the last batch, so count again */
+    here = (fd_list_t *)list;
 
-    /* argv[1] is port number, make sure it's passed to us */
-    if (argc != 2)
+    for (i = 0; (i < index) && (NULL != here); i++)
     {
-        fprintf(stderr, "Usage:  %s <port number>\n", argv[0]);
-        exit(EXIT_FAILURE);
+        here = here->next;
     }
 
-    fdList = NULL;
-
-    /* create server socket descriptor */
-    listenFd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-    if (listenFd < 0)
+    for (i = 0; (i < batch) && (NULL != here); i++)
     {
-        perror("Error creating socket");
-        exit(EXIT_FAILURE);
-    }
-
-    memset(&serverAddr, 0, sizeof(serverAddr));     /* clear data structure */
+        if (TcpInfoSample(here->fd, &(here->tcpInfo), now) == 0)
+        {
+            TcpInfoAdd(&sweepDist, &(here->tcpInfo));
+            lag = here->tcpInfo.value[TI_NOTSENT] + here->outLen +
+                here->lanes[LANE_URGENT].bytes + here->lanes[LANE_BULK].bytes;
 
-    /* allow internet connection from any address on port argv[1] */
-    serverAddr.sin_family = AF_INET;                /* internet address family */
-    serverAddr.sin_addr.s_addr = htonl(INADDR_ANY); /* any incoming address */
-    serverAddr.sin_port = htons(atoi(argv[1]));     /* port number */
+            if (lag > 0)
+            {
+                TopKAdd(&top[TOP_LAG], here->peer, lag);
+            }
+        }
 
-    /* bind to the local address */
-    result = bind(listenFd, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
+        here = here->next;
+    }
 
-    if (result < 0)
+    if (NULL != here)
     {
-        /* bind failed */
-        perror("Error binding socket");
-        close(listenFd);
-        exit(EXIT_FAILURE);
+        return index + batch;
     }
 
-    /* listen for incoming connections */
-    result = listen(listenFd, MAX_BACKLOG);
+    /* sweep is done, report it and start fresh */
+    memcpy(&tcpDist, &sweepDist, sizeof(tcpinfo_dist_t));
+    memset(&sweepDist, 0, sizeof(tcpinfo_dist_t));
 
-    if (result < 0)
+    if (workerIndex >= 0)
     {
-        /* listen failed */
-        perror("Error listening for connections");
-        exit(EXIT_FAILURE);
+        /* let the master see this worker's worst connections */
+        memcpy(workers[workerIndex].top, top, sizeof(top));
     }
 
-    /* listenFd is our only fd when we start */
-    numFds = 1;
-    changed = 1;
-    pfds = NULL;
+    return 0;
+}
 
-    /* service all sockets as needed */
-    while (1)
-    {
-        int startingFds = numFds;
 
-        if (changed)
-        {
-            /* one or more fds changed.  we need to change the polling struct */
+/***************************************************************************
+*   Function   : RingReady
+*   Description: This is the reactor callback for a worker's eventfd on
+*                the shared broadcast ring, which another worker wrote
+*                after publishing while this one was parked.
+*   Parameters : reactor - the worker's reactor.
+*                fd - the eventfd (unused).
+*                events - unused.
+*                data - unused.
+*   Effects    : The messages waiting in the ring are broadcast.
+*   Returned   : None
+***************************************************************************/
+void RingReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    (void)fd;
+    (void)events;
+    (void)data;
 
-            if (NULL != pfds)
-            {
-                free(pfds);
-            }
+    RingqUnpark(&(ring->readers[workerIndex].wake));
+    DrainRing(reactor);
+}
 
-            pfds = (struct pollfd *)malloc(numFds * sizeof(struct pollfd));
 
-            if (NULL == pfds)
-            {
-                perror("Error allocating fds for poll");
-                break;
-            }
+/***************************************************************************
+*   Function   : BalanceTimer
+*   Description: This is the master's reactor timer callback for load
+*                samples (-A).  It works out the load of an average
+*                connection, which PassClient charges for each connection
+*                it places until the next sample, and at most once every
+*                migrate_ms asks the most loaded worker to migrate a
+*                connection when it has more than BALANCE_RATIO times the
+*                load of the least loaded one and at least migrate_gap
+*                more.  The most it's asked to move is half the gap.
+*   Parameters : reactor - the master's reactor.
+*                data - unused.
+*   Effects    : A migration may be asked for.
+*   Returned   : None
+***************************************************************************/
+void BalanceTimer(reactor_t *reactor, void *data)
+{
+    const tunables_t *tunables;
+    handoff_msg_t msg;
+    unsigned long total, clients, gap;
+    int i, hot, cold;
+    long long now;
 
-            /* listen fd goes in slot 0, just because */
-            pfds[0].fd = listenFd;
-            pfds[0].events = POLLIN;
+    total = clients = 0;
+    hot = cold = -1;
 
-            /* now poll for input from the rest of the sockets */
-            thisFd = fdList;
-            for(i = 1; i < numFds; i++)
-            {
-                pfds[i].fd = thisFd->fd;
-                pfds[i].events = POLLIN;
-                thisFd = thisFd->next;
-            }
+    for (i = 0; i < (int)numWorkers; i++)
+    {
+        balance.pending[i] = 0;
 
-            changed = 0;
+        if (balance.handoff[i] < 0)
+        {
+            continue;
         }
 
-        /* block on poll until something needs servicing */
-        if (-1 ==  poll(pfds, numFds, -1))
+        total += workers[i].load;
+        clients += workers[i].clients;
+
+        if ((hot < 0) || (workers[i].load > workers[hot].load))
         {
-            perror("Error poll failed");
-            exit(EXIT_FAILURE);
+            hot = i;
         }
 
-        /* one or more fds need servicing */
-        if (pfds[0].revents & POLLIN)
+        if ((cold < 0) || (workers[i].load < workers[cold].load))
         {
-            /* listening socket we got a new connection request */
-            int acceptedFd;     /* fd for accepted connection */
+            cold = i;
+        }
+    }
 
-            /* accept the connection; we don't care about the address */
-            acceptedFd = accept(listenFd, NULL, NULL);
+    balance.perClient = (clients > 0) ? (total / clients) : 0;
+    tunables = TUNABLES();
+    now = LoopMonNow();
 
-            if (acceptedFd < 0)
-            {
-                /* accept failed.  keep processing */
-                perror("Error accepting connections");
-            }
-            else
-            {
-                printf("New connection on socket %d.\n", acceptedFd);
-                InsertFd(acceptedFd, &fdList);
-                numFds++;
-                changed = 1;
-            }
-        }
+    if ((hot != cold) && (tunables->migrateMs > 0) &&
+        ((now - balance.lastShed) >= (tunables->migrateMs * 1000000LL)))
+    {
+        gap = workers[hot].load - workers[cold].load;
 
-        for(i = 1; i < startingFds; i++)
+        if ((workers[hot].load > (BALANCE_RATIO * workers[cold].load)) &&
+            (gap >= (unsigned long)tunables->migrateGap))
         {
-            /* one or more clients needs servicing */
-            if (pfds[i].revents & POLLIN)
-            {
-                /* service this client */
-                result = DoEcho(pfds[i].fd, fdList);
+            memset(&msg, 0, sizeof(msg));
+            msg.type = HANDOFF_SHED;
+            msg.limit = gap / 2;
 
-                if (result <= 0)
-                {
-                    /* socket closed normally or failed */
-                    close(pfds[i].fd);
-                    RemoveFd(pfds[i].fd, &fdList);
-                    numFds--;
-                    changed = 1;
-                }
+            if (HandoffSend(balance.handoff[hot], -1, &msg,
+                sizeof(msg)) == 0)
+            {
+                balance.sheds++;
+                balance.lastShed = now;
             }
         }
     }
 
-    close(listenFd);
-    return EXIT_SUCCESS;    /* we should not get here */
+    ReactorTimer(reactor, BALANCE_INTERVAL_MS, BalanceTimer, data);
 }
 
 
 /***************************************************************************
-*   Function   : DoEcho
-*   Description: This routine receives from a client's socket and then
-*                writes the received message back to each connected client
-*                socket.  The write is non-blocking, so clients with busy
-*                sockets will not receive the message.
-*   Parameters : clientFd - The socket descriptor for the socket to be read
-*                from.
-*                list - a pointer to a list of fds for all connected sockets.
-*   Effects    : clientFd is read from.  If the read succeeds, the value
-*                that was read is sent to all client sockets.  The send will
-*                only succeed if the socket may be written to without
-*                blocking.
-*   Returned   : 0 for normal disconnect of clientFd, < 0 for failure,
-*                a positive value will be returned.
+*   Function   : LoadTimer
+*   Description: This is a worker's reactor timer callback for load
+*                samples (-A).  It publishes the worker's connection count
+*                and load (see ClientLoad) to the worker table for the
+*                master, then halves every connection's activity, so it
+*                reflects recent traffic rather than all traffic.
+*   Parameters : reactor - the worker's reactor.
+*                data - unused.
+*   Effects    : The worker's load is updated.
+*   Returned   : None
 ***************************************************************************/
-int DoEcho(const int clientFd, const fd_list_t *list)
+void LoadTimer(reactor_t *reactor, void *data)
 {
-    int result;
-    char buffer[BUF_SIZE + 1];  /* stores received message */
+    fd_list_t *here;
+    unsigned long clients, load;
 
-    (void)list;
-    result = recv(clientFd, buffer, BUF_SIZE, 0);
+    clients = load = 0;
 
-    if (result < 0)
+    for (here = fdList; here != NULL; here = here->next)
     {
-        /* receive failed */
-        perror("Error receiving message from client");
+        load += ClientLoad(here);
+        clients++;
+        here->activity /= 2;
     }
-    else if (0 == result)
+
+    workers[workerIndex].clients = clients;
+    workers[workerIndex].load = load;
+    ReactorTimer(reactor, BALANCE_INTERVAL_MS, LoadTimer, data);
+}
+
+
+/***************************************************************************
+*   Function   : HandleControl
+*   Description: This routine accepts a connection on the control socket
+*                and carries out its command.  The commands are:
+*                stats - write the policies, stats, loop monitor, TCP_INFO,
+*                coalescing and top-K summaries
+*                dump - write the flight recorder of every connection
+*                dump <fd> - write the flight recorder for socket fd
+*                tcpinfo - write every connection's TCP_INFO sample
+*                tcpinfo <fd> - write socket fd's TCP_INFO sample
+*                get - write the tunables
+*                set <name>=<value> ... - change tunables (see SetTunables)
+*                The master of pre-forked workers has no connections, and
+*                its stats are the workers' totals (see PrintWorkers).
+*   Parameters : controlFd - the listening control socket.
+*                reactor - the server's reactor.
+*                list - a pointer to a list of fds for all connected
+*                sockets.
+*   Effects    : The reply is written to the control connection.
+*   Returned   : None
+***************************************************************************/
+void HandleControl(const int controlFd, const reactor_t *reactor,
+    const fd_list_t *list)
+{
+    char command[CONTROL_CMD_SIZE];
+    FILE *reply;
+    int fd;
+
+    reply = ControlAccept(controlFd, command, sizeof(command));
+
+    if (NULL == reply)
     {
-        printf("Socket %d disconnected.\n", clientFd);
+        return;
     }
-    else
+
+    if ((strcmp(command, "stats") == 0) && (NULL != workers))
+    {
+        /* the master of pre-forked workers only has their totals */
+        ReactorPrintPolicies(reactor, reply);
+        PrintWorkers(reactor, reply);
+    }
+    else if (strcmp(command, "stats") == 0)
     {
-        const fd_list_t *here;
+        ReactorPrintPolicies(reactor, reply);
+        ReactorPrintStats(reactor, reply);
 
-        buffer[result] = '\0';
-        printf("Socket %d received %s", clientFd, buffer);
+        if (REACTOR_STATS_ON(reactor))
+        {
+            LoopMonPrint(&(reactor->monitor), reply);
+        }
 
-        /*******************************************************************
-        * echo the buffer to all connected sockets, skip if waiting
-        * is required.  Use threads or a complex polling loop if it's
-        * important that every socket receive the echo.
-        *******************************************************************/
-        here = list;
+        TcpInfoPrintDist(&tcpDist, reply);
+        PrintCoalesce(reply);
+        PrintLanes(reply);
+        PrintWebSocket(reply);
+        PrintFilters(list, reply);
+        PrintFastOpen(reply);
+        PrintTop(reply);
+    }
+    else if (strcmp(command, "get") == 0)
+    {
+        ControlPrintTunables(tunableTable, TUNABLES(), reply);
+    }
+    else if (strncmp(command, "set ", 4) == 0)
+    {
+        SetTunables(command + 4, reply);
 
-        while (here != NULL)
+        if (balance.listenFd >= 0)
         {
-            result = send(here->fd, buffer, result, MSG_DONTWAIT);
+            /* the acceptor's loop doesn't read the tunables */
+            listen(balance.listenFd, TUNABLES()->backlog);
+            SetFastOpen(balance.listenFd);
+        }
+    }
+    else if (strcmp(command, "dump") == 0)
+    {
+        DumpFlight(list, -1, reply);
+    }
+    else if (sscanf(command, "dump %d", &fd) == 1)
+    {
+        DumpFlight(list, fd, reply);
+    }
+    else if (strcmp(command, "tcpinfo") == 0)
+    {
+        TcpInfoPrintDist(&tcpDist, reply);
+        DumpTcpInfo(list, -1, reply);
+    }
+    else if (sscanf(command, "tcpinfo %d", &fd) == 1)
+    {
+        DumpTcpInfo(list, fd, reply);
+    }
+    else
+    {
+        fprintf(reply, "error: unknown command '%s'\n", command);
+    }
 
-            if (result == -1)
-            {
-                if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
-                {
-                    fprintf(stderr, "Socket %d is busy\n", here->fd);
-                }
-                else
-                {
-                    /* send failed */
-                    fprintf(stderr, "Error echoing message to socket %d ",
-                        here->fd);
-                    perror("");
-                }
-            }
+    fclose(reply);
+}
+
+
+/***************************************************************************
+*   Function   : SetTunables
+*   Description: This routine carries out a set command.  The assignments
+*                are made to a copy of the current tunables, which is then
+*                published to every loop (and worker) through config.
+*                Loops pick the new version up at their next turn, and
+*                the hot paths never take a lock to read it.
+*   Parameters : assignments - the name=value list.
+*                reply - where to write the result.
+*   Effects    : A new version of the tunables is published.
+*   Returned   : None
+***************************************************************************/
+void SetTunables(const char *assignments, FILE *reply)
+{
+    tunables_t *copy;
+    unsigned long generation;
+
+    copy = (tunables_t *)RcuCopy(config);
+
+    if (NULL == copy)
+    {
+        /* every retired version may still be in use, very unlikely */
+        fprintf(reply, "error: busy, try again\n");
+        return;
+    }
+
+    if (ControlSetTunables(tunableTable, copy, assignments, reply) != 0)
+    {
+        return;     /* an unpublished copy is simply reused */
+    }
+
+    generation = RcuPublish(config, copy);
+    fprintf(reply, "ok: generation=%lu\n", generation);
+    ControlPrintTunables(tunableTable, copy, reply);
+}
 
-            here = here->next;
+
+/***************************************************************************
+*   Function   : DumpFlight
+*   Description: This routine writes the flight recorder for one or all
+*                connections.
+*   Parameters : list - a pointer to a list of fds for all connected
+*                sockets.
+*                fd - the socket to dump, or -1 for every socket.
+*                stream - where to write the flight recorders.
+*   Effects    : The flight recorders are written to stream.
+*   Returned   : None
+***************************************************************************/
+void DumpFlight(const fd_list_t *list, const int fd, FILE *stream)
+{
+    const fd_list_t *here;
+    int found;
+
+    found = 0;
+
+    for (here = list; here != NULL; here = here->next)
+    {
+        if ((-1 == fd) || (here->fd == fd))
+        {
+            fprintf(stream, "flight: fd=%d events=%u\n", here->fd,
+                here->flight.next);
+            FlightPrint(&here->flight, stream);
+            found = 1;
         }
+    }
 
-        result = 1;     /* any echoing is success for this function */
+    if (!found)
+    {
+        if (-1 == fd)
+        {
+            fprintf(stream, "no connections\n");
+        }
+        else
+        {
+            fprintf(stream, "error: no connection for fd %d\n", fd);
+        }
     }
+}
 
-    return result;
+
+/***************************************************************************
+*   Function   : DumpTcpInfo
+*   Description: This routine writes the most recent TCP_INFO sample for
+*                one or all connections, one line per connection.
+*   Parameters : list - a pointer to a list of fds for all connected
+*                sockets.
+*                fd - the socket to write, or -1 for every socket.
+*                stream - where to write the samples.
+*   Effects    : The samples are written to stream.
+*   Returned   : None
+***************************************************************************/
+void DumpTcpInfo(const fd_list_t *list, const int fd, FILE *stream)
+{
+    const fd_list_t *here;
+
+    for (here = list; here != NULL; here = here->next)
+    {
+        if ((-1 == fd) || (here->fd == fd))
+        {
+            fprintf(stream, "client: fd=%d", here->fd);
+            TcpInfoPrintSample(&here->tcpInfo, stream);
+            fprintf(stream, "\n");
+        }
+    }
 }
 
 
@@ -345,63 +4942,74 @@ int DoEcho(const int clientFd, const fd_list_t *list)
 *                list - a pointer to a list of fds for all connected
 *                sockets.
 *   Effects    : A node for the fd is added to the end of the list of fds.
-*   Returned   : 0 for success, otherwise errno for the failure.
+*   Returned   : A pointer to the new node, or NULL if the fd is already in
+*                the list or a node couldn't be allocated.
 *
 *   NOTE: If duplicates aren't an issue, it's faster to insert the new
 *         file descriptor to the head of the linked list.
 ***************************************************************************/
-int InsertFd(int fd, fd_list_t **list)
+fd_list_t *InsertFd(int fd, fd_list_t **list)
 {
-    fd_list_t *here;
+    fd_list_t *here, *node;
 
-    /* handle empty list */
-    if (NULL == *list)
-    {
-        *list = (fd_list_t *)malloc(sizeof(fd_list_t));
-
-        if (NULL == list)
-        {
-            perror("Error allocating fd_list_t");
-            return errno;
-        }
-
-        (*list)->fd = fd;
-        (*list)->next = NULL;
-        return 0;
-    }
-
-    /* find the end of the list */
+    /* find the end of the list making sure that fd isn't already here */
     here = *list;
-    while(here->next != NULL)
+
+    while (here != NULL)
     {
         if (here->fd == fd)
         {
             fprintf(stderr, "Tried to insert fd that already exists: %d\n", fd);
-            return EEXIST;  /* is there a better errno? */
+            return NULL;
+        }
+
+        if (NULL == here->next)
+        {
+            break;
         }
 
         here = here->next;
     }
 
-    /* we're at the end make sure that fd isn't already here */
-    if (here->fd == fd)
+    /* add new fd to list */
+    node = (fd_list_t *)malloc(sizeof(fd_list_t));
+
+    if (NULL == node)
     {
-        fprintf(stderr, "Tried to insert fd that already exists: %d\n", fd);
-        return EEXIST;  /* is there a better errno? */
+        perror("Error allocating fd_list_t");
+        return NULL;
     }
 
-    /* add new fd to list */
-    here->next = (fd_list_t *)malloc(sizeof(fd_list_t));
+    node->fd = fd;
+    RxEstimateInit(&(node->rxEstimate));
+    FlightInit(&(node->flight));
+    memset(&(node->tcpInfo), 0, sizeof(tcp_sample_t));
+    node->partial = NULL;
+    node->partialLen = 0;
+    node->partialSize = 0;
+    node->co = NULL;
+    node->out = NULL;
+    node->outLen = 0;
+    node->outSize = 0;
+    memset(node->lanes, 0, sizeof(node->lanes));
+    node->writeWait = 0;
+    node->ws = useWebSockets ? WS_PENDING : WS_RAW;
+    node->accepted = LoopMonNow();
+    node->filters = 0;
+    node->matched = 0;
+    FlightRecord(&(node->flight), FR_OPEN, fd, node->accepted);
+    node->next = NULL;
 
-    if (NULL == here->next)
+    if (NULL == here)
     {
-        perror("Error allocating fd_list_t");
-        return errno;
+        *list = node;       /* list was empty */
+    }
+    else
+    {
+        here->next = node;
     }
 
-    here->next->fd = fd;
-    here->next->next = NULL;
-    return 0;
+    return node;
 }
 
 
@@ -415,7 +5023,10 @@ int InsertFd(int fd, fd_list_t **list)
 *   Parameters : fd - The socket descriptor to be deleted from the list.
 *                list - a pointer to a list of fds for all connected
 *                sockets.
-*   Effects    : The node for the fd is removed from the list of fds.
+*   Effects    : The node for the fd is removed from the list of fds and
+*                any partial line, unsent batch or queued frames it holds
+*                are returned to the buffer pool.  Its coroutine and
+*                filters, if it has them, are freed.
 *   Returned   : 0 for success, otherwise ENOENT for the failure.
 ***************************************************************************/
 int RemoveFd(int fd, fd_list_t **list)
@@ -445,6 +5056,37 @@ int RemoveFd(int fd, fd_list_t **list)
                 prev->next = here->next;
             }
 
+            if (fanoutStart == here)
+            {
+                fanoutStart = here->next;
+            }
+
+            if (NULL != here->partial)
+            {
+                BufPoolPut(here->partial, here->partialSize);
+            }
+
+            if (NULL != here->co)
+            {
+                CoroFree(here->co);
+            }
+
+            if (NULL != here->out)
+            {
+                BufPoolPut(here->out, here->outSize);
+            }
+
+            if (WS_OPEN == here->ws)
+            {
+                websocket.open--;
+            }
+
+            if (here->filters > 0)
+            {
+                FilterRemove(&filtering.index, here);
+            }
+
+            FreeLanes(here);
             free(here);
             return 0;
         }
@@ -457,6 +5099,52 @@ int RemoveFd(int fd, fd_list_t **list)
 }
 
 
+/***************************************************************************
+*   Function   : FreeFdList
+*   Description: This routine frees every node in a linked list of file
+*                descriptors.  The file descriptors themselves are not
+*                closed.
+*   Parameters : list - a pointer to a list of fds for all connected
+*                sockets.
+*   Effects    : All nodes (and their partial lines, batches, lane queues,
+*                coroutines and filters) are freed and the list is set to
+*                NULL.
+*   Returned   : None
+***************************************************************************/
+void FreeFdList(fd_list_t **list)
+{
+    fd_list_t *here;
+
+    fanoutStart = NULL;
+
+    while (NULL != *list)
+    {
+        here = *list;
+        *list = here->next;
+
+        if (NULL != here->partial)
+        {
+            BufPoolPut(here->partial, here->partialSize);
+        }
+
+        if (NULL != here->co)
+        {
+            CoroFree(here->co);
+        }
+
+        if (NULL != here->out)
+        {
+            BufPoolPut(here->out, here->outSize);
+        }
+
+        FreeLanes(here);
+        free(here);
+    }
+
+    FilterFree(&filtering.index);
+}
+
+
 /***************************************************************************
 *   Function   : PrintFdList
 *   Description: This is a debugging routine for printing all of file
@@ -48,22 +48,36 @@
 ***************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sched.h>
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <arpa/inet.h>
 
 #include <signal.h>
-#include <sys/signalfd.h>
 
-#include <poll.h>
+#include "reactor.h"
+#include "bufpool.h"
+#include "loopmon.h"
+#include "flightrec.h"
+#include "control.h"
+#include "rcu.h"
+#include "lowlat.h"
+#include "sketch.h"
+#include "filter.h"
 
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
-#define BUF_SIZE    1024        /* size of receive buffer */
+#define STALL_THRESHOLD_US  10000   /* report loop iterations longer than this */
+#define SOURCES_INTERVAL_MS 1000    /* sources are counted per interval */
+#define FLOOD_RATE          10000   /* default packets/sec from one source */
+#define ALERT_BITS          8192    /* sources alerted on, a power of 2 */
+#define MAX_FILTERS         16      /* filters a client may register */
 
 /***************************************************************************
 *                            TYPE DEFINITIONS
@@ -71,19 +85,97 @@
 typedef struct addr_list_t
 {
     struct sockaddr_in  addr;
+    flight_rec_t flight;        /* recent events for this source */
+    unsigned int filters;       /* filters registered, 0 = every message */
+    unsigned long matched;      /* the last filtered message it matched */
     struct addr_list_t* next;
 } addr_list_t;
 
+/* settings changed by the control socket's set command (see SetTunables) */
+typedef struct tunables_t
+{
+    long long stallUs;          /* loop turns longer than this stall */
+    long long log;              /* per message logging (-q sets 0) */
+    long long rcvBuf;           /* SO_RCVBUF for the socket, 0 = default */
+    long long floodRate;        /* alert above packets/sec, 0 = never */
+    long long floodSources;     /* alert above sources/sec, 0 = never */
+    long long throttleRate;     /* -T: drop above packets/sec, 0 = never */
+} tunables_t;
+
+/* the sources of this interval, in fixed space however many there are */
+typedef struct sources_t
+{
+    hll_t distinct;             /* sources seen */
+    cms_t packets;              /* datagrams from each source */
+    unsigned long received;     /* datagrams from all of them */
+    unsigned char alerted[ALERT_BITS / 8];  /* sources' "flood:" written */
+
+    /* reported on the sources: line */
+    unsigned long lastDistinct; /* estimated sources in the last interval */
+    unsigned long lastReceived; /* datagrams in the last interval */
+    unsigned long maxDistinct;  /* most sources in any interval */
+    unsigned long floods;       /* sources that passed flood_rate */
+    unsigned long sourceFloods; /* intervals that passed flood_sources */
+    unsigned long throttled;    /* datagrams dropped over throttle_rate */
+} sources_t;
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+static addr_list_t *addrList;       /* every known echo client */
+static addr_list_t *fanoutStart;    /* the next echo starts here */
+static rcu_t *config;               /* current tunables_t */
+static sources_t sources;           /* distinct sources and their rates */
+static filter_index_t filters;      /* every client's #sub filters */
+static unsigned long filterFrame;   /* messages looked up in the index */
+
+#define TUNABLES()  ((const tunables_t *)RcuRead(config))
+
+static const control_tunable_t tunableTable[] =
+{
+    {"stall_us", offsetof(tunables_t, stallUs), 0, 60000000},
+    {"log", offsetof(tunables_t, log), 0, 1},
+    {"rcvbuf", offsetof(tunables_t, rcvBuf), 0, 1LL << 30},
+    {"flood_rate", offsetof(tunables_t, floodRate), 0, 1LL << 31},
+    {"flood_sources", offsetof(tunables_t, floodSources), 0, 1LL << 31},
+    {"throttle_rate", offsetof(tunables_t, throttleRate), 0, 1LL << 31},
+    {NULL, 0, 0, 0}
+};
+
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
-void EchoMessage(const int socketFd, const char *message, addr_list_t *list);
-int DoEcho(const int socketFd);
+void EchoMessage(const int socketFd, const char *message, addr_list_t *list,
+    long long now, reactor_t *reactor);
+int DoEcho(const int socketFd, reactor_t *reactor);
+void MatchFilters(const char *message, size_t length);
+addr_list_t *FanoutFirst(addr_list_t *list);
+addr_list_t *FanoutNext(const addr_list_t *here, addr_list_t *list,
+    const addr_list_t *first);
+int CountSource(const struct sockaddr_in *addr);
+int FirstAlert(unsigned long long hash);
+void PrintSources(FILE *stream);
+
+/* reactor callbacks */
+void SocketReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void ControlReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+void SignalReceived(reactor_t *reactor, int signo, void *data);
+void TunablesChanged(reactor_t *reactor, void *data);
+void SourcesTimer(reactor_t *reactor, void *data);
+
+void HandleControl(const int controlFd, const reactor_t *reactor,
+    const addr_list_t *list);
+void SetTunables(const char *assignments, FILE *reply);
+void DumpFlight(const addr_list_t *list, const struct sockaddr_in *addr,
+    FILE *stream);
 
 int CompairSockAddr(const struct sockaddr_in *s1, const struct sockaddr_in *s2);
 
-int AddAddr(const struct sockaddr_in *addr, addr_list_t **list);
+addr_list_t *AddAddr(const struct sockaddr_in *addr, addr_list_t **list);
 int RemoveAddr(const struct sockaddr_in *addr, addr_list_t **list);
+void FreeAddrList(addr_list_t **list);
 
 /***************************************************************************
 *                                FUNCTIONS
@@ -92,12 +184,25 @@ int RemoveAddr(const struct sockaddr_in *addr, addr_list_t **list);
 /***************************************************************************
 *   Function   : main
 *   Description: This is the main function for this program, it opens a
-*                datagram (UDP) socket on the port specified in argv[1].
-*                It binds to the specified port and accepts data all
-*                received input.  The received input is echoed back to
-*                the client.
+*                datagram (UDP) socket on the port specified on the
+*                command line.  It binds to the specified port and accepts
+*                data all received input.  The received input is echoed
+*                back to the client.  The event loop is provided by the
+*                reactor, which calls SocketReady (and through it DoEcho)
+*                when a datagram arrives, and also delivers ctrl-c and
+*                ctrl-\, which exit, and SIGUSR1, which dumps the flight
+*                recorder of every source.  The options select the
+*                reactor's run time policies: -b backend, -q disables per
+*                message logging and -n disables statistics.  Datagrams
+*                are already framed, so -f is accepted (for scripts that
+*                run both servers) but has no effect.  -L prefills the
+*                buffer pool and enters low latency mode (see LowLatStart)
+*                with the given SCHED_FIFO priority (0 for none) before
+*                the first datagram is received.  -T drops datagrams from
+*                any source sending more than the given packets/sec (see
+*                CountSource).
 *   Parameters : argc - number of parameters
-*                argv - parameter list (argv[1] is port number)
+*                argv - parameter list (options, then the port number)
 *   Effects    : A socket is open and accepts all data on the specified
 *                port.
 *   Returned   : EXIT_SUCCESS on success, otherwise EXIT_FAILURE.
@@ -110,10 +215,87 @@ int main(int argc, char *argv[])
     /* structure for echo server internet addresses */
     struct sockaddr_in serverAddr;
 
-    /* argv[1] is port number, make sure it's passed to us */
-    if (argc != 2)
+    /* the event loop, and the backend it uses */
+    reactor_t reactor;
+    reactor_backend_t backend;
+    int framing, statsOn, logOn;
+
+    /* optional control socket */
+    const char *controlPath;
+    int controlFd;
+    int opt;
+    int lowLatency;
+
+    tunables_t tunables = {STALL_THRESHOLD_US, 1, 0, FLOOD_RATE, 0, 0};
+
+    controlPath = NULL;
+    backend = REACTOR_EPOLL;
+    statsOn = 1;
+    logOn = 1;
+    lowLatency = LOWLAT_OFF;
+
+    while ((opt = getopt(argc, argv, "b:c:f:nqL:T:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                if (ReactorParseBackend(optarg, &backend) != 0)
+                {
+                    optind = argc;  /* force the usage message */
+                }
+                break;
+
+            case 'c':
+                controlPath = optarg;
+                break;
+
+            case 'f':
+                /* every datagram is a message, so framing is ignored */
+                if (ReactorParseFraming(optarg, &framing) != 0)
+                {
+                    optind = argc;  /* force the usage message */
+                }
+                break;
+
+            case 'n':
+                statsOn = 0;
+                break;
+
+            case 'q':
+                logOn = 0;
+                tunables.log = 0;
+                break;
+
+            case 'T':
+                tunables.throttleRate = atoll(optarg);
+                break;
+
+            case 'L':
+                lowLatency = atoi(optarg);
+
+                if ((lowLatency < 0) ||
+                    (lowLatency > sched_get_priority_max(SCHED_FIFO)))
+                {
+                    fprintf(stderr, "-L priority must be 0 to %d\n",
+                        sched_get_priority_max(SCHED_FIFO));
+                    optind = argc;
+                }
+                break;
+
+            default:
+                optind = argc;      /* force the usage message */
+                break;
+        }
+    }
+
+    /* the port number follows the options, make sure it's passed to us */
+    if (argc != (optind + 1))
     {
-        fprintf(stderr, "Usage:  %s <port number>\n", argv[0]);
+        fprintf(stderr,
+            "Usage:  %s [-b poll|epoll] [-f raw|line] [-n] [-q] "
+            "[-T <packets/sec>] [-L <priority>] "
+            "[-c <control socket path>] <port number>\n",
+            argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -126,11 +308,11 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    /* allow internet data from any address on port argv[1] */
+    /* allow internet data from any address on the port */
     memset(&serverAddr, 0, sizeof(serverAddr));     /* clear data structure */
     serverAddr.sin_family = AF_INET;                /* internet addr family */
     serverAddr.sin_addr.s_addr = htonl(INADDR_ANY); /* any incoming address */
-    serverAddr.sin_port = htons(atoi(argv[1]));     /* port number */
+    serverAddr.sin_port = htons(atoi(argv[optind])); /* port number */
 
     /* bind the socket to the local address */
     result = bind(socketFd, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
@@ -143,10 +325,87 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    config = RcuNew(&tunables, sizeof(tunables), 1);
+
+    if (NULL == config)
+    {
+        close(socketFd);
+        exit(EXIT_FAILURE);
+    }
+
+    controlFd = -1;
+
+    if (NULL != controlPath)
+    {
+        controlFd = ControlOpen(controlPath);
+
+        if (controlFd < 0)
+        {
+            close(socketFd);
+            RcuFree(config);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* register everything we need to service with the reactor */
+    if ((ReactorInit(&reactor, backend, tunables.stallUs) != 0) ||
+        (ReactorAdd(&reactor, socketFd, REACTOR_READ, SocketReady,
+            NULL) != 0) ||
+        ((controlFd >= 0) &&
+        (ReactorAdd(&reactor, controlFd, REACTOR_READ, ControlReady,
+            NULL) != 0)) ||
+        (ReactorSignal(&reactor, SIGINT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGQUIT, SignalReceived, NULL) != 0) ||
+        (ReactorSignal(&reactor, SIGUSR1, SignalReceived, NULL) != 0) ||
+        (ReactorTimer(&reactor, SOURCES_INTERVAL_MS, SourcesTimer,
+            NULL) < 0))
+    {
+        ReactorFree(&reactor);
+        close(socketFd);
+        ControlClose(controlFd, controlPath);
+        RcuFree(config);
+        exit(EXIT_FAILURE);
+    }
+
     /* we have a good socket bound to a port, echo all received packets */
-    DoEcho(socketFd);
+    reactor.statsOn = statsOn;
+    reactor.logOn = logOn;
+    addrList = NULL;
+    ReactorRcu(&reactor, config, 0, TunablesChanged, &socketFd);
+
+    if (REACTOR_LOG_ON(&reactor))
+    {
+        printf("Waiting to receive a message [ctrl-c exits]:\n");
+    }
 
+    if ((LOWLAT_OFF != lowLatency) &&
+        ((0 == BufPoolPrefill(RX_MAX_SIZE)) ||
+        (LowLatStart(LowLatCpu(0), lowLatency, stderr) != 0)))
+    {
+        /* don't run with less than was asked for */
+        result = -1;
+    }
+    else
+    {
+        result = ReactorRun(&reactor);
+    }
+
+    ReactorFree(&reactor);
     close(socketFd);
+    ControlClose(controlFd, controlPath);
+    ReactorPrintPolicies(&reactor, stderr);
+    ReactorPrintStats(&reactor, stderr);
+    ReactorPrintCpu(stderr);
+
+    if (REACTOR_STATS_ON(&reactor))
+    {
+        LoopMonPrint(&(reactor.monitor), stderr);
+    }
+
+    PrintSources(stderr);
+    FreeAddrList(&addrList);
+    BufPoolRelease();
+    RcuFree(config);
 
     if (result < 0)
     {
@@ -167,41 +426,145 @@ int main(int argc, char *argv[])
 *                message - The message to be echoed.
 *                list - The head of a linked list of addresses to receive
 *                the message.
+*                now - time stamp for flight recorder events.
+*                reactor - the server's reactor.
 *   Effects    : The message is sent to all listed addresses over the
-*                socket.
+*                socket, in fan-out order (see FanoutFirst).  Addresses
+*                with filters are skipped unless one matches the message's
+*                key (see MatchFilters).  Each send is recorded in the
+*                flight recorder of the address it was sent to.
 *   Returned   : None
 ***************************************************************************/
-void EchoMessage(const int socketFd, const char *message, addr_list_t *list)
+void EchoMessage(const int socketFd, const char *message, addr_list_t *list,
+    long long now, reactor_t *reactor)
 {
     int result;
-    addr_list_t *here;
+    size_t length;
+    addr_list_t *here, *first;
+
+    length = strlen(message);
+    MatchFilters(message, length);
+
+    first = FanoutFirst(list);
 
     /***********************************************************************
     * echo the message to all connected sockets, skip if waiting
     * is required.  Use threads or a complex polling loop if it's
     * important that every socket receive the echo.
     ***********************************************************************/
-    here = list;
-
-    while (here != NULL)
+    for (here = first; here != NULL; here = FanoutNext(here, list, first))
     {
-        result = sendto(socketFd, message, strlen(message), MSG_DONTWAIT,
-            (struct sockaddr *)&(here->addr), sizeof(struct sockaddr_in));
-
-        if (result == -1)
+        if ((0 == here->filters) || (here->matched == filterFrame))
         {
-            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            result = sendto(socketFd, message, length, MSG_DONTWAIT,
+                (struct sockaddr *)&(here->addr), sizeof(struct sockaddr_in));
+
+            REACTOR_COUNT(reactor, sendCalls, 1);
+
+            if (result == -1)
             {
-                fprintf(stderr, "Socket is busy\n");
+                if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+                {
+                    FlightRecord(&here->flight, FR_EAGAIN, 0, now);
+
+                    if (REACTOR_LOG_ON(reactor))
+                    {
+                        fprintf(stderr, "Socket is busy\n");
+                    }
+                }
+                else
+                {
+                    /* send failed */
+                    FlightRecord(&here->flight, FR_ERROR, errno, now);
+                    perror("Error echoing message");
+                }
             }
             else
             {
-                /* send failed */
-                perror("Error echoing message");
+                FlightRecord(&here->flight, FR_SEND, result, now);
+                REACTOR_COUNT(reactor, bytesOut, result);
             }
         }
+    }
+}
 
-        here = here->next;
+
+/***************************************************************************
+*   Function   : FanoutFirst
+*   Description: This routine picks the address an echo starts with.
+*                Each echo starts one address further along the list than
+*                the last one, so every address takes its turn at each
+*                place in the send order instead of the earliest known
+*                always going first and the latest always going last.
+*   Parameters : list - The head of a linked list of addresses.
+*   Effects    : The next echo will start with the following address.
+*   Returned   : The first address to send to, NULL if there are none.
+***************************************************************************/
+addr_list_t *FanoutFirst(addr_list_t *list)
+{
+    addr_list_t *first;
+
+    first = (NULL != fanoutStart) ? fanoutStart : list;
+    fanoutStart = (NULL != first) ? first->next : NULL;
+    return first;
+}
+
+
+/***************************************************************************
+*   Function   : FanoutNext
+*   Description: This routine steps through the addresses in echo order,
+*                wrapping from the end of the list to its head.
+*   Parameters : here - the current address.
+*                list - The head of a linked list of addresses.
+*                first - the address the echo started with.
+*   Effects    : None
+*   Returned   : The next address, NULL once every address has been
+*                visited.
+***************************************************************************/
+addr_list_t *FanoutNext(const addr_list_t *here, addr_list_t *list,
+    const addr_list_t *first)
+{
+    addr_list_t *next;
+
+    next = (NULL != here->next) ? here->next : list;
+    return (next == first) ? NULL : next;
+}
+
+
+/***************************************************************************
+*   Function   : MatchFilters
+*   Description: This routine looks up the addresses with a filter that
+*                matches a message's key in the filter index and marks
+*                them with the number of this message, so EchoMessage
+*                checks an address by its mark rather than its filters.
+*   Parameters : message - the message.
+*                length - the length of the message.
+*   Effects    : The matching addresses are marked.
+*   Returned   : None
+***************************************************************************/
+void MatchFilters(const char *message, size_t length)
+{
+    void **owners;
+    int count, i;
+
+    if (0 == filters.count)
+    {
+        return;     /* nobody filters */
+    }
+
+    filterFrame++;
+    count = FilterMatch(&filters, message, FilterKeyLength(message, length),
+        &owners);
+
+    if (count < 0)
+    {
+        perror("Error building the filter index");
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        ((addr_list_t *)owners[i])->matched = filterFrame;
     }
 }
 
@@ -210,128 +573,562 @@ void EchoMessage(const int socketFd, const char *message, addr_list_t *list)
 *   Function   : DoEcho
 *   Description: This routine receives a packet from a UDP socket and then
 *                writes the received packet back to the address that it
-*                received from on the same socket.
+*                received from on the same socket.  FIONREAD reports the
+*                size of the next datagram, so each receive borrows a
+*                buffer from the pool that is just big enough for the
+*                datagram (bounded by RX_MIN_SIZE and RX_MAX_SIZE).  Every
+*                datagram is counted by CountSource first, and one from a
+*                throttled source goes no further.  A filter command
+*                ("#sub <prefix>", "#sub <low>..<high>" or "#unsub")
+*                changes its sender's filters instead of being echoed.
 *   Parameters : socketFd - The socket descriptor for the socket to be read
 *                from and echoed to.
+*                reactor - the server's reactor (policies and statistics).
 *   Effects    : socketFd is read from and the values read are echoed back.
-*   Returned   : Typically the size of the echoed message.  Values <= 0
-*                mean something went wrong.
+*   Returned   : Typically the size of the echoed message.  0 for an empty
+*                message, and values < 0 mean something went wrong.
 ***************************************************************************/
-int DoEcho(const int socketFd)
+int DoEcho(const int socketFd, reactor_t *reactor)
 {
     struct sockaddr_in clientAddr;      /* address that sent the packet */
-    char buffer[BUF_SIZE + 1];          /* stores received message */
+    socklen_t addrLen;
+    char *buffer;                       /* stores received message */
+    size_t size;                        /* size of the receive buffer */
+    int pending;                        /* size of the next datagram */
     int result;
+    int status;                         /* result of a filter command */
+    addr_list_t *source;
+    long long now;
 
-    /* we'll need these to handle ctrl-c, ctrl-\ while trying to recv */
-    sigset_t mask, oldMask;
-    int signalFd;
-
-    struct pollfd pfds[2];      /* poll for socket recv and signal */
-    addr_list_t *addrList;
+    /* start with a cleared client address structure */
+    memset(&clientAddr, 0, sizeof(struct sockaddr_in));
 
-    /* mask ctrl-c and ctrl-\ */
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGINT);
-    sigaddset(&mask, SIGQUIT);
+    /* size the buffer for the waiting datagram plus a '\0' */
+    REACTOR_COUNT(reactor, ioctlCalls, 1);
 
-    /* block ctrl-c and ctrl-\ signals so that can be signaled
-     * signaled by the signalFd and handled while polling. */
-    if (sigprocmask(SIG_BLOCK, &mask, &oldMask) == -1)
+    if (ioctl(socketFd, FIONREAD, &pending) < 0)
     {
-        perror("Error setting sigproc mask");
-        return 0;
+        pending = 0;
     }
 
-    signalFd = signalfd(-1, &mask, 0);
+    size = pending + 1;
 
-    if (signalFd == -1)
+    if (size < RX_MIN_SIZE)
     {
-        perror("Error creating signal fd");
-        sigprocmask(SIG_UNBLOCK, &mask, NULL);
-        sigprocmask(SIG_BLOCK, &oldMask, NULL);
-        return 0;
+        size = RX_MIN_SIZE;
+    }
+    else if (size > RX_MAX_SIZE)
+    {
+        size = RX_MAX_SIZE;
     }
 
-    pfds[0].fd = socketFd;
-    pfds[0].events = POLLIN;
+    buffer = (char *)BufPoolGet(size);
 
-    pfds[1].fd = signalFd;
-    pfds[1].events = POLLIN;
+    if (NULL == buffer)
+    {
+        perror("Error allocating receive buffer");
+        return -1;
+    }
 
-    addrList = NULL;
+    /* use recvfrom so we can know where the data came from */
+    addrLen = sizeof(clientAddr);
+    result = recvfrom(socketFd, buffer, size - 1, 0,
+        (struct sockaddr *)&clientAddr, &addrLen);
+    REACTOR_COUNT(reactor, recvCalls, 1);
+    now = LoopMonNow();
 
-    while (1)
+    if (result < 0)
     {
-        /* start with cleared buffer and client address structure */
-        memset(&buffer, 0, BUF_SIZE);
-        memset(&clientAddr, 0, sizeof(struct sockaddr_in));
-
-        printf("Waiting to receive a message [ctrl-c exits]:\n");
-        result = 0;
+        perror("Error receiving message");
+    }
+    else
+    {
+        buffer[result] = '\0';
+        REACTOR_COUNT(reactor, bytesIn, result);
 
-        poll(pfds, 2, -1);  /* block with poll until 1 of 2 events */
+        if (CountSource(&clientAddr))
+        {
+            /* a throttled source is neither echoed nor remembered */
+            BufPoolPut(buffer, size);
+            return result;
+        }
 
-        /* handle signals first */
-        if (pfds[1].revents & POLLIN)
+        if (REACTOR_LOG_ON(reactor))
         {
-            /* SIGINT or SIGQUIT get out of here */
-            break;
+            /* we received a valid message */
+            char from[INET_ADDRSTRLEN + 1];
+            from[0] = '\0';
+
+            if (NULL !=
+                inet_ntop(AF_INET, (void *)&(clientAddr.sin_addr), from,
+                    INET_ADDRSTRLEN))
+            {
+                printf("Received message from %s:%d: ", from,
+                    ntohs(clientAddr.sin_port));
+            }
+            else
+            {
+                printf("Received message from unresolveble address\n");
+            }
         }
 
-        /* now check for recvfrom on socket */
-        if (pfds[0].revents & POLLIN)
+        if (strlen(buffer) > 0)
         {
-            socklen_t addrLen;
+            if (REACTOR_LOG_ON(reactor))
+            {
+                printf("%s\n", buffer);
+            }
 
-            /* use recvfrom so we can know where the data came from */
-            result = recvfrom(socketFd, buffer, BUF_SIZE, 0,
-                (struct sockaddr *)&clientAddr, &addrLen);
+            source = AddAddr(&clientAddr, &addrList);
 
-            if (result < 0)
+            if (NULL != source)
             {
-                perror("Error receiving message");
+                FlightRecord(&source->flight, FR_RECV, result, now);
+                status = FilterCommand(&filters, source, buffer, result,
+                    MAX_FILTERS);
             }
             else
             {
-                /* we received a valid message */
-                char from[INET_ADDRSTRLEN + 1];
-                from[0] = '\0';
+                status = FILTER_NONE;
+            }
 
-                if (NULL !=
-                    inet_ntop(AF_INET, (void *)&(clientAddr.sin_addr), from,
-                        INET_ADDRSTRLEN))
-                {
-                    printf("Received message from %s:%d: ", from,
-                        ntohs(clientAddr.sin_port));
-                }
-                else
-                {
-                    printf("Received message from unresolveble address\n");
-                }
+            if (FILTER_BAD == status)
+            {
+                fprintf(stderr, "Bad filter command from port %d\n",
+                    ntohs(clientAddr.sin_port));
+            }
+            else if (FILTER_CHANGED == status)
+            {
+                source->filters = FilterOwned(&filters, source);
+            }
+            else
+            {
+                /* now try echoing the buffer to all addresses */
+                EchoMessage(socketFd, buffer, addrList, now, reactor);
+            }
+        }
+        else
+        {
+            if (REACTOR_LOG_ON(reactor))
+            {
+                printf("Message was empty\n");
+            }
 
-                if (strlen(buffer) > 0)
-                {
-                    printf("%s\n", buffer);
-                    AddAddr(&clientAddr, &addrList);
+            RemoveAddr(&clientAddr, &addrList);
+            result = 0;
+        }
+    }
 
-                    /* now try echoing the buffer to all addresses */
-                    EchoMessage(socketFd, buffer, addrList);
-                }
-                else
-                {
-                    printf("Message was empty\n");
-                    RemoveAddr(&clientAddr, &addrList);
-                }
+    BufPoolPut(buffer, size);
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : CountSource
+*   Description: This routine counts a datagram in the sketches of the
+*                current interval: the source in a HyperLogLog of
+*                distinct sources, and the datagram in a count-min sketch
+*                of datagrams by source.  No table of sources is kept, so
+*                a flood from many (perhaps spoofed) addresses costs no
+*                memory.  Whenever the source's estimated count is over
+*                flood_rate, a "flood:" alert is written unless one has
+*                been for the source this interval (see FirstAlert), so
+*                an estimate pushed past the rate by a colliding source,
+*                or a rate lowered below it, still alerts.  Past
+*                throttle_rate the source's datagrams are dropped until
+*                the interval ends.  Estimates may be high, never low, so
+*                a source sharing counters with a flood may be throttled
+*                with it, but a flood is never counted low.
+*   Parameters : addr - the datagram's source.
+*   Effects    : The sketches are updated and an alert may be written.
+*   Returned   : Non-zero if the datagram should be dropped.
+***************************************************************************/
+int CountSource(const struct sockaddr_in *addr)
+{
+    const tunables_t *tunables;
+    unsigned long long hash;
+    unsigned int count;
+    char from[INET_ADDRSTRLEN + 1];
+
+    hash = SketchHash(((unsigned long long)addr->sin_addr.s_addr << 16) |
+        addr->sin_port);
+    HllAdd(&sources.distinct, hash);
+    count = CmsAdd(&sources.packets, hash, 1);
+    sources.received++;
+    tunables = TUNABLES();
+
+    if ((tunables->floodRate > 0) && (count > tunables->floodRate) &&
+        FirstAlert(hash))
+    {
+        sources.floods++;
+
+        if (NULL == inet_ntop(AF_INET, (void *)&(addr->sin_addr), from,
+            INET_ADDRSTRLEN))
+        {
+            strcpy(from, "?");
+        }
+
+        fprintf(stderr, "flood: source=%s:%d packets_per_sec_over=%lld\n",
+            from, ntohs(addr->sin_port), tunables->floodRate);
+    }
+
+    if ((tunables->throttleRate > 0) && (count > tunables->throttleRate))
+    {
+        sources.throttled++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : FirstAlert
+*   Description: This routine notes a "flood:" alert for a source in a
+*                small Bloom filter, two bits per source, cleared each
+*                interval.  A source can only be taken for one already
+*                alerted on if both its bits were set by other floods in
+*                the same interval.
+*   Parameters : hash - the source's hash (see SketchHash).
+*   Effects    : The source's bits are set.
+*   Returned   : Non-zero if no alert was noted for the source yet.
+***************************************************************************/
+int FirstAlert(unsigned long long hash)
+{
+    unsigned int bit1, bit2;
+    int first;
+
+    bit1 = (unsigned int)(hash >> 20) & (ALERT_BITS - 1);
+    bit2 = (unsigned int)(hash >> 40) & (ALERT_BITS - 1);
+    first = !((sources.alerted[bit1 / 8] & (1 << (bit1 % 8))) &&
+        (sources.alerted[bit2 / 8] & (1 << (bit2 % 8))));
+
+    sources.alerted[bit1 / 8] |= 1 << (bit1 % 8);
+    sources.alerted[bit2 / 8] |= 1 << (bit2 % 8);
+    return first;
+}
+
+
+/***************************************************************************
+*   Function   : SourcesTimer
+*   Description: This is the reactor timer callback that ends an interval
+*                of source counting.  The interval's distinct sources are
+*                estimated (with about 3% error), a "flood:" alert is
+*                written if there were more than flood_sources, and the
+*                sketches are cleared for the next interval.
+*   Parameters : reactor - the server's reactor.
+*                data - unused.
+*   Effects    : The sketches are cleared and the timer is restarted.
+*   Returned   : None
+***************************************************************************/
+void SourcesTimer(reactor_t *reactor, void *data)
+{
+    long long limit;
+
+    sources.lastDistinct = (unsigned long)(HllCount(&sources.distinct) + 0.5);
+    sources.lastReceived = sources.received;
+
+    if (sources.lastDistinct > sources.maxDistinct)
+    {
+        sources.maxDistinct = sources.lastDistinct;
+    }
+
+    limit = TUNABLES()->floodSources;
+
+    if ((limit > 0) && (sources.lastDistinct > (unsigned long)limit))
+    {
+        sources.sourceFloods++;
+        fprintf(stderr, "flood: sources=%lu sources_per_sec_over=%lld\n",
+            sources.lastDistinct, limit);
+    }
+
+    memset(&sources.distinct, 0, sizeof(sources.distinct));
+    memset(&sources.packets, 0, sizeof(sources.packets));
+    memset(sources.alerted, 0, sizeof(sources.alerted));
+    sources.received = 0;
+
+    ReactorTimer(reactor, SOURCES_INTERVAL_MS, SourcesTimer, data);
+}
+
+
+/***************************************************************************
+*   Function   : PrintSources
+*   Description: This routine writes the source counts of the last
+*                complete interval and the flood totals.
+*   Parameters : stream - where to write them.
+*   Effects    : A "sources:" line is written to stream.
+*   Returned   : None
+***************************************************************************/
+void PrintSources(FILE *stream)
+{
+    fprintf(stream, "sources: distinct=%lu max_distinct=%lu received=%lu "
+        "floods=%lu source_floods=%lu throttled=%lu\n",
+        sources.lastDistinct, sources.maxDistinct, sources.lastReceived,
+        sources.floods, sources.sourceFloods, sources.throttled);
+}
+
+
+/***************************************************************************
+*   Function   : SocketReady
+*   Description: This is the reactor callback for the server's socket.  It
+*                calls DoEcho to echo the waiting datagram.
+*   Parameters : reactor - the server's reactor.
+*                fd - the server's socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : The datagram is echoed.  The reactor is stopped if a
+*                receive buffer couldn't be allocated.
+*   Returned   : None
+***************************************************************************/
+void SocketReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    (void)events;
+    (void)data;
+
+    if (DoEcho(fd, reactor) == -1)
+    {
+        ReactorStop(reactor, -1);
+        return;
+    }
+
+    if (REACTOR_LOG_ON(reactor))
+    {
+        printf("Waiting to receive a message [ctrl-c exits]:\n");
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ControlReady
+*   Description: This is the reactor callback for the control socket.
+*   Parameters : reactor - the server's reactor.
+*                fd - the listening control socket.
+*                events - unused.
+*                data - unused.
+*   Effects    : The control command is carried out.
+*   Returned   : None
+***************************************************************************/
+void ControlReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    (void)events;
+    (void)data;
+
+    HandleControl(fd, reactor, addrList);
+}
+
+
+/***************************************************************************
+*   Function   : SignalReceived
+*   Description: This is the reactor callback for signals.  SIGUSR1 dumps
+*                the flight recorder of every source; ctrl-c and ctrl-\
+*                stop the reactor.
+*   Parameters : reactor - the server's reactor.
+*                signo - the signal that was delivered.
+*                data - unused.
+*   Effects    : Flight recorders are written to stderr, or the reactor is
+*                stopped.
+*   Returned   : None
+***************************************************************************/
+void SignalReceived(reactor_t *reactor, int signo, void *data)
+{
+    (void)data;
+
+    if (SIGUSR1 == signo)
+    {
+        /* dump everyone's flight recorder */
+        DumpFlight(addrList, NULL, stderr);
+    }
+    else
+    {
+        /* SIGINT or SIGQUIT get out of here */
+        ReactorStop(reactor, 0);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : TunablesChanged
+*   Description: This is the reactor callback for a new version of the
+*                tunables.  It applies them to the reactor and the socket.
+*   Parameters : reactor - the server's reactor.
+*                data - a pointer to the server's socket.
+*   Effects    : The new settings are applied.
+*   Returned   : None
+***************************************************************************/
+void TunablesChanged(reactor_t *reactor, void *data)
+{
+    const tunables_t *tunables;
+    int size;
+
+    tunables = TUNABLES();
+    reactor->logOn = (int)tunables->log;
+    reactor->monitor.thresholdNs = tunables->stallUs * 1000LL;
+
+    if (tunables->rcvBuf > 0)
+    {
+        size = (int)tunables->rcvBuf;
+        setsockopt(*(int *)data, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+}
+
+
+/***************************************************************************
+*   Function   : HandleControl
+*   Description: This routine accepts a connection on the control socket
+*                and carries out its command.  The commands are:
+*                stats - write the policies, stats, loop monitor and
+*                sources lines
+*                dump - write the flight recorder of every source
+*                dump <address>:<port> - write the flight recorder for
+*                one source
+*                get - write the tunables
+*                set <name>=<value> ... - change tunables (see SetTunables)
+*   Parameters : controlFd - the listening control socket.
+*                reactor - the server's reactor.
+*                list - a pointer to a list of socket addresses of all
+*                known active echo clients.
+*   Effects    : The reply is written to the control connection.
+*   Returned   : None
+***************************************************************************/
+void HandleControl(const int controlFd, const reactor_t *reactor,
+    const addr_list_t *list)
+{
+    char command[CONTROL_CMD_SIZE];
+    char host[INET_ADDRSTRLEN + 1];
+    unsigned int port;
+    struct sockaddr_in addr;
+    FILE *reply;
+
+    reply = ControlAccept(controlFd, command, sizeof(command));
+
+    if (NULL == reply)
+    {
+        return;
+    }
+
+    if (strcmp(command, "stats") == 0)
+    {
+        ReactorPrintPolicies(reactor, reply);
+        ReactorPrintStats(reactor, reply);
+
+        if (REACTOR_STATS_ON(reactor))
+        {
+            LoopMonPrint(&(reactor->monitor), reply);
+        }
+
+        PrintSources(reply);
+    }
+    else if (strcmp(command, "get") == 0)
+    {
+        ControlPrintTunables(tunableTable, TUNABLES(), reply);
+    }
+    else if (strncmp(command, "set ", 4) == 0)
+    {
+        SetTunables(command + 4, reply);
+    }
+    else if (strcmp(command, "dump") == 0)
+    {
+        DumpFlight(list, NULL, reply);
+    }
+    else if (sscanf(command, "dump %16[0-9.]:%u", host, &port) == 2)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+
+        if (inet_pton(AF_INET, host, &(addr.sin_addr)) == 1)
+        {
+            DumpFlight(list, &addr, reply);
+        }
+        else
+        {
+            fprintf(reply, "error: bad address '%s'\n", host);
+        }
+    }
+    else
+    {
+        fprintf(reply, "error: unknown command '%s'\n", command);
+    }
+
+    fclose(reply);
+}
+
+
+/***************************************************************************
+*   Function   : SetTunables
+*   Description: This routine carries out a set command.  The assignments
+*                are made to a copy of the current tunables, which the
+*                loop picks up at its next turn.
+*   Parameters : assignments - the name=value list.
+*                reply - where to write the result.
+*   Effects    : A new version of the tunables is published.
+*   Returned   : None
+***************************************************************************/
+void SetTunables(const char *assignments, FILE *reply)
+{
+    tunables_t *copy;
+
+    copy = (tunables_t *)RcuCopy(config);
+
+    if (NULL == copy)
+    {
+        fprintf(reply, "error: busy, try again\n");
+        return;
+    }
+
+    if (ControlSetTunables(tunableTable, copy, assignments, reply) == 0)
+    {
+        fprintf(reply, "ok: generation=%lu\n", RcuPublish(config, copy));
+        ControlPrintTunables(tunableTable, copy, reply);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : DumpFlight
+*   Description: This routine writes the flight recorder for one or all
+*                sources.
+*   Parameters : list - a pointer to a list of socket addresses of all
+*                known active echo clients.
+*                addr - the source to dump, or NULL for every source.
+*                stream - where to write the flight recorders.
+*   Effects    : The flight recorders are written to stream.
+*   Returned   : None
+***************************************************************************/
+void DumpFlight(const addr_list_t *list, const struct sockaddr_in *addr,
+    FILE *stream)
+{
+    const addr_list_t *here;
+    char from[INET_ADDRSTRLEN + 1];
+    int found;
+
+    found = 0;
+
+    for (here = list; here != NULL; here = here->next)
+    {
+        if ((NULL == addr) || (CompairSockAddr(&(here->addr), addr) == 0))
+        {
+            if (NULL == inet_ntop(AF_INET, &(here->addr.sin_addr), from,
+                INET_ADDRSTRLEN))
+            {
+                strcpy(from, "?");
             }
+
+            fprintf(stream, "flight: source=%s:%d events=%u\n", from,
+                ntohs(here->addr.sin_port), here->flight.next);
+            FlightPrint(&here->flight, stream);
+            found = 1;
         }
     }
 
-    /* we should only get here by SIGINT or SIGQUIT. clean-up signal mask */
-    sigprocmask(SIG_UNBLOCK, &mask, NULL);
-    sigprocmask(SIG_BLOCK, &oldMask, NULL);
-    close(signalFd);
-    return result;
+    if (!found)
+    {
+        fprintf(stream, (NULL == addr) ? "no sources\n" :
+            "error: no such source\n");
+    }
 }
 
 
@@ -365,60 +1162,58 @@ int CompairSockAddr(const struct sockaddr_in *s1, const struct sockaddr_in *s2)
 *                active echo clients.
 *   Effects    : A node for the socket address is added to the end of the
 *                list of socket addresses.
-*   Returned   : 0 for success, otherwise errno for the failure.
+*   Returned   : A pointer to the address's node (new or existing), or NULL
+*                if a new node couldn't be allocated.
 ***************************************************************************/
-int AddAddr(const struct sockaddr_in *addr, addr_list_t **list)
+addr_list_t *AddAddr(const struct sockaddr_in *addr, addr_list_t **list)
 {
-    addr_list_t *here;
-
-    /* handle empty list */
-    if (NULL == *list)
-    {
-        *list = (addr_list_t *)malloc(sizeof(struct sockaddr_in));
-
-        if (NULL == list)
-        {
-            perror("Error allocating addr_list_t");
-            return errno;
-        }
-
-        memcpy(&((*list)->addr), addr, sizeof(struct sockaddr_in));
-        (*list)->next = NULL;
-        return 0;
-    }
+    addr_list_t *here, *node;
 
     /* find the end of the list checking to see if address is in the list */
     here = *list;
-    while(here->next != NULL)
+
+    while (here != NULL)
     {
         if (CompairSockAddr(&(here->addr), addr) == 0)
         {
             /* the address is alread in the list */
-            return 0;
+            return here;
+        }
+
+        if (NULL == here->next)
+        {
+            break;
         }
 
         here = here->next;
     }
 
-    /* we're at the end of the list make sure the address isn't here */
-    if (CompairSockAddr(&(here->addr), addr) == 0)
+    /* the address in new, add it to the end of the list */
+    node = (addr_list_t *)malloc(sizeof(addr_list_t));
+
+    if (NULL == node)
     {
-        /* the address is alread in the list */
-        return 0;
+        perror("Error allocating addr_list_t");
+        return NULL;
     }
 
-    /* the address in new, add it to the end of the list */
-    here->next = (addr_list_t *)malloc(sizeof(addr_list_t));
+    memcpy(&(node->addr), addr, sizeof(struct sockaddr_in));
+    FlightInit(&(node->flight));
+    FlightRecord(&(node->flight), FR_OPEN, 0, LoopMonNow());
+    node->filters = 0;
+    node->matched = 0;
+    node->next = NULL;
 
-    if (NULL == here->next)
+    if (NULL == here)
     {
-        perror("Error allocating addr_list_t");
-        return errno;
+        *list = node;       /* list was empty */
+    }
+    else
+    {
+        here->next = node;
     }
 
-    memcpy(&(here->next->addr), addr, sizeof(struct sockaddr_in));
-    here->next->next = NULL;
-    return 0;
+    return node;
 }
 
 
@@ -431,8 +1226,8 @@ int AddAddr(const struct sockaddr_in *addr, addr_list_t **list)
 *   Parameters : addr - The socket address to be deleted from the list.
 *                list - a pointer to a list of socket addresses of all known
 *                active echo clients.
-*   Effects    : The node for the socket address is removed from the list
-*                of socket addresses.
+*   Effects    : The node for the socket address, and its filters, are
+*                removed from the list of socket addresses.
 *   Returned   : 0 (it's acceptable to not find the socket address)
 ***************************************************************************/
 int RemoveAddr(const struct sockaddr_in *addr, addr_list_t **list)
@@ -462,6 +1257,16 @@ int RemoveAddr(const struct sockaddr_in *addr, addr_list_t **list)
                 prev->next = here->next;
             }
 
+            if (fanoutStart == here)
+            {
+                fanoutStart = here->next;
+            }
+
+            if (here->filters > 0)
+            {
+                FilterRemove(&filters, here);
+            }
+
             free(here);
             return 0;
         }
@@ -473,3 +1278,30 @@ int RemoveAddr(const struct sockaddr_in *addr, addr_list_t **list)
     /* client will not be in the list if it only sends an empty message */
     return 0;
 }
+
+
+/***************************************************************************
+*   Function   : FreeAddrList
+*   Description: This routine frees every node in a linked list of socket
+*                addresses.
+*   Parameters : list - a pointer to a list of socket addresses of all known
+*                active echo clients.
+*   Effects    : All nodes and their filters are freed and the list is set
+*                to NULL.
+*   Returned   : None
+***************************************************************************/
+void FreeAddrList(addr_list_t **list)
+{
+    addr_list_t *here;
+
+    fanoutStart = NULL;
+
+    while (NULL != *list)
+    {
+        here = *list;
+        *list = here->next;
+        free(here);
+    }
+
+    FilterFree(&filters);
+}
@@ -0,0 +1,635 @@
+/***************************************************************************
+*                      Subscriber Content Filter Index
+*
+*   File    : filter.c
+*   Purpose : This file implements an interval index of subscriber
+*             filters.  A message's key is its first word.  A filter is
+*             either a key prefix or an inclusive range of keys, and both
+*             are held as a half open range [low, high): a prefix's high
+*             is the first key that doesn't start with it, and a range's
+*             high is its last key followed by a '\0'.  The bounds of
+*             every filter cut the key space into segments, each covered
+*             by the same set of filters, so a lookup is a binary search
+*             for the key's segment, which lists the owners to send to.
+*             The segments are rebuilt when filters change, which is
+*             rare compared with broadcasts.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Filter: Key prefix and range subscriptions for the echo servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static size_t CommandLength(const char *message, size_t length);
+static int Build(filter_index_t *index);
+static int Locate(const filter_index_t *index, const unsigned char *key,
+    size_t length);
+static int Compare(const unsigned char *key1, size_t length1,
+    const unsigned char *key2, size_t length2);
+static int CompareBounds(const void *b1, const void *b2);
+static void Unbuild(filter_index_t *index);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : FilterAdd
+*   Description: This routine adds a filter.  A spec of the form
+*                low..high matches the keys from low through high, any
+*                other spec matches the keys that start with it.  An
+*                empty spec matches every key.
+*   Parameters : index - the filter index.
+*                owner - the subscriber the filter belongs to.
+*                spec - the prefix or range.
+*                length - the length of spec.
+*   Effects    : The filter is added to the index.
+*   Returned   : 0 for success, -1 if a bound is longer than
+*                FILTER_KEY_MAX, a range is empty or memory couldn't be
+*                allocated.
+***************************************************************************/
+int FilterAdd(filter_index_t *index, void *owner, const char *spec,
+    size_t length)
+{
+    filter_t *filter;
+    const char *dots;
+    size_t i;
+
+    if (index->count == index->size)
+    {
+        filter_t *filters;
+        unsigned int size;
+
+        size = (0 == index->size) ? 16 : (2 * index->size);
+        filters = (filter_t *)realloc(index->filters,
+            size * sizeof(filter_t));
+
+        if (NULL == filters)
+        {
+            return -1;
+        }
+
+        index->filters = filters;
+        index->size = size;
+    }
+
+    filter = &index->filters[index->count];
+    filter->owner = owner;
+    dots = NULL;
+
+    for (i = 0; (i + 1) < length; i++)
+    {
+        if (0 == memcmp(spec + i, FILTER_RANGE, 2))
+        {
+            dots = spec + i;
+            break;
+        }
+    }
+
+    if (NULL != dots)
+    {
+        /* low..high, high + '\0' is the first key past it */
+        filter->lowLength = dots - spec;
+        filter->highLength = length - filter->lowLength - 2;
+
+        if ((filter->lowLength > FILTER_KEY_MAX) ||
+            (filter->highLength > FILTER_KEY_MAX))
+        {
+            return -1;
+        }
+
+        memcpy(filter->low, spec, filter->lowLength);
+        memcpy(filter->high, dots + 2, filter->highLength);
+
+        if (Compare(filter->low, filter->lowLength, filter->high,
+            filter->highLength) > 0)
+        {
+            return -1;
+        }
+
+        filter->high[filter->highLength++] = '\0';
+        filter->bounded = 1;
+    }
+    else
+    {
+        /* a prefix, its successor is the first key past it */
+        if (length > FILTER_KEY_MAX)
+        {
+            return -1;
+        }
+
+        memcpy(filter->low, spec, length);
+        memcpy(filter->high, spec, length);
+        filter->lowLength = length;
+        filter->highLength = length;
+
+        while ((filter->highLength > 0) &&
+            (0xFF == filter->high[filter->highLength - 1]))
+        {
+            filter->highLength--;
+        }
+
+        /* an empty or all 0xFF prefix has no successor */
+        filter->bounded = (filter->highLength > 0);
+
+        if (filter->bounded)
+        {
+            filter->high[filter->highLength - 1]++;
+        }
+    }
+
+    index->count++;
+    Unbuild(index);
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : FilterRemove
+*   Description: This routine removes all of a subscriber's filters.
+*   Parameters : index - the filter index.
+*                owner - the subscriber.
+*   Effects    : The owner's filters are removed from the index.
+*   Returned   : The number of filters removed.
+***************************************************************************/
+unsigned int FilterRemove(filter_index_t *index, const void *owner)
+{
+    unsigned int i, kept;
+
+    kept = 0;
+
+    for (i = 0; i < index->count; i++)
+    {
+        if (index->filters[i].owner != owner)
+        {
+            if (kept != i)
+            {
+                index->filters[kept] = index->filters[i];
+            }
+
+            kept++;
+        }
+    }
+
+    i = index->count - kept;
+
+    if (i > 0)
+    {
+        index->count = kept;
+        Unbuild(index);
+    }
+
+    return i;
+}
+
+
+/***************************************************************************
+*   Function   : FilterOwned
+*   Description: This routine counts a subscriber's filters.
+*   Parameters : index - the filter index.
+*                owner - the subscriber.
+*   Effects    : None
+*   Returned   : The number of filters the owner has.
+***************************************************************************/
+unsigned int FilterOwned(const filter_index_t *index, const void *owner)
+{
+    unsigned int i, owned;
+
+    owned = 0;
+
+    for (i = 0; i < index->count; i++)
+    {
+        if (index->filters[i].owner == owner)
+        {
+            owned++;
+        }
+    }
+
+    return owned;
+}
+
+
+/***************************************************************************
+*   Function   : FilterCommand
+*   Description: This routine carries out a filter command.  FILTER_SUB
+*                followed by a space and a spec adds a filter (see
+*                FilterAdd), FILTER_UNSUB removes all of the sender's.  A
+*                trailing end of line is ignored.
+*   Parameters : index - the filter index.
+*                owner - the sender.
+*                message - the message that may be a command.
+*                length - the length of message.
+*                limit - the most filters a sender may have.
+*   Effects    : The sender's filters may be changed.
+*   Returned   : FILTER_NONE if message isn't a command, FILTER_CHANGED if
+*                it was carried out or FILTER_BAD if it was malformed or
+*                the sender already has limit filters.
+***************************************************************************/
+int FilterCommand(filter_index_t *index, void *owner, const char *message,
+    size_t length, unsigned int limit)
+{
+    size_t command;
+
+    command = CommandLength(message, length);
+
+    if (command == strlen(FILTER_UNSUB))
+    {
+        if (0 == memcmp(message, FILTER_UNSUB, command))
+        {
+            FilterRemove(index, owner);
+            return FILTER_CHANGED;
+        }
+    }
+    else if (command == strlen(FILTER_SUB))
+    {
+        if (0 == memcmp(message, FILTER_SUB, command))
+        {
+            while ((length > command) && (('\n' == message[length - 1]) ||
+                ('\r' == message[length - 1])))
+            {
+                length--;
+            }
+
+            if (length > command)
+            {
+                command++;      /* the space before the spec */
+            }
+
+            if ((FilterOwned(index, owner) >= limit) ||
+                (FilterAdd(index, owner, message + command,
+                length - command) != 0))
+            {
+                return FILTER_BAD;
+            }
+
+            return FILTER_CHANGED;
+        }
+    }
+
+    return FILTER_NONE;
+}
+
+
+/***************************************************************************
+*   Function   : FilterKeyLength
+*   Description: This routine finds a message's key, the bytes up to its
+*                first space, tab or end of line, at most FILTER_KEY_MAX
+*                of them.
+*   Parameters : message - the message.
+*                length - the length of message.
+*   Effects    : None
+*   Returned   : The length of the key.
+***************************************************************************/
+size_t FilterKeyLength(const char *message, size_t length)
+{
+    size_t i;
+
+    if (length > FILTER_KEY_MAX)
+    {
+        length = FILTER_KEY_MAX;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        if ((' ' == message[i]) || ('\t' == message[i]) ||
+            ('\r' == message[i]) || ('\n' == message[i]))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+/***************************************************************************
+*   Function   : FilterMatch
+*   Description: This routine looks up the subscribers with a filter that
+*                matches a key.  The segments are rebuilt first if the
+*                filters have changed.  A subscriber with overlapping
+*                filters may be listed more than once.
+*   Parameters : index - the filter index.
+*                key - the key (see FilterKeyLength).
+*                length - the length of key.
+*                owners - set to the list of matching subscribers.
+*   Effects    : The index's segments may be rebuilt.
+*   Returned   : The number of subscribers listed, or -1 if the segments
+*                couldn't be allocated.
+***************************************************************************/
+int FilterMatch(filter_index_t *index, const char *key, size_t length,
+    void ***owners)
+{
+    int segment;
+
+    *owners = NULL;
+
+    if (0 == index->count)
+    {
+        return 0;
+    }
+
+    if (!index->built && (Build(index) != 0))
+    {
+        return -1;
+    }
+
+    segment = Locate(index, (const unsigned char *)key, length);
+
+    if (segment < 0)
+    {
+        return 0;   /* below every filter */
+    }
+
+    *owners = index->owners + index->start[segment];
+    return (int)(index->start[segment + 1] - index->start[segment]);
+}
+
+
+/***************************************************************************
+*   Function   : FilterFree
+*   Description: This routine frees an index and all of its filters.
+*   Parameters : index - the filter index.
+*   Effects    : The index is empty.
+*   Returned   : None
+***************************************************************************/
+void FilterFree(filter_index_t *index)
+{
+    Unbuild(index);
+    free(index->filters);
+    memset(index, 0, sizeof(filter_index_t));
+}
+
+
+/***************************************************************************
+*   Function   : CommandLength
+*   Description: This routine finds the length of a message's first word,
+*                which is a command's name.
+*   Parameters : message - the message.
+*                length - the length of message.
+*   Effects    : None
+*   Returned   : The length of the first word, 0 if the message doesn't
+*                start with a command's '#'.
+***************************************************************************/
+static size_t CommandLength(const char *message, size_t length)
+{
+    if ((0 == length) || ('#' != message[0]))
+    {
+        return 0;
+    }
+
+    return FilterKeyLength(message, length);
+}
+
+
+/***************************************************************************
+*   Function   : Build
+*   Description: This routine cuts the key space into segments at every
+*                filter bound and lists the owners of the filters that
+*                cover each segment.  The owners are counted per segment,
+*                the counts are summed into the end of each segment's
+*                part of the list, and the list is filled from the ends
+*                back, which leaves start[i] at the start of segment i.
+*   Parameters : index - the filter index.
+*   Effects    : The index's segments are allocated and filled.
+*   Returned   : 0 for success, -1 if memory couldn't be allocated.
+***************************************************************************/
+static int Build(filter_index_t *index)
+{
+    const filter_t *filter;
+    unsigned int i, count;
+    int first, last, segment;
+
+    Unbuild(index);
+    index->bounds = (filter_bound_t *)malloc(2 * index->count *
+        sizeof(filter_bound_t));
+
+    if (NULL == index->bounds)
+    {
+        return -1;
+    }
+
+    count = 0;
+
+    for (i = 0; i < index->count; i++)
+    {
+        filter = &index->filters[i];
+        index->bounds[count].key = filter->low;
+        index->bounds[count].length = filter->lowLength;
+        count++;
+
+        if (filter->bounded)
+        {
+            index->bounds[count].key = filter->high;
+            index->bounds[count].length = filter->highLength;
+            count++;
+        }
+    }
+
+    qsort(index->bounds, count, sizeof(filter_bound_t), CompareBounds);
+    index->boundCount = 1;
+
+    for (i = 1; i < count; i++)
+    {
+        if (CompareBounds(&index->bounds[i],
+            &index->bounds[index->boundCount - 1]) != 0)
+        {
+            index->bounds[index->boundCount++] = index->bounds[i];
+        }
+    }
+
+    index->start = (unsigned int *)calloc(index->boundCount + 1,
+        sizeof(unsigned int));
+
+    if (NULL == index->start)
+    {
+        Unbuild(index);
+        return -1;
+    }
+
+    for (i = 0; i < index->count; i++)
+    {
+        filter = &index->filters[i];
+        first = Locate(index, filter->low, filter->lowLength);
+        last = filter->bounded ?
+            Locate(index, filter->high, filter->highLength) :
+            (int)index->boundCount;
+
+        for (segment = first; segment < last; segment++)
+        {
+            index->start[segment]++;
+        }
+    }
+
+    for (i = 1; i <= index->boundCount; i++)
+    {
+        index->start[i] += index->start[i - 1];
+    }
+
+    /* start[boundCount] was 0, so it's now the total */
+    index->owners = (void **)malloc((index->start[index->boundCount] + 1) *
+        sizeof(void *));
+
+    if (NULL == index->owners)
+    {
+        Unbuild(index);
+        return -1;
+    }
+
+    for (i = 0; i < index->count; i++)
+    {
+        filter = &index->filters[i];
+        first = Locate(index, filter->low, filter->lowLength);
+        last = filter->bounded ?
+            Locate(index, filter->high, filter->highLength) :
+            (int)index->boundCount;
+
+        for (segment = first; segment < last; segment++)
+        {
+            index->owners[--index->start[segment]] = filter->owner;
+        }
+    }
+
+    index->built = 1;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : Locate
+*   Description: This routine binary searches for the segment holding a
+*                key, the one starting at the greatest bound that isn't
+*                above it.
+*   Parameters : index - the built filter index.
+*                key - the key.
+*                length - the length of key.
+*   Effects    : None
+*   Returned   : The segment, or -1 if the key is below every bound.
+***************************************************************************/
+static int Locate(const filter_index_t *index, const unsigned char *key,
+    size_t length)
+{
+    unsigned int low, high, middle;
+
+    /* the segment is below high, and none below low holds the key */
+    low = 0;
+    high = index->boundCount;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (Compare(index->bounds[middle].key, index->bounds[middle].length,
+            key, length) <= 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (int)low - 1;
+}
+
+
+/***************************************************************************
+*   Function   : Compare
+*   Description: This routine orders two keys byte by byte, with a key
+*                before every longer key it starts.
+*   Parameters : key1, length1 - the first key and its length.
+*                key2, length2 - the second key and its length.
+*   Effects    : None
+*   Returned   : < 0, 0 or > 0 as key1 is before, equal to or after key2.
+***************************************************************************/
+static int Compare(const unsigned char *key1, size_t length1,
+    const unsigned char *key2, size_t length2)
+{
+    int result;
+
+    result = memcmp(key1, key2, (length1 < length2) ? length1 : length2);
+
+    if (0 != result)
+    {
+        return result;
+    }
+
+    return (length1 > length2) - (length1 < length2);
+}
+
+
+/***************************************************************************
+*   Function   : CompareBounds
+*   Description: This is the qsort comparison for filter bounds.
+*   Parameters : b1, b2 - the bounds.
+*   Effects    : None
+*   Returned   : < 0, 0 or > 0 as b1 is before, equal to or after b2.
+***************************************************************************/
+static int CompareBounds(const void *b1, const void *b2)
+{
+    const filter_bound_t *bound1 = (const filter_bound_t *)b1;
+    const filter_bound_t *bound2 = (const filter_bound_t *)b2;
+
+    return Compare(bound1->key, bound1->length, bound2->key, bound2->length);
+}
+
+
+/***************************************************************************
+*   Function   : Unbuild
+*   Description: This routine frees an index's segments after its filters
+*                change, FilterMatch rebuilds them when they're next used.
+*   Parameters : index - the filter index.
+*   Effects    : The segments are freed.
+*   Returned   : None
+***************************************************************************/
+static void Unbuild(filter_index_t *index)
+{
+    free(index->bounds);
+    free(index->start);
+    free(index->owners);
+    index->bounds = NULL;
+    index->start = NULL;
+    index->owners = NULL;
+    index->boundCount = 0;
+    index->built = 0;
+}
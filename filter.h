@@ -0,0 +1,115 @@
+/***************************************************************************
+*                      Subscriber Content Filter Index
+*
+*   File    : filter.h
+*   Purpose : This file provides the constants, types and prototypes for
+*             an index of subscriber filters keyed by message key.  A
+*             broadcast looks up the subscribers whose filters match its
+*             key instead of checking every subscriber's filters.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Filter: Key prefix and range subscriptions for the echo servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef FILTER_H
+#define FILTER_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define FILTER_KEY_MAX  64          /* longest key or filter bound */
+#define FILTER_SUB      "#sub"      /* command that adds a filter */
+#define FILTER_UNSUB    "#unsub"    /* command that removes them all */
+#define FILTER_RANGE    ".."        /* separates a range's bounds */
+
+/* FilterCommand results */
+#define FILTER_NONE     0           /* not a filter command */
+#define FILTER_CHANGED  1           /* the owner's filters changed */
+#define FILTER_BAD      -1          /* a malformed or refused command */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* the keys from low up to, but not including, high */
+typedef struct filter_t
+{
+    void *owner;                    /* the subscriber it belongs to */
+    unsigned char low[FILTER_KEY_MAX];
+    size_t lowLength;
+    unsigned char high[FILTER_KEY_MAX + 1];
+    size_t highLength;
+    int bounded;                    /* 0 if every key from low on matches */
+} filter_t;
+
+typedef struct filter_bound_t
+{
+    const unsigned char *key;
+    size_t length;
+} filter_bound_t;
+
+/* all zeros is an empty index */
+typedef struct filter_index_t
+{
+    filter_t *filters;
+    unsigned int count;             /* filters in use */
+    unsigned int size;              /* filters allocated */
+
+    /* the key space cut into segments at every bound, rebuilt when the
+       filters have changed (see FilterMatch) */
+    int built;
+    filter_bound_t *bounds;         /* sorted distinct bounds */
+    unsigned int boundCount;        /* segment i starts at bounds[i] */
+    unsigned int *start;            /* segment i's first entry in owners */
+    void **owners;                  /* owners whose filters cover each */
+} filter_index_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int FilterAdd(filter_index_t *index, void *owner, const char *spec,
+    size_t length);
+unsigned int FilterRemove(filter_index_t *index, const void *owner);
+unsigned int FilterOwned(const filter_index_t *index, const void *owner);
+int FilterCommand(filter_index_t *index, void *owner, const char *message,
+    size_t length, unsigned int limit);
+size_t FilterKeyLength(const char *message, size_t length);
+int FilterMatch(filter_index_t *index, const char *key, size_t length,
+    void ***owners);
+void FilterFree(filter_index_t *index);
+
+#endif  /* ndef FILTER_H */
@@ -0,0 +1,110 @@
+/***************************************************************************
+*                      Per-Connection Flight Recorder
+*
+*   File    : flightrec.c
+*   Purpose : This file provides the routines for initializing and dumping
+*             the per-connection flight recorders.  Events are recorded by
+*             the inline FlightRecord routine in flightrec.h.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Flight Recorder: Connection event recorder for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+
+#include "flightrec.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+static const char * const typeNames[FR_NUM_TYPES] =
+{
+    "open", "recv", "backlog", "send", "eagain", "error", "close", "move"
+};
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : FlightInit
+*   Description: This routine initializes an empty flight recorder.
+*   Parameters : rec - the recorder.
+*   Effects    : The recorder is cleared.
+*   Returned   : None
+***************************************************************************/
+void FlightInit(flight_rec_t *rec)
+{
+    memset(rec, 0, sizeof(flight_rec_t));
+}
+
+
+/***************************************************************************
+*   Function   : FlightPrint
+*   Description: This routine writes the events held by a flight recorder,
+*                oldest first, one per line.  Event times are written in
+*                microseconds before the most recent event.
+*   Parameters : rec - the recorder.
+*                stream - where to write the events.
+*   Effects    : The events are written to stream.
+*   Returned   : None
+***************************************************************************/
+void FlightPrint(const flight_rec_t *rec, FILE *stream)
+{
+    unsigned int i, count;
+    const flight_event_t *event, *newest;
+
+    count = (rec->next < FLIGHT_EVENTS) ? rec->next : FLIGHT_EVENTS;
+
+    if (0 == count)
+    {
+        fprintf(stream, "  no events\n");
+        return;
+    }
+
+    newest = &(rec->events[(rec->next - 1) & (FLIGHT_EVENTS - 1)]);
+
+    for (i = rec->next - count; i != rec->next; i++)
+    {
+        event = &(rec->events[i & (FLIGHT_EVENTS - 1)]);
+
+        fprintf(stream, "  #%u %10.1fus %-8s %u\n", i,
+            (event->time - newest->time) / 1000.0,
+            (event->type < FR_NUM_TYPES) ? typeNames[event->type] : "?",
+            event->value);
+    }
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+*                  Per-Connection Flight Recorder Header
+*
+*   File    : flightrec.h
+*   Purpose : This file provides the types, prototypes and inline recording
+*             routine for a tiny fixed size ring of recent events that is
+*             kept for each connection or source.  Recording an event is a
+*             handful of stores with no allocation, so the recorder can stay
+*             on all the time and be dumped after a latency spike.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Flight Recorder: Connection event recorder for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define FLIGHT_EVENTS   16      /* events kept per recorder (power of 2) */
+
+typedef enum
+{
+    FR_OPEN,                    /* connection accepted or source added */
+    FR_RECV,                    /* value is bytes received */
+    FR_BACKLOG,                 /* value is bytes still waiting (FIONREAD) */
+    FR_SEND,                    /* value is bytes sent */
+    FR_EAGAIN,                  /* send would have blocked */
+    FR_ERROR,                   /* value is errno */
+    FR_CLOSE,                   /* connection closed or source removed */
+    FR_MOVE,                    /* value is the worker it migrated to */
+    FR_NUM_TYPES
+} flight_type_t;
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct flight_event_t
+{
+    long long time;             /* monotonic time (ns) */
+    unsigned int type;          /* flight_type_t */
+    unsigned int value;         /* meaning depends on type */
+} flight_event_t;
+
+typedef struct flight_rec_t
+{
+    unsigned int next;          /* total events recorded */
+    flight_event_t events[FLIGHT_EVENTS];
+} flight_rec_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+void FlightInit(flight_rec_t *rec);
+void FlightPrint(const flight_rec_t *rec, FILE *stream);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : FlightRecord
+*   Description: This routine records an event, overwriting the oldest
+*                event once the ring is full.
+*   Parameters : rec - the recorder.
+*                type - the type of event.
+*                value - the event's value.
+*                now - the time of the event (ns).
+*   Effects    : The event is stored in rec.
+*   Returned   : None
+***************************************************************************/
+static inline void FlightRecord(flight_rec_t *rec, flight_type_t type,
+    unsigned int value, long long now)
+{
+    flight_event_t *event;
+
+    event = &(rec->events[rec->next & (FLIGHT_EVENTS - 1)]);
+    event->time = now;
+    event->type = type;
+    event->value = value;
+    rec->next++;
+}
+
+#endif  /* ndef FLIGHTREC_H */
@@ -0,0 +1,212 @@
+/***************************************************************************
+*                     Connection Handoff Between Processes
+*
+*   File    : handoff.c
+*   Purpose : This file implements passing a connected socket between the
+*             processes of a pre-forked server.  The socket travels as
+*             SCM_RIGHTS ancillary data on a SOCK_SEQPACKET socket pair,
+*             so each socket arrives with exactly the message that was
+*             sent with it.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Handoff: Passes sockets between the processes of the echo server
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "handoff.h"
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : HandoffPair
+*   Description: This routine creates the socket pair two processes pass
+*                sockets over.  Each end's send buffer is grown to hold a
+*                few HANDOFF_MAX messages.
+*   Parameters : fds - set to the two ends of the pair.
+*   Effects    : A socket pair is created.
+*   Returned   : 0 for success, otherwise -1.
+***************************************************************************/
+int HandoffPair(int fds[2])
+{
+    int size, i;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+    {
+        perror("Error creating handoff socket pair");
+        return -1;
+    }
+
+    size = 4 * HANDOFF_MAX;
+
+    for (i = 0; i < 2; i++)
+    {
+        /* failing leaves the default, which is still big enough */
+        setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : HandoffSend
+*   Description: This routine sends a message and, optionally, a socket
+*                over a handoff socket without waiting.  The sender's copy
+*                of the socket stays open until the sender closes it.
+*   Parameters : sock - the handoff socket.
+*                fd - the socket to pass, or -1 to send only the message.
+*                data - the message.
+*                length - the length of the message (at most HANDOFF_MAX).
+*   Effects    : The message and socket are queued for the other process.
+*   Returned   : 0 for success, otherwise -1 (with errno set, EAGAIN if
+*                the other process isn't keeping up).
+***************************************************************************/
+int HandoffSend(int sock, int fd, const void *data, size_t length)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    iov.iov_base = (void *)data;
+    iov.iov_len = length;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    if (sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : HandoffReceive
+*   Description: This routine receives the next message, and the socket
+*                sent with it, from a handoff socket without waiting.  A
+*                message that doesn't fit is discarded along with its
+*                socket.
+*   Parameters : sock - the handoff socket.
+*                fd - set to the socket that came with the message, or -1.
+*                data - buffer for the message.
+*                size - size of the buffer.
+*   Effects    : A message is removed from the handoff socket.
+*   Returned   : The length of the message, 0 if the other process closed
+*                its end, otherwise -1 (with errno set, EAGAIN if there's
+*                nothing waiting).
+***************************************************************************/
+ssize_t HandoffReceive(int sock, int *fd, void *data, size_t size)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t length;
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    *fd = -1;
+    iov.iov_base = data;
+    iov.iov_len = size;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    length = recvmsg(sock, &msg, MSG_DONTWAIT);
+
+    if (length <= 0)
+    {
+        return length;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+        cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if ((SOL_SOCKET == cmsg->cmsg_level) &&
+            (SCM_RIGHTS == cmsg->cmsg_type) &&
+            (cmsg->cmsg_len >= CMSG_LEN(sizeof(int))))
+        {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    return length;
+}
@@ -0,0 +1,376 @@
+/***************************************************************************
+*                     Event Loop Lag and Stall Monitor
+*
+*   File    : loopmon.c
+*   Purpose : This file provides a monitor that times each iteration of a
+*             poll loop.  Time spent waiting in poll is kept separate from
+*             time spent processing, processing times are kept in a log2
+*             histogram, and iterations that take longer than a threshold
+*             record a compact stall report.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Loop Monitor: Event loop monitor for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+#include <time.h>
+
+#include "loopmon.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define NS_PER_SEC  1000000000LL
+#define NS_PER_USEC 1000LL
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : LoopMonNow
+*   Description: This routine returns the monotonic clock in nanoseconds.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : The current time in nanoseconds.
+***************************************************************************/
+long long LoopMonNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonBucket
+*   Description: This routine returns the histogram bucket for a duration.
+*                Bucket 0 holds durations under 2us, bucket n holds
+*                durations from 2^n us up to 2^(n+1) us, and the last
+*                bucket holds everything longer.
+*   Parameters : ns - the duration in nanoseconds.
+*   Effects    : None
+*   Returned   : The bucket index.
+***************************************************************************/
+unsigned int LoopMonBucket(long long ns)
+{
+    unsigned int bucket;
+    long long us;
+
+    us = ns / NS_PER_USEC;
+    bucket = 0;
+
+    while ((us > 1) && (bucket < (LOOPMON_BUCKETS - 1)))
+    {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonInit
+*   Description: This routine initializes a loop monitor.
+*   Parameters : mon - the monitor being initialized.
+*                thresholdUs - iterations that spend longer than this
+*                processing (in microseconds) are reported as stalls.
+*   Effects    : The monitor is cleared.
+*   Returned   : None
+***************************************************************************/
+void LoopMonInit(loop_monitor_t *mon, unsigned long thresholdUs)
+{
+    memset(mon, 0, sizeof(loop_monitor_t));
+    mon->thresholdNs = thresholdUs * NS_PER_USEC;
+    mon->current.longestFd = -1;
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonPollStart
+*   Description: This routine is called just before the loop blocks in
+*                poll.  It ends the iteration that is in progress, so
+*                everything the loop does between polls counts as
+*                processing time.
+*   Parameters : mon - the loop's monitor.
+*   Effects    : The previous iteration ends and the start of the poll
+*                wait is recorded.
+*   Returned   : None
+***************************************************************************/
+void LoopMonPollStart(loop_monitor_t *mon)
+{
+    if (mon->inIteration)
+    {
+        LoopMonIterationEnd(mon);   /* also sets pollStart */
+    }
+    else
+    {
+        mon->pollStart = LoopMonNow();
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonPollEnd
+*   Description: This routine is called as soon as poll returns.  It
+*                starts the processing portion of the iteration.
+*   Parameters : mon - the loop's monitor.
+*   Effects    : The poll wait is accumulated and a new iteration starts.
+*   Returned   : None
+***************************************************************************/
+void LoopMonPollEnd(loop_monitor_t *mon)
+{
+    mon->pollEnd = LoopMonNow();
+    mon->totalPollNs += mon->pollEnd - mon->pollStart;
+    mon->inIteration = 1;
+
+    mon->current.fdsServiced = 0;
+    mon->current.bytesSent = 0;
+    mon->current.longestFd = -1;
+    mon->current.longestNs = 0;
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonCallbackStart
+*   Description: This routine is called before servicing a ready fd.
+*   Parameters : mon - the loop's monitor.
+*   Effects    : The start of the callback is recorded.
+*   Returned   : None
+***************************************************************************/
+void LoopMonCallbackStart(loop_monitor_t *mon)
+{
+    mon->callbackStart = LoopMonNow();
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonCallbackEnd
+*   Description: This routine is called after servicing a ready fd.  It
+*                keeps track of the slowest callback in the iteration.
+*   Parameters : mon - the loop's monitor.
+*                fd - the fd that was serviced.
+*                bytesSent - the number of bytes the callback sent.
+*   Effects    : The iteration's totals are updated.
+*   Returned   : None
+***************************************************************************/
+void LoopMonCallbackEnd(loop_monitor_t *mon, int fd, size_t bytesSent)
+{
+    long long duration;
+
+    duration = LoopMonNow() - mon->callbackStart;
+    mon->current.fdsServiced++;
+    mon->current.bytesSent += bytesSent;
+
+    if (duration > mon->current.longestNs)
+    {
+        mon->current.longestNs = duration;
+        mon->current.longestFd = fd;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonIterationEnd
+*   Description: This routine ends the iteration in progress.  It is
+*                called by LoopMonPollStart, and should only be called
+*                directly when the loop exits.  The processing time is
+*                added to the histogram, and if it exceeds the threshold
+*                a stall report is recorded and written to stderr.
+*   Parameters : mon - the loop's monitor.
+*   Effects    : The monitor's totals are updated.
+*   Returned   : None
+***************************************************************************/
+void LoopMonIterationEnd(loop_monitor_t *mon)
+{
+    long long now, duration;
+    stall_report_t *report;
+
+    now = LoopMonNow();
+    duration = now - mon->pollEnd;
+    mon->pollStart = now;
+    mon->inIteration = 0;
+
+    mon->iterations++;
+    mon->totalProcessNs += duration;
+    mon->histogram[LoopMonBucket(duration)]++;
+
+    if ((mon->thresholdNs > 0) && (duration > mon->thresholdNs))
+    {
+        report = &(mon->reports[mon->stalls % LOOPMON_REPORTS]);
+        memcpy(report, &(mon->current), sizeof(stall_report_t));
+        report->when = now;
+        report->processNs = duration;
+        report->pollNs = mon->pollEnd - mon->pollStart;
+        mon->stalls++;
+
+        LoopMonPrintReport(report, stderr);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonPrintReport
+*   Description: This routine writes a stall report as a single line.
+*   Parameters : report - the report to write.
+*                stream - where to write it.
+*   Effects    : The report is written to stream.
+*   Returned   : None
+***************************************************************************/
+void LoopMonPrintReport(const stall_report_t *report, FILE *stream)
+{
+    fprintf(stream, "stall: at_ms=%lld busy_us=%lld poll_us=%lld fds=%u "
+        "bytes_sent=%llu longest_fd=%d longest_us=%lld\n",
+        report->when / (NS_PER_SEC / 1000), report->processNs / NS_PER_USEC,
+        report->pollNs / NS_PER_USEC, report->fdsServiced,
+        report->bytesSent, report->longestFd,
+        report->longestNs / NS_PER_USEC);
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonPrint
+*   Description: This routine writes the monitor's totals as one line of
+*                key=value pairs, followed by a line with the non-empty
+*                histogram buckets and the retained stall reports.
+*   Parameters : mon - the loop's monitor.
+*                stream - where to write it.
+*   Effects    : The monitor's summary is written to stream.
+*   Returned   : None
+***************************************************************************/
+void LoopMonPrint(const loop_monitor_t *mon, FILE *stream)
+{
+    unsigned int i, count;
+
+    fprintf(stream, "loop: iterations=%llu poll_ms=%lld busy_ms=%lld "
+        "stalls=%lu\n", mon->iterations, mon->totalPollNs / 1000000LL,
+        mon->totalProcessNs / 1000000LL, mon->stalls);
+
+    LoopMonPrintHist("loop_busy_hist", mon->histogram, stream);
+
+    count = (mon->stalls < LOOPMON_REPORTS) ? mon->stalls : LOOPMON_REPORTS;
+
+    for (i = 0; i < count; i++)
+    {
+        LoopMonPrintReport(&(mon->reports[(mon->stalls - count + i) %
+            LOOPMON_REPORTS]), stream);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonPrintHist
+*   Description: This routine writes the non-empty buckets of a histogram
+*                of durations kept with LoopMonBucket.
+*   Parameters : name - the label the line starts with.
+*                histogram - LOOPMON_BUCKETS counts.
+*                stream - where to write it.
+*   Effects    : One line is written to stream.
+*   Returned   : None
+***************************************************************************/
+void LoopMonPrintHist(const char *name, const unsigned long *histogram,
+    FILE *stream)
+{
+    unsigned int i;
+
+    fprintf(stream, "%s:", name);
+
+    for (i = 0; i < LOOPMON_BUCKETS; i++)
+    {
+        if (histogram[i] != 0)
+        {
+            fprintf(stream, " %s%luus=%lu",
+                (i == (LOOPMON_BUCKETS - 1)) ? ">=" : "<",
+                (i == (LOOPMON_BUCKETS - 1)) ? (1UL << i) : (2UL << i),
+                histogram[i]);
+        }
+    }
+
+    fprintf(stream, "\n");
+}
+
+
+/***************************************************************************
+*   Function   : LoopMonHistPercentile
+*   Description: This routine estimates a percentile of a histogram of
+*                durations kept with LoopMonBucket.  The estimate is the
+*                upper bound of the bucket holding the percentile, so it
+*                is within a factor of two of the real value.
+*   Parameters : histogram - LOOPMON_BUCKETS counts.
+*                pct - the percentile (0.0 - 100.0).
+*   Effects    : None
+*   Returned   : The estimate in microseconds, 0 for an empty histogram.
+***************************************************************************/
+unsigned long LoopMonHistPercentile(const unsigned long *histogram,
+    double pct)
+{
+    unsigned long total, rank, seen;
+    unsigned int i;
+
+    total = 0;
+
+    for (i = 0; i < LOOPMON_BUCKETS; i++)
+    {
+        total += histogram[i];
+    }
+
+    if (0 == total)
+    {
+        return 0;
+    }
+
+    rank = (unsigned long)((pct / 100.0) * (total - 1)) + 1;
+    seen = 0;
+
+    for (i = 0; i < (LOOPMON_BUCKETS - 1); i++)
+    {
+        seen += histogram[i];
+
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    return (i == (LOOPMON_BUCKETS - 1)) ? (1UL << i) : (2UL << i);
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+*                 Event Loop Lag and Stall Monitor Header
+*
+*   File    : loopmon.h
+*   Purpose : This file provides the prototypes and types for a monitor that
+*             times each iteration of a poll loop, keeps a histogram of
+*             processing times, and records a report for iterations that
+*             stall.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Loop Monitor: Event loop monitor for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef LOOPMON_H
+#define LOOPMON_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define LOOPMON_BUCKETS     24      /* log2(usec) histogram buckets */
+#define LOOPMON_REPORTS     16      /* most recent stall reports kept */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct stall_report_t
+{
+    long long when;                 /* monotonic time of the stall (ns) */
+    long long processNs;            /* time spent processing */
+    long long pollNs;               /* time spent waiting in poll */
+    unsigned int fdsServiced;       /* callbacks made in the iteration */
+    unsigned long long bytesSent;   /* bytes sent in the iteration */
+    int longestFd;                  /* fd of the slowest callback */
+    long long longestNs;            /* duration of the slowest callback */
+} stall_report_t;
+
+typedef struct loop_monitor_t
+{
+    long long thresholdNs;          /* iterations longer than this stall */
+    unsigned long long iterations;
+    long long totalPollNs;
+    long long totalProcessNs;
+    unsigned long histogram[LOOPMON_BUCKETS];   /* processing times */
+    unsigned long stalls;
+    stall_report_t reports[LOOPMON_REPORTS];    /* ring of stall reports */
+
+    /* the iteration in progress */
+    int inIteration;
+    long long pollStart;
+    long long pollEnd;
+    long long callbackStart;
+    stall_report_t current;
+} loop_monitor_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+long long LoopMonNow(void);
+void LoopMonInit(loop_monitor_t *mon, unsigned long thresholdUs);
+void LoopMonPollStart(loop_monitor_t *mon);
+void LoopMonPollEnd(loop_monitor_t *mon);
+void LoopMonCallbackStart(loop_monitor_t *mon);
+void LoopMonCallbackEnd(loop_monitor_t *mon, int fd, size_t bytesSent);
+void LoopMonIterationEnd(loop_monitor_t *mon);
+void LoopMonPrintReport(const stall_report_t *report, FILE *stream);
+void LoopMonPrint(const loop_monitor_t *mon, FILE *stream);
+unsigned int LoopMonBucket(long long ns);
+void LoopMonPrintHist(const char *name, const unsigned long *histogram,
+    FILE *stream);
+unsigned long LoopMonHistPercentile(const unsigned long *histogram,
+    double pct);
+
+#endif  /* ndef LOOPMON_H */
@@ -0,0 +1,276 @@
+/***************************************************************************
+*                       Low Latency Process Setup
+*
+*   File    : lowlat.c
+*   Purpose : This file implements the servers' low latency mode.  Page
+*             faults and preemption are the usual sources of millisecond
+*             outliers in an event loop that otherwise takes microseconds,
+*             so the process locks its memory (touching every page now
+*             instead of on first use), keeps malloc from handing memory
+*             back to the kernel, stays on one CPU and, if asked, runs
+*             under SCHED_FIFO.  Everything is read back afterwards, so a
+*             server never silently runs with less than it asked for.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Low Latency: Memory locking, CPU pinning and SCHED_FIFO for the servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#define _GNU_SOURCE         /* CPU_SET and friends */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <malloc.h>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "lowlat.h"
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void PrefaultStack(void);
+static long LockedKb(void);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : LowLatCpu
+*   Description: This routine picks the CPU for a process of a server,
+*                the index-th of the CPUs it's allowed to run on (wrapping
+*                around), so processes started under taskset stay within
+*                its CPUs and pre-forked workers get a CPU each.
+*   Parameters : index - the process's index (0 for a single process).
+*   Effects    : None
+*   Returned   : The CPU number, or -1 if the allowed CPUs are unknown.
+***************************************************************************/
+int LowLatCpu(unsigned int index)
+{
+    cpu_set_t allowed;
+    int cpu, count;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return -1;
+    }
+
+    count = CPU_COUNT(&allowed);
+
+    if (0 == count)
+    {
+        return -1;
+    }
+
+    index %= count;
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed) && (0 == index--))
+        {
+            return cpu;
+        }
+    }
+
+    return -1;
+}
+
+
+/***************************************************************************
+*   Function   : LowLatStart
+*   Description: This routine puts the calling process in low latency
+*                mode.  It should be called once everything the process
+*                needs up front (pools, rings) is allocated.  Memory is
+*                locked, current and future, which faults in every mapped
+*                page; LOWLAT_STACK_SIZE of stack is touched; malloc is
+*                told never to trim its heap or use mmap, so freed memory
+*                stays locked for reuse; the process is pinned to cpu; and
+*                with a priority it's switched to SCHED_FIFO.  Each of
+*                these is then read back and a "lowlat:" line reports what
+*                the process got, including the page faults the setup
+*                took.  Memory locks and scheduling aren't inherited by
+*                fork, so every process calls this for itself.
+*   Parameters : cpu - the CPU to run on, or -1 to leave it unpinned.
+*                priority - the SCHED_FIFO priority, 0 for the normal
+*                scheduler.
+*                stream - where to write the "lowlat:" line.
+*   Effects    : The process's memory, CPU affinity and scheduling are
+*                changed.
+*   Returned   : 0 if the process got everything it asked for, otherwise
+*                -1 (and the reason is written to stderr).
+***************************************************************************/
+int LowLatStart(int cpu, int priority, FILE *stream)
+{
+    struct rusage before, after;
+    struct sched_param param;
+    cpu_set_t cpus;
+    long locked;
+    int result, policy;
+
+    result = 0;
+    getrusage(RUSAGE_SELF, &before);
+
+    /* freed memory is kept (and stays locked) for the next malloc */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("Error locking memory (see ulimit -l)");
+        result = -1;
+    }
+
+    PrefaultStack();
+
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+        {
+            perror("Error pinning to a CPU");
+            result = -1;
+        }
+    }
+
+    if (priority > 0)
+    {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+        {
+            perror("Error setting SCHED_FIFO (needs CAP_SYS_NICE)");
+            result = -1;
+        }
+    }
+
+    getrusage(RUSAGE_SELF, &after);
+
+    /* make sure we got what we asked for */
+    locked = LockedKb();
+
+    if (locked <= 0)
+    {
+        fprintf(stderr, "Memory isn't locked\n");
+        result = -1;
+    }
+
+    if ((cpu >= 0) &&
+        ((sched_getaffinity(0, sizeof(cpus), &cpus) != 0) ||
+        (CPU_COUNT(&cpus) != 1) || !CPU_ISSET(cpu, &cpus)))
+    {
+        fprintf(stderr, "Not pinned to CPU %d\n", cpu);
+        result = -1;
+    }
+
+    policy = sched_getscheduler(0);
+    memset(&param, 0, sizeof(param));
+    sched_getparam(0, &param);
+
+    if ((priority > 0) &&
+        ((SCHED_FIFO != policy) || (param.sched_priority != priority)))
+    {
+        fprintf(stderr, "Not running SCHED_FIFO at priority %d\n",
+            priority);
+        result = -1;
+    }
+
+    fprintf(stream, "lowlat: pid=%d locked_kb=%ld prefault_faults=%ld "
+        "cpu=%d policy=%s priority=%d ok=%d\n", (int)getpid(), locked,
+        after.ru_minflt - before.ru_minflt, (cpu >= 0) ? sched_getcpu() : -1,
+        (SCHED_FIFO == policy) ? "fifo" : "other", param.sched_priority,
+        (0 == result) ? 1 : 0);
+
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : PrefaultStack
+*   Description: This routine touches LOWLAT_STACK_SIZE bytes of stack
+*                below its caller, so the stack pages a deep call chain
+*                needs are mapped (and locked) before they're used.
+*   Parameters : None
+*   Effects    : Stack pages are faulted in.
+*   Returned   : None
+***************************************************************************/
+static void PrefaultStack(void)
+{
+    volatile char stack[LOWLAT_STACK_SIZE];
+
+    memset((char *)stack, 0, sizeof(stack));
+}
+
+
+/***************************************************************************
+*   Function   : LockedKb
+*   Description: This routine reads how much of the process's memory is
+*                locked from /proc/self/status.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : The VmLck value in kB, or -1 if it couldn't be read.
+***************************************************************************/
+static long LockedKb(void)
+{
+    FILE *status;
+    char line[128];
+    long kb;
+
+    status = fopen("/proc/self/status", "r");
+
+    if (NULL == status)
+    {
+        return -1;
+    }
+
+    kb = -1;
+
+    while (fgets(line, sizeof(line), status) != NULL)
+    {
+        if (sscanf(line, "VmLck: %ld", &kb) == 1)
+        {
+            break;
+        }
+    }
+
+    fclose(status);
+    return kb;
+}
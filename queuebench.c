@@ -0,0 +1,744 @@
+/***************************************************************************
+*                        Ring Queue Microbenchmark
+*
+*   File    : queuebench.c
+*   Purpose : This file provides a microbenchmark for the lock-free ring
+*             queues.  It measures throughput from one or more pinned
+*             producer threads to a pinned consumer, or the round trip
+*             latency between two pinned threads, and writes the results as
+*             a JSON object.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Ring Queue Benchmark: Queue microbenchmark for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#define _GNU_SOURCE             /* for pthread_setaffinity_np */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "ringq.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define MAX_PRODUCERS   16
+#define MAX_BATCH       256
+#define SPINS_PER_YIELD 64          /* failed tries before sched_yield */
+#define NS_PER_SEC      1000000000LL
+#define PRODUCER_SHIFT  48          /* item = producer << shift | sequence */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct qbench_opts_t
+{
+    int mpsc;                   /* non-zero for mpsc_queue_t */
+    int producers;
+    unsigned long items;        /* per producer, or round trips */
+    size_t batch;
+    size_t capacity;
+    int wait;                   /* consumers park instead of spinning */
+    int latency;                /* round trip mode */
+    int cpus[MAX_PRODUCERS + 1];    /* consumer first, then producers */
+    int numCpus;
+    const char *cpuList;
+} qbench_opts_t;
+
+typedef struct qbench_queue_t
+{
+    spsc_queue_t spsc;
+    mpsc_queue_t mpsc;
+} qbench_queue_t;
+
+typedef struct producer_t
+{
+    pthread_t thread;
+    int id;
+    int cpu;
+} producer_t;
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+static qbench_opts_t opts;
+static qbench_queue_t queues[2];    /* 0: to the consumer, 1: replies */
+static pthread_barrier_t startBarrier;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+long long NowNs(void);
+void Pin(int cpu);
+void Backoff(unsigned int *spins);
+size_t Push(qbench_queue_t *queue, void *const *items, size_t count);
+size_t Pop(qbench_queue_t *queue, void **items, size_t count);
+void Wait(qbench_queue_t *queue);
+unsigned long Wakeups(const qbench_queue_t *queue);
+void *Producer(void *arg);
+void *Echo(void *arg);
+void RunThroughput(void);
+void RunLatency(void);
+int CompareSamples(const void *s1, const void *s2);
+void Usage(const char *prog);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : main
+*   Description: This is the main function for this program.  It parses
+*                the command line, creates the queues and runs either the
+*                throughput or the latency benchmark.
+*   Parameters : argc - number of parameters
+*                argv - parameter list
+*   Effects    : Results are written to stdout as JSON.
+*   Returned   : EXIT_SUCCESS for success, otherwise EXIT_FAILURE.
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt, i;
+    long numCpus;
+    char *list, *token;
+
+    opts.producers = 1;
+    opts.items = 0;
+    opts.batch = 1;
+    opts.capacity = 1024;
+    opts.cpuList = "0,1";
+
+    while ((opt = getopt(argc, argv, "t:p:n:b:q:c:wl")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                if (0 == strcmp(optarg, "mpsc"))
+                {
+                    opts.mpsc = 1;
+                }
+                else if (0 != strcmp(optarg, "spsc"))
+                {
+                    Usage(argv[0]);
+                }
+                break;
+
+            case 'p':
+                opts.producers = atoi(optarg);
+                break;
+
+            case 'n':
+                opts.items = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'b':
+                opts.batch = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'q':
+                opts.capacity = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'c':
+                opts.cpuList = optarg;
+                break;
+
+            case 'w':
+                opts.wait = 1;
+                break;
+
+            case 'l':
+                opts.latency = 1;
+                break;
+
+            default:
+                Usage(argv[0]);
+                break;
+        }
+    }
+
+    if ((optind != argc) || (opts.producers < 1) ||
+        (opts.producers > MAX_PRODUCERS) ||
+        ((opts.producers > 1) && !opts.mpsc) ||
+        (opts.batch < 1) || (opts.batch > MAX_BATCH) ||
+        (opts.capacity < opts.batch))
+    {
+        Usage(argv[0]);
+    }
+
+    if (0 == opts.items)
+    {
+        opts.items = opts.latency ? 100000 : 10000000;
+    }
+
+    /* cpus beyond the list reuse it from the start */
+    numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    list = strdup(opts.cpuList);
+
+    for (token = strtok(list, ","); (NULL != token) &&
+        (opts.numCpus <= MAX_PRODUCERS); token = strtok(NULL, ","))
+    {
+        opts.cpus[opts.numCpus] = atoi(token);
+
+        if ((opts.cpus[opts.numCpus] < 0) ||
+            (opts.cpus[opts.numCpus] >= numCpus))
+        {
+            fprintf(stderr, "cpu %d isn't online, using cpu 0\n",
+                opts.cpus[opts.numCpus]);
+            opts.cpus[opts.numCpus] = 0;
+        }
+
+        opts.numCpus++;
+    }
+
+    free(list);
+
+    if (0 == opts.numCpus)
+    {
+        Usage(argv[0]);
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (opts.mpsc)
+        {
+            if (MpscInit(&(queues[i].mpsc), opts.capacity,
+                opts.wait ? RINGQ_WAKEUP : RINGQ_SPIN) != 0)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (SpscInit(&(queues[i].spsc), opts.capacity,
+            opts.wait ? RINGQ_WAKEUP : RINGQ_SPIN) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (opts.latency)
+    {
+        RunLatency();
+    }
+    else
+    {
+        RunThroughput();
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (opts.mpsc)
+        {
+            MpscFree(&(queues[i].mpsc));
+        }
+        else
+        {
+            SpscFree(&(queues[i].spsc));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/***************************************************************************
+*   Function   : Usage
+*   Description: This routine writes the command line usage to stderr and
+*                exits.
+*   Parameters : prog - the name of this program.
+*   Effects    : The program exits.
+*   Returned   : None
+***************************************************************************/
+void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage:  %s [options]\n"
+        "  -t spsc|mpsc  queue type (default spsc)\n"
+        "  -p <n>     mpsc producer threads (default 1)\n"
+        "  -n <n>     items per producer, or round trips with -l\n"
+        "             (default 10000000, 100000 with -l)\n"
+        "  -b <n>     items per push and pop (default 1, at most %d)\n"
+        "  -q <n>     queue capacity (default 1024)\n"
+        "  -c <list>  cpus, consumer first then producers, reused in\n"
+        "             order when there are more threads (default 0,1)\n"
+        "  -w         park empty consumers on an eventfd instead of "
+        "spinning\n"
+        "  -l         measure round trip latency instead of throughput\n",
+        prog, MAX_BATCH);
+    exit(EXIT_FAILURE);
+}
+
+
+/***************************************************************************
+*   Function   : NowNs
+*   Description: This routine returns the monotonic clock in nanoseconds.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : The current time in nanoseconds.
+***************************************************************************/
+long long NowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+
+/***************************************************************************
+*   Function   : Pin
+*   Description: This routine pins the calling thread to a cpu.
+*   Parameters : cpu - the cpu.
+*   Effects    : The thread only runs on cpu.
+*   Returned   : None
+***************************************************************************/
+void Pin(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        fprintf(stderr, "Unable to pin thread to cpu %d\n", cpu);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Backoff
+*   Description: This routine is called after a push to a full queue or a
+*                pop from an empty one fails.  It yields the cpu every
+*                SPINS_PER_YIELD failures, so threads sharing a cpu still
+*                make progress.
+*   Parameters : spins - the caller's count of failures.
+*   Effects    : The thread may yield.
+*   Returned   : None
+***************************************************************************/
+void Backoff(unsigned int *spins)
+{
+    (*spins)++;
+
+    if (0 == (*spins % SPINS_PER_YIELD))
+    {
+        sched_yield();
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Push
+*   Description: This routine pushes items onto whichever type of queue is
+*                being measured.
+*   Parameters : queue - the queue.
+*                items - the items.
+*                count - the number of items.
+*   Effects    : Items are added to the queue.
+*   Returned   : The number of items pushed.
+***************************************************************************/
+size_t Push(qbench_queue_t *queue, void *const *items, size_t count)
+{
+    if (opts.mpsc)
+    {
+        return MpscPushBatch(&(queue->mpsc), items, count);
+    }
+
+    return SpscPushBatch(&(queue->spsc), items, count);
+}
+
+
+/***************************************************************************
+*   Function   : Pop
+*   Description: This routine pops items from whichever type of queue is
+*                being measured.
+*   Parameters : queue - the queue.
+*                items - receives the items.
+*                count - the most items to pop.
+*   Effects    : Items are removed from the queue.
+*   Returned   : The number of items popped.
+***************************************************************************/
+size_t Pop(qbench_queue_t *queue, void **items, size_t count)
+{
+    if (opts.mpsc)
+    {
+        return MpscPopBatch(&(queue->mpsc), items, count);
+    }
+
+    return SpscPopBatch(&(queue->spsc), items, count);
+}
+
+
+/***************************************************************************
+*   Function   : Wait
+*   Description: This routine parks a consumer until its queue has items.
+*   Parameters : queue - the empty queue.
+*   Effects    : The thread may block on the queue's eventfd.
+*   Returned   : None
+***************************************************************************/
+void Wait(qbench_queue_t *queue)
+{
+    if (opts.mpsc)
+    {
+        MpscWait(&(queue->mpsc), -1);
+    }
+    else
+    {
+        SpscWait(&(queue->spsc), -1);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Wakeups
+*   Description: This routine returns the number of times producers woke
+*                a queue's parked consumer.
+*   Parameters : queue - the queue.
+*   Effects    : None
+*   Returned   : The number of eventfd writes.
+***************************************************************************/
+unsigned long Wakeups(const qbench_queue_t *queue)
+{
+    if (opts.mpsc)
+    {
+        return atomic_load(&(queue->mpsc.wake.wakeups));
+    }
+
+    return atomic_load(&(queue->spsc.wake.wakeups));
+}
+
+
+/***************************************************************************
+*   Function   : Producer
+*   Description: This is the throughput benchmark's producer thread.  It
+*                pushes opts.items numbered items in batches of opts.batch.
+*   Parameters : arg - the producer_t for this thread.
+*   Effects    : Items are pushed onto queues[0].
+*   Returned   : NULL
+***************************************************************************/
+void *Producer(void *arg)
+{
+    producer_t *self;
+    void *items[MAX_BATCH];
+    unsigned long next, i;
+    size_t count, pushed;
+    unsigned int spins;
+
+    self = (producer_t *)arg;
+    Pin(self->cpu);
+    pthread_barrier_wait(&startBarrier);
+    spins = 0;
+
+    for (next = 0; next < opts.items; next += count)
+    {
+        count = opts.batch;
+
+        if (count > (opts.items - next))
+        {
+            count = opts.items - next;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            items[i] = (void *)(uintptr_t)
+                (((uint64_t)self->id << PRODUCER_SHIFT) | (next + i));
+        }
+
+        pushed = 0;
+
+        while (pushed < count)
+        {
+            size_t result;
+
+            result = Push(&queues[0], items + pushed, count - pushed);
+
+            if (0 == result)
+            {
+                Backoff(&spins);
+            }
+
+            pushed += result;
+        }
+    }
+
+    return NULL;
+}
+
+
+/***************************************************************************
+*   Function   : RunThroughput
+*   Description: This routine starts the producers, consumes every item
+*                on the calling thread (pinned to the first cpu), checks
+*                that each producer's items arrive in order, and writes
+*                the results.
+*   Parameters : None
+*   Effects    : Results are written to stdout.
+*   Returned   : None
+***************************************************************************/
+void RunThroughput(void)
+{
+    producer_t producers[MAX_PRODUCERS];
+    unsigned long expected[MAX_PRODUCERS];
+    unsigned long total, received, orderErrors, emptyPolls;
+    void *items[MAX_BATCH];
+    unsigned int spins;
+    long long start, stop;
+    size_t count, i;
+    int p;
+
+    Pin(opts.cpus[0]);
+    pthread_barrier_init(&startBarrier, NULL, opts.producers + 1);
+
+    for (p = 0; p < opts.producers; p++)
+    {
+        producers[p].id = p;
+        producers[p].cpu = opts.cpus[(p + 1) % opts.numCpus];
+        expected[p] = 0;
+        pthread_create(&(producers[p].thread), NULL, Producer,
+            &producers[p]);
+    }
+
+    total = opts.items * opts.producers;
+    received = 0;
+    orderErrors = 0;
+    emptyPolls = 0;
+    spins = 0;
+
+    pthread_barrier_wait(&startBarrier);
+    start = NowNs();
+
+    while (received < total)
+    {
+        count = Pop(&queues[0], items, opts.batch);
+
+        if (0 == count)
+        {
+            emptyPolls++;
+
+            if (opts.wait)
+            {
+                Wait(&queues[0]);
+            }
+            else
+            {
+                Backoff(&spins);
+            }
+
+            continue;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            uint64_t item;
+
+            item = (uint64_t)(uintptr_t)items[i];
+            p = (int)(item >> PRODUCER_SHIFT);
+
+            if ((item & ((1ULL << PRODUCER_SHIFT) - 1)) != expected[p])
+            {
+                orderErrors++;
+            }
+
+            expected[p]++;
+        }
+
+        received += count;
+    }
+
+    stop = NowNs();
+
+    for (p = 0; p < opts.producers; p++)
+    {
+        pthread_join(producers[p].thread, NULL);
+    }
+
+    pthread_barrier_destroy(&startBarrier);
+
+    printf("{\"queue\": \"%s\", \"mode\": \"throughput\", "
+        "\"producers\": %d, \"batch\": %lu, \"capacity\": %lu, "
+        "\"consumer\": \"%s\", \"cpus\": \"%s\", \"items\": %lu, "
+        "\"secs\": %.3f, \"mitems_per_sec\": %.2f, \"ns_per_item\": %.2f, "
+        "\"empty_polls\": %lu, \"wakeups\": %lu, \"order_errors\": %lu}\n",
+        opts.mpsc ? "mpsc" : "spsc", opts.producers,
+        (unsigned long)opts.batch, (unsigned long)opts.capacity,
+        opts.wait ? "park" : "spin", opts.cpuList, total,
+        (stop - start) / 1e9, total / ((stop - start) / 1e3),
+        (double)(stop - start) / total, emptyPolls, Wakeups(&queues[0]),
+        orderErrors);
+}
+
+
+/***************************************************************************
+*   Function   : Echo
+*   Description: This is the latency benchmark's echo thread.  It pops
+*                each item from queues[0] and pushes it back on queues[1].
+*   Parameters : arg - the cpu to run on.
+*   Effects    : opts.items items are echoed.
+*   Returned   : NULL
+***************************************************************************/
+void *Echo(void *arg)
+{
+    void *item;
+    unsigned long n;
+    unsigned int spins;
+
+    Pin(*(int *)arg);
+    pthread_barrier_wait(&startBarrier);
+    spins = 0;
+
+    for (n = 0; n < opts.items; n++)
+    {
+        while (0 == Pop(&queues[0], &item, 1))
+        {
+            if (opts.wait)
+            {
+                Wait(&queues[0]);
+            }
+            else
+            {
+                Backoff(&spins);
+            }
+        }
+
+        while (0 == Push(&queues[1], &item, 1))
+        {
+            Backoff(&spins);
+        }
+    }
+
+    return NULL;
+}
+
+
+/***************************************************************************
+*   Function   : CompareSamples
+*   Description: This routine is the qsort comparison function for the
+*                round trip samples.
+*   Parameters : s1 - pointer to a sample
+*                s2 - pointer to a sample
+*   Effects    : None
+*   Returned   : < 0, 0, or > 0 if s1 is less than, equal to, or greater
+*                than s2.
+***************************************************************************/
+int CompareSamples(const void *s1, const void *s2)
+{
+    long long a = *(const long long *)s1;
+    long long b = *(const long long *)s2;
+
+    return (a > b) - (a < b);
+}
+
+
+/***************************************************************************
+*   Function   : RunLatency
+*   Description: This routine bounces one item at a time between the
+*                calling thread (pinned to the first cpu) and an echo
+*                thread (pinned to the second), timing every round trip,
+*                and writes the percentiles.
+*   Parameters : None
+*   Effects    : Results are written to stdout.
+*   Returned   : None
+***************************************************************************/
+void RunLatency(void)
+{
+    pthread_t echo;
+    long long *samples, start;
+    unsigned long n;
+    unsigned int spins;
+    void *item;
+    int echoCpu;
+
+    samples = (long long *)malloc(opts.items * sizeof(long long));
+
+    if (NULL == samples)
+    {
+        perror("Error allocating samples");
+        return;
+    }
+
+    Pin(opts.cpus[0]);
+    echoCpu = opts.cpus[1 % opts.numCpus];
+    pthread_barrier_init(&startBarrier, NULL, 2);
+    pthread_create(&echo, NULL, Echo, &echoCpu);
+    pthread_barrier_wait(&startBarrier);
+    spins = 0;
+
+    for (n = 0; n < opts.items; n++)
+    {
+        item = (void *)(uintptr_t)n;
+        start = NowNs();
+
+        while (0 == Push(&queues[0], &item, 1))
+        {
+            Backoff(&spins);
+        }
+
+        while (0 == Pop(&queues[1], &item, 1))
+        {
+            if (opts.wait)
+            {
+                Wait(&queues[1]);
+            }
+            else
+            {
+                Backoff(&spins);
+            }
+        }
+
+        samples[n] = NowNs() - start;
+    }
+
+    pthread_join(echo, NULL);
+    pthread_barrier_destroy(&startBarrier);
+    qsort(samples, opts.items, sizeof(long long), CompareSamples);
+
+    printf("{\"queue\": \"%s\", \"mode\": \"latency\", "
+        "\"consumer\": \"%s\", \"cpus\": \"%s\", \"round_trips\": %lu, "
+        "\"rtt_p50_ns\": %lld, \"rtt_p90_ns\": %lld, \"rtt_p99_ns\": %lld, "
+        "\"rtt_max_ns\": %lld, \"wakeups\": %lu}\n",
+        opts.mpsc ? "mpsc" : "spsc", opts.wait ? "park" : "spin",
+        opts.cpuList, opts.items,
+        samples[opts.items / 2], samples[(opts.items * 9) / 10],
+        samples[(opts.items * 99) / 100], samples[opts.items - 1],
+        Wakeups(&queues[0]) + Wakeups(&queues[1]));
+
+    free(samples);
+}
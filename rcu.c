@@ -0,0 +1,217 @@
+/***************************************************************************
+*                      Read-Copy-Update Configuration
+*
+*   File    : rcu.c
+*   Purpose : This file implements lock-free configuration updates.  The
+*             versions live in shared memory; the writer copies the current
+*             one, changes the copy and swaps the pointer, and readers
+*             (event loops, possibly in forked worker processes) never
+*             wait.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* RCU Configuration: Lock-free configuration updates for the echo servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include <sys/mman.h>
+
+#include "rcu.h"
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RcuNew
+*   Description: This routine maps a configuration shared with processes
+*                forked later and publishes a copy of initial as its
+*                first version (generation 1).  Every reader starts
+*                offline.
+*   Parameters : initial - the first version.
+*                size - the size of a version.
+*                numReaders - the number of readers.
+*   Effects    : Memory is mapped for the configuration.
+*   Returned   : The configuration, or NULL on failure.
+***************************************************************************/
+rcu_t *RcuNew(const void *initial, size_t size, unsigned int numReaders)
+{
+    rcu_t *rcu;
+    size_t header, stride, mapSize;
+    char *base;
+    unsigned int i;
+
+    if ((0 == numReaders) || (numReaders > RCU_MAX_READERS))
+    {
+        fprintf(stderr, "A configuration may have 1 to %d readers\n",
+            RCU_MAX_READERS);
+        return NULL;
+    }
+
+    /* the versions follow the header, each aligned for any type */
+    header = (sizeof(rcu_t) + alignof(max_align_t) - 1) &
+        ~(alignof(max_align_t) - 1);
+    stride = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    mapSize = header + (RCU_VERSIONS * stride);
+
+    base = (char *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (MAP_FAILED == base)
+    {
+        perror("Error mapping configuration");
+        return NULL;
+    }
+
+    rcu = (rcu_t *)base;
+    rcu->numReaders = numReaders;
+    rcu->size = size;
+    rcu->mapSize = mapSize;
+
+    for (i = 0; i < RCU_VERSIONS; i++)
+    {
+        rcu->versions[i] = base + header + (i * stride);
+        rcu->published[i] = 0;
+    }
+
+    for (i = 0; i < numReaders; i++)
+    {
+        atomic_init(&rcu->readers[i], RCU_OFFLINE);
+    }
+
+    memcpy(rcu->versions[0], initial, size);
+    rcu->published[0] = 1;
+    atomic_init(&rcu->generation, 1);
+    atomic_init(&rcu->current, rcu->versions[0]);
+    return rcu;
+}
+
+
+/***************************************************************************
+*   Function   : RcuFree
+*   Description: This routine unmaps a configuration.
+*   Parameters : rcu - the configuration (may be NULL).
+*   Effects    : The configuration and its versions are unmapped.
+*   Returned   : None
+***************************************************************************/
+void RcuFree(rcu_t *rcu)
+{
+    if (NULL != rcu)
+    {
+        munmap(rcu, rcu->mapSize);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : RcuCopy
+*   Description: This routine finds a version that no reader can still
+*                hold and copies the current version into it, for the
+*                writer to change and publish.  There is a single writer;
+*                it may also be one of the readers.
+*   Parameters : rcu - the configuration.
+*   Effects    : A free version is filled with the current one.
+*   Returned   : The copy, or NULL if every retired version may still be
+*                in use (try again after the readers' next loop turn).
+***************************************************************************/
+void *RcuCopy(rcu_t *rcu)
+{
+    const char *current;
+    unsigned long oldest, seen;
+    unsigned int i;
+
+    current = (const char *)atomic_load(&rcu->current);
+
+    /* the oldest generation any reader may still be using */
+    oldest = atomic_load(&rcu->generation);
+
+    for (i = 0; i < rcu->numReaders; i++)
+    {
+        seen = atomic_load(&rcu->readers[i]);
+
+        if (seen < oldest)
+        {
+            oldest = seen;
+        }
+    }
+
+    for (i = 0; i < RCU_VERSIONS; i++)
+    {
+        /* versions published before oldest were replaced before it */
+        if ((rcu->versions[i] != current) && (rcu->published[i] < oldest))
+        {
+            memcpy(rcu->versions[i], current, rcu->size);
+            return rcu->versions[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/***************************************************************************
+*   Function   : RcuPublish
+*   Description: This routine makes a version from RcuCopy current.
+*                Readers see it at their next RcuOnline (or sooner).
+*   Parameters : rcu - the configuration.
+*                version - the changed copy.
+*   Effects    : The current version and the generation change.
+*   Returned   : The new generation.
+***************************************************************************/
+unsigned long RcuPublish(rcu_t *rcu, void *version)
+{
+    unsigned long generation;
+    unsigned int i;
+
+    generation = atomic_load(&rcu->generation) + 1;
+
+    for (i = 0; i < RCU_VERSIONS; i++)
+    {
+        if (rcu->versions[i] == version)
+        {
+            rcu->published[i] = generation;
+        }
+    }
+
+    /* the pointer changes first, so a reader that sees the new
+     * generation also sees the new version */
+    atomic_store(&rcu->current, version);
+    atomic_store(&rcu->generation, generation);
+    return generation;
+}
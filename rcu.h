@@ -0,0 +1,151 @@
+/***************************************************************************
+*                      Read-Copy-Update Configuration
+*
+*   File    : rcu.h
+*   Purpose : This file provides the types, constants, and prototypes for
+*             publishing configuration to event loops without locks.
+*             Readers follow a pointer to an immutable version; a writer
+*             publishes a modified copy and only reuses a version once
+*             every reader has passed a quiescent state since it was
+*             replaced.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* RCU Configuration: Lock-free configuration updates for the echo servers
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef RCU_H
+#define RCU_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define RCU_VERSIONS        4       /* the current version and 3 retired */
+#define RCU_MAX_READERS     64      /* event loops (or processes) reading */
+#define RCU_OFFLINE         ULONG_MAX   /* a reader that holds no version */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/***************************************************************************
+* Each reader records the generation it saw when it last came online, at
+* the start of every loop turn.  A reader that saw generation g can only
+* hold versions published at g or later, so a version replaced by
+* generation g + 1 is free again once every reader is offline or has seen
+* g + 1.  The structure is mapped shared, so readers in processes forked
+* after RcuNew see the writer's updates.
+***************************************************************************/
+typedef struct rcu_t
+{
+    void *_Atomic current;          /* the version readers use */
+    atomic_ulong generation;        /* generation of the current version */
+    atomic_ulong readers[RCU_MAX_READERS];  /* generation each reader saw */
+    unsigned int numReaders;
+    size_t size;                    /* bytes in each version */
+    size_t mapSize;                 /* bytes mapped for the whole thing */
+    unsigned long published[RCU_VERSIONS];  /* generation of each version,
+                                               0 if it was never used */
+    char *versions[RCU_VERSIONS];
+} rcu_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+rcu_t *RcuNew(const void *initial, size_t size, unsigned int numReaders);
+void RcuFree(rcu_t *rcu);
+
+/* writer: copy the current version, change the copy, then publish it */
+void *RcuCopy(rcu_t *rcu);
+unsigned long RcuPublish(rcu_t *rcu, void *version);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RcuRead
+*   Description: This routine returns the current version.  It stays
+*                valid until the reader's next RcuOffline or RcuOnline.
+*   Parameters : rcu - the configuration.
+*   Effects    : None
+*   Returned   : The current version.
+***************************************************************************/
+static inline const void *RcuRead(rcu_t *rcu)
+{
+    return atomic_load_explicit(&rcu->current, memory_order_acquire);
+}
+
+
+/***************************************************************************
+*   Function   : RcuOnline
+*   Description: This routine marks a quiescent state for a reader that is
+*                about to read: it drops whatever versions it held and may
+*                only hold the current one from now on.
+*   Parameters : rcu - the configuration.
+*                reader - the reader's index.
+*   Effects    : The reader's generation is updated.
+*   Returned   : The current generation.
+***************************************************************************/
+static inline unsigned long RcuOnline(rcu_t *rcu, unsigned int reader)
+{
+    unsigned long generation;
+
+    generation = atomic_load(&rcu->generation);
+    atomic_store(&rcu->readers[reader], generation);
+    return generation;
+}
+
+
+/***************************************************************************
+*   Function   : RcuOffline
+*   Description: This routine marks a reader that holds no version, for
+*                example while its loop waits for events, so the writer
+*                doesn't wait for it however long it sleeps.
+*   Parameters : rcu - the configuration.
+*                reader - the reader's index.
+*   Effects    : The reader is offline until its next RcuOnline.
+*   Returned   : None
+***************************************************************************/
+static inline void RcuOffline(rcu_t *rcu, unsigned int reader)
+{
+    atomic_store_explicit(&rcu->readers[reader], RCU_OFFLINE,
+        memory_order_release);
+}
+
+#endif  /* ndef RCU_H */
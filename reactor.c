@@ -0,0 +1,1298 @@
+/***************************************************************************
+*                           Event Loop (Reactor)
+*
+*   File    : reactor.c
+*   Purpose : This file implements the event loop shared by the echo clients
+*             and servers.  Programs register a callback for each fd, timer,
+*             and signal they care about, and the reactor dispatches them
+*             from a poll or epoll backend while keeping I/O statistics and
+*             timing every loop iteration.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Reactor: Shared event loop for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#define _GNU_SOURCE             /* for ppoll */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+
+#include "reactor.h"
+#include "bufpool.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define NS_PER_USEC         1000LL
+#define NS_PER_MSEC         1000000LL
+#define NS_PER_SEC          1000000000LL
+#define MIN_HANDLERS        64      /* initial size of the handler table */
+#define MIN_POLL_FDS        16      /* initial size of the pollfd array */
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+#define HAVE_EPOLL_PWAIT2   1       /* nanosecond epoll timeouts */
+#endif
+
+/***************************************************************************
+*                                GLOBALS
+***************************************************************************/
+#ifdef HAVE_EPOLL_PWAIT2
+static int usePwait2 = 1;           /* cleared if the kernel lacks it */
+#endif
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int GrowHandlers(reactor_t *reactor, int fd);
+static void Dispatch(reactor_t *reactor, int fd, unsigned int events);
+static void SignalReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data);
+
+static long long NextTimeout(const reactor_t *reactor, long long now);
+static void RunTimers(reactor_t *reactor, long long now);
+static void RcuTurn(reactor_t *reactor);
+
+static int PollAdd(reactor_t *reactor, int fd, unsigned int events);
+static void PollCompact(reactor_t *reactor);
+static int PollWait(reactor_t *reactor, long long timeout);
+static void PollDispatch(reactor_t *reactor, int ready);
+
+static int EpollControl(reactor_t *reactor, int op, int fd,
+    unsigned int events);
+static int EpollWait(reactor_t *reactor, long long timeout);
+static void EpollDispatch(reactor_t *reactor, int ready);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : ReactorInit
+*   Description: This routine initializes a reactor with no registered
+*                fds, timers, or signals.  Policies that are chosen at run
+*                time start out as raw framing with statistics and logging
+*                enabled; programs may change them before ReactorRun.
+*   Parameters : reactor - the reactor to initialize.
+*                backend - REACTOR_POLL or REACTOR_EPOLL.  It's ignored if
+*                REACTOR_BACKEND fixes the backend.
+*                stallThresholdUs - loop iterations that take longer than
+*                this are reported by the loop monitor (0 for never).
+*   Effects    : The reactor is initialized.  The epoll backend creates an
+*                epoll fd.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+int ReactorInit(reactor_t *reactor, reactor_backend_t backend,
+    unsigned long stallThresholdUs)
+{
+    memset(reactor, 0, sizeof(reactor_t));
+    reactor->framing = REACTOR_FRAME_RAW;
+    reactor->statsOn = 1;
+    reactor->logOn = 1;
+    reactor->epollFd = -1;
+    reactor->signalFd = -1;
+    reactor->stats = &(reactor->ownStats);
+    sigemptyset(&(reactor->signalMask));
+    LoopMonInit(&(reactor->monitor), stallThresholdUs);
+
+#if (REACTOR_BACKEND == REACTOR_RUNTIME)
+    reactor->backend = backend;
+#else
+    reactor->backend = REACTOR_BACKEND;     /* fixed at compile time */
+    (void)backend;
+#endif
+
+    if (REACTOR_IS_EPOLL(reactor))
+    {
+        reactor->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (reactor->epollFd < 0)
+        {
+            perror("Error creating epoll fd");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorFree
+*   Description: This routine releases everything held by a reactor.  The
+*                fds registered by its users are not closed.
+*   Parameters : reactor - the reactor to free.
+*   Effects    : The epoll fd and signalfd are closed, signals that were
+*                blocked for the signalfd are restored, and all memory is
+*                freed.
+*   Returned   : None
+***************************************************************************/
+void ReactorFree(reactor_t *reactor)
+{
+    if (NULL != reactor->rcu)
+    {
+        RcuOffline(reactor->rcu, reactor->rcuReader);
+        reactor->rcu = NULL;
+    }
+
+    if (reactor->signalFd >= 0)
+    {
+        close(reactor->signalFd);
+        sigprocmask(SIG_SETMASK, &(reactor->oldMask), NULL);
+        reactor->signalFd = -1;
+    }
+
+    if (reactor->epollFd >= 0)
+    {
+        close(reactor->epollFd);
+        reactor->epollFd = -1;
+    }
+
+    free(reactor->handlers);
+    free(reactor->pollFds);
+    reactor->handlers = NULL;
+    reactor->pollFds = NULL;
+    reactor->numHandlers = 0;
+    reactor->numPollFds = 0;
+    reactor->maxPollFds = 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorParseBackend
+*   Description: This routine converts a backend name used on a command
+*                line into a backend.
+*   Parameters : name - "poll" or "epoll".
+*                backend - set to the named backend.
+*   Effects    : None
+*   Returned   : 0 for a known name, otherwise -1.
+***************************************************************************/
+int ReactorParseBackend(const char *name, reactor_backend_t *backend)
+{
+    if (strcmp(name, "poll") == 0)
+    {
+        *backend = REACTOR_POLL;
+    }
+    else if (strcmp(name, "epoll") == 0)
+    {
+        *backend = REACTOR_EPOLL;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorBackendName
+*   Description: This routine returns the name of a backend.
+*   Parameters : backend - the backend to name.
+*   Effects    : None
+*   Returned   : "poll" or "epoll".
+***************************************************************************/
+const char *ReactorBackendName(reactor_backend_t backend)
+{
+    return (REACTOR_EPOLL == backend) ? "epoll" : "poll";
+}
+
+
+/***************************************************************************
+*   Function   : ReactorParseFraming
+*   Description: This routine converts a framing name used on a command
+*                line into a REACTOR_FRAME_ value.
+*   Parameters : name - "raw" or "line".
+*                framing - set to the named framing.
+*   Effects    : None
+*   Returned   : 0 for a known name, otherwise -1.
+***************************************************************************/
+int ReactorParseFraming(const char *name, int *framing)
+{
+    if (strcmp(name, "raw") == 0)
+    {
+        *framing = REACTOR_FRAME_RAW;
+    }
+    else if (strcmp(name, "line") == 0)
+    {
+        *framing = REACTOR_FRAME_LINE;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorPrintPolicies
+*   Description: This routine writes the policies a reactor runs with, and
+*                whether each was fixed at compile time or chosen at run
+*                time, as a single line.
+*   Parameters : reactor - the reactor whose policies are written.
+*                stream - where to write the policies.
+*   Effects    : The policies are written to stream.
+*   Returned   : None
+***************************************************************************/
+void ReactorPrintPolicies(const reactor_t *reactor, FILE *stream)
+{
+    fprintf(stream, "policies: backend=%s%s framing=%s%s stats=%s%s "
+        "log=%s%s\n",
+        ReactorBackendName(reactor->backend),
+        (REACTOR_BACKEND == REACTOR_RUNTIME) ? "" : "(fixed)",
+        (REACTOR_FRAME_LINE == REACTOR_FRAMING_OF(reactor)) ? "line" : "raw",
+        (REACTOR_FRAMING == REACTOR_RUNTIME) ? "" : "(fixed)",
+        REACTOR_STATS_ON(reactor) ? "on" : "off",
+        (REACTOR_STATS == REACTOR_RUNTIME) ? "" : "(fixed)",
+        REACTOR_LOG_ON(reactor) ? "on" : "off",
+        (REACTOR_LOG == REACTOR_RUNTIME) ? "" : "(fixed)");
+}
+
+
+/***************************************************************************
+*   Function   : ReactorAdd
+*   Description: This routine registers a callback for events on an fd.
+*                Read and write interest is given by events; errors and
+*                hang ups are always reported.
+*   Parameters : reactor - the reactor to register with.
+*                fd - the fd to watch.
+*                events - REACTOR_READ and/or REACTOR_WRITE.
+*                callback - called when fd is ready.
+*                data - passed to callback.
+*   Effects    : fd is watched by the reactor until ReactorRemove.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+int ReactorAdd(reactor_t *reactor, int fd, unsigned int events,
+    reactor_io_cb_t callback, void *data)
+{
+    reactor_handler_t *handler;
+    int result;
+
+    if (fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if ((fd >= reactor->numHandlers) && (GrowHandlers(reactor, fd) != 0))
+    {
+        return -1;
+    }
+
+    handler = &(reactor->handlers[fd]);
+
+    if (NULL != handler->callback)
+    {
+        errno = EEXIST;
+        return -1;
+    }
+
+    handler->callback = callback;
+    handler->data = data;
+    handler->events = events;
+    handler->generation = ++(reactor->generation);
+
+    if (REACTOR_IS_EPOLL(reactor))
+    {
+        result = EpollControl(reactor, EPOLL_CTL_ADD, fd, events);
+    }
+    else
+    {
+        result = PollAdd(reactor, fd, events);
+    }
+
+    if (result != 0)
+    {
+        handler->callback = NULL;
+    }
+
+    return result;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorModify
+*   Description: This routine changes the events watched on a registered
+*                fd.
+*   Parameters : reactor - the reactor fd is registered with.
+*                fd - the registered fd.
+*                events - REACTOR_READ and/or REACTOR_WRITE.
+*   Effects    : Only the new events are reported for fd.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+int ReactorModify(reactor_t *reactor, int fd, unsigned int events)
+{
+    reactor_handler_t *handler;
+
+    if ((fd < 0) || (fd >= reactor->numHandlers) ||
+        (NULL == reactor->handlers[fd].callback))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    handler = &(reactor->handlers[fd]);
+
+    if (handler->events == events)
+    {
+        return 0;
+    }
+
+    handler->events = events;
+
+    if (REACTOR_IS_EPOLL(reactor))
+    {
+        return EpollControl(reactor, EPOLL_CTL_MOD, fd, events);
+    }
+
+    reactor->pollFds[handler->index].events =
+        ((events & REACTOR_READ) ? POLLIN : 0) |
+        ((events & REACTOR_WRITE) ? POLLOUT : 0);
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorRemove
+*   Description: This routine stops watching an fd.  It may be called from
+*                any callback, including the fd's own.  Remove fds before
+*                closing them.
+*   Parameters : reactor - the reactor fd is registered with.
+*                fd - the registered fd.
+*   Effects    : fd's callback won't be called again, even for events
+*                that were already collected.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+int ReactorRemove(reactor_t *reactor, int fd)
+{
+    reactor_handler_t *handler;
+
+    if ((fd < 0) || (fd >= reactor->numHandlers) ||
+        (NULL == reactor->handlers[fd].callback))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    handler = &(reactor->handlers[fd]);
+    handler->callback = NULL;
+
+    if (REACTOR_IS_EPOLL(reactor))
+    {
+        epoll_ctl(reactor->epollFd, EPOLL_CTL_DEL, fd, NULL);
+    }
+    else
+    {
+        /* poll ignores negative fds, compact the array before next poll */
+        reactor->pollFds[handler->index].fd = -1;
+        reactor->pollFds[handler->index].revents = 0;
+        reactor->pollDirty = 1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorTimer
+*   Description: This routine starts a one-shot timer.  A callback that
+*                needs to run periodically restarts its timer.
+*   Parameters : reactor - the reactor to run the timer.
+*                delayMs - milliseconds until callback is called.  A delay
+*                of 0 calls it after the next check for ready fds, which
+*                doesn't block.
+*                callback - called when the timer expires.
+*                data - passed to callback.
+*   Effects    : The timer is started.
+*   Returned   : The timer's id for ReactorCancelTimer, or -1 if
+*                REACTOR_MAX_TIMERS timers are already pending.
+***************************************************************************/
+int ReactorTimer(reactor_t *reactor, long delayMs,
+    reactor_timer_cb_t callback, void *data)
+{
+    return ReactorTimerUs(reactor, delayMs * 1000L, callback, data);
+}
+
+
+/***************************************************************************
+*   Function   : ReactorTimerUs
+*   Description: This routine starts a one-shot timer with a delay in
+*                microseconds.  The wait for events is given a nanosecond
+*                timeout (ppoll or epoll_pwait2), so short delays aren't
+*                rounded up to a millisecond, except with kernels too old
+*                for epoll_pwait2.
+*   Parameters : reactor - the reactor to run the timer.
+*                delayUs - microseconds until callback is called.
+*                callback - called when the timer expires.
+*                data - passed to callback.
+*   Effects    : The timer is started.
+*   Returned   : The timer's id for ReactorCancelTimer, or -1 if
+*                REACTOR_MAX_TIMERS timers are already pending.
+***************************************************************************/
+int ReactorTimerUs(reactor_t *reactor, long delayUs,
+    reactor_timer_cb_t callback, void *data)
+{
+    int i;
+
+    for (i = 0; i < REACTOR_MAX_TIMERS; i++)
+    {
+        if (NULL == reactor->timers[i].callback)
+        {
+            reactor->timers[i].due = LoopMonNow() + (delayUs * NS_PER_USEC);
+            reactor->timers[i].callback = callback;
+            reactor->timers[i].data = data;
+            reactor->pendingTimers++;
+            return i;
+        }
+    }
+
+    fprintf(stderr, "Error starting timer: all %d timers are in use\n",
+        REACTOR_MAX_TIMERS);
+    return -1;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorCancelTimer
+*   Description: This routine stops a timer before it expires.
+*   Parameters : reactor - the reactor running the timer.
+*                timer - the id returned by ReactorTimer.
+*   Effects    : The timer's callback won't be called.
+*   Returned   : None
+***************************************************************************/
+void ReactorCancelTimer(reactor_t *reactor, int timer)
+{
+    if ((timer >= 0) && (timer < REACTOR_MAX_TIMERS) &&
+        (NULL != reactor->timers[timer].callback))
+    {
+        reactor->timers[timer].callback = NULL;
+        reactor->pendingTimers--;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ReactorSignal
+*   Description: This routine registers a callback for a signal.  The
+*                signal is blocked and delivered through a signalfd, so
+*                the callback runs from the loop like any other event.
+*   Parameters : reactor - the reactor to register with.
+*                signo - the signal to handle.
+*                callback - called with the signal number when the signal
+*                is delivered.
+*                data - passed to callback.
+*   Effects    : signo is blocked until the reactor is freed.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+int ReactorSignal(reactor_t *reactor, int signo,
+    reactor_signal_cb_t callback, void *data)
+{
+    sigset_t mask;
+    int fd;
+
+    if ((signo <= 0) || (signo >= NSIG))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+
+    if (sigprocmask(SIG_BLOCK, &mask,
+        (reactor->signalFd < 0) ? &(reactor->oldMask) : NULL) == -1)
+    {
+        perror("Error setting sigproc mask");
+        return -1;
+    }
+
+    sigaddset(&(reactor->signalMask), signo);
+    reactor->signalCallback[signo] = callback;
+    reactor->signalData[signo] = data;
+
+    /* creates the signalfd the first time, updates its mask after that */
+    fd = signalfd(reactor->signalFd, &(reactor->signalMask),
+        SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if (fd == -1)
+    {
+        perror("Error creating signal fd");
+        return -1;
+    }
+
+    if (reactor->signalFd < 0)
+    {
+        reactor->signalFd = fd;
+
+        if (ReactorAdd(reactor, fd, REACTOR_READ, SignalReady, NULL) != 0)
+        {
+            perror("Error watching signal fd");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorRun
+*   Description: This routine is the event loop.  It blocks until a
+*                registered fd is ready or the next timer is due, calls the
+*                callbacks for everything that is ready, and repeats until
+*                ReactorStop is called.  When statistics are enabled,
+*                every iteration is timed by the reactor's loop monitor.
+*   Parameters : reactor - the reactor to run.
+*   Effects    : Callbacks are made.
+*   Returned   : The status passed to ReactorStop, or -1 if waiting for
+*                events failed.
+***************************************************************************/
+int ReactorRun(reactor_t *reactor)
+{
+    int ready;
+    long long now;
+
+    reactor->running = 1;
+    reactor->status = 0;
+
+    while (reactor->running)
+    {
+        long long timeout;
+
+        /* timers use the monitor's clock readings when there are some */
+        if (REACTOR_STATS_ON(reactor))
+        {
+            LoopMonPollStart(&(reactor->monitor));
+            now = reactor->monitor.pollStart;
+        }
+        else
+        {
+            now = (reactor->pendingTimers > 0) ? LoopMonNow() : 0;
+        }
+
+        timeout = NextTimeout(reactor, now);
+
+        /* a loop waiting for events holds no configuration */
+        if (NULL != reactor->rcu)
+        {
+            RcuOffline(reactor->rcu, reactor->rcuReader);
+        }
+
+        if (REACTOR_IS_EPOLL(reactor))
+        {
+            ready = EpollWait(reactor, timeout);
+        }
+        else
+        {
+            ready = PollWait(reactor, timeout);
+        }
+
+        if (NULL != reactor->rcu)
+        {
+            RcuTurn(reactor);
+        }
+
+        if (REACTOR_STATS_ON(reactor))
+        {
+            LoopMonPollEnd(&(reactor->monitor));
+            now = reactor->monitor.pollEnd;
+        }
+        else
+        {
+            now = (reactor->pendingTimers > 0) ? LoopMonNow() : 0;
+        }
+
+        if (ready < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            perror("Error waiting for events");
+            reactor->status = -1;
+            break;
+        }
+
+        if (REACTOR_IS_EPOLL(reactor))
+        {
+            EpollDispatch(reactor, ready);
+        }
+        else
+        {
+            PollDispatch(reactor, ready);
+        }
+
+        RunTimers(reactor, now);
+    }
+
+    reactor->running = 0;
+    return reactor->status;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorStop
+*   Description: This routine makes ReactorRun return.  Callbacks for
+*                events that haven't been dispatched yet are skipped.
+*   Parameters : reactor - the running reactor.
+*                status - the value for ReactorRun to return.
+*   Effects    : The loop ends once the current callback returns.
+*   Returned   : None
+***************************************************************************/
+void ReactorStop(reactor_t *reactor, int status)
+{
+    reactor->running = 0;
+    reactor->status = status;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorShareStats
+*   Description: This routine moves a reactor's counters to memory chosen
+*                by the caller, for example a segment shared with another
+*                process that reports them.
+*   Parameters : reactor - the reactor.
+*                shared - where the counters will be kept.
+*   Effects    : The counters so far are copied to shared, which the
+*                handlers update from now on.
+*   Returned   : None
+***************************************************************************/
+void ReactorShareStats(reactor_t *reactor, reactor_stats_t *shared)
+{
+    *shared = *(reactor->stats);
+    reactor->stats = shared;
+}
+
+
+/***************************************************************************
+*   Function   : ReactorRcu
+*   Description: This routine makes the reactor a reader of a lock-free
+*                configuration.  The loop is offline while it waits for
+*                events and comes back online (a quiescent state) before
+*                dispatching them, so callbacks may use the version from
+*                RcuRead until they return.  When the loop sees a new
+*                generation, changed is called before the events are
+*                dispatched, to apply settings that aren't read on every
+*                use.
+*   Parameters : reactor - the reactor.
+*                rcu - the configuration.
+*                reader - the reactor's reader index in rcu.
+*                changed - called for each new generation, or NULL.
+*                data - passed to changed.
+*   Effects    : The reactor reports its quiescent states to rcu.
+*   Returned   : None
+***************************************************************************/
+void ReactorRcu(reactor_t *reactor, rcu_t *rcu, unsigned int reader,
+    reactor_timer_cb_t changed, void *data)
+{
+    reactor->rcu = rcu;
+    reactor->rcuReader = reader;
+    reactor->rcuChanged = changed;
+    reactor->rcuData = data;
+    reactor->rcuGeneration = RcuOnline(rcu, reader);
+}
+
+
+/***************************************************************************
+*   Function   : RcuTurn
+*   Description: This routine brings the loop's configuration reader back
+*                online after waiting for events, and calls the reactor's
+*                rcuChanged callback if the configuration has changed.
+*   Parameters : reactor - the reactor.
+*   Effects    : The reader's quiescent state is recorded.
+*   Returned   : None
+***************************************************************************/
+static void RcuTurn(reactor_t *reactor)
+{
+    unsigned long generation;
+
+    generation = RcuOnline(reactor->rcu, reactor->rcuReader);
+
+    if (generation != reactor->rcuGeneration)
+    {
+        reactor->rcuGeneration = generation;
+
+        if (NULL != reactor->rcuChanged)
+        {
+            reactor->rcuChanged(reactor, reactor->rcuData);
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ReactorPrintStats
+*   Description: This routine writes the reactor's syscall, traffic, and
+*                buffer pool statistics as a single line that is easy for
+*                scripts to parse.  Nothing is written if statistics are
+*                disabled.
+*   Parameters : reactor - the reactor whose statistics are written.
+*                stream - where to write the statistics.
+*   Effects    : Statistics are written to stream.
+*   Returned   : None
+***************************************************************************/
+void ReactorPrintStats(const reactor_t *reactor, FILE *stream)
+{
+    bufpool_stats_t poolStats;
+
+    if (!REACTOR_STATS_ON(reactor))
+    {
+        return;
+    }
+
+    BufPoolGetStats(&poolStats);
+    ReactorPrintTotals(reactor->stats, &poolStats, stream);
+}
+
+
+/***************************************************************************
+*   Function   : ReactorPrintTotals
+*   Description: This routine writes counters and buffer pool statistics
+*                in the format of ReactorPrintStats.  It's used to report
+*                totals added up from several reactors.
+*   Parameters : stats - the counters.
+*                poolStats - the buffer pool statistics.
+*                stream - where to write the statistics.
+*   Effects    : Statistics are written to stream.
+*   Returned   : None
+***************************************************************************/
+void ReactorPrintTotals(const reactor_stats_t *stats,
+    const bufpool_stats_t *poolStats, FILE *stream)
+{
+    fprintf(stream, "stats: recv_calls=%lu ioctl_calls=%lu send_calls=%lu "
+        "bytes_in=%llu bytes_out=%llu pool_gets=%lu pool_misses=%lu "
+        "pool_peak_bytes=%lu pool_in_use_bytes=%lu pool_cached_bytes=%lu\n",
+        stats->recvCalls, stats->ioctlCalls, stats->sendCalls,
+        stats->bytesIn, stats->bytesOut, poolStats->gets, poolStats->misses,
+        (unsigned long)poolStats->peakInUse,
+        (unsigned long)poolStats->inUse, (unsigned long)poolStats->cached);
+}
+
+
+/***************************************************************************
+*   Function   : ReactorPrintCpu
+*   Description: This routine writes the CPU time used by the process (and
+*                any children it has waited for) as a single line.  It's
+*                measured by the kernel, so it's available even when the
+*                reactor's statistics are disabled, and it's how
+*                differently built servers are compared.  The page faults
+*                and involuntary context switches (preemptions) that go
+*                with it are the usual causes of latency outliers.
+*   Parameters : stream - where to write the CPU time.
+*   Effects    : The CPU time is written to stream.
+*   Returned   : None
+***************************************************************************/
+void ReactorPrintCpu(FILE *stream)
+{
+    struct rusage usage, children;
+    double user, sys;
+
+    if ((getrusage(RUSAGE_SELF, &usage) != 0) ||
+        (getrusage(RUSAGE_CHILDREN, &children) != 0))
+    {
+        return;
+    }
+
+    user = (usage.ru_utime.tv_sec * 1000.0) + (usage.ru_utime.tv_usec / 1000.0) +
+        (children.ru_utime.tv_sec * 1000.0) +
+        (children.ru_utime.tv_usec / 1000.0);
+    sys = (usage.ru_stime.tv_sec * 1000.0) + (usage.ru_stime.tv_usec / 1000.0) +
+        (children.ru_stime.tv_sec * 1000.0) +
+        (children.ru_stime.tv_usec / 1000.0);
+
+    fprintf(stream, "cpu: user_ms=%.1f sys_ms=%.1f total_ms=%.1f "
+        "minor_faults=%ld major_faults=%ld preempted=%ld\n",
+        user, sys, user + sys, usage.ru_minflt + children.ru_minflt,
+        usage.ru_majflt + children.ru_majflt,
+        usage.ru_nivcsw + children.ru_nivcsw);
+}
+
+
+/***************************************************************************
+*   Function   : GrowHandlers
+*   Description: This routine grows the handler table so that it can be
+*                indexed by fd.
+*   Parameters : reactor - the reactor whose table is grown.
+*                fd - the fd that needs a handler.
+*   Effects    : The table is reallocated and the new entries are cleared.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+static int GrowHandlers(reactor_t *reactor, int fd)
+{
+    reactor_handler_t *handlers;
+    int size;
+
+    size = (reactor->numHandlers > 0) ? reactor->numHandlers : MIN_HANDLERS;
+
+    while (size <= fd)
+    {
+        size *= 2;
+    }
+
+    handlers = (reactor_handler_t *)realloc(reactor->handlers,
+        size * sizeof(reactor_handler_t));
+
+    if (NULL == handlers)
+    {
+        perror("Error allocating reactor handlers");
+        return -1;
+    }
+
+    memset(handlers + reactor->numHandlers, 0,
+        (size - reactor->numHandlers) * sizeof(reactor_handler_t));
+    reactor->handlers = handlers;
+    reactor->numHandlers = size;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : Dispatch
+*   Description: This routine calls the callback registered for a ready
+*                fd and, if statistics are enabled, times it with the loop
+*                monitor.  The bytes the
+*                callback sent are taken from the reactor's statistics.
+*   Parameters : reactor - the reactor fd is registered with.
+*                fd - the ready fd.
+*                events - the REACTOR_ events that are ready.
+*   Effects    : fd's callback is made unless fd was removed or it isn't
+*                interested in events.
+*   Returned   : None
+***************************************************************************/
+static void Dispatch(reactor_t *reactor, int fd, unsigned int events)
+{
+    reactor_handler_t *handler;
+    unsigned long long bytesOut;
+
+    handler = &(reactor->handlers[fd]);
+    events &= (handler->events | REACTOR_ERROR);
+
+    if ((NULL == handler->callback) || (0 == events))
+    {
+        return;
+    }
+
+    if (!REACTOR_STATS_ON(reactor))
+    {
+        handler->callback(reactor, fd, events, handler->data);
+        return;
+    }
+
+    bytesOut = reactor->stats->bytesOut;
+    LoopMonCallbackStart(&(reactor->monitor));
+    handler->callback(reactor, fd, events, handler->data);
+    LoopMonCallbackEnd(&(reactor->monitor), fd,
+        reactor->stats->bytesOut - bytesOut);
+}
+
+
+/***************************************************************************
+*   Function   : SignalReady
+*   Description: This routine is the callback for the signalfd.  It reads
+*                every pending signal and calls the callback registered for
+*                it.
+*   Parameters : reactor - the reactor that owns the signalfd.
+*                fd - the signalfd.
+*                events - unused.
+*                data - unused.
+*   Effects    : Signal callbacks are made.
+*   Returned   : None
+***************************************************************************/
+static void SignalReady(reactor_t *reactor, int fd, unsigned int events,
+    void *data)
+{
+    struct signalfd_siginfo info;
+    int signo;
+
+    (void)events;
+    (void)data;
+
+    while (reactor->running &&
+        (read(fd, &info, sizeof(info)) == sizeof(info)))
+    {
+        signo = info.ssi_signo;
+
+        if ((signo > 0) && (signo < NSIG) &&
+            (NULL != reactor->signalCallback[signo]))
+        {
+            reactor->signalCallback[signo](reactor, signo,
+                reactor->signalData[signo]);
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : NextTimeout
+*   Description: This routine determines how long the loop may block
+*                without missing a timer.
+*   Parameters : reactor - the reactor running the timers.
+*                now - the current time (ns), the monitor's poll start
+*                time if statistics are enabled.
+*   Effects    : None
+*   Returned   : Nanoseconds until the next timer is due, or -1 if there
+*                are no timers.
+***************************************************************************/
+static long long NextTimeout(const reactor_t *reactor, long long now)
+{
+    long long due;
+    int i;
+
+    if (0 == reactor->pendingTimers)
+    {
+        return -1;
+    }
+
+    due = -1;
+
+    for (i = 0; i < REACTOR_MAX_TIMERS; i++)
+    {
+        if ((NULL != reactor->timers[i].callback) &&
+            ((-1 == due) || (reactor->timers[i].due < due)))
+        {
+            due = reactor->timers[i].due;
+        }
+    }
+
+    if (due <= now)
+    {
+        return 0;
+    }
+
+    return due - now;
+}
+
+
+/***************************************************************************
+*   Function   : RunTimers
+*   Description: This routine calls the callback of every timer that is
+*                due.  Each callback is timed by the loop monitor as fd -1.
+*                The current time is taken when the wait for events ends,
+*                so a timer that expires while the ready fds are being
+*                serviced runs after the next (non-blocking) wait.
+*   Parameters : reactor - the reactor running the timers.
+*                now - the time the wait for events ended (ns).
+*   Effects    : Expired timers are freed before their callback is made.
+*   Returned   : None
+***************************************************************************/
+static void RunTimers(reactor_t *reactor, long long now)
+{
+    reactor_timer_cb_t callback;
+    unsigned long long bytesOut;
+    int i;
+
+    for (i = 0; (reactor->pendingTimers > 0) && (i < REACTOR_MAX_TIMERS) &&
+        reactor->running; i++)
+    {
+        if ((NULL == reactor->timers[i].callback) ||
+            (reactor->timers[i].due > now))
+        {
+            continue;
+        }
+
+        callback = reactor->timers[i].callback;
+        reactor->timers[i].callback = NULL;
+        reactor->pendingTimers--;
+
+        if (!REACTOR_STATS_ON(reactor))
+        {
+            callback(reactor, reactor->timers[i].data);
+            continue;
+        }
+
+        bytesOut = reactor->stats->bytesOut;
+        LoopMonCallbackStart(&(reactor->monitor));
+        callback(reactor, reactor->timers[i].data);
+        LoopMonCallbackEnd(&(reactor->monitor), -1,
+            reactor->stats->bytesOut - bytesOut);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : PollAdd
+*   Description: This routine appends an fd to the poll backend's array of
+*                pollfds.
+*   Parameters : reactor - the reactor using the poll backend.
+*                fd - the fd to add.
+*                events - REACTOR_READ and/or REACTOR_WRITE.
+*   Effects    : The array may be reallocated.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+static int PollAdd(reactor_t *reactor, int fd, unsigned int events)
+{
+    struct pollfd *pfd;
+
+    if (reactor->numPollFds == reactor->maxPollFds)
+    {
+        int size;
+
+        size = (reactor->maxPollFds > 0) ?
+            (2 * reactor->maxPollFds) : MIN_POLL_FDS;
+        pfd = (struct pollfd *)realloc(reactor->pollFds,
+            size * sizeof(struct pollfd));
+
+        if (NULL == pfd)
+        {
+            perror("Error allocating fds for poll");
+            return -1;
+        }
+
+        reactor->pollFds = pfd;
+        reactor->maxPollFds = size;
+    }
+
+    reactor->handlers[fd].index = reactor->numPollFds;
+    pfd = &(reactor->pollFds[reactor->numPollFds]);
+    pfd->fd = fd;
+    pfd->events = ((events & REACTOR_READ) ? POLLIN : 0) |
+        ((events & REACTOR_WRITE) ? POLLOUT : 0);
+    pfd->revents = 0;
+    reactor->numPollFds++;
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : PollCompact
+*   Description: This routine squeezes the removed fds out of the poll
+*                backend's array of pollfds.  It isn't done by
+*                ReactorRemove so that the array doesn't change while it's
+*                being dispatched.
+*   Parameters : reactor - the reactor using the poll backend.
+*   Effects    : Removed entries are dropped and the handlers' indices are
+*                updated.
+*   Returned   : None
+***************************************************************************/
+static void PollCompact(reactor_t *reactor)
+{
+    int from, to;
+
+    to = 0;
+
+    for (from = 0; from < reactor->numPollFds; from++)
+    {
+        if (reactor->pollFds[from].fd >= 0)
+        {
+            reactor->pollFds[to] = reactor->pollFds[from];
+            reactor->handlers[reactor->pollFds[to].fd].index = to;
+            to++;
+        }
+    }
+
+    reactor->numPollFds = to;
+    reactor->pollDirty = 0;
+}
+
+
+/***************************************************************************
+*   Function   : PollWait
+*   Description: This routine blocks in ppoll until a registered fd is
+*                ready or the timeout expires.
+*   Parameters : reactor - the reactor using the poll backend.
+*                timeout - timeout in nanoseconds (-1 for none).
+*   Effects    : revents is set for every pollfd.
+*   Returned   : The number of ready fds, or -1 on error.
+***************************************************************************/
+static int PollWait(reactor_t *reactor, long long timeout)
+{
+    struct timespec ts;
+
+    if (reactor->pollDirty)
+    {
+        PollCompact(reactor);
+    }
+
+    ts.tv_sec = timeout / NS_PER_SEC;
+    ts.tv_nsec = timeout % NS_PER_SEC;
+
+    return ppoll(reactor->pollFds, reactor->numPollFds,
+        (timeout < 0) ? NULL : &ts, NULL);
+}
+
+
+/***************************************************************************
+*   Function   : PollDispatch
+*   Description: This routine makes the callbacks for the fds poll found
+*                ready.  Fds added by the callbacks are appended to the
+*                array, so only the entries that were polled are visited.
+*   Parameters : reactor - the reactor using the poll backend.
+*                ready - the number of ready fds returned by poll.
+*   Effects    : Callbacks are made.
+*   Returned   : None
+***************************************************************************/
+static void PollDispatch(reactor_t *reactor, int ready)
+{
+    int i, polled;
+    short revents;
+    unsigned int events;
+
+    polled = reactor->numPollFds;
+
+    for (i = 0; (i < polled) && (ready > 0) && reactor->running; i++)
+    {
+        /* the array may move if a callback adds an fd, so index it */
+        revents = reactor->pollFds[i].revents;
+
+        if ((0 == revents) || (reactor->pollFds[i].fd < 0))
+        {
+            continue;
+        }
+
+        ready--;
+        events = ((revents & POLLIN) ? REACTOR_READ : 0) |
+            ((revents & POLLOUT) ? REACTOR_WRITE : 0) |
+            ((revents & (POLLHUP | POLLERR | POLLNVAL)) ? REACTOR_ERROR : 0);
+        Dispatch(reactor, reactor->pollFds[i].fd, events);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : EpollControl
+*   Description: This routine adds an fd to the epoll set or changes its
+*                events.  The fd and its handler's generation are packed
+*                into the event data, so events collected for an fd that
+*                was removed and reused by the same batch are dropped.
+*   Parameters : reactor - the reactor using the epoll backend.
+*                op - EPOLL_CTL_ADD or EPOLL_CTL_MOD.
+*                fd - the fd to add or modify.
+*                events - REACTOR_READ and/or REACTOR_WRITE.
+*   Effects    : The kernel's epoll set is updated.
+*   Returned   : 0 for success, otherwise -1 (errno is set).
+***************************************************************************/
+static int EpollControl(reactor_t *reactor, int op, int fd,
+    unsigned int events)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = ((events & REACTOR_READ) ? EPOLLIN : 0) |
+        ((events & REACTOR_WRITE) ? EPOLLOUT : 0);
+    event.data.u64 = ((uint64_t)reactor->handlers[fd].generation << 32) |
+        (uint32_t)fd;
+
+    if (epoll_ctl(reactor->epollFd, op, fd, &event) != 0)
+    {
+        perror("Error updating epoll set");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : EpollWait
+*   Description: This routine blocks in epoll_pwait2 until a registered fd
+*                is ready or the timeout expires.  If the kernel doesn't
+*                have epoll_pwait2, epoll_wait is used with the timeout
+*                rounded up to a millisecond.
+*   Parameters : reactor - the reactor using the epoll backend.
+*                timeout - timeout in nanoseconds (-1 for none).
+*   Effects    : Ready events are stored in reactor->epollEvents.
+*   Returned   : The number of ready events, or -1 on error.
+***************************************************************************/
+static int EpollWait(reactor_t *reactor, long long timeout)
+{
+#ifdef HAVE_EPOLL_PWAIT2
+    if (usePwait2)
+    {
+        struct timespec ts;
+        int ready;
+
+        ts.tv_sec = timeout / NS_PER_SEC;
+        ts.tv_nsec = timeout % NS_PER_SEC;
+        ready = epoll_pwait2(reactor->epollFd, reactor->epollEvents,
+            REACTOR_EPOLL_BATCH, (timeout < 0) ? NULL : &ts, NULL);
+
+        if ((ready >= 0) || (ENOSYS != errno))
+        {
+            return ready;
+        }
+
+        usePwait2 = 0;      /* kernel is older than 5.11 */
+    }
+#endif
+
+    return epoll_wait(reactor->epollFd, reactor->epollEvents,
+        REACTOR_EPOLL_BATCH,
+        (timeout < 0) ? -1 : (int)((timeout + NS_PER_MSEC - 1) / NS_PER_MSEC));
+}
+
+
+/***************************************************************************
+*   Function   : EpollDispatch
+*   Description: This routine makes the callbacks for the events collected
+*                by epoll_wait.
+*   Parameters : reactor - the reactor using the epoll backend.
+*                ready - the number of events returned by epoll_wait.
+*   Effects    : Callbacks are made.
+*   Returned   : None
+***************************************************************************/
+static void EpollDispatch(reactor_t *reactor, int ready)
+{
+    struct epoll_event *event;
+    unsigned int events;
+    int i, fd;
+
+    for (i = 0; (i < ready) && reactor->running; i++)
+    {
+        event = &(reactor->epollEvents[i]);
+        fd = (int)(event->data.u64 & 0xFFFFFFFF);
+
+        if ((fd >= reactor->numHandlers) ||
+            (reactor->handlers[fd].generation !=
+            (unsigned int)(event->data.u64 >> 32)))
+        {
+            continue;       /* removed (and maybe reused) by a callback */
+        }
+
+        events = ((event->events & EPOLLIN) ? REACTOR_READ : 0) |
+            ((event->events & EPOLLOUT) ? REACTOR_WRITE : 0) |
+            ((event->events & (EPOLLHUP | EPOLLERR)) ? REACTOR_ERROR : 0);
+        Dispatch(reactor, fd, events);
+    }
+}
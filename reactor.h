@@ -0,0 +1,274 @@
+/***************************************************************************
+*                       Event Loop (Reactor) Header
+*
+*   File    : reactor.h
+*   Purpose : This file provides the prototypes, types, and constants for
+*             the event loop shared by the echo clients and servers.  It
+*             dispatches fd readiness through a poll or epoll backend, and
+*             also handles one-shot timers, signals, I/O statistics, and
+*             loop monitoring.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Reactor: Shared event loop for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef REACTOR_H
+#define REACTOR_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <signal.h>
+
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include "loopmon.h"
+#include "bufpool.h"
+#include "rcu.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* events that handlers may register for and are passed */
+#define REACTOR_READ    0x01        /* fd is readable */
+#define REACTOR_WRITE   0x02        /* fd is writable */
+#define REACTOR_ERROR   0x04        /* hang up or error (always reported) */
+
+#define REACTOR_MAX_TIMERS  8       /* timers that may be pending at once */
+#define REACTOR_EPOLL_BATCH 256     /* most events taken per epoll_wait */
+
+/* backends */
+#define REACTOR_POLL        1       /* poll(2), rebuilt array of pollfds */
+#define REACTOR_EPOLL       2       /* epoll(7), kernel keeps the fd set */
+
+/* framing of TCP streams */
+#define REACTOR_FRAME_RAW   1       /* echo whatever each receive returns */
+#define REACTOR_FRAME_LINE  2       /* echo only complete '\n' ended lines */
+
+/* values for policies that are switched on or off */
+#define REACTOR_DISABLED    1
+#define REACTOR_ENABLED     2
+
+/***************************************************************************
+* Compile-time policies.  Each policy is chosen at run time (from the
+* command line) unless it's fixed with -D, for example:
+*     -DREACTOR_BACKEND=REACTOR_EPOLL -DREACTOR_LOG=REACTOR_DISABLED
+* A fixed policy makes its test below a constant, so the compiler drops
+* the branch and the code for the other choices from the event loop and
+* the echo paths.
+*   REACTOR_BACKEND - REACTOR_POLL or REACTOR_EPOLL
+*   REACTOR_FRAMING - REACTOR_FRAME_RAW or REACTOR_FRAME_LINE
+*   REACTOR_STATS   - I/O counters and loop monitoring, enabled or disabled
+*   REACTOR_LOG     - per message logging, enabled or disabled
+***************************************************************************/
+#define REACTOR_RUNTIME     0       /* policy is chosen at run time */
+
+#ifndef REACTOR_BACKEND
+#define REACTOR_BACKEND     REACTOR_RUNTIME
+#endif
+
+#ifndef REACTOR_FRAMING
+#define REACTOR_FRAMING     REACTOR_RUNTIME
+#endif
+
+#ifndef REACTOR_STATS
+#define REACTOR_STATS       REACTOR_RUNTIME
+#endif
+
+#ifndef REACTOR_LOG
+#define REACTOR_LOG         REACTOR_RUNTIME
+#endif
+
+/***************************************************************************
+*                                 MACROS
+***************************************************************************/
+#if (REACTOR_BACKEND == REACTOR_RUNTIME)
+#define REACTOR_IS_EPOLL(r)     (REACTOR_EPOLL == (r)->backend)
+#else
+#define REACTOR_IS_EPOLL(r)     (REACTOR_EPOLL == REACTOR_BACKEND)
+#endif
+
+#if (REACTOR_FRAMING == REACTOR_RUNTIME)
+#define REACTOR_FRAMING_OF(r)   ((r)->framing)
+#else
+#define REACTOR_FRAMING_OF(r)   (REACTOR_FRAMING)
+#endif
+
+#if (REACTOR_STATS == REACTOR_RUNTIME)
+#define REACTOR_STATS_ON(r)     ((r)->statsOn)
+#else
+#define REACTOR_STATS_ON(r)     (REACTOR_ENABLED == REACTOR_STATS)
+#endif
+
+#if (REACTOR_LOG == REACTOR_RUNTIME)
+#define REACTOR_LOG_ON(r)       ((r)->logOn)
+#else
+#define REACTOR_LOG_ON(r)       (REACTOR_ENABLED == REACTOR_LOG)
+#endif
+
+/* add n to one of the reactor_stats_t counters of reactor r */
+#define REACTOR_COUNT(r, counter, n) \
+    do \
+    { \
+        if (REACTOR_STATS_ON(r)) \
+        { \
+            (r)->stats->counter += (n); \
+        } \
+    } while (0)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef int reactor_backend_t;     /* REACTOR_POLL or REACTOR_EPOLL */
+
+struct reactor_t;
+
+/* called when fd is ready, events is a combination of REACTOR_ flags */
+typedef void (*reactor_io_cb_t)(struct reactor_t *reactor, int fd,
+    unsigned int events, void *data);
+
+/* called when a timer expires or a signal is delivered */
+typedef void (*reactor_timer_cb_t)(struct reactor_t *reactor, void *data);
+typedef void (*reactor_signal_cb_t)(struct reactor_t *reactor, int signo,
+    void *data);
+
+typedef struct reactor_handler_t
+{
+    reactor_io_cb_t callback;       /* NULL if the fd isn't registered */
+    void *data;
+    unsigned int events;            /* REACTOR_READ and/or REACTOR_WRITE */
+    unsigned int generation;        /* detects fds reused while dispatching */
+    int index;                      /* poll backend: slot in pollfds */
+} reactor_handler_t;
+
+typedef struct reactor_timer_t
+{
+    long long due;                  /* monotonic expiration time (ns) */
+    reactor_timer_cb_t callback;    /* NULL if the timer is free */
+    void *data;
+} reactor_timer_t;
+
+typedef struct reactor_stats_t
+{
+    unsigned long recvCalls;        /* calls to recv or recvfrom */
+    unsigned long ioctlCalls;       /* FIONREAD queries */
+    unsigned long sendCalls;        /* calls to send or sendto */
+    unsigned long long bytesIn;     /* bytes received */
+    unsigned long long bytesOut;    /* bytes sent */
+} reactor_stats_t;
+
+typedef struct reactor_t
+{
+    reactor_backend_t backend;
+    int framing;                    /* policies chosen at run time */
+    int statsOn;
+    int logOn;
+    int running;
+    int status;                     /* value returned by ReactorRun */
+
+    /* registered fds, indexed by fd */
+    reactor_handler_t *handlers;
+    int numHandlers;
+    unsigned int generation;
+
+    /* poll backend */
+    struct pollfd *pollFds;
+    int numPollFds;
+    int maxPollFds;
+    int pollDirty;                  /* removed fds need to be compacted */
+
+    /* epoll backend */
+    int epollFd;
+    struct epoll_event epollEvents[REACTOR_EPOLL_BATCH];
+
+    /* signals are delivered through a signalfd */
+    int signalFd;
+    sigset_t signalMask;
+    sigset_t oldMask;
+    reactor_signal_cb_t signalCallback[NSIG];
+    void *signalData[NSIG];
+
+    reactor_timer_t timers[REACTOR_MAX_TIMERS];
+    int pendingTimers;
+
+    reactor_stats_t *stats;         /* updated by the handlers, ownStats
+                                       unless ReactorShareStats moved them */
+    reactor_stats_t ownStats;
+    loop_monitor_t monitor;         /* times every loop iteration */
+
+    /* configuration read by this loop (see ReactorRcu), or NULL */
+    rcu_t *rcu;
+    unsigned int rcuReader;         /* this loop's reader index */
+    unsigned long rcuGeneration;    /* generation the loop last saw */
+    reactor_timer_cb_t rcuChanged;  /* called when the generation changes */
+    void *rcuData;
+} reactor_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int ReactorInit(reactor_t *reactor, reactor_backend_t backend,
+    unsigned long stallThresholdUs);
+void ReactorFree(reactor_t *reactor);
+int ReactorParseBackend(const char *name, reactor_backend_t *backend);
+const char *ReactorBackendName(reactor_backend_t backend);
+int ReactorParseFraming(const char *name, int *framing);
+void ReactorPrintPolicies(const reactor_t *reactor, FILE *stream);
+
+int ReactorAdd(reactor_t *reactor, int fd, unsigned int events,
+    reactor_io_cb_t callback, void *data);
+int ReactorModify(reactor_t *reactor, int fd, unsigned int events);
+int ReactorRemove(reactor_t *reactor, int fd);
+
+int ReactorTimer(reactor_t *reactor, long delayMs,
+    reactor_timer_cb_t callback, void *data);
+int ReactorTimerUs(reactor_t *reactor, long delayUs,
+    reactor_timer_cb_t callback, void *data);
+void ReactorCancelTimer(reactor_t *reactor, int timer);
+int ReactorSignal(reactor_t *reactor, int signo,
+    reactor_signal_cb_t callback, void *data);
+
+int ReactorRun(reactor_t *reactor);
+void ReactorStop(reactor_t *reactor, int status);
+
+void ReactorShareStats(reactor_t *reactor, reactor_stats_t *shared);
+void ReactorRcu(reactor_t *reactor, rcu_t *rcu, unsigned int reader,
+    reactor_timer_cb_t changed, void *data);
+void ReactorPrintStats(const reactor_t *reactor, FILE *stream);
+void ReactorPrintTotals(const reactor_stats_t *stats,
+    const bufpool_stats_t *poolStats, FILE *stream);
+void ReactorPrintCpu(FILE *stream);
+
+#endif  /* ndef REACTOR_H */
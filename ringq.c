@@ -0,0 +1,400 @@
+/***************************************************************************
+*                          Lock-Free Ring Queues
+*
+*   File    : ringq.c
+*   Purpose : This file implements creation of the bounded lock-free ring
+*             queues and the routines a consumer uses to park on an eventfd
+*             while its queue is empty.  Enqueue and dequeue are inline in
+*             ringq.h.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Ring Queues: Lock-free queues for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "ringq.h"
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static size_t RoundCapacity(size_t capacity);
+static int WakeInit(ringq_wake_t *wake, int wakeup);
+static int SpscReady(spsc_queue_t *queue);
+static int MpscReady(const mpsc_queue_t *queue);
+static int WaitForItems(ringq_wake_t *wake, int timeoutMs);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RoundCapacity
+*   Description: This routine rounds a queue capacity up to a power of 2
+*                so positions can be mapped to slots with a mask.
+*   Parameters : capacity - the requested capacity.
+*   Effects    : None
+*   Returned   : The capacity to use (at least 2).
+***************************************************************************/
+static size_t RoundCapacity(size_t capacity)
+{
+    size_t rounded;
+
+    rounded = 2;
+
+    while (rounded < capacity)
+    {
+        rounded <<= 1;
+    }
+
+    return rounded;
+}
+
+
+/***************************************************************************
+*   Function   : WakeInit
+*   Description: This routine initializes a queue's consumer wakeup.
+*   Parameters : wake - the wakeup.
+*                wakeup - RINGQ_WAKEUP for an eventfd, or RINGQ_SPIN.
+*   Effects    : An eventfd may be opened.
+*   Returned   : 0 for success, -1 if the eventfd couldn't be created.
+***************************************************************************/
+static int WakeInit(ringq_wake_t *wake, int wakeup)
+{
+    atomic_init(&wake->parked, 0);
+    atomic_init(&wake->wakeups, 0);
+    wake->eventFd = -1;
+
+    if (RINGQ_WAKEUP == wakeup)
+    {
+        wake->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (wake->eventFd < 0)
+        {
+            perror("Error creating queue eventfd");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : SpscInit
+*   Description: This routine initializes a single producer, single
+*                consumer queue.  The queue should be static or allocated
+*                with aligned_alloc so the producer's and consumer's data
+*                really are on separate cache lines.
+*   Parameters : queue - the queue.
+*                capacity - the most items the queue holds (rounded up to
+*                a power of 2).
+*                wakeup - RINGQ_WAKEUP if the consumer may park in
+*                SpscWait, otherwise RINGQ_SPIN.
+*   Effects    : The queue's slots are allocated.
+*   Returned   : 0 for success, -1 for failure.
+***************************************************************************/
+int SpscInit(spsc_queue_t *queue, size_t capacity, int wakeup)
+{
+    capacity = RoundCapacity(capacity);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->cachedHead = 0;
+    queue->cachedTail = 0;
+    queue->mask = capacity - 1;
+    queue->slots = (void **)calloc(capacity, sizeof(void *));
+
+    if (NULL == queue->slots)
+    {
+        perror("Error allocating queue");
+        return -1;
+    }
+
+    if (WakeInit(&queue->wake, wakeup) != 0)
+    {
+        free(queue->slots);
+        queue->slots = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : SpscFree
+*   Description: This routine frees a queue's slots and eventfd.  Items
+*                still in the queue are not freed.
+*   Parameters : queue - the queue.
+*   Effects    : The queue may no longer be used.
+*   Returned   : None
+***************************************************************************/
+void SpscFree(spsc_queue_t *queue)
+{
+    free(queue->slots);
+    queue->slots = NULL;
+
+    if (queue->wake.eventFd >= 0)
+    {
+        close(queue->wake.eventFd);
+        queue->wake.eventFd = -1;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SpscReady
+*   Description: This routine checks for items on the consumer's side.
+*   Parameters : queue - the queue.
+*   Effects    : The consumer's copy of tail is updated.
+*   Returned   : Non-zero if the queue has items.
+***************************************************************************/
+static int SpscReady(spsc_queue_t *queue)
+{
+    queue->cachedTail =
+        atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    return (queue->cachedTail !=
+        atomic_load_explicit(&queue->head, memory_order_relaxed));
+}
+
+
+/***************************************************************************
+*   Function   : SpscWait
+*   Description: This routine waits for a queue to have items.  Only the
+*                consumer may call it.  RINGQ_SPIN queues return at once.
+*   Parameters : queue - the queue.
+*                timeoutMs - the longest wait (-1 waits forever).
+*   Effects    : The consumer may park on the queue's eventfd.
+*   Returned   : Non-zero if the queue has items, otherwise 0.
+***************************************************************************/
+int SpscWait(spsc_queue_t *queue, int timeoutMs)
+{
+    if (SpscReady(queue) || (RingqPark(&queue->wake) != 0))
+    {
+        return SpscReady(queue);
+    }
+
+    if (!SpscReady(queue))
+    {
+        WaitForItems(&queue->wake, timeoutMs);
+    }
+
+    RingqUnpark(&queue->wake);
+    return SpscReady(queue);
+}
+
+
+/***************************************************************************
+*   Function   : MpscInit
+*   Description: This routine initializes a multiple producer, single
+*                consumer queue.  The queue should be static or allocated
+*                with aligned_alloc so producer and consumer data really
+*                are on separate cache lines.
+*   Parameters : queue - the queue.
+*                capacity - the most items the queue holds (rounded up to
+*                a power of 2).
+*                wakeup - RINGQ_WAKEUP if the consumer may park in
+*                MpscWait, otherwise RINGQ_SPIN.
+*   Effects    : The queue's slots are allocated.
+*   Returned   : 0 for success, -1 for failure.
+***************************************************************************/
+int MpscInit(mpsc_queue_t *queue, size_t capacity, int wakeup)
+{
+    size_t i;
+
+    capacity = RoundCapacity(capacity);
+    atomic_init(&queue->tail, 0);
+    queue->head = 0;
+    queue->mask = capacity - 1;
+    queue->slots = (mpsc_slot_t *)malloc(capacity * sizeof(mpsc_slot_t));
+
+    if (NULL == queue->slots)
+    {
+        perror("Error allocating queue");
+        return -1;
+    }
+
+    for (i = 0; i < capacity; i++)
+    {
+        atomic_init(&(queue->slots[i].sequence), i);
+        queue->slots[i].item = NULL;
+    }
+
+    if (WakeInit(&queue->wake, wakeup) != 0)
+    {
+        free(queue->slots);
+        queue->slots = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : MpscFree
+*   Description: This routine frees a queue's slots and eventfd.  Items
+*                still in the queue are not freed.
+*   Parameters : queue - the queue.
+*   Effects    : The queue may no longer be used.
+*   Returned   : None
+***************************************************************************/
+void MpscFree(mpsc_queue_t *queue)
+{
+    free(queue->slots);
+    queue->slots = NULL;
+
+    if (queue->wake.eventFd >= 0)
+    {
+        close(queue->wake.eventFd);
+        queue->wake.eventFd = -1;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : MpscReady
+*   Description: This routine checks for a published item at the head of
+*                the queue.
+*   Parameters : queue - the queue.
+*   Effects    : None
+*   Returned   : Non-zero if the queue has items.
+***************************************************************************/
+static int MpscReady(const mpsc_queue_t *queue)
+{
+    return (atomic_load_explicit(
+        &(queue->slots[queue->head & queue->mask].sequence),
+        memory_order_acquire) == (queue->head + 1));
+}
+
+
+/***************************************************************************
+*   Function   : MpscWait
+*   Description: This routine waits for a queue to have items.  Only the
+*                consumer may call it.  RINGQ_SPIN queues return at once.
+*   Parameters : queue - the queue.
+*                timeoutMs - the longest wait (-1 waits forever).
+*   Effects    : The consumer may park on the queue's eventfd.
+*   Returned   : Non-zero if the queue has items, otherwise 0.
+***************************************************************************/
+int MpscWait(mpsc_queue_t *queue, int timeoutMs)
+{
+    if (MpscReady(queue) || (RingqPark(&queue->wake) != 0))
+    {
+        return MpscReady(queue);
+    }
+
+    if (!MpscReady(queue))
+    {
+        WaitForItems(&queue->wake, timeoutMs);
+    }
+
+    RingqUnpark(&queue->wake);
+    return MpscReady(queue);
+}
+
+
+/***************************************************************************
+*   Function   : RingqPark
+*   Description: This routine tells producers that the consumer is about
+*                to block on wake->eventFd.  A consumer that waits in its
+*                own event loop calls this when its queue is empty, checks
+*                the queue again (items may have been published before the
+*                producer saw the flag), and only then waits for the
+*                eventfd to be readable.  RingqUnpark must follow.
+*   Parameters : wake - the queue's wakeup.
+*   Effects    : Producers will write the eventfd after their next push.
+*   Returned   : 0 for success, -1 if the queue has no eventfd.
+***************************************************************************/
+int RingqPark(ringq_wake_t *wake)
+{
+    if (wake->eventFd < 0)
+    {
+        return -1;
+    }
+
+    atomic_store(&wake->parked, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : RingqUnpark
+*   Description: This routine ends a park and clears the eventfd.
+*   Parameters : wake - the queue's wakeup.
+*   Effects    : Producers stop writing the eventfd.
+*   Returned   : None
+***************************************************************************/
+void RingqUnpark(ringq_wake_t *wake)
+{
+    uint64_t count;
+
+    atomic_store_explicit(&wake->parked, 0, memory_order_relaxed);
+
+    /* a producer may have written it even though we didn't block */
+    if (read(wake->eventFd, &count, sizeof(count)) < 0)
+    {
+        count = 0;      /* nothing was written */
+    }
+}
+
+
+/***************************************************************************
+*   Function   : WaitForItems
+*   Description: This routine blocks until a producer writes the eventfd.
+*   Parameters : wake - the queue's wakeup.
+*                timeoutMs - the longest wait (-1 waits forever).
+*   Effects    : None
+*   Returned   : 1 if the eventfd was written, 0 on timeout or error.
+***************************************************************************/
+static int WaitForItems(ringq_wake_t *wake, int timeoutMs)
+{
+    struct pollfd pfd;
+
+    pfd.fd = wake->eventFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return (poll(&pfd, 1, timeoutMs) > 0);
+}
@@ -0,0 +1,435 @@
+/***************************************************************************
+*                       Lock-Free Ring Queue Header
+*
+*   File    : ringq.h
+*   Purpose : This file provides the types, prototypes and inline enqueue
+*             and dequeue routines for bounded lock-free single producer and
+*             multiple producer ring queues used to pass pointers between
+*             threads.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Ring Queues: Lock-free queues for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef RINGQ_H
+#define RINGQ_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define RINGQ_CACHE_LINE    64      /* producer and consumer data are kept
+                                       on separate lines of this size */
+
+/* values for the wakeup argument of the Init routines */
+#define RINGQ_SPIN          0       /* consumer polls, no eventfd */
+#define RINGQ_WAKEUP        1       /* consumer may park on an eventfd */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/***************************************************************************
+* A consumer that finds its queue empty may park in the Wait routine (or
+* poll wake.eventFd itself, see RingqPark).  Producers only write the
+* eventfd when the consumer is parked, so a busy consumer costs them no
+* system calls.
+***************************************************************************/
+typedef struct ringq_wake_t
+{
+    atomic_int parked;              /* consumer is blocked or about to be */
+    int eventFd;                    /* -1 for RINGQ_SPIN queues */
+    atomic_ulong wakeups;           /* eventfd writes by producers */
+} ringq_wake_t;
+
+/* single producer, single consumer */
+typedef struct spsc_queue_t
+{
+    /* written by the consumer */
+    _Alignas(RINGQ_CACHE_LINE) atomic_size_t head;
+    size_t cachedTail;              /* consumer's last look at tail */
+
+    /* written by the producer */
+    _Alignas(RINGQ_CACHE_LINE) atomic_size_t tail;
+    size_t cachedHead;              /* producer's last look at head */
+
+    /* read mostly */
+    _Alignas(RINGQ_CACHE_LINE) void **slots;
+    size_t mask;                    /* capacity - 1 */
+    ringq_wake_t wake;
+} spsc_queue_t;
+
+typedef struct mpsc_slot_t
+{
+    atomic_size_t sequence;         /* position + 1 when full, position
+                                       + capacity once it's been read */
+    void *item;
+} mpsc_slot_t;
+
+/* multiple producers, single consumer */
+typedef struct mpsc_queue_t
+{
+    /* claimed by producers with compare and swap */
+    _Alignas(RINGQ_CACHE_LINE) atomic_size_t tail;
+
+    /* consumer only */
+    _Alignas(RINGQ_CACHE_LINE) size_t head;
+
+    /* read mostly */
+    _Alignas(RINGQ_CACHE_LINE) mpsc_slot_t *slots;
+    size_t mask;                    /* capacity - 1 */
+    ringq_wake_t wake;
+} mpsc_queue_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int SpscInit(spsc_queue_t *queue, size_t capacity, int wakeup);
+void SpscFree(spsc_queue_t *queue);
+int SpscWait(spsc_queue_t *queue, int timeoutMs);
+
+int MpscInit(mpsc_queue_t *queue, size_t capacity, int wakeup);
+void MpscFree(mpsc_queue_t *queue);
+int MpscWait(mpsc_queue_t *queue, int timeoutMs);
+
+int RingqPark(ringq_wake_t *wake);
+void RingqUnpark(ringq_wake_t *wake);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RingqNotify
+*   Description: This routine is called by producers after publishing
+*                items.  It wakes the consumer if it's parked.  The fence
+*                orders the publish before the check of parked, matching
+*                the one in RingqPark, so either the consumer sees the
+*                items or the producer sees it parked.
+*   Parameters : wake - the queue's wakeup.
+*   Effects    : The eventfd may be written.
+*   Returned   : None
+***************************************************************************/
+static inline void RingqNotify(ringq_wake_t *wake)
+{
+    uint64_t one;
+
+    if (wake->eventFd < 0)
+    {
+        return;
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&wake->parked, memory_order_relaxed) &&
+        atomic_exchange(&wake->parked, 0))
+    {
+        one = 1;
+
+        if (write(wake->eventFd, &one, sizeof(one)) == sizeof(one))
+        {
+            atomic_fetch_add_explicit(&wake->wakeups, 1,
+                memory_order_relaxed);
+        }
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SpscPushBatch
+*   Description: This routine enqueues as many items as there's room for,
+*                publishing all of them with one store.  Only the producer
+*                may call it.
+*   Parameters : queue - the queue.
+*                items - the items to enqueue.
+*                count - the number of items.
+*   Effects    : Items are added to the queue.
+*   Returned   : The number of items enqueued (0 if the queue is full).
+***************************************************************************/
+static inline size_t SpscPushBatch(spsc_queue_t *queue, void *const *items,
+    size_t count)
+{
+    size_t tail, space, i;
+
+    tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    space = queue->mask + 1 - (tail - queue->cachedHead);
+
+    if (space < count)
+    {
+        /* only look at the consumer's line when it might help */
+        queue->cachedHead =
+            atomic_load_explicit(&queue->head, memory_order_acquire);
+        space = queue->mask + 1 - (tail - queue->cachedHead);
+
+        if (space < count)
+        {
+            count = space;
+        }
+    }
+
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        queue->slots[(tail + i) & queue->mask] = items[i];
+    }
+
+    atomic_store_explicit(&queue->tail, tail + count, memory_order_release);
+    RingqNotify(&queue->wake);
+    return count;
+}
+
+
+/***************************************************************************
+*   Function   : SpscPush
+*   Description: This routine enqueues one item.  Only the producer may
+*                call it.
+*   Parameters : queue - the queue.
+*                item - the item to enqueue.
+*   Effects    : The item is added to the queue.
+*   Returned   : 1 if the item was enqueued, 0 if the queue is full.
+***************************************************************************/
+static inline int SpscPush(spsc_queue_t *queue, void *item)
+{
+    return (int)SpscPushBatch(queue, &item, 1);
+}
+
+
+/***************************************************************************
+*   Function   : SpscPopBatch
+*   Description: This routine dequeues up to count items, releasing their
+*                slots with one store.  Only the consumer may call it.
+*   Parameters : queue - the queue.
+*                items - receives the items.
+*                count - the most items to dequeue.
+*   Effects    : Items are removed from the queue.
+*   Returned   : The number of items dequeued (0 if the queue is empty).
+***************************************************************************/
+static inline size_t SpscPopBatch(spsc_queue_t *queue, void **items,
+    size_t count)
+{
+    size_t head, available, i;
+
+    head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    available = queue->cachedTail - head;
+
+    if (available < count)
+    {
+        queue->cachedTail =
+            atomic_load_explicit(&queue->tail, memory_order_acquire);
+        available = queue->cachedTail - head;
+
+        if (available < count)
+        {
+            count = available;
+        }
+    }
+
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        items[i] = queue->slots[(head + i) & queue->mask];
+    }
+
+    atomic_store_explicit(&queue->head, head + count, memory_order_release);
+    return count;
+}
+
+
+/***************************************************************************
+*   Function   : SpscPop
+*   Description: This routine dequeues one item.  Only the consumer may
+*                call it.
+*   Parameters : queue - the queue.
+*                item - receives the item.
+*   Effects    : The item is removed from the queue.
+*   Returned   : 1 if an item was dequeued, 0 if the queue is empty.
+***************************************************************************/
+static inline int SpscPop(spsc_queue_t *queue, void **item)
+{
+    return (int)SpscPopBatch(queue, item, 1);
+}
+
+
+/***************************************************************************
+*   Function   : MpscPushBatch
+*   Description: This routine enqueues items from any producer thread.  It
+*                claims a run of slots with one compare and swap; if the
+*                queue doesn't have room for all of them, it tries half as
+*                many.  Each slot is published by its sequence number.
+*   Parameters : queue - the queue.
+*                items - the items to enqueue.
+*                count - the number of items.
+*   Effects    : Items are added to the queue.
+*   Returned   : The number of items enqueued (0 if the queue is full).
+***************************************************************************/
+static inline size_t MpscPushBatch(mpsc_queue_t *queue, void *const *items,
+    size_t count)
+{
+    size_t pos, last, sequence, i;
+    mpsc_slot_t *slot;
+
+    pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    while (count > 0)
+    {
+        /* slots are freed in order, so the last being free is enough */
+        last = pos + count - 1;
+        slot = &(queue->slots[last & queue->mask]);
+        sequence = atomic_load_explicit(&slot->sequence,
+            memory_order_acquire);
+
+        if (sequence == last)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos,
+                pos + count, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+
+            /* pos has been reloaded, try again */
+        }
+        else if ((intptr_t)(sequence - last) < 0)
+        {
+            /* not read yet, see if fewer items fit */
+            count /= 2;
+        }
+        else
+        {
+            /* another producer claimed it */
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        slot = &(queue->slots[(pos + i) & queue->mask]);
+        slot->item = items[i];
+        atomic_store_explicit(&slot->sequence, pos + i + 1,
+            memory_order_release);
+    }
+
+    RingqNotify(&queue->wake);
+    return count;
+}
+
+
+/***************************************************************************
+*   Function   : MpscPush
+*   Description: This routine enqueues one item from any producer thread.
+*   Parameters : queue - the queue.
+*                item - the item to enqueue.
+*   Effects    : The item is added to the queue.
+*   Returned   : 1 if the item was enqueued, 0 if the queue is full.
+***************************************************************************/
+static inline int MpscPush(mpsc_queue_t *queue, void *item)
+{
+    return (int)MpscPushBatch(queue, &item, 1);
+}
+
+
+/***************************************************************************
+*   Function   : MpscPopBatch
+*   Description: This routine dequeues up to count items, stopping at the
+*                first slot that hasn't been published.  Only the consumer
+*                may call it.
+*   Parameters : queue - the queue.
+*                items - receives the items.
+*                count - the most items to dequeue.
+*   Effects    : Items are removed from the queue.
+*   Returned   : The number of items dequeued (0 if the queue is empty).
+***************************************************************************/
+static inline size_t MpscPopBatch(mpsc_queue_t *queue, void **items,
+    size_t count)
+{
+    size_t head, n;
+    mpsc_slot_t *slot;
+
+    head = queue->head;
+
+    for (n = 0; n < count; n++)
+    {
+        slot = &(queue->slots[head & queue->mask]);
+
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) !=
+            (head + 1))
+        {
+            break;
+        }
+
+        items[n] = slot->item;
+
+        /* free for the producer one lap later */
+        atomic_store_explicit(&slot->sequence, head + queue->mask + 1,
+            memory_order_release);
+        head++;
+    }
+
+    queue->head = head;
+    return n;
+}
+
+
+/***************************************************************************
+*   Function   : MpscPop
+*   Description: This routine dequeues one item.  Only the consumer may
+*                call it.
+*   Parameters : queue - the queue.
+*                item - receives the item.
+*   Effects    : The item is removed from the queue.
+*   Returned   : 1 if an item was dequeued, 0 if the queue is empty.
+***************************************************************************/
+static inline int MpscPop(mpsc_queue_t *queue, void **item)
+{
+    return (int)MpscPopBatch(queue, item, 1);
+}
+
+#endif  /* ndef RINGQ_H */
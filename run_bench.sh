@@ -0,0 +1,435 @@
+#!/bin/sh
+############################################################################
+# run_bench.sh - Loopback benchmark runner for the echo servers
+############################################################################
+# Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+#
+# Each scenario starts a fresh server on the loopback interface, drives it
+# with echobench, samples the server's resident memory half way through the
+# run, and then stops the server with SIGINT so that it prints its stats
+# line.  The echobench results and the server stats are merged into one
+# JSON object per scenario, written to <results dir>/<scenario>.json.
+#
+# -P runs the server under "perf stat" and adds cycles, instructions, cache
+# misses, context switches and system calls (total and per published
+# message) to the JSON.  -F runs the server under "perf record -g" and
+# leaves <scenario>.folded (folded stacks) next to the JSON, plus
+# <scenario>.svg when flamegraph.pl from Brendan Gregg's FlameGraph tools
+# is in the PATH.  With both, each scenario is run once for each.
+#
+# The servers are taken from the bin dir (-b).  So is echobench, unless
+# the ECHOBENCH environment variable names a different one; that lets
+# differently built servers be driven by the same load generator.
+#
+# -a passes extra options to every server, e.g. -a "-b poll" selects the
+# poll backend.  -e passes extra options to echobench after the scenario's
+# own, so they take precedence, e.g. -e "-S -s 64" measures the fan-out
+# spread with 64 subscribers.
+#
+# -N runs every scenario under one of the network impairment profiles
+# below.  The profile's tc netem qdisc is installed on the interface given
+# by -i (lo by default) for the whole run and removed afterwards, and each
+# result is tagged with a "netem" field naming the profile.  On lo every
+# packet passes the qdisc once, so a profile's delay is paid in each
+# direction.  To impair a veth pair instead, set it up with the servers'
+# end in the root namespace, give the other end's address as BENCH_HOST
+# and its name with -i.  Installing a qdisc needs root and the sch_netem
+# module.
+#
+# Usage: run_bench.sh [-d seconds] [-o results dir] [-b bin dir]
+#                     [-a server options] [-e echobench options]
+#                     [-N profile] [-i interface] [-P] [-F] [scenario ...]
+#
+############################################################################
+
+DURATION=5
+RESULTS=bench_results
+BINDIR=.
+SERVER_ARGS=
+BENCH_ARGS=
+PORT=${BENCH_PORT:-47000}
+HOST=${BENCH_HOST:-127.0.0.1}
+PROFILE=
+NETEM_DEV=lo
+PERF_STAT=0
+PERF_RECORD=0
+PERF=${PERF:-perf}
+PERF_EVENTS="cycles,instructions,cache-misses,context-switches,raw_syscalls:sys_enter"
+
+# name:server:echobench options
+SCENARIOS="
+tcp-broadcast:echoserver:-p 1 -s 8 -m 64 -r 2000
+tcp-bulk:echoserver:-p 1 -s 2 -m 16384 -r 2000
+tcp-burst:echoserver:-p 4 -s 8 -m 64 -r 5000
+tcp-priority:echoserver:-p 2 -s 4 -m 32768 -r 2000 -U 20
+tcp-idle:echoserver:-p 1 -s 1 -i 1000 -m 64 -r 100
+tcp-connect:echoserver:-p 1 -s 1 -m 64 -r 100 -c 2000
+udp-fanout:echoserver_udp:-u -p 1 -s 8 -m 64 -r 2000
+udp-bulk:echoserver_udp:-u -p 1 -s 2 -m 8192 -r 1000
+"
+
+# name:tc netem options (clean installs no qdisc)
+PROFILES="
+clean:
+lan:delay 200us 50us
+wan:delay 20ms 5ms distribution normal
+lossy:delay 5ms 1ms loss 1%
+reorder:delay 5ms reorder 25% 50%
+slow:rate 20mbit delay 2ms limit 1000
+"
+
+while getopts "d:o:b:a:e:N:i:PF" opt
+do
+    case $opt in
+        d) DURATION=$OPTARG ;;
+        o) RESULTS=$OPTARG ;;
+        b) BINDIR=$OPTARG ;;
+        a) SERVER_ARGS=$OPTARG ;;
+        e) BENCH_ARGS=$OPTARG ;;
+        N) PROFILE=$OPTARG ;;
+        i) NETEM_DEV=$OPTARG ;;
+        P) PERF_STAT=1 ;;
+        F) PERF_RECORD=1 ;;
+        *) echo "Usage: $0 [-d seconds] [-o results dir] [-b bin dir]" \
+               "[-a server options] [-e echobench options] [-N profile]" \
+               "[-i interface] [-P] [-F] [scenario ...]" >&2
+           exit 1 ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+SELECTED="$*"
+ECHOBENCH=${ECHOBENCH:-$BINDIR/echobench}
+
+mkdir -p "$RESULTS" || exit 1
+
+if [ $((PERF_STAT + PERF_RECORD)) -ne 0 ] && ! command -v "$PERF" >/dev/null
+then
+    echo "$0: -P and -F need perf ($PERF not found)" >&2
+    exit 1
+fi
+
+# netem_start <profile> - install the profile's qdisc on NETEM_DEV
+netem_start()
+{
+    netem=$(echo "$PROFILES" | awk -F: -v p="$1" '$1 == p { print $2; f = 1 }
+        END { exit !f }') || {
+        echo "$0: unknown netem profile $1" >&2
+        return 1
+    }
+
+    [ -z "$netem" ] && return 0
+
+    if ! tc qdisc replace dev "$NETEM_DEV" root netem $netem
+    then
+        echo "$0: can't install netem on $NETEM_DEV (needs root and" \
+            "sch_netem)" >&2
+        return 1
+    fi
+
+    trap 'tc qdisc del dev "$NETEM_DEV" root 2>/dev/null' EXIT
+    trap 'exit 1' INT TERM
+}
+
+# server_pid <pid> - the server started by a perf wrapper is its only child
+server_pid()
+{
+    child=$(cat /proc/$1/task/$1/children 2>/dev/null | awk '{ print $1 }')
+
+    if [ -z "$child" ] && command -v pgrep >/dev/null
+    then
+        child=$(pgrep -P "$1" | head -1)
+    fi
+
+    echo "${child:-$1}"
+}
+
+# perf_to_json <perf stat csv> <published messages> - perf counters as JSON
+perf_to_json()
+{
+    awk -F, -v msgs="$2" '
+        $1 ~ /^[0-9.]+$/ {
+            name = $3
+            sub(/:.*$/, "", name)
+            sub(/^raw_syscalls$/, "syscalls", name)
+            gsub(/-/, "_", name)
+            value[name] = $1
+            order[n++] = name
+        }
+        END {
+            sep = ""
+            for (i = 0; i < n; i++)
+            {
+                printf "%s\"perf_%s\": %s", sep, order[i], value[order[i]]
+                sep = ", "
+            }
+
+            if ((msgs > 0) && ("syscalls" in value))
+            {
+                printf "%s\"perf_syscalls_per_msg\": %.2f", sep,
+                    value["syscalls"] / msgs
+                sep = ", "
+            }
+
+            if ((msgs > 0) && ("cycles" in value))
+            {
+                printf "%s\"perf_cycles_per_msg\": %.0f", sep,
+                    value["cycles"] / msgs
+            }
+        }' "$1"
+}
+
+# fold_stacks - collapse "perf script" output into folded stacks
+fold_stacks()
+{
+    awk '
+        function flush(    s, i)
+        {
+            if (n > 0)
+            {
+                s = comm
+                for (i = n - 1; i >= 0; i--)
+                {
+                    s = s ";" stack[i]
+                }
+                count[s]++
+            }
+            n = 0
+        }
+
+        /^[^ \t]/ { flush(); comm = $1; next }
+        /^[ \t]+[0-9a-f]+ / {
+            sym = $2
+            sub(/\+0x[0-9a-f]+$/, "", sym)
+            stack[n++] = sym
+            next
+        }
+        /^[ \t]*$/ { flush() }
+        END {
+            flush()
+            for (s in count)
+            {
+                print s, count[s]
+            }
+        }'
+}
+
+# stats_to_json <line> <prefix> - turns "stats: a=1 b=2" into
+# "<prefix>a": 1, "<prefix>b": 2
+stats_to_json()
+{
+    echo "$1" | sed -e 's/^[a-z_]*: *//' \
+        -e "s/\\([a-z_0-9]*\\)=\\([0-9.]*\\)/\"$2\\1\": \\2,/g" -e 's/, *$//'
+}
+
+# run_scenario <name> <server> <echobench options> <plain|stat|record>
+run_scenario()
+{
+    name=$1
+    server=$2
+    options=$3
+    mode=$4
+    out="$RESULTS/$name.json"
+    errlog="$RESULTS/$name.server.log"
+
+    PORT=$((PORT + 1))
+
+    case $mode in
+        stat)
+            "$PERF" stat -x, -o "$RESULTS/$name.perfstat" -e "$PERF_EVENTS" \
+                -- "$BINDIR/$server" $SERVER_ARGS $PORT >/dev/null 2>"$errlog" &
+            ;;
+        record)
+            "$PERF" record -q -g -F 999 -o "$RESULTS/$name.perf.data" \
+                -- "$BINDIR/$server" $SERVER_ARGS $PORT >/dev/null 2>"$errlog" &
+            out="$RESULTS/$name.record.json"
+            ;;
+        *)
+            "$BINDIR/$server" $SERVER_ARGS $PORT >/dev/null 2>"$errlog" &
+            ;;
+    esac
+
+    wpid=$!
+    spid=$wpid
+    sleep 0.3
+
+    # under perf the server is perf's child (a server with -w has its own)
+    if [ "$mode" != plain ]
+    then
+        spid=$(server_pid $wpid)
+    fi
+
+    "$ECHOBENCH" $options $BENCH_ARGS -d "$DURATION" -n "$name" \
+        "$HOST" $PORT >"$RESULTS/$name.bench" &
+    bpid=$!
+
+    # sample server memory half way through the run
+    sleep $(((DURATION + 1) / 2))
+    rss=$(awk '/^VmRSS/ { print $2 }' /proc/$spid/status 2>/dev/null)
+
+    wait $bpid
+    kill -INT $spid 2>/dev/null
+    wait $wpid
+
+    stats=$(grep '^stats:' "$errlog" | tail -1)
+    loop=$(grep '^loop:' "$errlog" | tail -1)
+    cpu=$(grep '^cpu:' "$errlog" | tail -1)
+    coalesce=$(grep '^coalesce:' "$errlog" | tail -1)
+    lanes=$(grep '^lanes:' "$errlog" | tail -1)
+    prefork=$(grep '^prefork:' "$errlog" | tail -1)
+    tcpinfo=$(grep '^tcpinfo:' "$errlog" | tail -1)
+    lowlat=$(grep '^lowlat:' "$errlog" | tail -1 | sed 's/ policy=[a-z]*//')
+    sources=$(grep '^sources:' "$errlog" | tail -1)
+    fastopen=$(grep '^fastopen:' "$errlog" | tail -1)
+    bench=$(cat "$RESULTS/$name.bench")
+
+    if [ -z "$bench" ]
+    then
+        echo "$name: benchmark failed" >&2
+        return 1
+    fi
+
+    {
+        printf '%s' "${bench%\}}"
+        printf ', "server_rss_kb": %s' "${rss:-0}"
+
+        if [ -n "$PROFILE" ]
+        then
+            printf ', "netem": "%s"' "$PROFILE"
+        fi
+
+        if [ -n "$stats" ]
+        then
+            printf ', %s' "$(stats_to_json "$stats" server_)"
+        fi
+
+        if [ -n "$loop" ]
+        then
+            printf ', %s' "$(stats_to_json "$loop" server_loop_)"
+        fi
+
+        if [ -n "$cpu" ]
+        then
+            printf ', %s' "$(stats_to_json "$cpu" server_cpu_)"
+        fi
+
+        if [ -n "$coalesce" ]
+        then
+            printf ', %s' "$(stats_to_json "$coalesce" server_coalesce_)"
+        fi
+
+        if [ -n "$lanes" ]
+        then
+            printf ', %s' "$(stats_to_json "$lanes" server_lanes_)"
+        fi
+
+        if [ -n "$prefork" ]
+        then
+            printf ', %s' "$(stats_to_json "$prefork" server_prefork_)"
+        fi
+
+        if [ -n "$tcpinfo" ]
+        then
+            printf ', %s' "$(stats_to_json "$tcpinfo" server_tcpinfo_)"
+        fi
+
+        if [ -n "$lowlat" ]
+        then
+            printf ', %s' "$(stats_to_json "$lowlat" server_lowlat_)"
+        fi
+
+        if [ -n "$sources" ]
+        then
+            printf ', %s' "$(stats_to_json "$sources" server_sources_)"
+        fi
+
+        if [ -n "$fastopen" ]
+        then
+            printf ', %s' "$(stats_to_json "$fastopen" server_fastopen_)"
+        fi
+
+        if [ "$mode" = stat ] && [ -s "$RESULTS/$name.perfstat" ]
+        then
+            sent=$(echo "$bench" | sed 's/.*"sent_msgs": \([0-9]*\).*/\1/')
+            perf=$(perf_to_json "$RESULTS/$name.perfstat" "$sent")
+            [ -n "$perf" ] && printf ', %s' "$perf"
+        fi
+
+        printf '}\n'
+    } >"$out"
+
+    rm -f "$RESULTS/$name.bench"
+
+    if [ "$mode" = record ] && [ -s "$RESULTS/$name.perf.data" ]
+    then
+        "$PERF" script -i "$RESULTS/$name.perf.data" 2>/dev/null |
+            fold_stacks >"$RESULTS/$name.folded"
+
+        if command -v flamegraph.pl >/dev/null
+        then
+            flamegraph.pl --title "$name" "$RESULTS/$name.folded" \
+                >"$RESULTS/$name.svg"
+        fi
+    fi
+
+    cat "$out"
+}
+
+if [ -n "$PROFILE" ]
+then
+    netem_start "$PROFILE" || exit 1
+fi
+
+echo "$SCENARIOS" | while IFS=: read -r name server options
+do
+    [ -z "$name" ] && continue
+
+    if [ -n "$SELECTED" ]
+    then
+        case " $SELECTED " in
+            *" $name "*) ;;
+            *) continue ;;
+        esac
+    fi
+
+    if [ $PERF_STAT -eq 1 ]
+    then
+        run_scenario "$name" "$server" "$options" stat
+    elif [ $PERF_RECORD -eq 0 ]
+    then
+        run_scenario "$name" "$server" "$options" plain
+    fi
+
+    if [ $PERF_RECORD -eq 1 ]
+    then
+        run_scenario "$name" "$server" "$options" record
+    fi
+done
@@ -0,0 +1,409 @@
+/***************************************************************************
+*                        Shared Memory Broadcast Ring
+*
+*   File    : shmring.c
+*   Purpose : This file implements a ring in shared memory that carries
+*             broadcast messages between the processes of a pre-forked
+*             server.  Publishers claim slots with an atomic add and never
+*             wait for readers; a reader that falls a lap behind skips
+*             ahead, the way a busy socket misses broadcasts.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Shared Memory Ring: Broadcasts between echo server processes
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "shmring.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define SLOT_MASK   (SHMRING_SLOTS - 1)
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void Resync(shmring_t *ring, shmring_reader_t *reader);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : ShmRingNew
+*   Description: This routine maps a ring in anonymous shared memory, so
+*                it's shared with processes forked after it's created,
+*                and creates an eventfd for each reader.
+*   Parameters : numReaders - the number of processes that will read it
+*                (at most SHMRING_MAX_READERS).
+*   Effects    : Memory is mapped and eventfds are created.
+*   Returned   : The ring, or NULL on failure.
+***************************************************************************/
+shmring_t *ShmRingNew(unsigned int numReaders)
+{
+    shmring_t *ring;
+    unsigned int i;
+
+    if ((0 == numReaders) || (numReaders > SHMRING_MAX_READERS))
+    {
+        fprintf(stderr, "A ring may have 1 to %d readers\n",
+            SHMRING_MAX_READERS);
+        return NULL;
+    }
+
+    /* the pages are zeroed, so every slot's sequence starts at 0 */
+    ring = (shmring_t *)mmap(NULL, sizeof(shmring_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (MAP_FAILED == ring)
+    {
+        perror("Error mapping shared ring");
+        return NULL;
+    }
+
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->published, 0);
+    atomic_init(&ring->tooLong, 0);
+    ring->numReaders = numReaders;
+
+    for (i = 0; i < numReaders; i++)
+    {
+        atomic_init(&ring->readers[i].wake.parked, 0);
+        atomic_init(&ring->readers[i].wake.wakeups, 0);
+        ring->readers[i].wake.eventFd = eventfd(0, EFD_NONBLOCK);
+
+        if (ring->readers[i].wake.eventFd < 0)
+        {
+            perror("Error creating ring eventfd");
+            ring->numReaders = i;
+            ShmRingFree(ring);
+            return NULL;
+        }
+    }
+
+    return ring;
+}
+
+
+/***************************************************************************
+*   Function   : ShmRingFree
+*   Description: This routine closes a ring's eventfds and unmaps it.
+*                Each process that shares the ring may call it.
+*   Parameters : ring - the ring.
+*   Effects    : The ring is no longer usable by this process.
+*   Returned   : None
+***************************************************************************/
+void ShmRingFree(shmring_t *ring)
+{
+    unsigned int i;
+
+    if (NULL == ring)
+    {
+        return;
+    }
+
+    for (i = 0; i < ring->numReaders; i++)
+    {
+        close(ring->readers[i].wake.eventFd);
+    }
+
+    munmap(ring, sizeof(shmring_t));
+}
+
+
+/***************************************************************************
+*   Function   : ShmRingAttach
+*   Description: This routine starts a reader at the current end of the
+*                ring.  A process calls it for its reader before it starts
+*                reading, including one that replaces a process that
+*                exited.
+*   Parameters : ring - the ring.
+*                reader - the reader's index.
+*   Effects    : The reader will only see messages published from now on.
+*   Returned   : None
+***************************************************************************/
+void ShmRingAttach(shmring_t *ring, unsigned int reader)
+{
+    ring->readers[reader].head = atomic_load(&ring->tail);
+    atomic_store(&ring->readers[reader].wake.parked, 0);
+}
+
+
+/***************************************************************************
+*   Function   : ShmRingPublish
+*   Description: This routine copies a message into the ring and wakes
+*                every other reader that's parked.  The first slot's
+*                sequence is written last, so a reader that sees it sees
+*                the whole message.
+*   Parameters : ring - the ring.
+*                origin - the publisher's reader index, its own reader
+*                skips the message.
+*                message - the message.
+*                length - its length (at most SHMRING_MAX_MSG).
+*   Effects    : The message is added to the ring.  The oldest messages
+*                are overwritten.
+*   Returned   : 0 for success, -1 if the message is too long.
+***************************************************************************/
+int ShmRingPublish(shmring_t *ring, unsigned int origin, const char *message,
+    size_t length)
+{
+    shmring_slot_t *slot;
+    unsigned long position;
+    size_t slots, i, chunk;
+
+    if (length > SHMRING_MAX_MSG)
+    {
+        atomic_fetch_add_explicit(&ring->tooLong, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    slots = (length + SHMRING_SLOT_DATA - 1) / SHMRING_SLOT_DATA;
+    slots = (0 == slots) ? 1 : slots;
+    position = atomic_fetch_add_explicit(&ring->tail, slots,
+        memory_order_relaxed);
+
+    /* mark the slots as being written before changing them */
+    for (i = 0; i < slots; i++)
+    {
+        atomic_store_explicit(&ring->slots[(position + i) & SLOT_MASK].sequence,
+            0, memory_order_relaxed);
+    }
+
+    atomic_thread_fence(memory_order_release);
+
+    for (i = 0; i < slots; i++)
+    {
+        slot = &ring->slots[(position + i) & SLOT_MASK];
+        chunk = (length > SHMRING_SLOT_DATA) ? SHMRING_SLOT_DATA : length;
+        memcpy(slot->data, message, chunk);
+        slot->length = (unsigned int)length;
+        slot->slots = (0 == i) ? (unsigned short)slots : 0;
+        slot->origin = (unsigned short)origin;
+        message += chunk;
+        length -= chunk;
+    }
+
+    /* the first slot is published last */
+    for (i = slots; i > 0; i--)
+    {
+        atomic_store_explicit(
+            &ring->slots[(position + i - 1) & SLOT_MASK].sequence,
+            position + i, memory_order_release);
+    }
+
+    atomic_fetch_add_explicit(&ring->published, 1, memory_order_relaxed);
+
+    for (i = 0; i < ring->numReaders; i++)
+    {
+        if (i != origin)
+        {
+            RingqNotify(&ring->readers[i].wake);
+        }
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : ShmRingRead
+*   Description: This routine copies the next message published by another
+*                process.  The reader's own messages are skipped.  If the
+*                slots were overwritten before or during the copy, the
+*                reader was lapped and skips ahead (see Resync).
+*   Parameters : ring - the ring.
+*                reader - the reader's index.
+*                buffer - where to copy the message.
+*                size - the size of buffer; longer messages are skipped.
+*   Effects    : The reader's position is advanced.
+*   Returned   : The length of the message copied, or 0 if there isn't
+*                one.
+***************************************************************************/
+size_t ShmRingRead(shmring_t *ring, unsigned int reader, char *buffer,
+    size_t size)
+{
+    shmring_reader_t *me;
+    shmring_slot_t *slot;
+    unsigned long position, sequence;
+    size_t slots, length, i, chunk;
+    unsigned int origin;
+    int torn;
+
+    me = &ring->readers[reader];
+
+    for (;;)
+    {
+        position = me->head;
+        slot = &ring->slots[position & SLOT_MASK];
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        if (sequence != (position + 1))
+        {
+            if ((sequence > (position + 1)) ||
+                ((atomic_load(&ring->tail) - position) > SHMRING_SLOTS))
+            {
+                Resync(ring, me);
+                continue;
+            }
+
+            return 0;       /* not published yet */
+        }
+
+        slots = slot->slots;
+        length = slot->length;
+        origin = slot->origin;
+        torn = (0 == slots) || (slots > (SHMRING_SLOTS / 4)) ||
+            (length > (slots * SHMRING_SLOT_DATA));
+
+        if (!torn && (origin != reader) && (length <= size))
+        {
+            for (i = 0; i < slots; i++)
+            {
+                chunk = (length > SHMRING_SLOT_DATA) ?
+                    SHMRING_SLOT_DATA : length;
+                memcpy(buffer + (i * SHMRING_SLOT_DATA),
+                    ring->slots[(position + i) & SLOT_MASK].data, chunk);
+                length -= chunk;
+            }
+
+            length = slot->length;
+        }
+
+        /* make sure nothing was overwritten while it was copied */
+        atomic_thread_fence(memory_order_acquire);
+
+        for (i = 0; !torn && (i < slots); i++)
+        {
+            torn = atomic_load_explicit(
+                &ring->slots[(position + i) & SLOT_MASK].sequence,
+                memory_order_relaxed) != (position + i + 1);
+        }
+
+        if (torn)
+        {
+            Resync(ring, me);
+            continue;
+        }
+
+        me->head = position + slots;
+
+        if (origin == reader)
+        {
+            continue;
+        }
+
+        if (length > size)
+        {
+            me->overruns++;
+            continue;
+        }
+
+        me->received++;
+        return length;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : ShmRingPending
+*   Description: This routine checks for a published message at a
+*                reader's position.  It's used after parking, to catch a
+*                message published before the publisher saw the park.
+*   Parameters : ring - the ring.
+*                reader - the reader's index.
+*   Effects    : None
+*   Returned   : Non-zero if there's a message to read (or the reader was
+*                lapped).
+***************************************************************************/
+int ShmRingPending(const shmring_t *ring, unsigned int reader)
+{
+    unsigned long position, sequence;
+
+    position = ring->readers[reader].head;
+    sequence = atomic_load_explicit(
+        &ring->slots[position & SLOT_MASK].sequence, memory_order_acquire);
+
+    /* a claimed slot that isn't written yet will be notified */
+    return (sequence >= (position + 1)) ||
+        ((atomic_load(&ring->tail) - position) > SHMRING_SLOTS);
+}
+
+
+/***************************************************************************
+*   Function   : Resync
+*   Description: This routine moves a reader that was lapped to the first
+*                complete message in the newer half of the ring, leaving
+*                publishers half a ring of room before it's lapped again.
+*   Parameters : ring - the ring.
+*                reader - the lapped reader.
+*   Effects    : The reader's position is moved forward and its overrun
+*                count is incremented.
+*   Returned   : None
+***************************************************************************/
+static void Resync(shmring_t *ring, shmring_reader_t *reader)
+{
+    unsigned long position, tail;
+    const shmring_slot_t *slot;
+
+    reader->overruns++;
+    tail = atomic_load(&ring->tail);
+    position = (tail > (SHMRING_SLOTS / 2)) ? (tail - (SHMRING_SLOTS / 2)) : 0;
+
+    if (position < reader->head)
+    {
+        position = reader->head + 1;
+    }
+
+    for (; position < tail; position++)
+    {
+        slot = &ring->slots[position & SLOT_MASK];
+
+        if ((atomic_load_explicit(&slot->sequence, memory_order_acquire) ==
+            (position + 1)) && (slot->slots != 0))
+        {
+            break;
+        }
+    }
+
+    reader->head = position;
+}
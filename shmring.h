@@ -0,0 +1,116 @@
+/***************************************************************************
+*                    Shared Memory Broadcast Ring Header
+*
+*   File    : shmring.h
+*   Purpose : This file provides the types and prototypes for a ring in
+*             shared memory that carries broadcast messages between the
+*             processes of a pre-forked server.  Every process may publish
+*             and every process reads every message.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Shared Memory Ring: Broadcasts between echo server processes
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef SHMRING_H
+#define SHMRING_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "ringq.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define SHMRING_SLOT_SIZE   512     /* bytes per slot, header included */
+#define SHMRING_SLOTS       16384   /* slots per ring (8MB), a power of 2 */
+#define SHMRING_MAX_READERS 64      /* processes that may share a ring */
+
+/* a message may use a quarter of the ring */
+#define SHMRING_SLOT_DATA   (SHMRING_SLOT_SIZE - 16)
+#define SHMRING_MAX_MSG     ((SHMRING_SLOTS / 4) * SHMRING_SLOT_DATA)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/***************************************************************************
+* A message takes one or more consecutive slots.  Each slot's sequence is
+* its position + 1 once it's written, and 0 while it's being written, so a
+* reader that copies a message and then finds the sequences unchanged knows
+* it wasn't overwritten during the copy.
+***************************************************************************/
+typedef struct shmring_slot_t
+{
+    atomic_ulong sequence;          /* position + 1, 0 while being written */
+    unsigned int length;            /* message length (first slot) */
+    unsigned short slots;           /* slots in the message, 0 for the
+                                       slots after the first */
+    unsigned short origin;          /* reader index of the publisher */
+    char data[SHMRING_SLOT_DATA];
+} shmring_slot_t;
+
+/* each process reads at its own pace and is woken like a ringq consumer */
+typedef struct shmring_reader_t
+{
+    _Alignas(RINGQ_CACHE_LINE) ringq_wake_t wake;
+    unsigned long head;             /* next position to read */
+    unsigned long received;         /* messages read */
+    unsigned long overruns;         /* times it was lapped by publishers */
+} shmring_reader_t;
+
+typedef struct shmring_t
+{
+    _Alignas(RINGQ_CACHE_LINE) atomic_ulong tail;   /* next free position */
+    atomic_ulong published;         /* messages published */
+    atomic_ulong tooLong;           /* messages too long to publish */
+    unsigned int numReaders;
+    shmring_reader_t readers[SHMRING_MAX_READERS];
+    shmring_slot_t slots[SHMRING_SLOTS];
+} shmring_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+shmring_t *ShmRingNew(unsigned int numReaders);
+void ShmRingFree(shmring_t *ring);
+void ShmRingAttach(shmring_t *ring, unsigned int reader);
+int ShmRingPublish(shmring_t *ring, unsigned int origin, const char *message,
+    size_t length);
+size_t ShmRingRead(shmring_t *ring, unsigned int reader, char *buffer,
+    size_t size);
+int ShmRingPending(const shmring_t *ring, unsigned int reader);
+
+#endif  /* ndef SHMRING_H */
@@ -0,0 +1,240 @@
+/***************************************************************************
+*                   Cardinality and Frequency Sketches
+*
+*   File    : sketch.c
+*   Purpose : This file implements two sketches that summarize a stream of
+*             keys in fixed space, whatever the number of distinct keys.
+*             A HyperLogLog (Flajolet, Fusy, Gandouet and Meunier, 2007)
+*             estimates how many distinct keys were added from the
+*             longest run of leading zeros seen by each of its registers.
+*             A count-min sketch (Cormode and Muthukrishnan, 2005)
+*             estimates how often a key was added as the smallest of its
+*             counters in several rows, each indexed by a different hash;
+*             an estimate can only be too high, by the counts of keys
+*             that share all of its counters.  Counters are updated
+*             conservatively (only those at the minimum grow), which
+*             shrinks that error.  Both sketches take a key's hash from
+*             SketchHash, so the key is hashed once for both.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Sketch: HyperLogLog and count-min sketches for the UDP echo server
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <math.h>
+
+#include "sketch.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define HLL_ALPHA   (0.7213 / (1.0 + (1.079 / HLL_REGISTERS)))
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int CmsIndex(unsigned long long hash, unsigned int row);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : SketchHash
+*   Description: This routine mixes a key into a 64 bit hash with the
+*                SplitMix64 finalizer, so keys that differ in a few bits
+*                (neighboring ports) have unrelated hashes.
+*   Parameters : key - the key.
+*   Effects    : None
+*   Returned   : The key's hash.
+***************************************************************************/
+unsigned long long SketchHash(unsigned long long key)
+{
+    key += 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+
+/***************************************************************************
+*   Function   : HllAdd
+*   Description: This routine adds a key to a HyperLogLog.  The top
+*                HLL_BITS of its hash pick a register, which keeps the
+*                largest position of the first one bit in the rest.
+*   Parameters : hll - the HyperLogLog.
+*                hash - the key's hash (see SketchHash).
+*   Effects    : A register may grow.
+*   Returned   : None
+***************************************************************************/
+void HllAdd(hll_t *hll, unsigned long long hash)
+{
+    unsigned int index;
+    unsigned char rank;
+
+    index = (unsigned int)(hash >> (64 - HLL_BITS));
+    hash <<= HLL_BITS;
+    rank = 1;
+
+    while ((rank <= (64 - HLL_BITS)) && (0 == (hash & (1ULL << 63))))
+    {
+        hash <<= 1;
+        rank++;
+    }
+
+    if (rank > hll->registers[index])
+    {
+        hll->registers[index] = rank;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : HllCount
+*   Description: This routine estimates the number of distinct keys added
+*                to a HyperLogLog.  While many registers are still empty,
+*                linear counting of the empty registers is more accurate
+*                and is used instead.
+*   Parameters : hll - the HyperLogLog.
+*   Effects    : None
+*   Returned   : The estimate.
+***************************************************************************/
+double HllCount(const hll_t *hll)
+{
+    double sum, estimate;
+    unsigned int i, empty;
+
+    sum = 0.0;
+    empty = 0;
+
+    for (i = 0; i < HLL_REGISTERS; i++)
+    {
+        sum += 1.0 / (double)(1ULL << hll->registers[i]);
+        empty += (0 == hll->registers[i]) ? 1 : 0;
+    }
+
+    estimate = HLL_ALPHA * HLL_REGISTERS * HLL_REGISTERS / sum;
+
+    if ((estimate <= (2.5 * HLL_REGISTERS)) && (empty > 0))
+    {
+        estimate = HLL_REGISTERS * log((double)HLL_REGISTERS / empty);
+    }
+
+    return estimate;
+}
+
+
+/***************************************************************************
+*   Function   : CmsAdd
+*   Description: This routine adds to a key's count in a count-min
+*                sketch.  Only the counters that are below the key's new
+*                estimate are raised to it (conservative update).
+*   Parameters : cms - the count-min sketch.
+*                hash - the key's hash (see SketchHash).
+*                n - the amount added.
+*   Effects    : Counters grow.
+*   Returned   : The key's new estimated count.
+***************************************************************************/
+unsigned int CmsAdd(cms_t *cms, unsigned long long hash, unsigned int n)
+{
+    unsigned int row, estimate;
+    unsigned int *counter;
+
+    estimate = CmsCount(cms, hash) + n;
+
+    for (row = 0; row < CMS_DEPTH; row++)
+    {
+        counter = &(cms->counters[row][CmsIndex(hash, row)]);
+
+        if (*counter < estimate)
+        {
+            *counter = estimate;
+        }
+    }
+
+    return estimate;
+}
+
+
+/***************************************************************************
+*   Function   : CmsCount
+*   Description: This routine estimates a key's count in a count-min
+*                sketch.
+*   Parameters : cms - the count-min sketch.
+*                hash - the key's hash (see SketchHash).
+*   Effects    : None
+*   Returned   : The smallest of the key's counters, never less than its
+*                true count.
+***************************************************************************/
+unsigned int CmsCount(const cms_t *cms, unsigned long long hash)
+{
+    unsigned int row, count, estimate;
+
+    estimate = cms->counters[0][CmsIndex(hash, 0)];
+
+    for (row = 1; row < CMS_DEPTH; row++)
+    {
+        count = cms->counters[row][CmsIndex(hash, row)];
+
+        if (count < estimate)
+        {
+            estimate = count;
+        }
+    }
+
+    return estimate;
+}
+
+
+/***************************************************************************
+*   Function   : CmsIndex
+*   Description: This routine finds a key's counter in one row of a
+*                count-min sketch.  The rows' hashes are combinations of
+*                the two halves of the key's hash (Kirsch and
+*                Mitzenmacher), which are as good as independent hashes.
+*   Parameters : hash - the key's hash.
+*                row - the row.
+*   Effects    : None
+*   Returned   : The index of the key's counter in the row.
+***************************************************************************/
+static unsigned int CmsIndex(unsigned long long hash, unsigned int row)
+{
+    unsigned int low, high;
+
+    low = (unsigned int)(hash & 0xFFFFFFFFUL);
+    high = (unsigned int)(hash >> 32) | 1;
+    return (low + (row * high)) & (CMS_WIDTH - 1);
+}
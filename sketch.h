@@ -0,0 +1,77 @@
+/***************************************************************************
+*                   Cardinality and Frequency Sketches
+*
+*   File    : sketch.h
+*   Purpose : This file provides the constants, types and prototypes for
+*             a HyperLogLog (distinct keys) and a count-min sketch (counts
+*             by key) of fixed size.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Sketch: HyperLogLog and count-min sketches for the UDP echo server
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef SKETCH_H
+#define SKETCH_H
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define HLL_BITS        10          /* hash bits choosing a register */
+#define HLL_REGISTERS   (1 << HLL_BITS) /* about 3% standard error */
+#define CMS_DEPTH       4           /* rows, each with its own hash */
+#define CMS_WIDTH       1024        /* counters per row, a power of 2 */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* all zeros is empty for both sketches */
+typedef struct hll_t
+{
+    unsigned char registers[HLL_REGISTERS];
+} hll_t;
+
+typedef struct cms_t
+{
+    unsigned int counters[CMS_DEPTH][CMS_WIDTH];
+} cms_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+unsigned long long SketchHash(unsigned long long key);
+void HllAdd(hll_t *hll, unsigned long long hash);
+double HllCount(const hll_t *hll);
+unsigned int CmsAdd(cms_t *cms, unsigned long long hash, unsigned int n);
+unsigned int CmsCount(const cms_t *cms, unsigned long long hash);
+
+#endif  /* ndef SKETCH_H */
@@ -0,0 +1,284 @@
+#!/bin/sh
+############################################################################
+# soak.sh - Long running churn test that fails on resource growth
+############################################################################
+# Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+#
+# Starts one server (echoserver for tcp, echoserver_udp for udp) with a
+# control socket and keeps it busy for the whole run.  Each round cycles
+# through connection churn (short echobench runs with subscribers and idle
+# connections that come and go), a burst of small messages and a stream of
+# bulk messages, then measures latency with a fixed probe run and samples
+# the server's resident memory, open file descriptors and buffer pool
+# occupancy (bytes handed out and bytes cached, from the control socket's
+# stats).  The samples are written to <results dir>/<proto>.csv.
+#
+# When the run ends, a least squares line is fitted to each metric, leaving
+# out the warm up rounds (-w).  A metric fails if the line grows by more
+# than the tolerance (-T, percent of its starting value) and by more than
+# the metric's noise floor: 512KB of memory, 2 descriptors, 64KB of pool
+# buffers, 100us of median and 250us of p99 latency.  At least 5 rounds
+# after the warm up are needed for a verdict.  The script exits with 1 if
+# any metric fails.  -A analyzes an existing samples file instead of running.
+#
+# Run the server single process: with -w its workers' memory, descriptors
+# and pools aren't sampled.  The control socket is queried with socat, or
+# python3 when socat isn't installed; without either the pool isn't
+# sampled.
+#
+# Usage: soak.sh [-t seconds] [-r round seconds] [-T tolerance %]
+#                [-w warm up rounds] [-o results dir] [-b bin dir]
+#                [-a server options] [-A samples file] [tcp|udp]
+#
+############################################################################
+
+DURATION=3600
+ROUND=30
+TOLERANCE=10
+WARMUP=3
+RESULTS=soak
+BINDIR=.
+SERVER_ARGS=
+ANALYZE=
+PORT=${BENCH_PORT:-47500}
+
+while getopts "t:r:T:w:o:b:a:A:" opt
+do
+    case $opt in
+        t) DURATION=$OPTARG ;;
+        r) ROUND=$OPTARG ;;
+        T) TOLERANCE=$OPTARG ;;
+        w) WARMUP=$OPTARG ;;
+        o) RESULTS=$OPTARG ;;
+        b) BINDIR=$OPTARG ;;
+        a) SERVER_ARGS=$OPTARG ;;
+        A) ANALYZE=$OPTARG ;;
+        *) echo "Usage: $0 [-t seconds] [-r round seconds] [-T tolerance %]" \
+               "[-w warm up rounds] [-o results dir] [-b bin dir]" \
+               "[-a server options] [-A samples file] [tcp|udp]" >&2
+           exit 1 ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+PROTO=${1:-tcp}
+
+case $PROTO in
+    tcp) SERVER=echoserver; UFLAG=; BULK=16384 ;;
+    udp) SERVER=echoserver_udp; UFLAG=-u; BULK=8192 ;;
+    *) echo "$0: protocol must be tcp or udp" >&2; exit 1 ;;
+esac
+
+# analyze <samples file> - fit a line to each metric and report its growth
+analyze()
+{
+    awk -F, -v warmup="$WARMUP" -v tolerance="$TOLERANCE" '
+        BEGIN {
+            floor["rss_kb"] = 512
+            floor["fds"] = 2
+            floor["pool_in_use_bytes"] = 65536
+            floor["pool_cached_bytes"] = 65536
+            floor["lat_p50_us"] = 100
+            floor["lat_p99_us"] = 250
+            failed = 0
+        }
+        NR == 1 {
+            for (i = 3; i <= NF; i++)
+            {
+                name[i] = $i
+            }
+            next
+        }
+        $1 > warmup {
+            n++
+            for (i = 3; i <= NF; i++)
+            {
+                if ($i == "")
+                {
+                    continue
+                }
+
+                count[i]++
+                sx[i] += $2
+                sy[i] += $i
+                sxx[i] += $2 * $2
+                sxy[i] += $2 * $i
+                first[i] = (count[i] == 1) ? $2 : first[i]
+                last[i] = $2
+            }
+        }
+        END {
+            printf "%-18s %12s %12s %9s %s\n", "metric", "start", "end",
+                "growth", "result"
+
+            for (i = 3; i in name; i++)
+            {
+                if (count[i] < 5)
+                {
+                    printf "%-18s %12s %12s %9s %s\n", name[i], "-", "-",
+                        "-", "skipped"
+                    continue
+                }
+
+                d = count[i] * sxx[i] - sx[i] * sx[i]
+                slope = (d != 0) ? (count[i] * sxy[i] - sx[i] * sy[i]) / d : 0
+                base = (sy[i] - slope * sx[i]) / count[i]
+                start = base + slope * first[i]
+                end = base + slope * last[i]
+                growth = end - start
+                pct = (start > 0) ? 100.0 * growth / start : 0
+                bad = (growth > floor[name[i]]) && (pct > tolerance)
+                failed += bad
+
+                printf "%-18s %12.1f %12.1f %+8.1f%% %s\n", name[i], start,
+                    end, pct, bad ? "FAIL" : "ok"
+            }
+
+            if (n < 5)
+            {
+                print "too few rounds after the warm up to find a trend"
+            }
+
+            exit (failed > 0)
+        }' "$1"
+}
+
+# control_query <socket path> <command> - send a control command
+control_query()
+{
+    if command -v socat >/dev/null
+    then
+        echo "$2" | socat - "UNIX-CONNECT:$1" 2>/dev/null
+    elif command -v python3 >/dev/null
+    then
+        python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.sendall((sys.argv[2] + "\n").encode())
+while True:
+    d = s.recv(4096)
+    if not d:
+        break
+    sys.stdout.write(d.decode())' "$1" "$2" 2>/dev/null
+    fi
+}
+
+# stat_field <stats line> <name> - a value from a "stats:" line
+stat_field()
+{
+    echo "$1" | sed -n "s/.* $2=\\([0-9.]*\\).*/\\1/p"
+}
+
+# bench_field <echobench JSON> <name> - a numeric value from echobench
+bench_field()
+{
+    echo "$1" | sed -n "s/.*\"$2\": \\([0-9.]*\\).*/\\1/p"
+}
+
+# churn <seconds> - connections that come and go for about <seconds>
+churn()
+{
+    end=$(($(date +%s) + $1))
+
+    while [ "$(date +%s)" -lt "$end" ]
+    do
+        "$BINDIR/echobench" $UFLAG -p 1 -s 16 -i 16 -m 64 -r 500 -d 1 \
+            127.0.0.1 $PORT >/dev/null 2>&1
+    done
+}
+
+if [ -n "$ANALYZE" ]
+then
+    analyze "$ANALYZE"
+    exit $?
+fi
+
+mkdir -p "$RESULTS" || exit 1
+samples="$RESULTS/$PROTO.csv"
+errlog="$RESULTS/$PROTO.server.log"
+control="$RESULTS/$PROTO.control"
+
+rm -f "$control"
+"$BINDIR/$SERVER" -q $SERVER_ARGS -c "$control" $PORT >/dev/null \
+    2>"$errlog" &
+spid=$!
+trap 'kill -INT $spid 2>/dev/null' EXIT
+trap 'exit 1' INT TERM
+sleep 0.3
+
+if ! kill -0 $spid 2>/dev/null
+then
+    echo "$0: $SERVER didn't start, see $errlog" >&2
+    exit 1
+fi
+
+echo "round,elapsed_s,rss_kb,fds,pool_in_use_bytes,pool_cached_bytes," \
+    "lat_p50_us,lat_p99_us" | tr -d ' ' >"$samples"
+
+phase=$((ROUND / 3))
+phase=$((phase > 1 ? phase : 1))
+start=$(date +%s)
+round=0
+
+while [ $(($(date +%s) - start)) -lt "$DURATION" ]
+do
+    round=$((round + 1))
+
+    churn $phase
+    "$BINDIR/echobench" $UFLAG -p 4 -s 8 -m 64 -r 5000 -d $phase \
+        127.0.0.1 $PORT >/dev/null 2>&1
+    "$BINDIR/echobench" $UFLAG -p 1 -s 2 -m $BULK -r 1000 -d $phase \
+        127.0.0.1 $PORT >/dev/null 2>&1
+
+    # the same probe every round, so latency is comparable
+    probe=$("$BINDIR/echobench" $UFLAG -p 1 -s 4 -m 64 -r 1000 -d 2 \
+        127.0.0.1 $PORT 2>/dev/null)
+
+    if ! kill -0 $spid 2>/dev/null
+    then
+        echo "$0: $SERVER exited during round $round, see $errlog" >&2
+        exit 1
+    fi
+
+    rss=$(awk '/^VmRSS/ { print $2 }' /proc/$spid/status 2>/dev/null)
+    fds=$(ls /proc/$spid/fd 2>/dev/null | wc -l)
+    stats=$(control_query "$control" stats | grep '^stats:')
+
+    echo "$round,$(($(date +%s) - start)),$rss,$fds," \
+        "$(stat_field "$stats" pool_in_use_bytes)," \
+        "$(stat_field "$stats" pool_cached_bytes)," \
+        "$(bench_field "$probe" lat_p50_us)," \
+        "$(bench_field "$probe" lat_p99_us)" | tr -d ' ' >>"$samples"
+    tail -1 "$samples"
+done
+
+analyze "$samples"
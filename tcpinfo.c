@@ -0,0 +1,262 @@
+/***************************************************************************
+*                            TCP_INFO Sampling
+*
+*   File    : tcpinfo.c
+*   Purpose : This file provides routines to sample the kernel's TCP_INFO
+*             for a connected socket, and to aggregate samples into log2
+*             histograms so the distribution of round trip times,
+*             retransmits, congestion windows and queued bytes across all
+*             clients can be reported.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* TCP Info: TCP_INFO sampling for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>      /* glibc's tcp_info lacks tcpi_notsent_bytes */
+
+#include "tcpinfo.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+static const char * const fieldNames[TI_NUM_FIELDS] =
+{
+    "rtt_us", "retrans", "cwnd", "unacked", "notsent_bytes"
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int Bucket(unsigned int value);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : Bucket
+*   Description: This routine returns the log2 histogram bucket for a
+*                value.  Bucket 0 holds 0, bucket n holds values from
+*                2^(n-1) up to 2^n - 1.
+*   Parameters : value - the value being counted.
+*   Effects    : None
+*   Returned   : The bucket index.
+***************************************************************************/
+static unsigned int Bucket(unsigned int value)
+{
+    unsigned int bucket;
+
+    bucket = 0;
+
+    while ((value != 0) && (bucket < (TCPINFO_BUCKETS - 1)))
+    {
+        value >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+
+/***************************************************************************
+*   Function   : TcpInfoSample
+*   Description: This routine reads TCP_INFO for a connected socket and
+*                keeps the fields we report.  Kernels too old to report
+*                the not sent byte count report it as 0.
+*   Parameters : fd - the connected TCP socket.
+*                sample - where to store the sample.
+*                now - the time of the sample (ns).
+*   Effects    : sample is overwritten.
+*   Returned   : 0 for success, -1 if getsockopt failed.
+***************************************************************************/
+int TcpInfoSample(int fd, tcp_sample_t *sample, long long now)
+{
+    struct tcp_info info;
+    socklen_t length;
+
+    memset(&info, 0, sizeof(info));
+    length = sizeof(info);
+
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) < 0)
+    {
+        return -1;
+    }
+
+    sample->when = now;
+    sample->value[TI_RTT] = info.tcpi_rtt;
+    sample->value[TI_RETRANS] = info.tcpi_total_retrans;
+    sample->value[TI_CWND] = info.tcpi_snd_cwnd;
+    sample->value[TI_UNACKED] = info.tcpi_unacked;
+
+    if (length >= (offsetof(struct tcp_info, tcpi_notsent_bytes) +
+        sizeof(info.tcpi_notsent_bytes)))
+    {
+        sample->value[TI_NOTSENT] = info.tcpi_notsent_bytes;
+    }
+    else
+    {
+        sample->value[TI_NOTSENT] = 0;
+    }
+
+    return 0;
+}
+
+
+/***************************************************************************
+*   Function   : TcpInfoAdd
+*   Description: This routine adds a sample to a distribution.
+*   Parameters : dist - the distribution.
+*                sample - the sample being added.
+*   Effects    : dist's histograms are updated.
+*   Returned   : None
+***************************************************************************/
+void TcpInfoAdd(tcpinfo_dist_t *dist, const tcp_sample_t *sample)
+{
+    unsigned int i;
+
+    for (i = 0; i < TI_NUM_FIELDS; i++)
+    {
+        dist->histogram[i][Bucket(sample->value[i])]++;
+    }
+
+    dist->samples++;
+}
+
+
+/***************************************************************************
+*   Function   : TcpInfoPercentile
+*   Description: This routine estimates a percentile of one field of a
+*                distribution.  The result is the upper bound of the
+*                histogram bucket holding the percentile.
+*   Parameters : dist - the distribution.
+*                field - the field of interest.
+*                pct - the percentile (0.0 - 100.0).
+*   Effects    : None
+*   Returned   : The estimated percentile, 0 for an empty distribution.
+***************************************************************************/
+unsigned int TcpInfoPercentile(const tcpinfo_dist_t *dist,
+    tcpinfo_field_t field, double pct)
+{
+    unsigned int i;
+    unsigned long target, count;
+
+    if (0 == dist->samples)
+    {
+        return 0;
+    }
+
+    target = (unsigned long)((pct / 100.0) * dist->samples);
+
+    if (target >= dist->samples)
+    {
+        target = dist->samples - 1;
+    }
+
+    count = 0;
+
+    for (i = 0; i < TCPINFO_BUCKETS; i++)
+    {
+        count += dist->histogram[field][i];
+
+        if (count > target)
+        {
+            break;
+        }
+    }
+
+    return (0 == i) ? 0 : (unsigned int)((1ULL << i) - 1);
+}
+
+
+/***************************************************************************
+*   Function   : TcpInfoPrintSample
+*   Description: This routine writes one sample as key=value pairs on the
+*                current line (the caller writes the line's start and
+*                end).
+*   Parameters : sample - the sample to write.
+*                stream - where to write it.
+*   Effects    : The sample is written to stream.
+*   Returned   : None
+***************************************************************************/
+void TcpInfoPrintSample(const tcp_sample_t *sample, FILE *stream)
+{
+    unsigned int i;
+
+    if (0 == sample->when)
+    {
+        fprintf(stream, " not_sampled=1");
+        return;
+    }
+
+    for (i = 0; i < TI_NUM_FIELDS; i++)
+    {
+        fprintf(stream, " %s=%u", fieldNames[i], sample->value[i]);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : TcpInfoPrintDist
+*   Description: This routine writes the median, 99th percentile and
+*                maximum bucket of every field in a distribution as a
+*                single line of key=value pairs.
+*   Parameters : dist - the distribution.
+*                stream - where to write it.
+*   Effects    : The distribution is written to stream.
+*   Returned   : None
+***************************************************************************/
+void TcpInfoPrintDist(const tcpinfo_dist_t *dist, FILE *stream)
+{
+    unsigned int i;
+
+    fprintf(stream, "tcpinfo: clients=%lu", dist->samples);
+
+    for (i = 0; i < TI_NUM_FIELDS; i++)
+    {
+        fprintf(stream, " %s_p50=%u %s_p99=%u %s_max=%u",
+            fieldNames[i], TcpInfoPercentile(dist, i, 50.0),
+            fieldNames[i], TcpInfoPercentile(dist, i, 99.0),
+            fieldNames[i], TcpInfoPercentile(dist, i, 100.0));
+    }
+
+    fprintf(stream, "\n");
+}
@@ -0,0 +1,91 @@
+/***************************************************************************
+*                         TCP_INFO Sampling Header
+*
+*   File    : tcpinfo.h
+*   Purpose : This file provides the types and prototypes used to sample the
+*             kernel's TCP_INFO for connected sockets and to aggregate the
+*             samples into distributions.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* TCP Info: TCP_INFO sampling for the Berkeley socket examples
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef TCPINFO_H
+#define TCPINFO_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define TCPINFO_BUCKETS     32      /* log2 histogram buckets */
+
+typedef enum
+{
+    TI_RTT,                         /* smoothed round trip time (us) */
+    TI_RETRANS,                     /* total retransmitted segments */
+    TI_CWND,                        /* congestion window (segments) */
+    TI_UNACKED,                     /* unacknowledged segments */
+    TI_NOTSENT,                     /* bytes queued but not yet sent */
+    TI_NUM_FIELDS
+} tcpinfo_field_t;
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct tcp_sample_t
+{
+    long long when;                 /* time of the sample (ns), 0 = never */
+    unsigned int value[TI_NUM_FIELDS];
+} tcp_sample_t;
+
+typedef struct tcpinfo_dist_t
+{
+    unsigned long samples;          /* connections sampled */
+    unsigned long histogram[TI_NUM_FIELDS][TCPINFO_BUCKETS];
+} tcpinfo_dist_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int TcpInfoSample(int fd, tcp_sample_t *sample, long long now);
+void TcpInfoAdd(tcpinfo_dist_t *dist, const tcp_sample_t *sample);
+unsigned int TcpInfoPercentile(const tcpinfo_dist_t *dist,
+    tcpinfo_field_t field, double pct);
+void TcpInfoPrintSample(const tcp_sample_t *sample, FILE *stream);
+void TcpInfoPrintDist(const tcpinfo_dist_t *dist, FILE *stream);
+
+#endif  /* ndef TCPINFO_H */
@@ -0,0 +1,406 @@
+/***************************************************************************
+*                        Space-Saving Top-K Sketch
+*
+*   File    : topk.c
+*   Purpose : This file implements the Space-Saving algorithm (Metwally,
+*             Agrawal and El Abbadi, 2005) for finding the heaviest keys
+*             of a stream in constant space.  A sketch tracks TOPK_SIZE
+*             keys.  A key that isn't tracked replaces the lightest one
+*             and inherits its count, so a count is never too low and is
+*             too high by at most the recorded error.  Any key heavier
+*             than total / TOPK_SIZE is guaranteed to be tracked.
+*
+*             The entries form a min-heap on their counts, so the lightest
+*             is always at the top, and a small open addressing hash
+*             finds a key's entry.  An update is a hash probe and a short
+*             sift through a 16 entry heap: constant time, whatever the
+*             number of keys in the stream.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* TopK: Space-Saving heavy hitters for the echo server
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "topk.h"
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void Update(topk_t *topk, unsigned long long key,
+    unsigned long long weight, unsigned long long error);
+static unsigned int HomeSlot(unsigned long long key);
+static int Find(const topk_t *topk, unsigned long long key);
+static void Link(topk_t *topk, unsigned int entry);
+static void Unlink(topk_t *topk, unsigned int entry);
+static void Swap(topk_t *topk, unsigned int a, unsigned int b);
+static void SiftUp(topk_t *topk, unsigned int entry);
+static void SiftDown(topk_t *topk, unsigned int entry);
+static int CompareEntries(const void *e1, const void *e2);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : TopKAdd
+*   Description: This routine adds weight to a key's count.
+*   Parameters : topk - the sketch.
+*                key - the key (any value).
+*                weight - the weight added.
+*   Effects    : The key is tracked, possibly in place of the lightest.
+*   Returned   : None
+***************************************************************************/
+void TopKAdd(topk_t *topk, unsigned long long key, unsigned long long weight)
+{
+    topk->total += weight;
+    Update(topk, key, weight, 0);
+}
+
+
+/***************************************************************************
+*   Function   : TopKMerge
+*   Description: This routine adds the counts of another sketch to a
+*                sketch, for example to combine the sketches of several
+*                processes.  Counts of a key tracked by both are summed.
+*   Parameters : topk - the sketch being added to.
+*                from - the sketch being added.
+*   Effects    : topk includes the counts of from.
+*   Returned   : None
+***************************************************************************/
+void TopKMerge(topk_t *topk, const topk_t *from)
+{
+    unsigned int i;
+
+    topk->total += from->total;
+
+    for (i = 0; i < from->used; i++)
+    {
+        Update(topk, from->heap[i].key, from->heap[i].count,
+            from->heap[i].error);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : TopKSorted
+*   Description: This routine copies a sketch's entries, heaviest first.
+*   Parameters : topk - the sketch.
+*                entries - an array of TOPK_SIZE entries to fill.
+*   Effects    : None
+*   Returned   : The number of entries copied.
+***************************************************************************/
+unsigned int TopKSorted(const topk_t *topk, topk_entry_t *entries)
+{
+    memcpy(entries, topk->heap, topk->used * sizeof(topk_entry_t));
+    qsort(entries, topk->used, sizeof(topk_entry_t), CompareEntries);
+    return topk->used;
+}
+
+
+/***************************************************************************
+*   Function   : Update
+*   Description: This routine is the Space-Saving update.  A tracked key's
+*                count grows, a new key takes a free entry or else
+*                replaces the lightest key, starting from its count.
+*   Parameters : topk - the sketch.
+*                key - the key.
+*                weight - the weight added.
+*                error - error already in the weight (when merging).
+*   Effects    : The key is tracked.
+*   Returned   : None
+***************************************************************************/
+static void Update(topk_t *topk, unsigned long long key,
+    unsigned long long weight, unsigned long long error)
+{
+    topk_entry_t *entry;
+    int found;
+
+    found = Find(topk, key);
+
+    if (found >= 0)
+    {
+        entry = &(topk->heap[found]);
+        entry->count += weight;
+        entry->error += error;
+        SiftDown(topk, found);
+    }
+    else if (topk->used < TOPK_SIZE)
+    {
+        entry = &(topk->heap[topk->used]);
+        entry->key = key;
+        entry->count = weight;
+        entry->error = error;
+        Link(topk, topk->used);
+        topk->used++;
+        SiftUp(topk, topk->used - 1);
+    }
+    else
+    {
+        /* the lightest key is forgotten, the new one takes its count */
+        entry = &(topk->heap[0]);
+        Unlink(topk, 0);
+        entry->key = key;
+        entry->error = entry->count + error;
+        entry->count += weight;
+        Link(topk, 0);
+        SiftDown(topk, 0);
+    }
+}
+
+
+/***************************************************************************
+*   Function   : HomeSlot
+*   Description: This routine hashes a key (Fibonacci hashing).
+*   Parameters : key - the key.
+*   Effects    : None
+*   Returned   : The first hash slot to look for the key in.
+***************************************************************************/
+static unsigned int HomeSlot(unsigned long long key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 58) &
+        (TOPK_SLOTS - 1);
+}
+
+
+/***************************************************************************
+*   Function   : Find
+*   Description: This routine looks a key up in the hash.
+*   Parameters : topk - the sketch.
+*                key - the key.
+*   Effects    : None
+*   Returned   : The key's entry, or -1 if it isn't tracked.
+***************************************************************************/
+static int Find(const topk_t *topk, unsigned long long key)
+{
+    unsigned int slot;
+
+    slot = HomeSlot(key);
+
+    while (0 != topk->index[slot])
+    {
+        if (topk->heap[topk->index[slot] - 1].key == key)
+        {
+            return topk->index[slot] - 1;
+        }
+
+        slot = (slot + 1) & (TOPK_SLOTS - 1);
+    }
+
+    return -1;
+}
+
+
+/***************************************************************************
+*   Function   : Link
+*   Description: This routine puts an entry's key in the hash.
+*   Parameters : topk - the sketch.
+*                entry - the entry.
+*   Effects    : The key may be found.
+*   Returned   : None
+***************************************************************************/
+static void Link(topk_t *topk, unsigned int entry)
+{
+    unsigned int slot;
+
+    slot = HomeSlot(topk->heap[entry].key);
+
+    while (0 != topk->index[slot])
+    {
+        slot = (slot + 1) & (TOPK_SLOTS - 1);
+    }
+
+    topk->index[slot] = (unsigned char)(entry + 1);
+    topk->slot[entry] = (unsigned char)slot;
+}
+
+
+/***************************************************************************
+*   Function   : Unlink
+*   Description: This routine takes an entry's key out of the hash.  Keys
+*                after it in the probe sequence that could have used its
+*                slot are moved back, so no key is hidden behind a gap.
+*   Parameters : topk - the sketch.
+*                entry - the entry.
+*   Effects    : The key can't be found.
+*   Returned   : None
+***************************************************************************/
+static void Unlink(topk_t *topk, unsigned int entry)
+{
+    unsigned int gap, slot, home;
+
+    gap = topk->slot[entry];
+    topk->index[gap] = 0;
+    slot = gap;
+
+    for (;;)
+    {
+        slot = (slot + 1) & (TOPK_SLOTS - 1);
+
+        if (0 == topk->index[slot])
+        {
+            break;
+        }
+
+        home = HomeSlot(topk->heap[topk->index[slot] - 1].key);
+
+        /* leave it if its home is (cyclically) after the gap */
+        if (((slot - home) & (TOPK_SLOTS - 1)) <
+            ((slot - gap) & (TOPK_SLOTS - 1)))
+        {
+            continue;
+        }
+
+        topk->index[gap] = topk->index[slot];
+        topk->slot[topk->index[gap] - 1] = (unsigned char)gap;
+        topk->index[slot] = 0;
+        gap = slot;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Swap
+*   Description: This routine exchanges two heap entries, keeping the
+*                hash pointing at them.
+*   Parameters : topk - the sketch.
+*                a, b - the entries.
+*   Effects    : The entries are exchanged.
+*   Returned   : None
+***************************************************************************/
+static void Swap(topk_t *topk, unsigned int a, unsigned int b)
+{
+    topk_entry_t entry;
+    unsigned char slot;
+
+    entry = topk->heap[a];
+    topk->heap[a] = topk->heap[b];
+    topk->heap[b] = entry;
+
+    slot = topk->slot[a];
+    topk->slot[a] = topk->slot[b];
+    topk->slot[b] = slot;
+
+    topk->index[topk->slot[a]] = (unsigned char)(a + 1);
+    topk->index[topk->slot[b]] = (unsigned char)(b + 1);
+}
+
+
+/***************************************************************************
+*   Function   : SiftUp
+*   Description: This routine moves an entry toward the top of the heap
+*                until its parent is no heavier.
+*   Parameters : topk - the sketch.
+*                entry - the entry.
+*   Effects    : The heap is ordered.
+*   Returned   : None
+***************************************************************************/
+static void SiftUp(topk_t *topk, unsigned int entry)
+{
+    unsigned int parent;
+
+    while (entry > 0)
+    {
+        parent = (entry - 1) / 2;
+
+        if (topk->heap[parent].count <= topk->heap[entry].count)
+        {
+            break;
+        }
+
+        Swap(topk, parent, entry);
+        entry = parent;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : SiftDown
+*   Description: This routine moves an entry whose count grew away from
+*                the top of the heap until no child is lighter.
+*   Parameters : topk - the sketch.
+*                entry - the entry.
+*   Effects    : The heap is ordered.
+*   Returned   : None
+***************************************************************************/
+static void SiftDown(topk_t *topk, unsigned int entry)
+{
+    unsigned int child;
+
+    for (;;)
+    {
+        child = (2 * entry) + 1;
+
+        if (child >= topk->used)
+        {
+            break;
+        }
+
+        if (((child + 1) < topk->used) &&
+            (topk->heap[child + 1].count < topk->heap[child].count))
+        {
+            child++;
+        }
+
+        if (topk->heap[entry].count <= topk->heap[child].count)
+        {
+            break;
+        }
+
+        Swap(topk, entry, child);
+        entry = child;
+    }
+}
+
+
+/***************************************************************************
+*   Function   : CompareEntries
+*   Description: This routine is the qsort comparison for sorting entries
+*                heaviest first.
+*   Parameters : e1, e2 - the entries.
+*   Effects    : None
+*   Returned   : Less than 0 if e1 is heavier, 0 if they're equal and
+*                greater than 0 if e2 is heavier.
+***************************************************************************/
+static int CompareEntries(const void *e1, const void *e2)
+{
+    unsigned long long a = ((const topk_entry_t *)e1)->count;
+    unsigned long long b = ((const topk_entry_t *)e2)->count;
+
+    return (a < b) - (a > b);
+}
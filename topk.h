@@ -0,0 +1,80 @@
+/***************************************************************************
+*                        Space-Saving Top-K Sketch
+*
+*   File    : topk.h
+*   Purpose : This file provides the constants, types and prototypes for
+*             a fixed size sketch of the heaviest keys in a stream of
+*             weighted updates.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* TopK: Space-Saving heavy hitters for the echo server
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef TOPK_H
+#define TOPK_H
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define TOPK_SIZE       16          /* keys tracked by a sketch */
+#define TOPK_SLOTS      64          /* hash slots, a power of 2 */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct topk_entry_t
+{
+    unsigned long long key;
+    unsigned long long count;       /* estimated weight, never too low */
+    unsigned long long error;       /* most the estimate may be too high */
+} topk_entry_t;
+
+/* all zeros is an empty sketch, and it holds no pointers, so it may be
+   copied or kept in memory shared between processes */
+typedef struct topk_t
+{
+    unsigned long long total;       /* weight of every update */
+    unsigned int used;              /* entries in use */
+    topk_entry_t heap[TOPK_SIZE];   /* min-heap ordered by count */
+    unsigned char slot[TOPK_SIZE];  /* each entry's hash slot */
+    unsigned char index[TOPK_SLOTS];    /* entry + 1 in each slot, 0 empty */
+} topk_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+void TopKAdd(topk_t *topk, unsigned long long key, unsigned long long weight);
+void TopKMerge(topk_t *topk, const topk_t *from);
+unsigned int TopKSorted(const topk_t *topk, topk_entry_t *entries);
+
+#endif  /* ndef TOPK_H */
@@ -0,0 +1,558 @@
+/***************************************************************************
+*                          WebSocket Framing
+*
+*   File    : websock.c
+*   Purpose : This file implements the parts of WebSocket (RFC 6455) that
+*             the echo server's gateway mode needs: the opening handshake
+*             (with its SHA-1 and base64), parsing client frame headers,
+*             unmasking client payloads, and encoding server frame
+*             headers.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* WebSocket: Handshake and framing for the echo server's gateway mode
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "websock.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define WS_GUID     "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_KEY_SIZE 64      /* longer Sec-WebSocket-Key values are refused */
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static const char *FindHeader(const char *request, size_t length,
+    const char *name, size_t *valueLength);
+static void Sha1Block(uint32_t state[5], const unsigned char block[64]);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : WsIsUpgrade
+*   Description: This routine decides if the start of a connection's data
+*                could be a WebSocket opening handshake, which is an HTTP
+*                GET request.
+*   Parameters : request - the data received so far.
+*                length - the length of the data.
+*   Effects    : None
+*   Returned   : 1 if the data starts (or might start) with "GET ",
+*                otherwise 0.
+***************************************************************************/
+int WsIsUpgrade(const char *request, size_t length)
+{
+    if (length > 4)
+    {
+        length = 4;
+    }
+
+    return (memcmp(request, "GET ", length) == 0);
+}
+
+
+/***************************************************************************
+*   Function   : WsHandshake
+*   Description: This routine checks a complete opening handshake (the
+*                request through its blank line) and builds the 101
+*                response, whose Sec-WebSocket-Accept is the base64 SHA-1
+*                of the client's key and the protocol's GUID.
+*   Parameters : request - the HTTP request.
+*                length - the length of the request.
+*                response - buffer receiving the response.
+*                size - the size of the response buffer.
+*   Effects    : The response is written to response.
+*   Returned   : The length of the response, or -1 if the request isn't
+*                a WebSocket upgrade.
+***************************************************************************/
+int WsHandshake(const char *request, size_t length, char *response,
+    size_t size)
+{
+    const char *value;
+    size_t valueLength;
+    char key[WS_KEY_SIZE + sizeof(WS_GUID)];
+    unsigned char digest[20];
+    char accept[32];
+    int result;
+
+    value = FindHeader(request, length, "Upgrade", &valueLength);
+
+    if ((NULL == value) || (valueLength != 9) ||
+        (strncasecmp(value, "websocket", 9) != 0))
+    {
+        return -1;
+    }
+
+    value = FindHeader(request, length, "Sec-WebSocket-Key", &valueLength);
+
+    if ((NULL == value) || (0 == valueLength) || (valueLength > WS_KEY_SIZE))
+    {
+        return -1;
+    }
+
+    memcpy(key, value, valueLength);
+    memcpy(key + valueLength, WS_GUID, sizeof(WS_GUID) - 1);
+    WsSha1(key, valueLength + sizeof(WS_GUID) - 1, digest);
+    WsBase64(digest, sizeof(digest), accept);
+
+    result = snprintf(response, size,
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+
+    return ((result < 0) || ((size_t)result >= size)) ? -1 : result;
+}
+
+
+/***************************************************************************
+*   Function   : FindHeader
+*   Description: This routine finds an HTTP header by name (ignoring case)
+*                and returns its value without surrounding white space.
+*   Parameters : request - the HTTP request.
+*                length - the length of the request.
+*                name - the header's name.
+*                valueLength - set to the length of the value.
+*   Effects    : None
+*   Returned   : The value, or NULL if the header isn't there.
+***************************************************************************/
+static const char *FindHeader(const char *request, size_t length,
+    const char *name, size_t *valueLength)
+{
+    const char *line, *end, *next, *value;
+    size_t nameLength;
+
+    nameLength = strlen(name);
+    end = request + length;
+    line = memchr(request, '\n', length);      /* skip the request line */
+
+    while ((NULL != line) && (++line < end))
+    {
+        next = memchr(line, '\n', end - line);
+
+        if (NULL == next)
+        {
+            next = end;
+        }
+
+        if (((size_t)(next - line) > nameLength) && (':' == line[nameLength]) &&
+            (strncasecmp(line, name, nameLength) == 0))
+        {
+            value = line + nameLength + 1;
+
+            while ((value < next) && ((' ' == *value) || ('\t' == *value)))
+            {
+                value++;
+            }
+
+            while ((next > value) && ((' ' == next[-1]) ||
+                ('\t' == next[-1]) || ('\r' == next[-1]) ||
+                ('\n' == next[-1])))
+            {
+                next--;
+            }
+
+            *valueLength = next - value;
+            return value;
+        }
+
+        line = (next < end) ? next : NULL;
+    }
+
+    return NULL;
+}
+
+
+/***************************************************************************
+*   Function   : WsParseFrame
+*   Description: This routine parses a frame header: the FIN and RSV bits,
+*                the opcode, the 7, 16 or 64 bit payload length and the
+*                mask key.
+*   Parameters : data - the received data, starting with a frame.
+*                length - the length of the data.
+*                frame - set to the parsed header.
+*   Effects    : None
+*   Returned   : 1 if the header is complete, 0 if more data is needed.
+***************************************************************************/
+int WsParseFrame(const unsigned char *data, size_t length,
+    ws_frame_t *frame)
+{
+    size_t needed;
+    int i;
+
+    if (length < 2)
+    {
+        return 0;
+    }
+
+    frame->fin = (data[0] >> 7) & 1;
+    frame->reserved = (data[0] >> 4) & 7;
+    frame->opcode = data[0] & 0x0F;
+    frame->masked = (data[1] >> 7) & 1;
+    frame->payloadLength = data[1] & 0x7F;
+    needed = 2;
+
+    if (126 == frame->payloadLength)
+    {
+        needed += 2;
+    }
+    else if (127 == frame->payloadLength)
+    {
+        needed += 8;
+    }
+
+    if (frame->masked)
+    {
+        needed += 4;
+    }
+
+    if (length < needed)
+    {
+        return 0;
+    }
+
+    if (126 == frame->payloadLength)
+    {
+        frame->payloadLength = ((unsigned int)data[2] << 8) | data[3];
+    }
+    else if (127 == frame->payloadLength)
+    {
+        frame->payloadLength = 0;
+
+        for (i = 2; i < 10; i++)
+        {
+            frame->payloadLength = (frame->payloadLength << 8) | data[i];
+        }
+    }
+
+    if (frame->masked)
+    {
+        memcpy(frame->mask, data + needed - 4, 4);
+    }
+
+    frame->headerLength = needed;
+    return 1;
+}
+
+
+/***************************************************************************
+*   Function   : WsEncodeHeader
+*   Description: This routine encodes the header of an unfragmented,
+*                unmasked (server to client) frame.
+*   Parameters : header - buffer of at least WS_MAX_HEADER bytes.
+*                opcode - the frame's WS_OP_ opcode.
+*                length - the payload length.
+*   Effects    : The header is written to header.
+*   Returned   : The length of the header.
+***************************************************************************/
+size_t WsEncodeHeader(unsigned char *header, int opcode, size_t length)
+{
+    int i;
+
+    header[0] = 0x80 | (opcode & 0x0F);
+
+    if (length < 126)
+    {
+        header[1] = (unsigned char)length;
+        return 2;
+    }
+
+    if (length <= 0xFFFF)
+    {
+        header[1] = 126;
+        header[2] = (unsigned char)(length >> 8);
+        header[3] = (unsigned char)length;
+        return 4;
+    }
+
+    header[1] = 127;
+
+    for (i = 9; i >= 2; i--)
+    {
+        header[i] = (unsigned char)length;
+        length >>= 8;
+    }
+
+    return 10;
+}
+
+
+/***************************************************************************
+*   Function   : WsUnmask
+*   Description: This routine unmasks a client payload in place, XORing
+*                byte i with mask[i % 4].  The mask is repeated across a
+*                vector register (32 bytes with AVX2, 16 with SSE2), then
+*                a 64 bit word, so only the last few bytes are handled
+*                one at a time.
+*   Parameters : data - the payload.
+*                length - the length of the payload.
+*                mask - the frame's mask key.
+*   Effects    : The payload is unmasked.
+*   Returned   : None
+***************************************************************************/
+void WsUnmask(unsigned char *data, size_t length,
+    const unsigned char mask[4])
+{
+    uint32_t mask32;
+    uint64_t mask64, word;
+    size_t i;
+
+    memcpy(&mask32, mask, 4);
+    mask64 = ((uint64_t)mask32 << 32) | mask32;
+    i = 0;
+
+#if defined(__AVX2__)
+    {
+        __m256i vmask = _mm256_set1_epi32((int)mask32);
+
+        for (; (i + 32) <= length; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+            _mm256_storeu_si256((__m256i *)(data + i),
+                _mm256_xor_si256(v, vmask));
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128i vmask = _mm_set1_epi32((int)mask32);
+
+        for (; (i + 16) <= length; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            _mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, vmask));
+        }
+    }
+#endif
+
+    /* every step so far was a multiple of 4, so the mask is still aligned */
+    for (; (i + 8) <= length; i += 8)
+    {
+        memcpy(&word, data + i, 8);
+        word ^= mask64;
+        memcpy(data + i, &word, 8);
+    }
+
+    for (; i < length; i++)
+    {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+
+/***************************************************************************
+*   Function   : WsSha1
+*   Description: This routine computes the SHA-1 digest of data.  SHA-1 is
+*                only used for the handshake's accept key, so a small
+*                straightforward implementation is enough.
+*   Parameters : data - the data to digest.
+*                length - the length of the data.
+*                digest - receives the 20 byte digest.
+*   Effects    : The digest is written to digest.
+*   Returned   : None
+***************************************************************************/
+void WsSha1(const void *data, size_t length, unsigned char digest[20])
+{
+    uint32_t state[5] =
+        {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const unsigned char *bytes;
+    unsigned char block[64];
+    unsigned long long bits;
+    size_t remaining;
+    int i;
+
+    bytes = (const unsigned char *)data;
+    bits = (unsigned long long)length * 8;
+
+    for (remaining = length; remaining >= 64; remaining -= 64)
+    {
+        Sha1Block(state, bytes);
+        bytes += 64;
+    }
+
+    /* pad with 0x80, zeros and the length in bits */
+    memset(block, 0, sizeof(block));
+    memcpy(block, bytes, remaining);
+    block[remaining] = 0x80;
+
+    if (remaining >= 56)
+    {
+        Sha1Block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        block[63 - i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    Sha1Block(state, block);
+
+    for (i = 0; i < 20; i++)
+    {
+        digest[i] = (unsigned char)(state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+
+/***************************************************************************
+*   Function   : Sha1Block
+*   Description: This routine runs the SHA-1 compression function on one
+*                64 byte block.
+*   Parameters : state - the digest state.
+*                block - the block.
+*   Effects    : state is updated.
+*   Returned   : None
+***************************************************************************/
+static void Sha1Block(uint32_t state[5], const unsigned char block[64])
+{
+    uint32_t w[80];
+    uint32_t a, b, c, d, e, f, k, temp;
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)block[4 * i] << 24) |
+            ((uint32_t)block[4 * i + 1] << 16) |
+            ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+
+    for (i = 16; i < 80; i++)
+    {
+        temp = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+        w[i] = (temp << 1) | (temp >> 31);
+    }
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    for (i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        temp = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = (b << 30) | (b >> 2);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+
+/***************************************************************************
+*   Function   : WsBase64
+*   Description: This routine base64 encodes data.
+*   Parameters : data - the data to encode.
+*                length - the length of the data.
+*                out - receives the encoding and a '\0', at least
+*                4 * ((length + 2) / 3) + 1 bytes.
+*   Effects    : The encoding is written to out.
+*   Returned   : The length of the encoding.
+***************************************************************************/
+size_t WsBase64(const unsigned char *data, size_t length, char *out)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i, o;
+    uint32_t group;
+
+    o = 0;
+
+    for (i = 0; i < length; i += 3)
+    {
+        group = (uint32_t)data[i] << 16;
+
+        if ((i + 1) < length)
+        {
+            group |= (uint32_t)data[i + 1] << 8;
+        }
+
+        if ((i + 2) < length)
+        {
+            group |= data[i + 2];
+        }
+
+        out[o++] = digits[(group >> 18) & 0x3F];
+        out[o++] = digits[(group >> 12) & 0x3F];
+        out[o++] = ((i + 1) < length) ? digits[(group >> 6) & 0x3F] : '=';
+        out[o++] = ((i + 2) < length) ? digits[group & 0x3F] : '=';
+    }
+
+    out[o] = '\0';
+    return o;
+}
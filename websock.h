@@ -0,0 +1,99 @@
+/***************************************************************************
+*                          WebSocket Framing
+*
+*   File    : websock.h
+*   Purpose : This file provides the constants, types, and prototypes for
+*             the WebSocket (RFC 6455) handshake and framing used by the
+*             echo server's gateway mode.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* WebSocket: Handshake and framing for the echo server's gateway mode
+* Copyright (C) 2026 by Michael Dipperstein (mdipperstein@gmail.com)
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its contributors
+* may be used to endorse or promote products derived from this software without
+* specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+***************************************************************************/
+#ifndef WEBSOCK_H
+#define WEBSOCK_H
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define WS_OP_CONTINUE      0x0
+#define WS_OP_TEXT          0x1
+#define WS_OP_BINARY        0x2
+#define WS_OP_CLOSE         0x8
+#define WS_OP_PING          0x9
+#define WS_OP_PONG          0xA
+
+#define WS_MAX_HEADER       14      /* largest frame header (masked) */
+#define WS_RESPONSE_SIZE    256     /* room for the handshake response */
+
+/* close status codes */
+#define WS_CLOSE_NORMAL     1000
+#define WS_CLOSE_PROTOCOL   1002
+#define WS_CLOSE_TOO_BIG    1009
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* a parsed frame header */
+typedef struct ws_frame_t
+{
+    int fin;                        /* last frame of a message */
+    int opcode;                     /* WS_OP_ */
+    int masked;                     /* client frames must be masked */
+    int reserved;                   /* RSV bits, must be 0 */
+    unsigned char mask[4];
+    size_t headerLength;
+    unsigned long long payloadLength;
+} ws_frame_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+int WsIsUpgrade(const char *request, size_t length);
+int WsHandshake(const char *request, size_t length, char *response,
+    size_t size);
+int WsParseFrame(const unsigned char *data, size_t length,
+    ws_frame_t *frame);
+size_t WsEncodeHeader(unsigned char *header, int opcode, size_t length);
+void WsUnmask(unsigned char *data, size_t length,
+    const unsigned char mask[4]);
+
+void WsSha1(const void *data, size_t length, unsigned char digest[20]);
+size_t WsBase64(const unsigned char *data, size_t length, char *out);
+
+#endif  /* ndef WEBSOCK_H */